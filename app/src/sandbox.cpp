@@ -30,7 +30,6 @@ Sandbox::Sandbox(const std::filesystem::path& working_dir)
 
 	// First a window, device and swap chain are initialised in the base class
 	loadGameObjects();
-	createUniformBuffers();
 	createDescriptors();
 	initSystems();
 	initUI();
@@ -51,38 +50,83 @@ VeFrameInfo Sandbox::update() {
 	auto& compute_command_buffer = m_ve_renderer.getCurrentComputeCommandBuffer();
 	auto current_frame = m_ve_renderer.getCurrentFrame();
 	VeFrameInfo frame_info = {
-		.global_descriptor_set = m_global_descriptor_sets[current_frame],
+		.global_descriptor_set = m_global_descriptor_set,
 		.material_descriptor_set = m_material_descriptor_set,
 		.cubemap_descriptor_set = m_cubemap_descriptor_set,
 		.command_buffer = command_buffer,
 		.compute_command_buffer = compute_command_buffer,
+		.frame_ring = m_frame_ring,
+		.render_queue = m_render_queue,
 		.game_objects = m_game_objects,
 		.frame_time = m_frame_time,
 		.total_time = m_total_time,
-		.current_frame = current_frame
+		.current_frame = current_frame,
+		.texture_descriptor_set = m_texture_registry.getDescriptorSet(),
+		.sample_count = m_ve_renderer.getSampleCount()
 	};
 
+	// Render scale of this frame from the GPU time of the last finished one
+	updateRenderScale();
+	// A new msaa sample count is applied by the renderer when the next frame begins
+	ui_context.sample_count = static_cast<uint32_t>(
+		m_ve_renderer.setSampleCount(static_cast<vk::SampleCountFlagBits>(ui_context.sample_count)));
+	// Mode of the frame being recorded, a change from the UI is applied by the renderer
+	// when the next frame begins
+	m_particle_system->setAsyncCompute(m_ve_renderer.isAsyncCompute());
+	m_ve_renderer.setAsyncCompute(ui_context.async_compute);
+	ui_context.gpu_compute_time = m_ve_renderer.getGpuComputeTime();
+	ui_context.gpu_overlap_time = m_ve_renderer.getGpuOverlapTime();
+
 	// Updates camera state based on input and frame time. Returns actions for systems.
 	auto actions = m_input_controller.processInput(m_frame_time, m_camera);
 
 	// Update state based on actions and ui_context updated in previous renderUI
 	ui_context.visible = actions.ui_visible; // Tab toggles UI visibility
 	updateCamera();
+	const VeFrustum frustum = VeFrustum::fromViewProj(m_camera.getProj() * m_camera.getView());
+	m_particle_system->setFrustum(frustum);
 	updateParticles(frame_info, actions);
+	// Upload the data of new and moved objects, then cull them against the camera.
+	// On the GPU the kernel is recorded into the graphics command buffer after the uploads.
+	m_simple_render_system->updateObjects(frame_info);
+	ui_context.uploaded_objects = m_simple_render_system->getUploadedCount();
+	m_simple_render_system->setCullMode(static_cast<SimpleRenderSystem::CullMode>(ui_context.cull_mode));
+	m_simple_render_system->cullObjects(frame_info, frustum);
+	ui_context.visible_objects = m_simple_render_system->getVisibleCount();
+	ui_context.culled_objects = m_simple_render_system->getCulledCount();
+	// Bin the lights into clusters for the fragment shaders
+	m_point_light_system->update(frame_info, *m_light_cluster_system);
+	UniformBufferObject ubo{};
+	ubo.light_clusters = m_light_cluster_system->record(
+		*frame_info.compute_command_buffer, current_frame, m_camera, m_ve_renderer.getRenderExtent());
+	frame_info.light_descriptor_set = m_light_cluster_system->getRenderSet(current_frame);
+	m_ve_renderer.submitCompute(frame_info.compute_command_buffer);
 	updateWindowTitle();
 
 	// update global ubo
-	UniformBufferObject ubo{};
-	m_point_light_system->update(frame_info, ubo);
-	updateUniformBuffer(current_frame, ubo);
+	frame_info.global_ubo_offset = updateUniformBuffer(ubo);
 
 	return frame_info;
 }
 
+// With dynamic resolution the controller sets the scale, otherwise the UI slider does
+void Sandbox::updateRenderScale() {
+	const float gpu_time = m_ve_renderer.getGpuFrameTime();
+	if (ui_context.dynamic_resolution) {
+		m_dynamic_resolution.setTargetTime(ui_context.target_gpu_time);
+		ui_context.render_scale = m_dynamic_resolution.update(gpu_time);
+	} else {
+		m_dynamic_resolution.reset(ui_context.render_scale);
+	}
+	m_ve_renderer.setRenderScale(ui_context.render_scale);
+	ui_context.render_scale = m_ve_renderer.getRenderScale();
+	ui_context.gpu_time = gpu_time;
+}
+
 // Update particle system based on input actions and UI context
 void Sandbox::updateParticles(VeFrameInfo& frame_info, InputActions& actions) {
 	// Apply input actions
-	if (actions.set_mode >= 1 && actions.set_mode <= 5) {
+	if (actions.set_mode >= 1 && actions.set_mode <= 6) {
 		m_particle_system->setMode(actions.set_mode);
 	}
 	if (actions.reset_particles) {
@@ -104,35 +148,80 @@ void Sandbox::updateParticles(VeFrameInfo& frame_info, InputActions& actions) {
 
 	m_particle_system->setMean(ui_context.particle_velocity_mean);
 	m_particle_system->setStddev(ui_context.particle_velocity_stddev);
+	m_particle_system->setStorageMode(ui_context.particles_in_place ? ParticleStorageMode::IN_PLACE : ParticleStorageMode::PER_FRAME);
+	m_particle_system->setFrustumCulling(ui_context.particle_culling);
+	ui_context.particle_memory = m_particle_system->getMemoryUsage();
 	ui_context.apply_velocity_params = false; // not used currently
 
 
-	// Record and submit particle compute work
+	// The fence of this frame index has signaled, so its last alive count is complete
+	ui_context.emitter_alive = m_particle_emitter->getLastAliveCount(frame_info.current_frame);
+	m_particle_emitter->setEmitRate(ui_context.emitter_rate);
+	if (ui_context.emitter_burst) {
+		m_particle_emitter->burst(m_particle_emitter->getCapacity() / 4);
+		ui_context.emitter_burst = false;
+	}
+	ui_context.particle_memory += m_particle_emitter->getMemoryUsage();
+
+	// Record particle compute work, submitted together with culling in update()
 	m_particle_system->update(frame_info);
-	m_ve_renderer.submitCompute(frame_info.compute_command_buffer);
+	m_particle_emitter->update(frame_info);
 }
 
 // Renders the scene and draws the UI
 void Sandbox::render(VeFrameInfo& frame_info) {	
 	auto& command_buffer = frame_info.command_buffer;
-	m_ve_renderer.beginSceneRender(command_buffer);
 
-	// systems
+	// systems submit their draws, the queue records them sorted by state
+	m_render_queue.begin(m_camera.getView());
 	m_skybox_render_system->render(frame_info);
 	m_simple_render_system->renderObjects(frame_info);
 	m_axes_render_system->render(frame_info);
 	m_point_light_system->render(frame_info);
 	m_particle_system->render(frame_info);
-
+	m_particle_emitter->render(frame_info);
+
+	// Large queues are recorded in chunks on the worker threads, each into a secondary command buffer
+	const uint32_t chunk_count = m_render_queue.getChunkCount(m_thread_pool, RECORD_PACKETS_PER_CHUNK,
+		VeRenderQueue::PASS_BACKGROUND, VeRenderQueue::PASS_TRANSPARENT);
+	m_ve_renderer.beginSceneRender(command_buffer, chunk_count > 1);
+	if (chunk_count > 1) {
+		m_ve_renderer.prepareSecondaryCommandBuffers(chunk_count);
+		const auto& secondary_buffers = m_render_queue.recordParallel(m_thread_pool, chunk_count, [this](uint32_t chunk) {
+			return m_ve_renderer.beginSecondaryCommandBuffer(chunk);
+		}, VeRenderQueue::PASS_BACKGROUND, VeRenderQueue::PASS_TRANSPARENT);
+		command_buffer.executeCommands(secondary_buffers);
+	} else {
+		m_render_queue.record(*command_buffer, VeRenderQueue::PASS_BACKGROUND, VeRenderQueue::PASS_TRANSPARENT);
+	}
 	m_ve_renderer.endSceneRender(command_buffer);
 
+	// Order independent transparency accumulates against the scene depth, then is blended over the scene
+	m_ve_renderer.beginTransparentRender(command_buffer);
+	m_render_queue.record(*command_buffer, VeRenderQueue::PASS_OIT, VeRenderQueue::PASS_OIT);
+	m_ve_renderer.endTransparentRender(command_buffer);
+	m_ve_renderer.beginCompositeRender(command_buffer);
+	m_oit_composite_system->render(*command_buffer, m_ve_renderer.getOitAccumImage(), m_ve_renderer.getOitWeightImage());
+	m_ve_renderer.endCompositeRender(command_buffer);
+
+	const VeRenderQueue::Stats& queue_stats = m_render_queue.getStats();
+	ui_context.draw_packets = queue_stats.packets;
+	ui_context.binds = queue_stats.binds;
+	ui_context.binds_saved = queue_stats.binds_saved;
+
+	// Stretch the scene over the swap chain image, the UI is drawn on top at full resolution
+	m_ve_renderer.beginPresentRender(command_buffer);
+	m_upscale_system->setSharpness(ui_context.upscale_sharpness);
+	m_upscale_system->render(*command_buffer, m_ve_renderer.getSceneImage(), m_ve_renderer.getRenderExtent());
+	m_ve_renderer.endPresentRender(command_buffer);
+
 	// Draw UI and update ui_context for next frame intents
 	imgui_layer->renderUI(ui_context);
 }
 
 void Sandbox::loadGameObjects() {
 	// Create some lights with ranging colors
-	constexpr uint32_t num_lights = 17; // max 100 see config
+	constexpr uint32_t num_lights = 17;
 	constexpr float intensity = 0.3f;
 	constexpr float radius = 1.0f;
 	const glm::vec3 colors[10] = {
@@ -172,9 +261,8 @@ void Sandbox::loadGameObjects() {
 
 	// Floor
 	VeGameObject floor = VeGameObject::createGameObject();
-	auto quad = std::make_shared<VeModel>(m_ve_device, m_quad_model_path);
+	auto quad = std::make_shared<VeModel>(m_mesh_arena, m_quad_model_path);
 	floor.ve_model = quad;
-	floor.has_texture = 0.0f;
 	floor.transform = {
 		.translation = {0.0f, 0.0f, -0.1f},
 		.scale = {80.0f, 80.0f, 8.0f}
@@ -182,19 +270,20 @@ void Sandbox::loadGameObjects() {
 	m_game_objects.emplace(floor.getId(), std::move(floor));
 
 	// Textured viking rooms in a grid
-	std::shared_ptr<VeModel> model = std::make_shared<VeModel>(m_ve_device, m_viking_room_model_path);
+	const uint32_t viking_room_texture = m_texture_registry.add(m_texture);
+	std::shared_ptr<VeModel> model = std::make_shared<VeModel>(m_mesh_arena, m_viking_room_model_path);
 	for (int j = 0; j < 10; j++) {
 		for (int i = 0; i < 10; i++) {
 			VeGameObject obj = VeGameObject::createGameObject();
 			obj.ve_model = model;
 			obj.transform.translation = {(float)i * 4.0f, (float)j * 4.0f, 0.f};
-			obj.has_texture = 1.0f;
+			obj.texture_index = viking_room_texture;
 			m_game_objects.emplace(obj.getId(), std::move(obj));
 		}
 	}
 
 	// Cubes in a grid
-	std::shared_ptr<VeModel> model2 = std::make_shared<VeModel>(m_ve_device, m_cube_model_path);
+	std::shared_ptr<VeModel> model2 = std::make_shared<VeModel>(m_mesh_arena, m_cube_model_path);
 	for (int j = 0; j < 10; j++) {
 		for (int i = 0; i < 10; i++) {
 			VeGameObject obj = VeGameObject::createGameObject();
@@ -205,7 +294,7 @@ void Sandbox::loadGameObjects() {
 		}
 	}
 	// Flat vases in a grid
-	std::shared_ptr<VeModel> model3 = std::make_shared<VeModel>(m_ve_device, m_flat_vase_model_path);
+	std::shared_ptr<VeModel> model3 = std::make_shared<VeModel>(m_mesh_arena, m_flat_vase_model_path);
 	for (int j = 0; j < 10; j++) {
 		for (int i = 0; i < 10; i++) {
 			VeGameObject obj = VeGameObject::createGameObject();
@@ -219,7 +308,7 @@ void Sandbox::loadGameObjects() {
 		}
 	}
 	// Smooth vases in a grid
-	std::shared_ptr<VeModel> model4 = std::make_shared<VeModel>(m_ve_device, m_smooth_vase_model_path);
+	std::shared_ptr<VeModel> model4 = std::make_shared<VeModel>(m_mesh_arena, m_smooth_vase_model_path);
 	for (int j = 0; j < 10; j++) {
 		for (int i = 0; i < 10; i++) {
 			VeGameObject obj = VeGameObject::createGameObject();
@@ -235,59 +324,31 @@ void Sandbox::loadGameObjects() {
 
 }
 
-void Sandbox::createUniformBuffers() {
-	vk::DeviceSize buffer_size = sizeof(UniformBufferObject);
-	assert(buffer_size > 0 && "Uniform buffer size is zero");
-	assert(buffer_size % 16 == 0 && "Uniform buffer size must be a multiple of 16 bytes");
-	assert(buffer_size <= m_ve_device.getDeviceProperties().limits.maxUniformBufferRange && "Uniform buffer size exceeds maximum limit");
-
-	m_uniform_buffers.clear();
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		m_uniform_buffers.emplace_back(std::make_unique<VeBuffer>(
-			m_ve_device,
-			buffer_size,
-			1,
-			vk::BufferUsageFlagBits::eUniformBuffer,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-			m_ve_device.getDeviceProperties().limits.minUniformBufferOffsetAlignment
-		));
-		m_uniform_buffers[i]->map();
-	}
-}
-
 void Sandbox::createDescriptors() {
+	// Sized for the sets of a typical scene, replaced sets stay allocated in the retirement
+	// queue for a few frames. When a block runs out the pool chains another one of this size.
 	m_global_pool = VeDescriptorPool::Builder(m_ve_device)
-		// Global sets (per-frame) + compute sets (per-frame) + material set (2) + slack
-		.setMaxSets(2 * MAX_FRAMES_IN_FLIGHT + 4)
-		// Uniform buffers: global (per frame) + compute (per frame)
-		.addPoolSize(vk::DescriptorType::eUniformBuffer, 2 * MAX_FRAMES_IN_FLIGHT)
-		// Sampler for material sets
-		.addPoolSize(vk::DescriptorType::eCombinedImageSampler, 2)
-		// Compute storage buffers: 2 per frame (prev + current)
-		.addPoolSize(vk::DescriptorType::eStorageBuffer, 2 * MAX_FRAMES_IN_FLIGHT)
+		.setMaxSets(64)
+		.addPoolSize(vk::DescriptorType::eUniformBufferDynamic, 32)
+		.addPoolSize(vk::DescriptorType::eCombinedImageSampler, 16)
+		.addPoolSize(vk::DescriptorType::eStorageBuffer, 256)
 		.setPoolFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
 		.buildShared();
 
 	m_global_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
-		.addBinding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eAllGraphics)
+		.addBinding(0, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eAllGraphics)
 		.build();
 
 	m_material_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
 		.addBinding(0, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment)
 		.build();
 
-	// create descriptor sets from global pool with global layout
-	m_global_descriptor_sets.clear();
-	m_global_descriptor_sets.reserve(MAX_FRAMES_IN_FLIGHT);
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		auto buffer_info = m_uniform_buffers[i]->getDescriptorInfo();
-		vk::raii::DescriptorSet set{nullptr};
-		VeDescriptorWriter(*m_global_set_layout, *m_global_pool)
-			.writeBuffer(0, &buffer_info)
-			.build(set);
-		m_global_descriptor_sets.push_back(std::move(set));
-	}
+	// One global set for all frames, the ubo lives in the frame ring and is selected by dynamic offset
+	assert(sizeof(UniformBufferObject) <= m_ve_device.getDeviceProperties().limits.maxUniformBufferRange && "Uniform buffer size exceeds maximum limit");
+	auto buffer_info = m_frame_ring.getDescriptorInfo(sizeof(UniformBufferObject));
+	VeDescriptorWriter(*m_global_set_layout, *m_global_pool)
+		.writeBuffer(0, &buffer_info)
+		.build(m_global_descriptor_set);
 
 	// Create one material descriptor set for current texture
 	auto image_info = m_texture.getDescriptorInfo();
@@ -308,17 +369,29 @@ void Sandbox::initSystems() {
 	VE_LOGD("Sandbox::initSystems");
 	VE_LOGD("Working directory: " << working_directory);
 
+	VE_LOGD("light cluster system: " << working_directory / "shaders" / "light_cluster_kernel.spv");
+	m_light_cluster_system = std::make_unique<LightClusterSystem>(
+		m_ve_device,
+		m_global_pool,
+		m_frame_ring,
+		working_directory / "shaders" / "light_cluster_kernel.spv"
+	);
 	VE_LOGD("simple system: " << working_directory / "shaders" / "simple_shader.spv");
 	m_simple_render_system = std::make_unique<SimpleRenderSystem>(
 		m_ve_device,
 		m_global_set_layout->getDescriptorSetLayout(),
-		m_material_set_layout->getDescriptorSetLayout(),
+		m_texture_registry.getSetLayout(),
+		m_light_cluster_system->getRenderSetLayout(),
+		m_global_pool,
+		m_frame_ring,
 		m_ve_renderer.getSwapChainImageFormat(),
-		working_directory / "shaders" / "simple_shader.spv"
+		working_directory / "shaders" / "simple_shader.spv",
+		working_directory / "shaders" / "cull_kernel.spv"
 	);
 	VE_LOGD("axes system: " << working_directory / "shaders" / "axes_shader.spv");
 	m_axes_render_system = std::make_unique<AxesRenderSystem>(
 		m_ve_device,
+		m_mesh_arena,
 		m_global_set_layout->getDescriptorSetLayout(),
 		m_ve_renderer.getSwapChainImageFormat(),
 		working_directory / "shaders" / "axes_shader.spv"
@@ -335,21 +408,46 @@ void Sandbox::initSystems() {
 	m_particle_system = std::make_unique<ParticleSystem>(
 		m_ve_device,
 		m_global_pool,
+		m_frame_ring,
 		m_global_set_layout->getDescriptorSetLayout(),
-		m_ve_renderer.getSwapChainImageFormat(),
 		434567, // number of particles
 		glm::vec3{0.0f, -200.0f, 10.0f},
 		working_directory / "shaders" / "particle_compute.spv"
 	);
+	VE_LOGD("particle emitter: " << working_directory / "shaders" / "particle_emitter_kernel.spv");
+	m_particle_emitter = std::make_unique<ParticleEmitterSystem>(
+		m_ve_device,
+		m_global_pool,
+		m_global_set_layout->getDescriptorSetLayout(),
+		PARTICLE_EMITTER_CAPACITY,
+		glm::vec3{30.0f, -200.0f, 0.0f},
+		working_directory / "shaders" / "particle_emitter_kernel.spv",
+		working_directory / "shaders" / "particle_compute.spv"
+	);
 	VE_LOGD("skybox system: " << working_directory / "shaders" / "skybox_shader.spv");
 	m_skybox_render_system = std::make_unique<SkyboxRenderSystem>(
 		m_ve_device,
+		m_mesh_arena,
 		m_global_set_layout->getDescriptorSetLayout(),
 		m_material_set_layout->getDescriptorSetLayout(),
 		m_ve_renderer.getSwapChainImageFormat(),
 		working_directory / "shaders" / "skybox_shader.spv",
 		working_directory / "models" / "cube.obj"
 	);
+	VE_LOGD("upscale system: " << working_directory / "shaders" / "upscale_shader.spv");
+	m_upscale_system = std::make_unique<UpscaleSystem>(
+		m_ve_device,
+		m_global_pool,
+		m_ve_renderer.getSwapChainImageFormat(),
+		working_directory / "shaders" / "upscale_shader.spv"
+	);
+	VE_LOGD("OIT composite system: " << working_directory / "shaders" / "oit_composite_shader.spv");
+	m_oit_composite_system = std::make_unique<OitCompositeSystem>(
+		m_ve_device,
+		m_global_pool,
+		m_ve_renderer.getSwapChainImageFormat(),
+		working_directory / "shaders" / "oit_composite_shader.spv"
+	);
 }
 
 void Sandbox::initUI() {
@@ -361,7 +459,29 @@ void Sandbox::initUI() {
 		.reset_particle_count = false,
 		.particle_velocity_mean = m_particle_system->getMean(),
 		.particle_velocity_stddev = m_particle_system->getStddev(),
-		.apply_velocity_params = false
+		.apply_velocity_params = false,
+		.particles_in_place = m_particle_system->getStorageMode() == ParticleStorageMode::IN_PLACE,
+		.particle_memory = m_particle_system->getMemoryUsage() + m_particle_emitter->getMemoryUsage(),
+		.particle_culling = m_particle_system->getFrustumCulling(),
+		.emitter_rate = m_particle_emitter->getEmitRate(),
+		.emitter_burst = false,
+		.emitter_alive = 0,
+		.cull_mode = static_cast<int>(m_simple_render_system->getCullMode()),
+		.visible_objects = 0,
+		.culled_objects = 0,
+		.uploaded_objects = 0,
+		.draw_packets = 0,
+		.binds = 0,
+		.binds_saved = 0,
+		.dynamic_resolution = false,
+		.target_gpu_time = m_dynamic_resolution.getTargetTime(),
+		.render_scale = m_ve_renderer.getRenderScale(),
+		.upscale_sharpness = m_upscale_system->getSharpness(),
+		.gpu_time = 0.0f,
+		.async_compute = m_ve_renderer.isAsyncCompute(),
+		.gpu_compute_time = 0.0f,
+		.gpu_overlap_time = 0.0f,
+		.sample_count = static_cast<uint32_t>(m_ve_renderer.getSampleCount())
 	};
 }
 
@@ -20,11 +20,11 @@ public:
 
 private:
 	void loadGameObjects();
-	void createUniformBuffers();
 	void createDescriptors();
 	void initSystems();
 	void initUI();
 
+	void updateRenderScale();
 	void updateParticles(VeFrameInfo& frame_info, InputActions& actions);
 
 	const std::filesystem::path working_directory;
@@ -58,12 +58,19 @@ private:
 	// UI context captured during renderUI(), consumed in updateParticles() for example.
 	UIContext ui_context;
 
+	// Picks the render scale from the GPU frame time
+	VeDynamicResolution m_dynamic_resolution;
+
 	// Render systems 
 	std::unique_ptr<SkyboxRenderSystem> m_skybox_render_system;
 	std::unique_ptr<SimpleRenderSystem> m_simple_render_system;
 	std::unique_ptr<AxesRenderSystem> m_axes_render_system;
 	std::unique_ptr<PointLightSystem> m_point_light_system;
+	std::unique_ptr<LightClusterSystem> m_light_cluster_system;
 	std::unique_ptr<ParticleSystem> m_particle_system;
+	std::unique_ptr<ParticleEmitterSystem> m_particle_emitter;
+	std::unique_ptr<OitCompositeSystem> m_oit_composite_system;
+	std::unique_ptr<UpscaleSystem> m_upscale_system;
 };
 
 } // namespace ve
@@ -4,3 +4,5 @@ option(VE_BUILD_TESTS "Build unit tests" OFF)
 option(VE_FETCH_GLFW "Fetch GLFW if not found" ON)
 option(VE_FETCH_GLM "Fetch GLM if not found" ON)
 option(VE_USE_LEAKS "Enable debug info and add 'leaks' target for macOS memory leak checking" OFF)
+option(VE_ENABLE_AVX2 "Compile with AVX2/FMA, the binary then needs a CPU with AVX2" OFF)
+option(VE_SYNC_VALIDATION "Enable synchronization validation of the validation layer in debug builds" OFF)
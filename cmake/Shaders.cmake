@@ -128,6 +128,19 @@ file(GLOB_RECURSE SLANG_SHADER_FILES "${PROJECT_SOURCE_DIR}/shaders/*.slang")
 # Create a target for each shader file and add target to list
 foreach(SLANG_SHADER ${SLANG_SHADER_FILES})
 	get_filename_component(SLANG_SHADER_NAME ${SLANG_SHADER} NAME_WE)
+	# *_kernel shaders only contain a compute entry point (compMain) and compile to <name>.spv
+	if ( SLANG_SHADER_NAME MATCHES ".*_kernel$")
+		add_slang_spirv_target(${SLANG_SHADER_NAME}
+			TYPE COMPUTE
+			SOURCES ${SLANG_SHADER}
+			ENTRY compMain
+			PROFILE spirv_1_5
+			OUT_DIR "${PROJECT_SOURCE_DIR}/shaders"
+			OUT_FILE "${PROJECT_SOURCE_DIR}/shaders/${SLANG_SHADER_NAME}.spv"
+		)
+		list(APPEND SHADER_TARGETS ${SLANG_SHADER_NAME})
+		continue()
+	endif()
 	add_slang_spirv_target(${SLANG_SHADER_NAME}
 		TYPE GRAPHICS
 		SOURCES ${SLANG_SHADER}
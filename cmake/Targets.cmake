@@ -71,6 +71,19 @@ endif()
 # PCH & warnings
 target_precompile_headers(VEngineLib PRIVATE engine/src/pch.hpp)
 
+# Public so tests reusing the PCH and the app are compiled for the same target
+if (VE_ENABLE_AVX2)
+	if (MSVC)
+		target_compile_options(VEngineLib PUBLIC /arch:AVX2)
+	else()
+		target_compile_options(VEngineLib PUBLIC -mavx2 -mfma)
+	endif()
+endif()
+
+if (VE_SYNC_VALIDATION)
+	target_compile_definitions(VEngineLib PRIVATE VE_SYNC_VALIDATION)
+endif()
+
 if (MSVC)
 	target_compile_options(VEngineLib PRIVATE /W4 $<$<BOOL:${VE_WARNINGS_AS_ERRORS}>:/WX>)
 	target_compile_options(${PROJECT_NAME} PRIVATE /W4 $<$<BOOL:${VE_WARNINGS_AS_ERRORS}>:/WX>)
@@ -17,11 +17,15 @@ if (TEST_SOURCES)
 		target_link_libraries(${_test_target} PRIVATE Catch2::Catch2WithMain VEngine::Lib)
 		target_precompile_headers(${_test_target} REUSE_FROM VEngineLib)
 		target_include_directories(${_test_target} PUBLIC ${PROJECT_SOURCE_DIR}/engine/src)
+		# Device tests load compiled shaders relative to the source tree
+		foreach(shader_target ${SHADER_TARGETS})
+			add_dependencies(${_test_target} ${shader_target})
+		endforeach()
 		if (NOT MSVC)
 			target_compile_options(${_test_target} PRIVATE -Wall -Wextra -Wconversion -Wpedantic $<$<BOOL:${VE_WARNINGS_AS_ERRORS}>:-Werror>)
 		else()
 			target_compile_options(${_test_target} PRIVATE /W4 $<$<BOOL:${VE_WARNINGS_AS_ERRORS}>:/WX>)
 		endif()
-		add_test(NAME ${_test_target} COMMAND ${_test_target})
+		add_test(NAME ${_test_target} COMMAND ${_test_target} WORKING_DIRECTORY ${PROJECT_SOURCE_DIR})
 	endforeach()
 endif()
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "pch.hpp"
+#include "ve_allocator.hpp"
+
+namespace ve {
+
+static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+	assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// --------------------------- VeFreeList ---------------------------
+
+VeFreeList::VeFreeList(vk::DeviceSize size) : m_size(size), m_free_bytes(size) {
+	assert(size > 0 && "Free list size must be greater than zero");
+	m_free_ranges.emplace(0, size);
+}
+
+std::optional<vk::DeviceSize> VeFreeList::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+	assert(size > 0 && "Allocation size must be greater than zero");
+	if (alignment == 0) alignment = 1;
+	for (auto it = m_free_ranges.begin(); it != m_free_ranges.end(); ++it) {
+		const vk::DeviceSize range_offset = it->first;
+		const vk::DeviceSize range_end = range_offset + it->second;
+		const vk::DeviceSize aligned = alignUp(range_offset, alignment);
+		if (aligned + size > range_end) continue;
+
+		// Split the range into the alignment padding in front and the remainder behind
+		m_free_ranges.erase(it);
+		if (aligned > range_offset) {
+			m_free_ranges.emplace(range_offset, aligned - range_offset);
+		}
+		if (aligned + size < range_end) {
+			m_free_ranges.emplace(aligned + size, range_end - (aligned + size));
+		}
+		m_free_bytes -= size;
+		return aligned;
+	}
+	return std::nullopt;
+}
+
+void VeFreeList::free(vk::DeviceSize offset, vk::DeviceSize size) {
+	assert(size > 0 && offset + size <= m_size && "Freed range out of bounds");
+	auto next = m_free_ranges.lower_bound(offset);
+	assert((next == m_free_ranges.end() || offset + size <= next->first) && "Double free or overlapping range");
+	m_free_bytes += size;
+
+	// Merge with the following range
+	vk::DeviceSize merged_size = size;
+	if (next != m_free_ranges.end() && offset + size == next->first) {
+		merged_size += next->second;
+		next = m_free_ranges.erase(next);
+	}
+	// Merge with the preceding range
+	if (next != m_free_ranges.begin()) {
+		auto prev = std::prev(next);
+		assert(prev->first + prev->second <= offset && "Double free or overlapping range");
+		if (prev->first + prev->second == offset) {
+			prev->second += merged_size;
+			return;
+		}
+	}
+	m_free_ranges.emplace(offset, merged_size);
+}
+
+// --------------------------- VeAllocation ---------------------------
+
+VeAllocation::~VeAllocation() {
+	release();
+}
+
+VeAllocation::VeAllocation(VeAllocation&& other) noexcept {
+	*this = std::move(other);
+}
+
+VeAllocation& VeAllocation::operator=(VeAllocation&& other) noexcept {
+	if (this != &other) {
+		release();
+		m_allocator = std::exchange(other.m_allocator, nullptr);
+		m_block = std::exchange(other.m_block, nullptr);
+		m_memory = std::exchange(other.m_memory, vk::DeviceMemory{});
+		m_offset = std::exchange(other.m_offset, 0);
+		m_size = std::exchange(other.m_size, 0);
+		m_memory_type = std::exchange(other.m_memory_type, 0);
+		m_mapped = std::exchange(other.m_mapped, nullptr);
+		m_dedicated = std::exchange(other.m_dedicated, false);
+	}
+	return *this;
+}
+
+void VeAllocation::release() {
+	if (m_allocator) {
+		m_allocator->free(*this);
+		m_allocator = nullptr;
+		m_block = nullptr;
+		m_memory = vk::DeviceMemory{};
+		m_mapped = nullptr;
+	}
+}
+
+// --------------------------- VeAllocator ---------------------------
+
+VeAllocator::VeAllocator(
+	vk::raii::Device& device,
+	const vk::PhysicalDeviceMemoryProperties& memory_properties,
+	vk::DeviceSize buffer_image_granularity,
+	vk::DeviceSize preferred_block_size)
+	: m_device(device),
+		m_memory_properties(memory_properties),
+		m_buffer_image_granularity(std::max<vk::DeviceSize>(buffer_image_granularity, 1)),
+		m_preferred_block_size(preferred_block_size) {
+	assert(preferred_block_size > 0 && "Block size must be greater than zero");
+	m_blocks.resize(m_memory_properties.memoryTypeCount);
+}
+
+VeAllocator::~VeAllocator() {
+	if (m_stats.allocation_count != 0) {
+		VE_LOGW("VeAllocator destroyed with " << m_stats.allocation_count << " live allocations");
+	}
+	// blocks own RAII device memory and are released automatically
+}
+
+// Small heaps (e.g. 256MB BAR memory) get proportionally smaller blocks
+vk::DeviceSize VeAllocator::getBlockSize(uint32_t memory_type_index) const {
+	assert(memory_type_index < m_memory_properties.memoryTypeCount && "Invalid memory type index");
+	const uint32_t heap_index = m_memory_properties.memoryTypes[memory_type_index].heapIndex;
+	const vk::DeviceSize heap_size = m_memory_properties.memoryHeaps[heap_index].size;
+	return std::min(m_preferred_block_size, std::max<vk::DeviceSize>(heap_size / 8, 1));
+}
+
+VeAllocation VeAllocator::allocate(const vk::MemoryRequirements& requirements, uint32_t memory_type_index, bool linear) {
+	assert(requirements.size > 0 && "Allocation size must be greater than zero");
+	assert((requirements.memoryTypeBits & (1u << memory_type_index)) && "Memory type not allowed by requirements");
+
+	vk::DeviceSize alignment = std::max<vk::DeviceSize>(requirements.alignment, 1);
+	vk::DeviceSize size = requirements.size;
+	if (!linear) {
+		// Occupy whole granularity pages so no linear resource can alias the same page
+		alignment = std::max(alignment, m_buffer_image_granularity);
+		size = alignUp(size, m_buffer_image_granularity);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const vk::DeviceSize block_size = getBlockSize(memory_type_index);
+	Block* target = nullptr;
+	std::optional<vk::DeviceSize> offset;
+	if (size > block_size / 2) {
+		target = &createBlock(memory_type_index, size, true);
+		offset = target->free_list.allocate(size, 1);
+	} else {
+		for (auto& block : m_blocks[memory_type_index]) {
+			if (block->dedicated || block->free_list.getFreeBytes() < size) continue;
+			offset = block->free_list.allocate(size, alignment);
+			if (offset) {
+				target = block.get();
+				break;
+			}
+		}
+		if (!target) {
+			target = &createBlock(memory_type_index, block_size, false);
+			offset = target->free_list.allocate(size, alignment);
+		}
+	}
+	assert(offset && "Fresh block must fit the allocation");
+
+	target->allocation_count++;
+	m_stats.allocation_count++;
+	m_stats.used_bytes += size;
+
+	VeAllocation allocation;
+	allocation.m_allocator = this;
+	allocation.m_block = target;
+	allocation.m_memory = *target->memory;
+	allocation.m_offset = *offset;
+	allocation.m_size = size;
+	allocation.m_memory_type = memory_type_index;
+	allocation.m_mapped = target->mapped ? static_cast<char*>(target->mapped) + *offset : nullptr;
+	allocation.m_dedicated = target->dedicated;
+	return allocation;
+}
+
+void VeAllocator::free(VeAllocation& allocation) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Block* block = static_cast<Block*>(allocation.m_block);
+	assert(block && "Allocation has no owning block");
+	block->free_list.free(allocation.m_offset, allocation.m_size);
+	block->allocation_count--;
+	m_stats.allocation_count--;
+	m_stats.used_bytes -= allocation.m_size;
+
+	if (block->allocation_count > 0) return;
+	if (block->dedicated) {
+		destroyBlock(block);
+		return;
+	}
+	// Keep one empty block per memory type around to avoid allocation churn
+	auto& blocks = m_blocks[block->memory_type];
+	const auto empty_blocks = std::count_if(blocks.begin(), blocks.end(), [](const auto& b) {
+		return !b->dedicated && b->allocation_count == 0;
+	});
+	if (empty_blocks > 1) {
+		destroyBlock(block);
+	}
+}
+
+VeAllocator::Block& VeAllocator::createBlock(uint32_t memory_type_index, vk::DeviceSize size, bool dedicated) {
+	vk::MemoryAllocateInfo alloc_info{
+		.sType = vk::StructureType::eMemoryAllocateInfo,
+		.allocationSize = size,
+		.memoryTypeIndex = memory_type_index
+	};
+	auto block = std::make_unique<Block>(Block{
+		.memory = vk::raii::DeviceMemory(m_device, alloc_info),
+		.free_list = VeFreeList(size),
+		.memory_type = memory_type_index,
+		.allocation_count = 0,
+		.mapped = nullptr,
+		.dedicated = dedicated
+	});
+	const auto flags = m_memory_properties.memoryTypes[memory_type_index].propertyFlags;
+	if (flags & vk::MemoryPropertyFlagBits::eHostVisible) {
+		block->mapped = block->memory.mapMemory(0, VK_WHOLE_SIZE);
+	}
+
+	if (dedicated) m_stats.dedicated_count++;
+	else m_stats.block_count++;
+	m_stats.reserved_bytes += size;
+	VE_LOGD("VeAllocator: new " << (dedicated ? "dedicated" : "shared") << " block of " << size
+		<< " bytes for memory type " << memory_type_index);
+
+	m_blocks[memory_type_index].push_back(std::move(block));
+	return *m_blocks[memory_type_index].back();
+}
+
+void VeAllocator::destroyBlock(Block* block) {
+	auto& blocks = m_blocks[block->memory_type];
+	auto it = std::find_if(blocks.begin(), blocks.end(), [block](const auto& b) { return b.get() == block; });
+	assert(it != blocks.end() && "Block not owned by this allocator");
+	if (block->dedicated) m_stats.dedicated_count--;
+	else m_stats.block_count--;
+	m_stats.reserved_bytes -= block->free_list.getSize();
+	// vkFreeMemory implicitly unmaps
+	blocks.erase(it);
+}
+
+VeAllocationStats VeAllocator::getStats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+} // namespace ve
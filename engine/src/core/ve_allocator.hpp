@@ -0,0 +1,133 @@
+/* VeAllocator sub-allocates device memory for buffers and images. Instead of one
+vkAllocateMemory per resource it reserves large blocks per memory type and hands
+out aligned ranges from them, keeping the number of live device allocations far
+below maxMemoryAllocationCount. Host visible blocks are mapped once for their
+whole lifetime, VeAllocation exposes a pointer to its range of the mapping.
+Resources larger than half a block get a dedicated allocation. */
+#pragma once
+#include "ve_export.hpp"
+
+#define VULKAN_HPP_ENABLE_RAII
+#include <vulkan/vulkan_raii.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace ve {
+
+// Free range bookkeeping of a single memory block (first fit, coalescing on free).
+// Contains no Vulkan calls so it can be tested without a device.
+class VENGINE_API VeFreeList {
+public:
+	explicit VeFreeList(vk::DeviceSize size);
+
+	// Returns the offset of an aligned range of size bytes or nullopt if no free range fits
+	std::optional<vk::DeviceSize> allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+	void free(vk::DeviceSize offset, vk::DeviceSize size);
+
+	vk::DeviceSize getSize() const { return m_size; }
+	vk::DeviceSize getFreeBytes() const { return m_free_bytes; }
+	size_t getFreeRangeCount() const { return m_free_ranges.size(); }
+	bool isEmpty() const { return m_free_bytes == m_size; }
+
+private:
+	vk::DeviceSize m_size;
+	vk::DeviceSize m_free_bytes;
+	std::map<vk::DeviceSize, vk::DeviceSize> m_free_ranges; // offset -> size
+};
+
+struct VeAllocationStats {
+	uint32_t block_count = 0;        // shared blocks currently allocated
+	uint32_t dedicated_count = 0;    // resources with their own vkAllocateMemory
+	uint32_t allocation_count = 0;   // live sub-allocations (including dedicated ones)
+	vk::DeviceSize reserved_bytes = 0; // bytes obtained from the driver
+	vk::DeviceSize used_bytes = 0;     // bytes handed out to resources (including alignment)
+
+	uint32_t getDeviceMemoryCount() const { return block_count + dedicated_count; }
+};
+
+class VeAllocator;
+
+// Move-only handle to a range of device memory, the range is returned to the allocator on destruction
+class VENGINE_API VeAllocation {
+public:
+	VeAllocation() = default;
+	~VeAllocation();
+
+	VeAllocation(const VeAllocation&) = delete;
+	VeAllocation& operator=(const VeAllocation&) = delete;
+	VeAllocation(VeAllocation&& other) noexcept;
+	VeAllocation& operator=(VeAllocation&& other) noexcept;
+
+	vk::DeviceMemory getMemory() const { return m_memory; }
+	vk::DeviceSize getOffset() const { return m_offset; }
+	vk::DeviceSize getSize() const { return m_size; }
+	uint32_t getMemoryTypeIndex() const { return m_memory_type; }
+	// Pointer to the start of this allocation in the persistent mapping, nullptr if not host visible
+	void* getMappedData() const { return m_mapped; }
+	bool isDedicated() const { return m_dedicated; }
+	explicit operator bool() const { return m_allocator != nullptr; }
+
+	void release();
+
+private:
+	friend class VeAllocator;
+
+	VeAllocator* m_allocator = nullptr;
+	void* m_block = nullptr; // VeAllocator::Block owning this range
+	vk::DeviceMemory m_memory{};
+	vk::DeviceSize m_offset = 0;
+	vk::DeviceSize m_size = 0;
+	uint32_t m_memory_type = 0;
+	void* m_mapped = nullptr;
+	bool m_dedicated = false;
+};
+
+class VENGINE_API VeAllocator {
+public:
+	static constexpr vk::DeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+	VeAllocator(
+		vk::raii::Device& device,
+		const vk::PhysicalDeviceMemoryProperties& memory_properties,
+		vk::DeviceSize buffer_image_granularity,
+		vk::DeviceSize preferred_block_size = DEFAULT_BLOCK_SIZE);
+	~VeAllocator();
+
+	VeAllocator(const VeAllocator&) = delete;
+	VeAllocator& operator=(const VeAllocator&) = delete;
+
+	// linear is true for buffers and linear tiled images, false for optimal tiled images.
+	// Non-linear allocations are padded to bufferImageGranularity so they never share a page with linear ones.
+	VeAllocation allocate(const vk::MemoryRequirements& requirements, uint32_t memory_type_index, bool linear);
+	VeAllocationStats getStats() const;
+	vk::DeviceSize getBlockSize(uint32_t memory_type_index) const;
+
+private:
+	struct Block {
+		vk::raii::DeviceMemory memory{nullptr};
+		VeFreeList free_list;
+		uint32_t memory_type = 0;
+		uint32_t allocation_count = 0;
+		void* mapped = nullptr;
+		bool dedicated = false;
+	};
+	friend class VeAllocation;
+
+	void free(VeAllocation& allocation);
+	Block& createBlock(uint32_t memory_type_index, vk::DeviceSize size, bool dedicated);
+	void destroyBlock(Block* block);
+
+	vk::raii::Device& m_device;
+	vk::PhysicalDeviceMemoryProperties m_memory_properties;
+	vk::DeviceSize m_buffer_image_granularity;
+	vk::DeviceSize m_preferred_block_size;
+
+	mutable std::mutex m_mutex;
+	std::vector<std::vector<std::unique_ptr<Block>>> m_blocks; // indexed by memory type
+	VeAllocationStats m_stats{};
+};
+
+} // namespace ve
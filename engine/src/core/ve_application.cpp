@@ -17,6 +17,9 @@ VeApplication::VeApplication()
 	: m_ve_window(WIDTH, HEIGHT, APP_NAME),
 	  m_ve_device(m_ve_window),
 	  m_ve_renderer(m_ve_device, m_ve_window),
+	  m_frame_ring(m_ve_device),
+	  m_mesh_arena(m_ve_device, sizeof(VeModel::Vertex)),
+	  m_texture_registry(m_ve_device),
 	  m_input_controller(m_ve_window),
 	  m_camera(glm::vec3{20.0f, 20.0f, 20.0f}, glm::vec3{0.0f, 0.0f, 1.0f}) {
 }
@@ -30,6 +33,8 @@ void VeApplication::run() {
 
 		if (!m_ve_renderer.beginFrame())
 			continue;
+		// The frame's fence has been waited on, so its ring region can be reused
+		m_frame_ring.beginFrame(m_ve_renderer.getCurrentFrame());
 
 		VeFrameInfo frame_info = update();
 		render(frame_info);		
@@ -57,11 +62,11 @@ void VeApplication::updateCamera() {
 }
 
 // Updates the camera and uniform buffer object once per frame
-void VeApplication::updateUniformBuffer(uint32_t current_frame, UniformBufferObject& ubo) {
+uint32_t VeApplication::updateUniformBuffer(UniformBufferObject& ubo) {
 	ubo.view = m_camera.getView();
 	ubo.proj = m_camera.getProj();
-	m_uniform_buffers[current_frame]->writeToBuffer(&ubo);
 	// No flush required with MEMORY_PROPERTY_HOST_COHERENT
+	return m_frame_ring.push(ubo).getDynamicOffset();
 }
 
 // Print FPS and frame time to window title every 100 ms
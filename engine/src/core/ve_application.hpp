@@ -5,11 +5,17 @@
 #include "core/ve_renderer.hpp"
 #include "ui/imgui_layer.hpp"
 #include "core/ve_buffer.hpp"
+#include "core/ve_frame_ring.hpp"
+#include "core/ve_render_queue.hpp"
+#include "core/ve_thread_pool.hpp"
 #include "core/ve_descriptors.hpp"
+#include "core/ve_texture_registry.hpp"
 #include "input/input_controller.hpp"
 #include "game/ve_camera.hpp"
 #include "game/ve_frame_info.hpp"
 #include "game/ve_game_object.hpp"
+#include "game/ve_mesh_arena.hpp"
+#include "game/ve_model.hpp"
 #include <memory>
 #include <vector>
 #include <chrono>
@@ -37,7 +43,8 @@ public:
 
 protected:
 	void updateCamera();
-	void updateUniformBuffer(uint32_t current_frame, UniformBufferObject& ubo);
+	// Writes the ubo into the frame ring and returns its dynamic offset
+	uint32_t updateUniformBuffer(UniformBufferObject& ubo);
 	void updateWindowTitle();
 	void updateFrameTime();
 
@@ -45,7 +52,11 @@ protected:
 	VeDevice m_ve_device;
 	VeRenderer m_ve_renderer;
 	std::unique_ptr<ImGuiLayer> imgui_layer{}; // created in cpp
-	std::vector<std::unique_ptr<VeBuffer>> m_uniform_buffers{};
+	VeFrameRing m_frame_ring; // transient per-frame data such as the global ubo
+	VeRenderQueue m_render_queue; // draws of the render systems, recorded sorted by state
+	VeThreadPool m_thread_pool; // records large render queues in parallel
+	VeMeshArena m_mesh_arena; // vertices and indices of all models, must outlive the models
+	VeTextureRegistry m_texture_registry; // bindless array of all material textures
 
 	// Descriptor pool, layouts, sets
 	std::shared_ptr<VeDescriptorPool> m_global_pool{};
@@ -53,7 +64,7 @@ protected:
 	std::unique_ptr<VeDescriptorSetLayout> m_global_set_layout{};
 	std::unique_ptr<VeDescriptorSetLayout> m_material_set_layout{};
 
-	std::vector<vk::raii::DescriptorSet> m_global_descriptor_sets{};
+	vk::raii::DescriptorSet m_global_descriptor_set{nullptr}; // dynamic ubo offset selects the frame
 	vk::raii::DescriptorSet m_material_descriptor_set{nullptr};
 	vk::raii::DescriptorSet m_cubemap_descriptor_set{nullptr};
 
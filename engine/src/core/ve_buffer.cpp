@@ -37,25 +37,25 @@ VeBuffer::VeBuffer(VeDevice& ve_device,
 		m_usage_flags,
 		m_memory_property_flags,
 		m_buffer,
-		m_buffer_memory);
+		m_allocation);
 }
 
 VeBuffer::~VeBuffer() {
 	unmap();
-	// buffer and buffer_memory are RAII objects and will be cleaned up automatically
+	// buffer is a RAII object and the allocation returns its range to the device allocator
 }
 
+// Host visible blocks are persistently mapped by the allocator, mapping only exposes this buffer's range
 void VeBuffer::map(vk::DeviceSize size, vk::DeviceSize offset) {
-	assert(m_buffer_memory != VK_NULL_HANDLE && "Buffer memory is null");
-	m_mapped = m_buffer_memory.mapMemory(offset, size);
-	assert(m_mapped != VK_NULL_HANDLE && "Failed to map buffer memory");
+	assert(m_allocation && "Buffer memory is null");
+	assert(m_allocation.getMappedData() != nullptr && "Buffer memory is not host visible");
+	assert((size == VK_WHOLE_SIZE || offset + size <= m_buffer_size) && "Mapped range exceeds buffer size");
+	(void)size;
+	m_mapped = static_cast<char*>(m_allocation.getMappedData()) + offset;
 }
 
 void VeBuffer::unmap() {
-	if (m_mapped) {
-		m_buffer_memory.unmapMemory();
-		m_mapped = nullptr;
-	}
+	m_mapped = nullptr;
 }
 
 void VeBuffer::writeToBuffer(void* data, vk::DeviceSize size, vk::DeviceSize offset) {
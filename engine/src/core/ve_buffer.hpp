@@ -35,8 +35,8 @@ public:
 
 private:
 	void* m_mapped = nullptr;
+	VeAllocation m_allocation; // declared before m_buffer so the buffer is destroyed first
 	vk::raii::Buffer m_buffer{nullptr};
-	vk::raii::DeviceMemory m_buffer_memory{nullptr};
 
 	vk::DeviceSize m_instance_size;
 	uint32_t m_instance_count;
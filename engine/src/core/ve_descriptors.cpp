@@ -1,4 +1,5 @@
 #include "ve_descriptors.hpp"
+#include "utils/ve_log.hpp"
 
 // std
 #include <cassert>
@@ -11,7 +12,8 @@ VeDescriptorSetLayout::Builder &VeDescriptorSetLayout::Builder::addBinding(
 	uint32_t binding,
 	vk::DescriptorType descriptor_type,
 	vk::ShaderStageFlags stage_flags,
-	uint32_t count) {
+	uint32_t count,
+	vk::DescriptorBindingFlags binding_flags) {
 	assert(m_bindings.count(binding) == 0 && "Binding already in use");
 	vk::DescriptorSetLayoutBinding layout_binding{
 		.binding = binding,
@@ -20,25 +22,42 @@ VeDescriptorSetLayout::Builder &VeDescriptorSetLayout::Builder::addBinding(
 		.stageFlags = stage_flags
 	};
 	m_bindings[binding] = layout_binding;
+	if (binding_flags)
+		m_binding_flags[binding] = binding_flags;
 	return *this;
 }
 
 std::unique_ptr<VeDescriptorSetLayout> VeDescriptorSetLayout::Builder::build() const {
-	return std::make_unique<VeDescriptorSetLayout>(m_ve_device, m_bindings);
+	return std::make_unique<VeDescriptorSetLayout>(m_ve_device, m_bindings, m_binding_flags);
 }
 
 // *************** Descriptor Set Layout *********************
 
+// Binding flags are passed per binding in the same order as the bindings, layouts
+// with update after bind bindings must be created with eUpdateAfterBindPool
 VeDescriptorSetLayout::VeDescriptorSetLayout(
-	VeDevice &device, std::unordered_map<uint32_t, vk::DescriptorSetLayoutBinding> bindings_map)
+	VeDevice &device,
+	std::unordered_map<uint32_t, vk::DescriptorSetLayoutBinding> bindings_map,
+	const std::unordered_map<uint32_t, vk::DescriptorBindingFlags> &binding_flags)
 	: m_ve_device{device}, m_bindings{bindings_map} {
 	std::vector<vk::DescriptorSetLayoutBinding> set_layout_bindings{};
+	std::vector<vk::DescriptorBindingFlags> set_binding_flags{};
+	vk::DescriptorSetLayoutCreateFlags layout_flags{};
 	for (const auto& kv : bindings_map) {
 		set_layout_bindings.push_back(kv.second);
+		auto flags = binding_flags.find(kv.first);
+		set_binding_flags.push_back(flags != binding_flags.end() ? flags->second : vk::DescriptorBindingFlags{});
+		if (set_binding_flags.back() & vk::DescriptorBindingFlagBits::eUpdateAfterBind)
+			layout_flags |= vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
 	}
 
+	vk::DescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{
+		.bindingCount = static_cast<uint32_t>(set_binding_flags.size()),
+		.pBindingFlags = set_binding_flags.data()
+	};
 	vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_info{
-		.flags = {}, // TODO
+		.pNext = binding_flags.empty() ? nullptr : &binding_flags_info,
+		.flags = layout_flags,
 		.bindingCount = static_cast<uint32_t>(set_layout_bindings.size()),
 		.pBindings = set_layout_bindings.data()
 	};
@@ -57,7 +76,7 @@ VeDescriptorPool::Builder &VeDescriptorPool::Builder::addPoolSize(
 }
 
 VeDescriptorPool::Builder &VeDescriptorPool::Builder::setPoolFlags(
-		vk::DescriptorPoolCreateFlagBits flags) {
+		vk::DescriptorPoolCreateFlags flags) {
 	m_pool_flags = flags;
 	return *this;
 }
@@ -79,38 +98,54 @@ std::shared_ptr<VeDescriptorPool> VeDescriptorPool::Builder::buildShared() const
 VeDescriptorPool::VeDescriptorPool(
 		VeDevice &ve_device,
 		uint32_t max_sets,
-		vk::DescriptorPoolCreateFlagBits pool_flags,
+		vk::DescriptorPoolCreateFlags pool_flags,
 		const std::vector<vk::DescriptorPoolSize> &pool_sizes)
-		: m_ve_device{ve_device} {
-
-	vk::DescriptorPoolCreateInfo descriptor_pool_info{
-		.flags = pool_flags,
-		.maxSets = max_sets,
-		.poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
-		.pPoolSizes = pool_sizes.data()
-	};
-
-	m_descriptor_pool = vk::raii::DescriptorPool(m_ve_device.getDevice(), descriptor_pool_info);
+		: m_ve_device{ve_device}, m_pool_flags{pool_flags}, m_max_sets{max_sets}, m_pool_sizes{pool_sizes} {
+	addPool();
 }
 
 VeDescriptorPool::~VeDescriptorPool() {}
 
-//TODO: consider allocating more than one at once and handling full pool
-void VeDescriptorPool::allocateDescriptor(const vk::raii::DescriptorSetLayout& descriptor_set_layout, vk::raii::DescriptorSet& descriptor_set) const {
-
-	vk::DescriptorSetAllocateInfo alloc_info{
-		.descriptorPool = *m_descriptor_pool,
-		.descriptorSetCount = 1,
-		.pSetLayouts = &*descriptor_set_layout
+void VeDescriptorPool::addPool() {
+	vk::DescriptorPoolCreateInfo descriptor_pool_info{
+		.flags = m_pool_flags,
+		.maxSets = m_max_sets,
+		.poolSizeCount = static_cast<uint32_t>(m_pool_sizes.size()),
+		.pPoolSizes = m_pool_sizes.data()
 	};
+	m_descriptor_pools.emplace_back(m_ve_device.getDevice(), descriptor_pool_info);
+	if (m_descriptor_pools.size() > 1)
+		VE_LOGI("Descriptor pool exhausted, chained pool " << m_descriptor_pools.size());
+}
 
-	auto descriptor_sets = vk::raii::DescriptorSets(m_ve_device.getDevice(), alloc_info);
-	descriptor_set = std::move(descriptor_sets.front());
+// A set remembers the pool it came from and is freed there, so the chain is only
+// visible to allocations. Older pools are not revisited, freed sets in them are reused
+// once the pool is reset.
+void VeDescriptorPool::allocateDescriptor(const vk::raii::DescriptorSetLayout& descriptor_set_layout, vk::raii::DescriptorSet& descriptor_set) {
+	auto allocate = [&]() {
+		vk::DescriptorSetAllocateInfo alloc_info{
+			.descriptorPool = *m_descriptor_pools.back(),
+			.descriptorSetCount = 1,
+			.pSetLayouts = &*descriptor_set_layout
+		};
+		auto descriptor_sets = vk::raii::DescriptorSets(m_ve_device.getDevice(), alloc_info);
+		descriptor_set = std::move(descriptor_sets.front());
+	};
+	try {
+		allocate();
+	} catch (const vk::OutOfPoolMemoryError&) {
+		addPool();
+		allocate();
+	} catch (const vk::FragmentedPoolError&) {
+		addPool();
+		allocate();
+	}
 }
 
 void VeDescriptorPool::resetPool() {
 	vk::Device device = *m_ve_device.getDevice();
-	device.resetDescriptorPool(m_descriptor_pool);
+	for (auto& pool : m_descriptor_pools)
+		device.resetDescriptorPool(*pool);
 }
 
 // *************** Descriptor Writer *********************
@@ -141,18 +176,18 @@ VeDescriptorWriter &VeDescriptorWriter::writeBuffer(
 }
 
 VeDescriptorWriter &VeDescriptorWriter::writeImage(
-	uint32_t binding, vk::DescriptorImageInfo *image_info) {
+	uint32_t binding, vk::DescriptorImageInfo *image_info, uint32_t array_element) {
 	assert(m_set_layout.m_bindings.count(binding) == 1 && "Layout does not contain specified binding");
 
 	auto &binding_description = m_set_layout.m_bindings[binding];
 
 	assert(
-		binding_description.descriptorCount == 1 &&
-		"Binding single descriptor info, but binding expects multiple");
+		array_element < binding_description.descriptorCount &&
+		"Array element out of bounds of the binding");
 
 	vk::WriteDescriptorSet write{
 		.dstBinding = binding,
-		.dstArrayElement = 0,
+		.dstArrayElement = array_element,
 		.descriptorCount = 1,
 		.descriptorType = binding_description.descriptorType,
 		.pImageInfo = image_info
@@ -1,5 +1,7 @@
 /* Contains classes and builders for creating descriptor sets layouts,
-descriptor pools, and writing descriptor sets.
+descriptor pools, and writing descriptor sets. A VeDescriptorPool is a chain of
+Vulkan pools of the built size, a new one is added when the last is exhausted, so
+sets kept alive by the retirement queue never make an allocation fail.
 */
 #pragma once
 
@@ -20,19 +22,25 @@ public:
 	public:
 		Builder(VeDevice &ve_device) : m_ve_device{ve_device} {}
 
+		// Bindings with eUpdateAfterBind make the layout need a pool with eUpdateAfterBind
 		Builder &addBinding(
 			uint32_t binding,
 			vk::DescriptorType descriptor_type,
 			vk::ShaderStageFlags stage_flags,
-			uint32_t count = 1);
+			uint32_t count = 1,
+			vk::DescriptorBindingFlags binding_flags = {});
 		std::unique_ptr<VeDescriptorSetLayout> build() const;
 
 	private:
 		VeDevice &m_ve_device;
 		std::unordered_map<uint32_t, vk::DescriptorSetLayoutBinding> m_bindings{};
+		std::unordered_map<uint32_t, vk::DescriptorBindingFlags> m_binding_flags{};
 	};
 
-	VeDescriptorSetLayout(VeDevice &ve_device, std::unordered_map<uint32_t, vk::DescriptorSetLayoutBinding> bindings_map);
+	VeDescriptorSetLayout(
+		VeDevice &ve_device,
+		std::unordered_map<uint32_t, vk::DescriptorSetLayoutBinding> bindings_map,
+		const std::unordered_map<uint32_t, vk::DescriptorBindingFlags> &binding_flags = {});
 	~VeDescriptorSetLayout();
 
 	VeDescriptorSetLayout(const VeDescriptorSetLayout &) = delete;
@@ -56,7 +64,7 @@ public:
 		Builder(VeDevice &ve_device) : m_ve_device{ve_device} {}
 
 		Builder &addPoolSize(vk::DescriptorType descriptor_type, uint32_t count);
-		Builder &setPoolFlags(vk::DescriptorPoolCreateFlagBits flags);
+		Builder &setPoolFlags(vk::DescriptorPoolCreateFlags flags);
 		Builder &setMaxSets(uint32_t count);
 			std::unique_ptr<VeDescriptorPool> build() const;
 			std::shared_ptr<VeDescriptorPool> buildShared() const;
@@ -65,25 +73,33 @@ public:
 		VeDevice &m_ve_device;
 		std::vector<vk::DescriptorPoolSize> m_pool_sizes{};
 		uint32_t m_max_sets = 1000;
-		vk::DescriptorPoolCreateFlagBits m_pool_flags{};
+		vk::DescriptorPoolCreateFlags m_pool_flags{};
 	};
 
 	VeDescriptorPool(
 		VeDevice &ve_device,
 		uint32_t max_sets,
-		vk::DescriptorPoolCreateFlagBits pool_flags,
+		vk::DescriptorPoolCreateFlags pool_flags,
 		const std::vector<vk::DescriptorPoolSize> &pool_sizes);
 	~VeDescriptorPool();
 	VeDescriptorPool(const VeDescriptorPool &) = delete;
 	VeDescriptorPool &operator=(const VeDescriptorPool &) = delete;
 
-	void allocateDescriptor(const vk::raii::DescriptorSetLayout& descriptor_set_layout, vk::raii::DescriptorSet& descriptor_set) const;
+	// Allocates from the newest pool of the chain, adding one when it is out of memory
+	void allocateDescriptor(const vk::raii::DescriptorSetLayout& descriptor_set_layout, vk::raii::DescriptorSet& descriptor_set);
 
+	// Resets every pool of the chain, the sets allocated from them must not be used anymore
 	void resetPool();
+	size_t getPoolCount() const { return m_descriptor_pools.size(); }
 
 private:
+	void addPool();
+
 	VeDevice &m_ve_device;
-	vk::raii::DescriptorPool m_descriptor_pool = nullptr;
+	vk::DescriptorPoolCreateFlags m_pool_flags;
+	uint32_t m_max_sets;
+	std::vector<vk::DescriptorPoolSize> m_pool_sizes;
+	std::vector<vk::raii::DescriptorPool> m_descriptor_pools; // allocations go to the last
 	friend class VeDescriptorWriter;
 };
 
@@ -92,7 +108,8 @@ public:
 	VeDescriptorWriter(VeDescriptorSetLayout &set_layout, VeDescriptorPool &pool);
 
 	VeDescriptorWriter &writeBuffer(uint32_t binding, vk::DescriptorBufferInfo *buffer_info);
-	VeDescriptorWriter &writeImage(uint32_t binding, vk::DescriptorImageInfo *image_info);
+	// array_element selects the descriptor of an array binding
+	VeDescriptorWriter &writeImage(uint32_t binding, vk::DescriptorImageInfo *image_info, uint32_t array_element = 0);
 
 	void build(vk::raii::DescriptorSet &set);
 	void overwrite(vk::raii::DescriptorSet &set);
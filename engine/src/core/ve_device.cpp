@@ -1,5 +1,9 @@
 #include "pch.hpp" // IWYU pragma: keep
 #include "ve_device.hpp"
+#include "ve_uploader.hpp"
+#include "ve_retirement_queue.hpp"
+
+#include <array>
 
 
 namespace ve {
@@ -41,10 +45,16 @@ VeDevice::VeDevice(VeWindow &window) : m_window(window) {
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
+	createAllocator();
 	createCommandPools();
+	createUploader();
+	m_retirement_queue = std::make_unique<VeRetirementQueue>(*this);
 }
 
 VeDevice::~VeDevice() {
+	// Retired resources may still be in use, the GPU has to finish before they are released
+	m_device.waitIdle();
+	m_retirement_queue->releaseAll();
 	// commandPool, ve_device, surface, debugMessenger and instance are RAII objects and will be cleaned up automatically
 }
 
@@ -91,8 +101,12 @@ void VeDevice::createInstance() {
 		VE_LOGD("\t" << extension);
 	}
 
-	// Check if the required extensions are supported by the Vulkan implementation.
+	// Check if the required extensions are supported by the Vulkan implementation or the enabled layers.
 	auto extension_properties = m_context.enumerateInstanceExtensionProperties();
+	for (const char* layer : required_layers) {
+		auto layer_extensions = m_context.enumerateInstanceExtensionProperties(std::string(layer));
+		extension_properties.insert(extension_properties.end(), layer_extensions.begin(), layer_extensions.end());
+	}
 	for (uint32_t i = 0; i < required_extensions.size(); ++i)
 	{
 		// If none of the available extensions matches the required extension, throw an error
@@ -112,6 +126,18 @@ void VeDevice::createInstance() {
 		.enabledExtensionCount = static_cast<uint32_t>(required_extensions.size()),
 		.ppEnabledExtensionNames = required_extensions.data()};
 
+#ifdef VE_SYNC_VALIDATION
+	// Hazards between commands, queues and frames are reported like other validation errors
+	constexpr vk::ValidationFeatureEnableEXT validation_enables[] = {
+		vk::ValidationFeatureEnableEXT::eSynchronizationValidation};
+	const vk::ValidationFeaturesEXT validation_features{
+		.enabledValidationFeatureCount = 1,
+		.pEnabledValidationFeatures = validation_enables};
+	if (enable_validation_layers) {
+		createInfo.pNext = &validation_features;
+	}
+#endif
+
 	m_instance = vk::raii::Instance(m_context, createInfo);
 }
 
@@ -135,6 +161,14 @@ void VeDevice::setupDebugMessenger() {
 	m_debug_messenger = m_instance.createDebugUtilsMessengerEXT(create_info);
 }
 
+void VeDevice::createAllocator() {
+	assert(*m_device != VK_NULL_HANDLE && "Logical device must be created before the allocator");
+	m_allocator = std::make_unique<VeAllocator>(
+		m_device,
+		m_physical_device.getMemoryProperties(),
+		m_physical_device.getProperties().limits.bufferImageGranularity);
+}
+
 void VeDevice::createCommandPools() {
 	assert(m_queue_index != UINT32_MAX && "Cannot create command pool: invalid queue index");
 	vk::CommandPoolCreateInfo pool_info{
@@ -159,6 +193,11 @@ void VeDevice::createCommandPools() {
 	m_command_pool_compute = vk::raii::CommandPool(m_device, pool_info_compute);
 }
 
+void VeDevice::createUploader() {
+	assert(*m_command_pool_transfer != VK_NULL_HANDLE && "Transfer command pool must be created before the uploader");
+	m_uploader = std::make_unique<VeUploader>(*this);
+}
+
 void VeDevice::createSurface() {
 	VkSurfaceKHR _surface; // glfw works with c api handles
 	assert(m_window.getGLFWwindow() != VK_NULL_HANDLE && "GLFW window is null");
@@ -207,14 +246,24 @@ bool VeDevice::isDeviceSuitable(const vk::raii::PhysicalDevice& phyisical_device
 	// Fourth, it must support the required features
 	auto features = phyisical_device.getFeatures2<vk::PhysicalDeviceFeatures2,
 											vk::PhysicalDeviceVulkan11Features,
+											vk::PhysicalDeviceVulkan12Features,
 											vk::PhysicalDeviceVulkan13Features,
-											vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT,
-											vk::PhysicalDeviceTimelineSemaphoreFeatures>();
-	if (!features.get<vk::PhysicalDeviceFeatures2>().features.samplerAnisotropy ||
+											vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+	const auto& core_features = features.get<vk::PhysicalDeviceFeatures2>().features;
+	if (!core_features.samplerAnisotropy ||
+		!core_features.multiDrawIndirect ||
+		!core_features.drawIndirectFirstInstance ||
+		!features.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount ||
+		!features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore ||
+		!features.get<vk::PhysicalDeviceVulkan12Features>().descriptorIndexing ||
+		!features.get<vk::PhysicalDeviceVulkan12Features>().shaderSampledImageArrayNonUniformIndexing ||
+		!features.get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingSampledImageUpdateAfterBind ||
+		!features.get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingUpdateUnusedWhilePending ||
+		!features.get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingPartiallyBound ||
+		!features.get<vk::PhysicalDeviceVulkan12Features>().runtimeDescriptorArray ||
 		!features.get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering ||
 		!features.get<vk::PhysicalDeviceVulkan13Features>().synchronization2 ||
-		!features.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState ||
-		!features.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore) {
+		!features.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState) {
 		return false;
 	}
 
@@ -256,26 +305,38 @@ void VeDevice::createLogicalDevice() {
 	m_queue_index = findQueueFamilies(m_physical_device);
 	assert(m_queue_index != UINT32_MAX && "Failed to find a valid queue family index");
 	//TODO: transfer_queue_index = findTransferQueueFamilies(physical_device);
-	// same for compute queue
 	// For now we use the same queue for m1 machine
 	m_transfer_queue_index = m_queue_index;
-	m_compute_queue_index = m_queue_index;
+	// A dedicated compute family runs the frame's compute work next to the graphics work
+	m_compute_queue_index = findComputeQueueFamilies(m_physical_device);
+	VE_LOGI("Compute queue family " << m_compute_queue_index << (hasDedicatedComputeQueue() ? " (dedicated)" : " (shared with graphics)"));
 	assert(m_transfer_queue_index != UINT32_MAX && "Failed to find a valid transfer queue family index");
 	assert(m_compute_queue_index != UINT32_MAX && "Failed to find a valid compute queue family index");
 
 	// Setup a chain of structures to enable required Vulkan features
 	// Note: Slang-generated SPIR-V for VS uses DrawParameters (BaseVertex/VertexIndex),
 	// so we must enable shaderDrawParameters from Vulkan 1.1 features.
+	// GPU culling writes its draws with firstInstance set and draws them with drawIndexedIndirectCount.
+	// VeTextureRegistry needs descriptor indexing for its partially bound, update after bind texture array.
 	vk::StructureChain<vk::PhysicalDeviceFeatures2,
 					vk::PhysicalDeviceVulkan11Features,
+					vk::PhysicalDeviceVulkan12Features,
 					vk::PhysicalDeviceVulkan13Features,
-					vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT,
-					vk::PhysicalDeviceTimelineSemaphoreFeatures> feature_chain = {
-		{.features = {.samplerAnisotropy = true}},
+					vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT> feature_chain = {
+		{.features = {.multiDrawIndirect = true, .drawIndirectFirstInstance = true, .samplerAnisotropy = true}},
 		{.shaderDrawParameters = true},
+		{
+			.drawIndirectCount = true,
+			.descriptorIndexing = true,
+			.shaderSampledImageArrayNonUniformIndexing = true,
+			.descriptorBindingSampledImageUpdateAfterBind = true,
+			.descriptorBindingUpdateUnusedWhilePending = true,
+			.descriptorBindingPartiallyBound = true,
+			.runtimeDescriptorArray = true,
+			.timelineSemaphore = true
+		},
 		{.synchronization2 = true, .dynamicRendering = true},
-		{.extendedDynamicState = true },
-		{.timelineSemaphore = true}
+		{.extendedDynamicState = true }
 	};
 
 	assert(m_required_device_extensions.size() > 0 && "At least one device extension must be enabled");
@@ -339,6 +400,20 @@ assert(*m_surface != VK_NULL_HANDLE && "Surface must be valid when finding queue
 	return _queue_index;
 }
 
+// Prefers a family with compute but without graphics, such queues run asynchronously to the
+// graphics queue on most desktop GPUs. Falls back to the graphics family (e.g. m1 machines).
+uint32_t VeDevice::findComputeQueueFamilies(const vk::raii::PhysicalDevice& phyisical_device) const {
+	assert(m_queue_index != UINT32_MAX && "Graphics queue family must be found before the compute one");
+	auto qf_properties = phyisical_device.getQueueFamilyProperties();
+	for (uint32_t qfp_index = 0; qfp_index < qf_properties.size(); qfp_index++) {
+		if ((qf_properties[qfp_index].queueFlags & vk::QueueFlagBits::eCompute) &&
+			!(qf_properties[qfp_index].queueFlags & vk::QueueFlagBits::eGraphics)) {
+			return qfp_index;
+		}
+	}
+	return m_queue_index;
+}
+
 // Not used for now as m1 machines do not have a dedicated transfer queue
 uint32_t VeDevice::findTransferQueueFamilies(const vk::raii::PhysicalDevice& phyisical_device) const {
 	assert(*m_surface != VK_NULL_HANDLE && "Surface must be valid when finding queue families");
@@ -373,6 +448,9 @@ const std::vector<const char*> VeDevice::getRequiredInstanceExtensions() const {
 	std::vector<const char*> extensions(glfw_extensions, glfw_extensions + glfw_extensionCount);
 	if (enable_validation_layers) {
 		extensions.push_back(vk::EXTDebugUtilsExtensionName);
+#ifdef VE_SYNC_VALIDATION
+		extensions.push_back(vk::EXTValidationFeaturesExtensionName); // provided by the validation layer
+#endif
 	}
 	// add configured instance extensions
 	extensions.insert(extensions.end(), ve::REQUIRED_INSTANCE_EXTENSIONS.begin(), ve::REQUIRED_INSTANCE_EXTENSIONS.end());
@@ -390,14 +468,17 @@ SwapChainSupportDetails VeDevice::querySwapChainSupport(const vk::raii::Physical
 	return details;
 }
 
-// Query the maximum usable sample count for MSAA for m_physical_device
-vk::SampleCountFlagBits VeDevice::queryMaxUsableSampleCount() const {
+vk::SampleCountFlags VeDevice::getSupportedSampleCounts() const {
 	if constexpr (ve::MSAA_ENABLED == false)
 		return vk::SampleCountFlagBits::e1;
 
-    vk::PhysicalDeviceProperties properties = m_physical_device.getProperties();
+	vk::PhysicalDeviceProperties properties = m_physical_device.getProperties();
+	return properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+}
 
-    vk::SampleCountFlags counts = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+// Query the maximum usable sample count for MSAA for m_physical_device
+vk::SampleCountFlagBits VeDevice::queryMaxUsableSampleCount() const {
+    vk::SampleCountFlags counts = getSupportedSampleCounts();
     if (counts & vk::SampleCountFlagBits::e64) return vk::SampleCountFlagBits::e64;
     if (counts & vk::SampleCountFlagBits::e32) return vk::SampleCountFlagBits::e32;
     if (counts & vk::SampleCountFlagBits::e16) return vk::SampleCountFlagBits::e16;
@@ -443,44 +524,47 @@ vk::Format VeDevice::findDepthFormat() {
 	);
 }
 
-// sharing mode is hardcoded exclusive for now
+VeAllocation VeDevice::allocateMemory(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, bool linear) {
+	assert(m_allocator && "Allocator must be created before allocating memory");
+	return m_allocator->allocate(requirements, findMemoryType(requirements.memoryTypeBits, properties), linear);
+}
+
+// Buffers are shared concurrently by the graphics and a dedicated compute family, so
+// compute results need no queue family ownership transfers. Images stay exclusive.
 void VeDevice::createBuffer(
 		vk::DeviceSize size,
 		vk::BufferUsageFlags usage,
 		vk::MemoryPropertyFlags req_properties,
 		vk::raii::Buffer& buffer,
-		vk::raii::DeviceMemory& buffer_memory) {
+		VeAllocation& buffer_allocation) {
 
 	assert(size > 0 && "Buffer size must be greater than zero");
 	assert(usage != static_cast<vk::BufferUsageFlags>(0) && "Buffer usage flags must not be empty");
 
 	// Create buffer
+	const std::array<uint32_t, 2> queue_family_indices{ m_queue_index, m_compute_queue_index };
+	const bool concurrent = hasDedicatedComputeQueue();
 	vk::BufferCreateInfo buffer_create_info {
 		.sType = vk::StructureType::eBufferCreateInfo,
 		.size = size,
 		.usage = usage,
-		.sharingMode = vk::SharingMode::eExclusive
+		.sharingMode = concurrent ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
+		.queueFamilyIndexCount = concurrent ? static_cast<uint32_t>(queue_family_indices.size()) : 0u,
+		.pQueueFamilyIndices = concurrent ? queue_family_indices.data() : nullptr
 	};
 	buffer = vk::raii::Buffer(m_device, buffer_create_info);
 
-	// Allocate and bind memory to buffer
-	vk::MemoryRequirements mem_requirements = buffer.getMemoryRequirements();
-	vk::MemoryAllocateInfo alloc_info {
-		.sType = vk::StructureType::eMemoryAllocateInfo,
-		.allocationSize = mem_requirements.size,
-		.memoryTypeIndex = findMemoryType(mem_requirements.memoryTypeBits, req_properties)
-	};
-	buffer_memory = vk::raii::DeviceMemory(m_device, alloc_info);
-	buffer.bindMemory(*buffer_memory, 0); // offset 0
+	// Sub-allocate and bind memory to buffer
+	buffer_allocation = allocateMemory(buffer.getMemoryRequirements(), req_properties, true);
+	buffer.bindMemory(buffer_allocation.getMemory(), buffer_allocation.getOffset());
 }
 
 void VeDevice::copyBuffer(vk::raii::Buffer& src_buffer, vk::raii::Buffer& dst_buffer, vk::DeviceSize size) {
 	assert(size > 0 && "Buffer size must be greater than zero");
 	assert(*src_buffer != VK_NULL_HANDLE && "Source buffer must be valid");
 	assert(*dst_buffer != VK_NULL_HANDLE && "Destination buffer must be valid");
-	auto cmd = beginSingleTimeCommands(QueueKind::Transfer);
-	cmd->copyBuffer(*src_buffer, *dst_buffer, vk::BufferCopy{ 0, 0, size });
-	endSingleTimeCommands(*cmd, QueueKind::Transfer);
+	m_uploader->copyBuffer(*src_buffer, *dst_buffer, vk::BufferCopy{ 0, 0, size });
+	m_uploader->flushAndWait();
 }
 
 // Assumes the image is already in eTransferDstOptimal layout
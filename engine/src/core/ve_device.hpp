@@ -8,14 +8,19 @@ There are also methods for submitting single time command buffers to a queue. */
 #include "ve_export.hpp"
 #include "ve_window.hpp"
 #include "ve_config.hpp"
+#include "ve_allocator.hpp"
 
 #define VULKAN_HPP_ENABLE_RAII
 #include <vulkan/vulkan_raii.hpp>
 #include <vulkan/vulkan_beta.h> // required for macOS portability subset extension
+#include <memory>
 #include <vector>
 
 namespace ve {
 
+class VeUploader;
+class VeRetirementQueue;
+
 struct SwapChainSupportDetails {
 	vk::SurfaceCapabilitiesKHR capabilities;
 	std::vector<vk::SurfaceFormatKHR> formats;
@@ -47,30 +52,46 @@ public:
 
 	vk::raii::CommandPool& getCommandPool() { return m_command_pool; }
 	vk::raii::CommandPool& getComputeCommandPool() { return m_command_pool_compute; }
+	vk::raii::CommandPool& getTransferCommandPool() { return m_command_pool_transfer; }
 	vk::raii::Device& getDevice() { return m_device; }
 	vk::raii::Queue& getQueue() { return m_queue; }
 	vk::raii::Queue& getComputeQueue() { return m_compute_queue; }
+	vk::raii::Queue& getTransferQueue() { return m_transfer_queue; }
 	vk::raii::SurfaceKHR* getSurface() { return &m_surface; }
 	vk::raii::Instance& getInstance() { return m_instance; }
 	vk::raii::PhysicalDevice& getPhysicalDevice() { return m_physical_device; }
 	uint32_t getGraphicsQueueFamilyIndex() const { return m_queue_index; }
+	uint32_t getComputeQueueFamilyIndex() const { return m_compute_queue_index; }
+	// True when compute work is submitted to a family without graphics, buffers are then concurrent
+	bool hasDedicatedComputeQueue() const { return m_compute_queue_index != m_queue_index; }
 
 	SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(m_physical_device); }
 	uint32_t findMemoryType(uint32_t type_filter, vk::MemoryPropertyFlags properties);
 	vk::Format findSupportedFormat(const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features);
 	vk::Format findDepthFormat();
 
+	// Sub-allocates memory from the device allocator, linear is false for optimal tiled images
+	VeAllocation allocateMemory(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, bool linear);
+	VeAllocator& getAllocator() { return *m_allocator; }
+	// Batched transfer queue uploads, see VeUploader
+	VeUploader& getUploader() { return *m_uploader; }
+	// Deferred destruction of resources frames in flight may use, see VeRetirementQueue
+	VeRetirementQueue& getRetirementQueue() { return *m_retirement_queue; }
+
 	void createBuffer(
 		vk::DeviceSize size,
 		vk::BufferUsageFlags usage,
 		vk::MemoryPropertyFlags req_properties,
 		vk::raii::Buffer& buffer,
-		vk::raii::DeviceMemory& buffer_memory);
+		VeAllocation& buffer_allocation);
+	// Synchronous helpers, record into the uploader and wait for its timeline value
 	void copyBuffer(vk::raii::Buffer& src_buffer, vk::raii::Buffer& dst_buffer, vk::DeviceSize size);
 	void copyBufferToImage(vk::raii::Buffer& src_buffer, const vk::raii::Image& dst_image, uint32_t width, uint32_t height, uint32_t array_layers = 1);
 
 	const vk::PhysicalDeviceProperties getDeviceProperties() const { return m_physical_device.getProperties(); }
 	vk::SampleCountFlagBits getSampleCount() const { return m_max_msaa_samples; };
+	// Sample counts usable for both color and depth attachments, only 1 without MSAA_ENABLED
+	vk::SampleCountFlags getSupportedSampleCounts() const;
 
 	// Single-time command buffer helpers (select queue/pool)
 	std::unique_ptr<vk::raii::CommandBuffer> beginSingleTimeCommands(QueueKind kind = QueueKind::Graphics);
@@ -83,12 +104,14 @@ private:
 	void pickPhysicalDevice();
 	void createLogicalDevice();
 	void createCommandPools();
+	void createAllocator();
+	void createUploader();
 
 	bool isDeviceSuitable (const vk::raii::PhysicalDevice& device) const;
 	const std::vector<const char *> getRequiredInstanceExtensions() const;
 	uint32_t findQueueFamilies(const vk::raii::PhysicalDevice& phyisical_device) const;
 	uint32_t findTransferQueueFamilies(const vk::raii::PhysicalDevice& phyisical_device) const;
-	//TODO: uint32_t findComputeQueueFamilies(const vk::raii::PhysicalDevice& phyisical_device);
+	uint32_t findComputeQueueFamilies(const vk::raii::PhysicalDevice& phyisical_device) const;
 	SwapChainSupportDetails querySwapChainSupport(const vk::raii::PhysicalDevice& device) const;
 	vk::SampleCountFlagBits queryMaxUsableSampleCount() const;
 
@@ -101,6 +124,7 @@ private:
 	vk::raii::DebugUtilsMessengerEXT m_debug_messenger{nullptr};
 	vk::raii::SurfaceKHR m_surface{nullptr};
 	vk::raii::PhysicalDevice m_physical_device{nullptr};
+	std::unique_ptr<VeAllocator> m_allocator; // declared after m_device so it is destroyed first
 
 	vk::raii::CommandPool m_command_pool{nullptr};
 	vk::raii::CommandPool m_command_pool_transfer{nullptr}; // eTransient
@@ -118,6 +142,9 @@ private:
 
 	const std::vector<const char *> m_validation_layers = ve::VALIDATION_LAYERS;
 	std::vector<const char*> m_required_device_extensions = ve::REQUIRED_DEVICE_EXTENSIONS;
+
+	std::unique_ptr<VeUploader> m_uploader; // waits for its uploads before pools and allocator go away
+	std::unique_ptr<VeRetirementQueue> m_retirement_queue; // last member, its resources need everything above
 };
 
 }
\ No newline at end of file
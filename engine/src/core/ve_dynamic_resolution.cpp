@@ -0,0 +1,48 @@
+#include "pch.hpp"
+#include "core/ve_dynamic_resolution.hpp"
+
+#include <cmath>
+
+namespace ve {
+
+VeDynamicResolution::VeDynamicResolution(float target_ms, float min_scale, float max_scale)
+	: m_target_ms(target_ms), m_min_scale(min_scale), m_max_scale(max_scale), m_scale(max_scale) {
+	assert(min_scale > 0.0f && min_scale <= max_scale && "Invalid render scale range");
+}
+
+void VeDynamicResolution::reset(float scale) {
+	m_scale = std::clamp(scale, m_min_scale, m_max_scale);
+	m_average_ms = 0.0f;
+	m_frames_since_change = 0;
+}
+
+float VeDynamicResolution::update(float gpu_time_ms) {
+	if (gpu_time_ms <= 0.0f || m_target_ms <= 0.0f)
+		return m_scale;
+	m_average_ms = m_average_ms > 0.0f ? m_average_ms + SMOOTHING * (gpu_time_ms - m_average_ms) : gpu_time_ms;
+	if (++m_frames_since_change < SETTLE_FRAMES)
+		return m_scale;
+
+	float scale = m_scale;
+	if (m_average_ms > m_target_ms) {
+		scale = m_scale * std::sqrt(m_target_ms / m_average_ms);
+	} else if (m_average_ms < m_target_ms * HEADROOM) {
+		// Aim for the middle of the band, at most one step at a time
+		const float aim = m_scale * std::sqrt(m_target_ms * (1.0f + HEADROOM) * 0.5f / m_average_ms);
+		scale = std::min(aim, m_scale + MAX_STEP_UP);
+	}
+	scale = std::clamp(scale, m_min_scale, m_max_scale);
+	// Small changes are skipped unless they reach a limit
+	const bool at_limit = scale == m_min_scale || scale == m_max_scale;
+	if (scale == m_scale || (!at_limit && std::abs(scale - m_scale) < MIN_CHANGE))
+		return m_scale;
+
+	// The average was measured at the old scale, estimate it for the new one
+	const float ratio = scale / m_scale;
+	m_average_ms *= ratio * ratio;
+	m_scale = scale;
+	m_frames_since_change = 0;
+	return m_scale;
+}
+
+} // namespace ve
@@ -0,0 +1,45 @@
+/* VeDynamicResolution picks the render scale from measured GPU frame times. The times
+are smoothed, a frame over budget lowers the scale at once by the square root of the
+overshoot since the cost of fill-rate bound work follows the pixel count. Below the
+budget by more than the headroom it raises the scale in small steps, in between it
+keeps the scale so it does not oscillate. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+
+#include <cstdint>
+
+namespace ve {
+
+class VENGINE_API VeDynamicResolution {
+public:
+	static constexpr float SMOOTHING = 0.1f;         // weight of a new time in the average
+	static constexpr float HEADROOM = 0.85f;         // the scale is raised below this part of the budget
+	static constexpr float MAX_STEP_UP = 0.05f;      // largest raise per change
+	static constexpr float MIN_CHANGE = 0.01f;       // smaller changes are skipped
+	static constexpr uint32_t SETTLE_FRAMES = 8;     // frames between changes, lets the average follow
+
+	explicit VeDynamicResolution(float target_ms = DYNAMIC_RESOLUTION_TARGET_MS,
+		float min_scale = MIN_RENDER_SCALE, float max_scale = 1.0f);
+
+	// Feeds the GPU time of a finished frame and returns the scale for the next one.
+	// Times of zero or less are ignored.
+	float update(float gpu_time_ms);
+	// Starts over at scale, without an average
+	void reset(float scale = 1.0f);
+
+	void setTargetTime(float target_ms) { m_target_ms = target_ms; }
+	float getTargetTime() const { return m_target_ms; }
+	float getScale() const { return m_scale; }
+	float getAverageTime() const { return m_average_ms; }
+
+private:
+	float m_target_ms;
+	float m_min_scale;
+	float m_max_scale;
+	float m_scale;
+	float m_average_ms = 0.0f;
+	uint32_t m_frames_since_change = 0;
+};
+
+} // namespace ve
@@ -0,0 +1,61 @@
+#include "pch.hpp"
+#include "core/ve_frame_ring.hpp"
+
+namespace ve {
+
+VeFrameRing::VeFrameRing(VeDevice& device, vk::DeviceSize region_size, vk::BufferUsageFlags usage)
+	: m_ve_device(device) {
+	assert(region_size > 0 && "Frame ring region size must be greater than zero");
+	const auto& limits = m_ve_device.getDeviceProperties().limits;
+	m_min_alignment = std::max({
+		limits.minUniformBufferOffsetAlignment,
+		limits.minStorageBufferOffsetAlignment,
+		vk::DeviceSize{16}});
+
+	// Regions start aligned so offsets inside them stay valid dynamic offsets
+	m_region_size = VeBuffer::getAlignment(region_size, m_min_alignment);
+	m_buffer = std::make_unique<VeBuffer>(
+		m_ve_device,
+		m_region_size,
+		MAX_FRAMES_IN_FLIGHT,
+		usage,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	m_buffer->map();
+	beginFrame(0);
+}
+
+VeFrameRing::~VeFrameRing() {}
+
+void VeFrameRing::beginFrame(uint32_t frame_index) {
+	assert(frame_index < MAX_FRAMES_IN_FLIGHT && "frame_index out of bounds");
+	m_region_begin = m_region_size * frame_index;
+	m_head = m_region_begin;
+}
+
+VeRingAllocation VeFrameRing::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+	assert(size > 0 && "Ring allocation size must be greater than zero");
+	const vk::DeviceSize align = alignment == 0 ? m_min_alignment : alignment;
+	const vk::DeviceSize offset = VeBuffer::getAlignment(m_head, align);
+	if (offset + size > m_region_begin + m_region_size) {
+		throw std::runtime_error(std::format(
+			"VeFrameRing: frame region of {} bytes exhausted (requested {} bytes)", m_region_size, size));
+	}
+	m_head = offset + size;
+	m_peak_bytes = std::max(m_peak_bytes, m_head - m_region_begin);
+	return VeRingAllocation{
+		.data = static_cast<char*>(m_buffer->getMappedMemory()) + offset,
+		.offset = offset,
+		.size = size
+	};
+}
+
+vk::DescriptorBufferInfo VeFrameRing::getDescriptorInfo(vk::DeviceSize range) const {
+	assert(range > 0 && range <= m_region_size && "Descriptor range must fit inside a frame region");
+	return vk::DescriptorBufferInfo{
+		.buffer = *m_buffer->getBuffer(),
+		.offset = 0,
+		.range = range
+	};
+}
+
+} // namespace ve
@@ -0,0 +1,77 @@
+/* VeFrameRing is a persistently mapped buffer split into one region per frame in
+flight. Transient per-frame data (uniforms, per-object data, debug geometry) is
+written with a single pointer bump into the region of the current frame. The
+region is reused once the frame's fence has been waited on, so there are no
+allocations and no descriptor writes per frame: descriptors point at the ring
+buffer once and are bound with the returned dynamic offset. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+#include "core/ve_device.hpp"
+#include "core/ve_buffer.hpp"
+
+#include <cstring>
+#include <memory>
+
+namespace ve {
+
+struct VeRingAllocation {
+	void* data = nullptr;      // host pointer into the mapped ring
+	vk::DeviceSize offset = 0; // offset from the start of the ring buffer
+	vk::DeviceSize size = 0;
+
+	// Offset as passed to bindDescriptorSets for dynamic uniform/storage descriptors
+	uint32_t getDynamicOffset() const { return static_cast<uint32_t>(offset); }
+};
+
+class VENGINE_API VeFrameRing {
+public:
+	VeFrameRing(
+		VeDevice& device,
+		vk::DeviceSize region_size = FRAME_RING_REGION_SIZE,
+		vk::BufferUsageFlags usage =
+			vk::BufferUsageFlagBits::eUniformBuffer |
+			vk::BufferUsageFlagBits::eStorageBuffer |
+			vk::BufferUsageFlagBits::eVertexBuffer |
+			vk::BufferUsageFlagBits::eIndexBuffer |
+			vk::BufferUsageFlagBits::eIndirectBuffer |
+			vk::BufferUsageFlagBits::eTransferSrc);
+	~VeFrameRing();
+
+	VeFrameRing(const VeFrameRing&) = delete;
+	VeFrameRing& operator=(const VeFrameRing&) = delete;
+
+	// Starts writing into the region of frame_index, must only be called once that frame's fence has signaled
+	void beginFrame(uint32_t frame_index);
+
+	// Bump allocates from the current frame's region. alignment 0 uses the device's
+	// uniform/storage offset alignment so the result is valid as a dynamic offset.
+	VeRingAllocation allocate(vk::DeviceSize size, vk::DeviceSize alignment = 0);
+	template <typename T>
+	VeRingAllocation push(const T& value) {
+		VeRingAllocation allocation = allocate(sizeof(T));
+		memcpy(allocation.data, &value, sizeof(T));
+		return allocation;
+	}
+
+	vk::Buffer getBuffer() const { return *m_buffer->getBuffer(); }
+	vk::raii::Buffer& getRaiiBuffer() { return m_buffer->getBuffer(); }
+	// Descriptor info for a dynamic descriptor covering range bytes from the dynamic offset
+	vk::DescriptorBufferInfo getDescriptorInfo(vk::DeviceSize range) const;
+
+	vk::DeviceSize getRegionSize() const { return m_region_size; }
+	vk::DeviceSize getUsedBytes() const { return m_head - m_region_begin; }
+	vk::DeviceSize getPeakBytes() const { return m_peak_bytes; }
+
+private:
+	VeDevice& m_ve_device;
+	std::unique_ptr<VeBuffer> m_buffer;
+	vk::DeviceSize m_region_size;
+	vk::DeviceSize m_min_alignment;
+
+	vk::DeviceSize m_region_begin = 0;
+	vk::DeviceSize m_head = 0;
+	vk::DeviceSize m_peak_bytes = 0;
+};
+
+} // namespace ve
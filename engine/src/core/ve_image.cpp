@@ -56,17 +56,11 @@ void VeImage::createImage() {
 	m_image = vk::raii::Image(m_ve_device.getDevice(), image_info);
 	assert(*m_image != VK_NULL_HANDLE && "Failed to create image");
 
-	// Allocate and bind memory to image
-	vk::MemoryRequirements mem_requirements = m_image.getMemoryRequirements();
-	vk::MemoryAllocateInfo alloc_info {
-		.sType = vk::StructureType::eMemoryAllocateInfo,
-		.pNext = nullptr,
-		.allocationSize = mem_requirements.size,
-		.memoryTypeIndex = m_ve_device.findMemoryType(mem_requirements.memoryTypeBits, m_properties)
-	};
-	m_image_memory = vk::raii::DeviceMemory(m_ve_device.getDevice(), alloc_info);
-	assert(*m_image_memory != VK_NULL_HANDLE && "Failed to allocate image memory");
-	m_image.bindMemory(*m_image_memory, 0); // offset 0
+	// Sub-allocate and bind memory to image
+	m_image_memory = m_ve_device.allocateMemory(
+		m_image.getMemoryRequirements(), m_properties, m_tiling == vk::ImageTiling::eLinear);
+	assert(m_image_memory && "Failed to allocate image memory");
+	m_image.bindMemory(m_image_memory.getMemory(), m_image_memory.getOffset());
 }
 
 void VeImage::createImageView() {
@@ -91,7 +85,6 @@ void VeImage::createImageView() {
 	assert(*m_image_view != VK_NULL_HANDLE && "Failed to create image view");
 }
 
-// Hardcoded: src and dst queue family indices to ignored, mip levels = 1
 void VeImage::transitionImageLayout(
 	vk::ImageLayout old_layout,
 	vk::ImageLayout new_layout,
@@ -106,6 +99,21 @@ void VeImage::transitionImageLayout(
 		kind = QueueKind::Transfer;
 	}
 	auto command_buffer = m_ve_device.beginSingleTimeCommands(kind);
+	recordTransition(**command_buffer, old_layout, new_layout, src_access_mask, dst_access_mask, src_stage, dst_stage);
+	m_ve_device.endSingleTimeCommands(*command_buffer, kind);
+}
+
+// Hardcoded: src and dst queue family indices to ignored, mip levels = 1
+void VeImage::recordTransition(
+	vk::CommandBuffer command_buffer,
+	vk::ImageLayout old_layout,
+	vk::ImageLayout new_layout,
+	vk::AccessFlags2 src_access_mask,
+	vk::AccessFlags2 dst_access_mask,
+	vk::PipelineStageFlags2 src_stage,
+	vk::PipelineStageFlags2 dst_stage) const {
+
+	assert(*m_image != VK_NULL_HANDLE && "Image must be valid when transitioning image layout");
 	vk::ImageMemoryBarrier2 barrier = {
 		.sType = vk::StructureType::eImageMemoryBarrier2,
 		.pNext = nullptr,
@@ -137,7 +145,6 @@ void VeImage::transitionImageLayout(
 		.imageMemoryBarrierCount = 1,
 		.pImageMemoryBarriers = &barrier
 	};
-	command_buffer->pipelineBarrier2(dependency_info);
-	m_ve_device.endSingleTimeCommands(*command_buffer, kind);
+	command_buffer.pipelineBarrier2(dependency_info);
 }
 } // namespace ve
@@ -27,7 +27,7 @@ public:
 
 	const vk::raii::Image& getImage() const { return m_image; }
 	const vk::raii::ImageView& getImageView() const { return m_image_view; }
-	const vk::raii::DeviceMemory& getImageMemory() const { return m_image_memory; }
+	const VeAllocation& getImageMemory() const { return m_image_memory; }
 	vk::Format getFormat() const { return m_format; }
 	uint32_t getWidth() const { return m_width; }
 	uint32_t getHeight() const { return m_height; }
@@ -41,6 +41,16 @@ public:
 		vk::AccessFlags2 dst_access_mask,
 		vk::PipelineStageFlags2 src_stage,
 		vk::PipelineStageFlags2 dst_stage);
+	// Records the layout transition into an existing command buffer instead of a single-time submit
+	void recordTransition(
+		vk::CommandBuffer command_buffer,
+		vk::ImageLayout old_layout,
+		vk::ImageLayout new_layout,
+		vk::AccessFlags2 src_access_mask,
+		vk::AccessFlags2 dst_access_mask,
+		vk::PipelineStageFlags2 src_stage,
+		vk::PipelineStageFlags2 dst_stage) const;
+	uint32_t getArrayLayers() const { return m_array_layers; }
 
 private:
 	void createImage();
@@ -59,8 +69,8 @@ private:
 	vk::ImageCreateFlags m_image_create_flags{};
 	vk::ImageViewType m_image_view_type{vk::ImageViewType::e2D};
 
+	VeAllocation m_image_memory; // declared first so it outlives the image and view
 	vk::raii::Image m_image{nullptr};
-	vk::raii::DeviceMemory m_image_memory{nullptr};
 	vk::raii::ImageView m_image_view{nullptr};
 
 
@@ -10,7 +10,12 @@ VePipeline::VePipeline(
 		VeDevice& ve_device,
 		const std::filesystem::path& shader_file_path,
 		const PipelineConfigInfo& config_info) : m_ve_device(ve_device) {
-	createGraphicsPipeline(shader_file_path, config_info);
+	assert(config_info.pipeline_layout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipelineLayout provided in config_info");
+	storeConfig(config_info);
+	// Use the same combined SPIR-V for both stages; entry points differ per stage
+	auto shader_code = VeFileSystem::readFile(shader_file_path);
+	createShaderModule(shader_code, &m_shader_module);
+	createGraphicsPipeline(m_config.multisample_info.rasterizationSamples);
 }
 
 VePipeline::~VePipeline() {}
@@ -99,15 +104,44 @@ void VePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& config_info, VeDe
 	};
 	config_info.attribute_descriptions = VeModel::Vertex::getAttributeDescriptions();
 	config_info.binding_descriptions = VeModel::Vertex::getBindingDescriptions();
+	config_info.depth_format = ve_device.findDepthFormat();
 }
 
-void VePipeline::createGraphicsPipeline(
-		const std::filesystem::path& shader_file_path,
-		const PipelineConfigInfo& config_info) {
+void VePipeline::storeConfig(const PipelineConfigInfo& config_info) {
+	assert(config_info.multisample_info.pSampleMask == nullptr && "Sample masks are not kept with the config");
+	m_config.dynamic_state_enables = config_info.dynamic_state_enables;
+	m_config.dynamic_state_info = config_info.dynamic_state_info;
+	m_config.dynamic_state_info.dynamicStateCount = static_cast<uint32_t>(m_config.dynamic_state_enables.size());
+	m_config.dynamic_state_info.pDynamicStates = m_config.dynamic_state_enables.data();
+	m_config.input_assembly_info = config_info.input_assembly_info;
+	m_config.rasterization_info = config_info.rasterization_info;
+	m_config.multisample_info = config_info.multisample_info;
+	m_config.depth_stencil_info = config_info.depth_stencil_info;
+	m_config.viewport_info = config_info.viewport_info;
+	m_config.color_blend_attachment = config_info.color_blend_attachment;
+	m_config.color_blend_info = config_info.color_blend_info;
+	m_config.color_blend_info.pAttachments = &m_config.color_blend_attachment;
+	m_config.pipeline_layout = config_info.pipeline_layout;
+	m_config.color_format = config_info.color_format;
+	m_config.extra_color_formats = config_info.extra_color_formats;
+	m_config.attribute_descriptions = config_info.attribute_descriptions;
+	m_config.binding_descriptions = config_info.binding_descriptions;
+	m_config.depth_format = config_info.depth_format;
+}
 
-	auto shader_code = VeFileSystem::readFile(shader_file_path);
-	// Use the same combined SPIR-V for both stages; entry points differ per stage
-	createShaderModule(shader_code, &m_shader_module);
+vk::Pipeline VePipeline::getPipeline(vk::SampleCountFlagBits samples) {
+	auto it = m_pipelines.find(samples);
+	if (it == m_pipelines.end()) {
+		createGraphicsPipeline(samples);
+		it = m_pipelines.find(samples);
+	}
+	return *it->second;
+}
+
+void VePipeline::createGraphicsPipeline(vk::SampleCountFlagBits samples) {
+	const PipelineConfigInfo& config_info = m_config;
+	vk::PipelineMultisampleStateCreateInfo multisample_info = config_info.multisample_info;
+	multisample_info.rasterizationSamples = samples;
 
 	vk::PipelineShaderStageCreateInfo shader_stages[2] = {
 		{
@@ -132,18 +166,21 @@ void VePipeline::createGraphicsPipeline(
 		.vertexAttributeDescriptionCount = static_cast<uint32_t>(config_info.attribute_descriptions.size()),
 		.pVertexAttributeDescriptions = config_info.attribute_descriptions.data()
 	};
-	vk::Format depth_format = m_ve_device.findSupportedFormat(
-		{vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint},
-		vk::ImageTiling::eOptimal,
-		vk::FormatFeatureFlagBits::eDepthStencilAttachment
-	);
+	// Every color attachment uses the same blend state, so independentBlend is not needed
+	std::vector<vk::Format> color_formats{config_info.color_format};
+	color_formats.insert(color_formats.end(), config_info.extra_color_formats.begin(), config_info.extra_color_formats.end());
+	std::vector<vk::PipelineColorBlendAttachmentState> blend_attachments(color_formats.size(), config_info.color_blend_attachment);
+	vk::PipelineColorBlendStateCreateInfo color_blend_info = config_info.color_blend_info;
+	color_blend_info.attachmentCount = static_cast<uint32_t>(blend_attachments.size());
+	color_blend_info.pAttachments = blend_attachments.data();
+
 	vk::PipelineRenderingCreateInfo pipelineRenderingCreateInfo{
 		.sType = vk::StructureType::ePipelineRenderingCreateInfo,
 		.pNext = nullptr,
 		.viewMask = 0,
-		.colorAttachmentCount = 1,
-		.pColorAttachmentFormats = &config_info.color_format,
-		.depthAttachmentFormat = depth_format,
+		.colorAttachmentCount = static_cast<uint32_t>(color_formats.size()),
+		.pColorAttachmentFormats = color_formats.data(),
+		.depthAttachmentFormat = config_info.depth_format,
 		.stencilAttachmentFormat = vk::Format::eUndefined
 	};
 	vk::GraphicsPipelineCreateInfo pipeline_info{
@@ -157,9 +194,9 @@ void VePipeline::createGraphicsPipeline(
 		.pTessellationState = nullptr,
 		.pViewportState = &config_info.viewport_info,
 		.pRasterizationState = &config_info.rasterization_info,
-		.pMultisampleState = &config_info.multisample_info,
+		.pMultisampleState = &multisample_info,
 		.pDepthStencilState = &config_info.depth_stencil_info,
-		.pColorBlendState = &config_info.color_blend_info,
+		.pColorBlendState = &color_blend_info,
 		.pDynamicState = &config_info.dynamic_state_info,
 		.layout = config_info.pipeline_layout,
 		.renderPass = nullptr, // Using dynamic rendering
@@ -167,9 +204,8 @@ void VePipeline::createGraphicsPipeline(
 		.basePipelineHandle = VK_NULL_HANDLE,
 		.basePipelineIndex = -1
 	};
-	assert(config_info.pipeline_layout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipelineLayout provided in config_info");
 
-	m_graphics_pipeline = vk::raii::Pipeline{m_ve_device.getDevice(), nullptr, pipeline_info};
+	m_pipelines.emplace(samples, vk::raii::Pipeline{m_ve_device.getDevice(), nullptr, pipeline_info});
 }
 
 void VePipeline::createShaderModule(const std::vector<char>& code, vk::raii::ShaderModule* _shader_module) {
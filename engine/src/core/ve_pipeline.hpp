@@ -1,11 +1,13 @@
 /* This class manages the creation and configuration of Vulkan pipelines.
-It also creates the necessary shader modules. */
+It also creates the necessary shader modules. The config is kept so variants of the
+pipeline for other MSAA sample counts can be created when they are first asked for. */
 #pragma once
 #include "ve_export.hpp"
 #include <vulkan/vulkan_raii.hpp>
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <unordered_map>
 
 namespace ve { class VeDevice; }
 
@@ -28,9 +30,10 @@ struct PipelineConfigInfo {
 	vk::PipelineColorBlendStateCreateInfo color_blend_info{};
 	vk::PipelineLayout pipeline_layout = nullptr;
 	vk::Format color_format = vk::Format::eUndefined;
+	std::vector<vk::Format> extra_color_formats{}; // attachments after the first, blended like it
 	std::vector<vk::VertexInputAttributeDescription> attribute_descriptions{};
 	std::vector<vk::VertexInputBindingDescription> binding_descriptions{};
-	//vk::Format depth_format = vk::Format::eUndefined;
+	vk::Format depth_format = vk::Format::eUndefined; // undefined for passes without depth attachment
 };
 
 class VENGINE_API VePipeline {
@@ -46,19 +49,23 @@ public:
 	VePipeline(const VePipeline&) = delete;
 	VePipeline& operator=(const VePipeline&) = delete;
 
-	vk::Pipeline getPipeline() const { return *m_graphics_pipeline; }
+	// Pipeline for the sample count of the config it was created with
+	vk::Pipeline getPipeline() const { return *m_pipelines.at(m_config.multisample_info.rasterizationSamples); }
+	// Pipeline for samples, created from the config on first use. Not thread safe.
+	vk::Pipeline getPipeline(vk::SampleCountFlagBits samples);
 
 	static void defaultPipelineConfigInfo(PipelineConfigInfo& config_info, VeDevice& device);
 
 private:
-	void createGraphicsPipeline(
-		const std::filesystem::path& shader_file_path,
-		const PipelineConfigInfo& config_info);
+	// Copies config_info into m_config, pointing its create infos at m_config's own members
+	void storeConfig(const PipelineConfigInfo& config_info);
+	void createGraphicsPipeline(vk::SampleCountFlagBits samples);
 
 	void createShaderModule(const std::vector<char>& code, vk::raii::ShaderModule* shader_module);
 
 	VeDevice& m_ve_device; // will outlive the pipeline class
-	vk::raii::Pipeline m_graphics_pipeline{nullptr};
+	PipelineConfigInfo m_config;
 	vk::raii::ShaderModule m_shader_module{nullptr};
+	std::unordered_map<vk::SampleCountFlagBits, vk::raii::Pipeline> m_pipelines;
 };
 }
\ No newline at end of file
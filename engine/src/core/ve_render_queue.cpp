@@ -0,0 +1,310 @@
+#include "pch.hpp"
+#include "core/ve_render_queue.hpp"
+#include "core/ve_thread_pool.hpp"
+
+#include <bit>
+
+namespace ve {
+
+namespace {
+
+template <typename Handle>
+uint64_t handleValue(Handle handle) {
+	return reinterpret_cast<uint64_t>(static_cast<typename Handle::CType>(handle));
+}
+
+void hashCombine(uint64_t& seed, uint64_t value) {
+	seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+} // namespace
+
+void VeRenderQueue::begin(const glm::mat4& view) {
+	m_view = view;
+	m_packets.clear();
+	m_entries.clear();
+	m_push_data.clear();
+	m_pass_counts.fill(0);
+	m_stats = Stats{};
+	m_pipeline_ids.clear();
+	m_material_ids.clear();
+	m_mesh_ids.clear();
+	m_sorted = true;
+}
+
+float VeRenderQueue::getViewDepth(const glm::vec3& world_position) const {
+	return -(m_view * glm::vec4(world_position, 1.0f)).z; // the camera looks down -z
+}
+
+// Ids only have to be equal for equal state within a frame. Past the width of their
+// field they saturate, which only costs grouping, the binds are compared by value.
+uint32_t VeRenderQueue::intern(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t state, uint32_t bits) {
+	const uint32_t max_id = (1u << bits) - 1;
+	return ids.try_emplace(state, std::min(static_cast<uint32_t>(ids.size()), max_id)).first->second;
+}
+
+void VeRenderQueue::submit(Pass pass, float depth, const VeDrawPacket& packet) {
+	assert(packet.pipeline && packet.pipeline_layout && "packet needs a pipeline and its layout");
+	assert(packet.descriptor_set_count <= VeDrawPacket::MAX_DESCRIPTOR_SETS && "too many descriptor sets");
+	assert(packet.vertex_buffer_count <= VeDrawPacket::MAX_VERTEX_BUFFERS && "too many vertex buffers");
+	assert((packet.type == VeDrawPacket::DRAW || packet.index_buffer) && "indexed packets need an index buffer");
+	assert(pass < PASS_COUNT && "unknown pass");
+	++m_pass_counts[pass];
+
+	uint64_t material = packet.dynamic_offset.value_or(UINT32_MAX);
+	for (uint32_t i = 0; i < packet.descriptor_set_count; ++i)
+		hashCombine(material, handleValue(packet.descriptor_sets[i]));
+	uint64_t mesh = handleValue(packet.index_buffer);
+	for (uint32_t i = 0; i < packet.vertex_buffer_count; ++i) {
+		hashCombine(mesh, handleValue(packet.vertex_buffers[i]));
+		hashCombine(mesh, packet.vertex_offsets[i]);
+	}
+
+	const uint64_t key = makeSortKey(
+		pass,
+		intern(m_pipeline_ids, handleValue(packet.pipeline), PIPELINE_BITS),
+		intern(m_material_ids, material, MATERIAL_BITS),
+		intern(m_mesh_ids, mesh, MESH_BITS),
+		depth);
+	m_entries.push_back({ key, static_cast<uint32_t>(m_packets.size()) });
+	m_packets.push_back(packet);
+	m_sorted = false;
+}
+
+// Depth keeps the upper bits of the float, whose bit pattern orders like the value for
+// non-negative floats. Transparent depths are inverted so farther packets come first.
+uint64_t VeRenderQueue::makeSortKey(Pass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+	const uint64_t depth_mask = (1ull << DEPTH_BITS) - 1;
+	uint64_t depth_key = std::bit_cast<uint32_t>(std::max(depth, 0.0f)) >> (32 - DEPTH_BITS);
+	if (pass == PASS_TRANSPARENT)
+		depth_key = ~depth_key & depth_mask;
+
+	uint64_t key = pass & ((1u << PASS_BITS) - 1);
+	key = (key << PIPELINE_BITS) | (pipeline & ((1u << PIPELINE_BITS) - 1));
+	key = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+	key = (key << MESH_BITS) | (mesh & ((1u << MESH_BITS) - 1));
+	return (key << DEPTH_BITS) | depth_key;
+}
+
+void VeRenderQueue::sort() {
+	if (m_sorted)
+		return;
+	radixSort();
+	m_sorted = true;
+}
+
+// LSD radix sort over the 8 bytes of the keys. All histograms are built in one pass and
+// bytes every key shares are skipped, in practice most of the pass and pipeline bytes.
+// Stable, so packets with equal keys keep their submission order.
+void VeRenderQueue::radixSort() {
+	const size_t count = m_entries.size();
+	if (count == 0)
+		return;
+	std::array<std::array<uint32_t, 256>, 8> histograms{};
+	for (const Entry& entry : m_entries) {
+		for (uint32_t byte = 0; byte < 8; ++byte)
+			++histograms[byte][(entry.key >> (byte * 8)) & 0xff];
+	}
+
+	m_scratch.resize(count);
+	for (uint32_t byte = 0; byte < 8; ++byte) {
+		auto& histogram = histograms[byte];
+		if (histogram[(m_entries.front().key >> (byte * 8)) & 0xff] == count)
+			continue;
+		uint32_t offset = 0;
+		for (uint32_t& bucket : histogram) {
+			const uint32_t bucket_count = bucket;
+			bucket = offset;
+			offset += bucket_count;
+		}
+		for (const Entry& entry : m_entries)
+			m_scratch[histogram[(entry.key >> (byte * 8)) & 0xff]++] = entry;
+		m_entries.swap(m_scratch);
+	}
+}
+
+uint32_t VeRenderQueue::getPacketCount(Pass first_pass, Pass last_pass) const {
+	const auto [first, last] = getPassRange(first_pass, last_pass);
+	return last - first;
+}
+
+// The pass is the most significant key field, so sorted packets are grouped by pass
+std::pair<uint32_t, uint32_t> VeRenderQueue::getPassRange(Pass first_pass, Pass last_pass) const {
+	assert(first_pass <= last_pass && last_pass < PASS_COUNT && "invalid pass range");
+	uint32_t first = 0;
+	for (uint32_t pass = 0; pass < first_pass; ++pass)
+		first += m_pass_counts[pass];
+	uint32_t last = first;
+	for (uint32_t pass = first_pass; pass <= last_pass; ++pass)
+		last += m_pass_counts[pass];
+	return { first, last };
+}
+
+void VeRenderQueue::record(vk::CommandBuffer command_buffer, Pass first_pass, Pass last_pass) {
+	sort();
+	const auto [first, last] = getPassRange(first_pass, last_pass);
+	const Stats stats = recordRange(command_buffer, first, last);
+	m_stats.packets += stats.packets;
+	m_stats.binds += stats.binds;
+	m_stats.binds_saved += stats.binds_saved;
+}
+
+uint32_t VeRenderQueue::getChunkCount(const VeThreadPool& thread_pool, uint32_t packets_per_chunk, Pass first_pass, Pass last_pass) const {
+	const uint32_t chunks = getPacketCount(first_pass, last_pass) / std::max(packets_per_chunk, 1u);
+	return std::clamp(chunks, 1u, thread_pool.getThreadCount());
+}
+
+// Every chunk starts with nothing bound, so binds at chunk boundaries are repeated.
+// Chunks of equal size are fine as long as packets cost about the same to record.
+const std::vector<vk::CommandBuffer>& VeRenderQueue::recordParallel(
+	VeThreadPool& thread_pool,
+	uint32_t chunk_count,
+	const std::function<vk::CommandBuffer(uint32_t chunk)>& begin_chunk,
+	Pass first_pass,
+	Pass last_pass) {
+	assert(chunk_count > 0 && "recordParallel needs at least one chunk");
+	sort();
+	const auto [begin, end] = getPassRange(first_pass, last_pass);
+	const uint32_t count = end - begin;
+	m_chunk_buffers.assign(chunk_count, vk::CommandBuffer{});
+	m_chunk_stats.assign(chunk_count, Stats{});
+	thread_pool.parallelFor(chunk_count, [&](uint32_t chunk) {
+		const uint32_t first = begin + static_cast<uint32_t>(uint64_t{count} * chunk / chunk_count);
+		const uint32_t last = begin + static_cast<uint32_t>(uint64_t{count} * (chunk + 1) / chunk_count);
+		vk::CommandBuffer command_buffer = begin_chunk(chunk);
+		m_chunk_stats[chunk] = recordRange(command_buffer, first, last);
+		command_buffer.end();
+		m_chunk_buffers[chunk] = command_buffer;
+	});
+
+	for (const Stats& stats : m_chunk_stats) {
+		m_stats.packets += stats.packets;
+		m_stats.binds += stats.binds;
+		m_stats.binds_saved += stats.binds_saved;
+	}
+	return m_chunk_buffers;
+}
+
+// The state bound so far is tracked per field. A new pipeline layout may disturb the
+// bound descriptor sets, so those are bound again after a layout change.
+VeRenderQueue::Stats VeRenderQueue::recordRange(vk::CommandBuffer command_buffer, uint32_t first, uint32_t last) const {
+	Stats stats{ .packets = last - first };
+	uint32_t naive_binds = 0;
+
+	vk::Pipeline bound_pipeline{};
+	vk::PipelineLayout bound_layout{};
+	std::array<vk::DescriptorSet, VeDrawPacket::MAX_DESCRIPTOR_SETS> bound_sets{};
+	uint32_t bound_set_count = 0;
+	std::optional<uint32_t> bound_dynamic_offset;
+	std::array<vk::Buffer, VeDrawPacket::MAX_VERTEX_BUFFERS> bound_vertex_buffers{};
+	std::array<vk::DeviceSize, VeDrawPacket::MAX_VERTEX_BUFFERS> bound_vertex_offsets{};
+	uint32_t bound_vertex_count = 0;
+	vk::Buffer bound_index_buffer{};
+
+	for (uint32_t i = first; i < last; ++i) {
+		const VeDrawPacket& packet = m_packets[m_entries[i].packet];
+
+		++naive_binds;
+		if (packet.pipeline != bound_pipeline) {
+			command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, packet.pipeline);
+			bound_pipeline = packet.pipeline;
+			++stats.binds;
+		}
+		if (packet.pipeline_layout != bound_layout) {
+			bound_layout = packet.pipeline_layout;
+			bound_set_count = 0;
+		}
+
+		if (packet.descriptor_set_count > 0) {
+			++naive_binds;
+			// Sets from the first one that differs are bound in one call
+			uint32_t first_set = 0;
+			while (first_set < packet.descriptor_set_count && first_set < bound_set_count &&
+				packet.descriptor_sets[first_set] == bound_sets[first_set] &&
+				(first_set > 0 || packet.dynamic_offset == bound_dynamic_offset))
+				++first_set;
+			if (first_set < packet.descriptor_set_count) {
+				const uint32_t set_count = packet.descriptor_set_count - first_set;
+				const bool with_offset = first_set == 0 && packet.dynamic_offset.has_value();
+				command_buffer.bindDescriptorSets(
+					vk::PipelineBindPoint::eGraphics,
+					packet.pipeline_layout,
+					first_set,
+					set_count,
+					packet.descriptor_sets.data() + first_set,
+					with_offset ? 1u : 0u,
+					with_offset ? &*packet.dynamic_offset : nullptr);
+				std::copy_n(packet.descriptor_sets.begin() + first_set, set_count, bound_sets.begin() + first_set);
+				if (first_set == 0)
+					bound_dynamic_offset = packet.dynamic_offset;
+				++stats.binds;
+			}
+			bound_set_count = std::max(bound_set_count, packet.descriptor_set_count);
+		}
+
+		if (packet.vertex_buffer_count > 0) {
+			++naive_binds;
+			uint32_t first_binding = 0;
+			while (first_binding < packet.vertex_buffer_count && first_binding < bound_vertex_count &&
+				packet.vertex_buffers[first_binding] == bound_vertex_buffers[first_binding] &&
+				packet.vertex_offsets[first_binding] == bound_vertex_offsets[first_binding])
+				++first_binding;
+			if (first_binding < packet.vertex_buffer_count) {
+				const uint32_t binding_count = packet.vertex_buffer_count - first_binding;
+				command_buffer.bindVertexBuffers(
+					first_binding,
+					binding_count,
+					packet.vertex_buffers.data() + first_binding,
+					packet.vertex_offsets.data() + first_binding);
+				std::copy_n(packet.vertex_buffers.begin() + first_binding, binding_count, bound_vertex_buffers.begin() + first_binding);
+				std::copy_n(packet.vertex_offsets.begin() + first_binding, binding_count, bound_vertex_offsets.begin() + first_binding);
+				++stats.binds;
+			}
+			bound_vertex_count = std::max(bound_vertex_count, packet.vertex_buffer_count);
+		}
+
+		if (packet.index_buffer) {
+			++naive_binds;
+			if (packet.index_buffer != bound_index_buffer) {
+				command_buffer.bindIndexBuffer(packet.index_buffer, 0, vk::IndexType::eUint32);
+				bound_index_buffer = packet.index_buffer;
+				++stats.binds;
+			}
+		}
+
+		if (packet.push_size > 0) {
+			command_buffer.pushConstants(
+				packet.pipeline_layout,
+				packet.push_stages,
+				0,
+				packet.push_size,
+				m_push_data.data() + packet.push_offset);
+		}
+
+		switch (packet.type) {
+			case VeDrawPacket::DRAW:
+				command_buffer.draw(packet.count, packet.instance_count, packet.first, packet.first_instance);
+				break;
+			case VeDrawPacket::DRAW_INDEXED:
+				command_buffer.drawIndexed(
+					packet.count, packet.instance_count, packet.first, packet.vertex_offset, packet.first_instance);
+				break;
+			case VeDrawPacket::DRAW_INDEXED_INDIRECT_COUNT:
+				command_buffer.drawIndexedIndirectCount(
+					packet.indirect_buffer,
+					packet.indirect_offset,
+					packet.count_buffer,
+					packet.count_offset,
+					packet.max_draw_count,
+					packet.stride);
+				break;
+			case VeDrawPacket::DRAW_INDIRECT:
+				command_buffer.drawIndirect(packet.indirect_buffer, packet.indirect_offset, packet.max_draw_count, packet.stride);
+				break;
+		}
+	}
+	stats.binds_saved = naive_binds - stats.binds;
+	return stats;
+}
+
+} // namespace ve
@@ -0,0 +1,184 @@
+/* VeRenderQueue collects the draws of all render systems for one frame and records
+them in an order that minimises state changes. Each draw is a VeDrawPacket carrying
+the state it needs (pipeline, descriptor sets, vertex and index buffers) and gets a
+64 bit sort key packing pass, pipeline, material, mesh and view depth, most
+significant first. The keys are radix sorted and the packets recorded in order,
+every bind that matches the state already bound is skipped. Opaque packets of one
+state are drawn front to back, transparent ones back to front. Large queues can be
+split into consecutive chunks recorded into secondary command buffers on the
+threads of a VeThreadPool. A range of passes can be recorded on its own, for passes
+that render into other targets than the scene. */
+#pragma once
+#include "ve_export.hpp"
+
+#include <vulkan/vulkan_raii.hpp>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <type_traits>
+#include <utility>
+
+namespace ve {
+
+class VeThreadPool;
+
+// One draw and the state it is drawn with, see VeRenderQueue::submit
+struct VeDrawPacket {
+	enum Type : uint32_t {
+		DRAW = 0,
+		DRAW_INDEXED = 1,
+		DRAW_INDEXED_INDIRECT_COUNT = 2,
+		DRAW_INDIRECT = 3
+	};
+	static constexpr uint32_t MAX_DESCRIPTOR_SETS = 4;
+	static constexpr uint32_t MAX_VERTEX_BUFFERS = 2;
+
+	Type type = DRAW;
+	vk::Pipeline pipeline{};
+	vk::PipelineLayout pipeline_layout{};
+	// Bound from set 0, only set 0 may hold a dynamic descriptor (the global ubo)
+	std::array<vk::DescriptorSet, MAX_DESCRIPTOR_SETS> descriptor_sets{};
+	uint32_t descriptor_set_count = 0;
+	std::optional<uint32_t> dynamic_offset;
+	// Bound from binding 0
+	std::array<vk::Buffer, MAX_VERTEX_BUFFERS> vertex_buffers{};
+	std::array<vk::DeviceSize, MAX_VERTEX_BUFFERS> vertex_offsets{};
+	uint32_t vertex_buffer_count = 0;
+	vk::Buffer index_buffer{}; // uint32 indices, required by the indexed types
+	vk::ShaderStageFlags push_stages{};
+
+	// DRAW: vertex range, DRAW_INDEXED: index range and vertex offset
+	uint32_t count = 0;
+	uint32_t instance_count = 1;
+	uint32_t first = 0;
+	int32_t vertex_offset = 0;
+	uint32_t first_instance = 0;
+
+	// DRAW_INDEXED_INDIRECT_COUNT, DRAW_INDIRECT draws max_draw_count commands without a count buffer
+	vk::Buffer indirect_buffer{};
+	vk::DeviceSize indirect_offset = 0;
+	vk::Buffer count_buffer{};
+	vk::DeviceSize count_offset = 0;
+	uint32_t max_draw_count = 0;
+	uint32_t stride = 0;
+
+	// Push constant bytes in the queue, set by VeRenderQueue::submit
+	uint32_t push_offset = 0;
+	uint32_t push_size = 0;
+};
+
+class VENGINE_API VeRenderQueue {
+public:
+	// Passes are recorded in this order
+	enum Pass : uint32_t {
+		PASS_BACKGROUND = 0,
+		PASS_OPAQUE = 1,
+		PASS_TRANSPARENT = 2, // back to front
+		PASS_OIT = 3,         // weighted blended transparency, order independent, recorded into the OIT targets
+		PASS_COUNT = 4
+	};
+	// Bits of each sort key field, from the most significant down
+	static constexpr uint32_t PASS_BITS = 4;
+	static constexpr uint32_t PIPELINE_BITS = 8;
+	static constexpr uint32_t MATERIAL_BITS = 14;
+	static constexpr uint32_t MESH_BITS = 14;
+	static constexpr uint32_t DEPTH_BITS = 24;
+	static_assert(PASS_BITS + PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS == 64);
+
+	struct Stats {
+		uint32_t packets = 0;
+		uint32_t binds = 0;       // pipeline, descriptor set, vertex and index buffer binds recorded
+		uint32_t binds_saved = 0; // binds skipped against binding everything for every packet
+	};
+
+	VeRenderQueue() = default;
+	~VeRenderQueue() = default;
+
+	VeRenderQueue(const VeRenderQueue&) = delete;
+	VeRenderQueue& operator=(const VeRenderQueue&) = delete;
+
+	// Drops the packets and counts of the last frame, view is used by getViewDepth
+	void begin(const glm::mat4& view);
+	// Distance in front of the camera, the depth to submit for a draw at world_position
+	float getViewDepth(const glm::vec3& world_position) const;
+
+	void submit(Pass pass, float depth, const VeDrawPacket& packet);
+	// Packet with push constants for its push_stages, copied into the queue
+	template <typename T>
+	void submit(Pass pass, float depth, VeDrawPacket packet, const T& push_constants) {
+		static_assert(std::is_trivially_copyable_v<T>, "push constants are copied as bytes");
+		packet.push_offset = static_cast<uint32_t>(m_push_data.size());
+		packet.push_size = static_cast<uint32_t>(sizeof(T));
+		const auto* bytes = reinterpret_cast<const uint8_t*>(&push_constants);
+		m_push_data.insert(m_push_data.end(), bytes, bytes + sizeof(T));
+		submit(pass, depth, packet);
+	}
+
+	// Sorts the packets by key, record sorts first when needed
+	void sort();
+	// Records the packets of passes [first_pass, last_pass] into command_buffer, which
+	// is assumed to have nothing bound
+	void record(vk::CommandBuffer command_buffer, Pass first_pass = PASS_BACKGROUND, Pass last_pass = PASS_OIT);
+	// Number of chunks recordParallel splits the packets of the passes into, at least
+	// packets_per_chunk packets each and at most one per thread of thread_pool
+	uint32_t getChunkCount(const VeThreadPool& thread_pool, uint32_t packets_per_chunk,
+		Pass first_pass = PASS_BACKGROUND, Pass last_pass = PASS_OIT) const;
+	// Records the packets of the passes in chunk_count consecutive chunks on the threads
+	// of thread_pool. begin_chunk(i) is called on the recording thread and returns the
+	// begun secondary command buffer of chunk i, which is ended after recording. The
+	// returned buffers are in the order they must be executed and valid until the next
+	// recordParallel.
+	const std::vector<vk::CommandBuffer>& recordParallel(
+		VeThreadPool& thread_pool,
+		uint32_t chunk_count,
+		const std::function<vk::CommandBuffer(uint32_t chunk)>& begin_chunk,
+		Pass first_pass = PASS_BACKGROUND,
+		Pass last_pass = PASS_OIT);
+
+	static uint64_t makeSortKey(Pass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+	uint32_t getPacketCount() const { return static_cast<uint32_t>(m_packets.size()); }
+	// Packets submitted to passes [first_pass, last_pass]
+	uint32_t getPacketCount(Pass first_pass, Pass last_pass) const;
+	// The i-th packet and its key in recording order, valid after sort
+	const VeDrawPacket& getSortedPacket(uint32_t i) const { return m_packets[m_entries[i].packet]; }
+	uint64_t getSortedKey(uint32_t i) const { return m_entries[i].key; }
+	// Counts of the records since begin
+	const Stats& getStats() const { return m_stats; }
+
+private:
+	struct Entry {
+		uint64_t key;
+		uint32_t packet;
+	};
+	uint32_t intern(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t state, uint32_t bits);
+	void radixSort();
+	// Sorted packets of the passes as [first, last)
+	std::pair<uint32_t, uint32_t> getPassRange(Pass first_pass, Pass last_pass) const;
+	// Records the sorted packets [first, last) and returns the binds it took
+	Stats recordRange(vk::CommandBuffer command_buffer, uint32_t first, uint32_t last) const;
+
+	glm::mat4 m_view{1.0f};
+	std::vector<VeDrawPacket> m_packets;
+	std::vector<Entry> m_entries;
+	std::vector<Entry> m_scratch;
+	std::vector<uint8_t> m_push_data;
+	std::array<uint32_t, PASS_COUNT> m_pass_counts{};
+	bool m_sorted = true;
+	Stats m_stats{};
+	std::vector<vk::CommandBuffer> m_chunk_buffers;
+	std::vector<Stats> m_chunk_stats;
+
+	// Small ids of the pipelines, descriptor set and mesh bindings submitted this frame,
+	// numbered in submission order so passes keep the order their systems submit in
+	std::unordered_map<uint64_t, uint32_t> m_pipeline_ids;
+	std::unordered_map<uint64_t, uint32_t> m_material_ids;
+	std::unordered_map<uint64_t, uint32_t> m_mesh_ids;
+};
+
+} // namespace ve
@@ -1,14 +1,19 @@
 #include "pch.hpp"
 #include "ve_renderer.hpp"
+#include "ve_retirement_queue.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 
 
 namespace ve {
-	// Constructor, initializes swap chain (with no msaa) and command buffers
+	// Constructor, initializes swap chain (with the device's max msaa samples) and command buffers
 	VeRenderer::VeRenderer(VeDevice& device, VeWindow& window) : m_ve_device(device), m_ve_window(window) {
-		m_ve_swap_chain = std::make_unique<VeSwapChain>(m_ve_device, m_ve_window.getExtent(), m_desired_num_samples);
+		m_ve_swap_chain = std::make_unique<VeSwapChain>(m_ve_device, m_ve_window.getExtent(), m_sample_count);
+		m_depth_format = m_ve_device.findDepthFormat();
 		createCommandBuffers();
+		createTimestampQueries();
 	}
 
 	VeRenderer::~VeRenderer() {}
@@ -17,6 +22,16 @@ namespace ve {
 	vk::Format VeRenderer::getSwapChainImageFormat() const { return m_ve_swap_chain->getSwapChainImageFormat(); }
 	size_t VeRenderer::getImageCount() const { return m_ve_swap_chain->getImageCount(); }
 	vk::Extent2D VeRenderer::getExtent() const { return m_ve_swap_chain->getSwapChainExtent(); }
+	vk::Extent2D VeRenderer::getRenderExtent() const {
+		const auto extent = m_ve_swap_chain->getSwapChainExtent();
+		auto scaled = [this](uint32_t size) {
+			return std::clamp(static_cast<uint32_t>(std::lround(static_cast<float>(size) * m_render_scale)), 1u, size);
+		};
+		return vk::Extent2D{ scaled(extent.width), scaled(extent.height) };
+	}
+	void VeRenderer::setRenderScale(float scale) {
+		m_render_scale = std::clamp(scale, MIN_RENDER_SCALE, 1.0f);
+	}
 	uint32_t VeRenderer::getCurrentFrame() const {
 		assert(m_is_frame_started && "Frame is not in progress");
 		return m_ve_swap_chain->getCurrentFrame();
@@ -49,6 +64,117 @@ namespace ve {
 		assert(m_compute_command_buffers.size() == ve::MAX_FRAMES_IN_FLIGHT && "Failed to allocate command buffers");
 	}
 
+	// The compute queue gets a pool of its own, so each queue only resets its own queries
+	void VeRenderer::createTimestampQueries() {
+		const auto queue_families = m_ve_device.getPhysicalDevice().getQueueFamilyProperties();
+		if (queue_families[m_ve_device.getGraphicsQueueFamilyIndex()].timestampValidBits == 0) {
+			VE_LOGW("Graphics queue has no timestamp support, GPU frame time unavailable");
+			return;
+		}
+		m_timestamp_period = m_ve_device.getDeviceProperties().limits.timestampPeriod;
+		const vk::QueryPoolCreateInfo pool_info{
+			.queryType = vk::QueryType::eTimestamp,
+			.queryCount = 2 * MAX_FRAMES_IN_FLIGHT
+		};
+		m_timestamp_pool = vk::raii::QueryPool(m_ve_device.getDevice(), pool_info);
+		if (queue_families[m_ve_device.getComputeQueueFamilyIndex()].timestampValidBits == 0) {
+			VE_LOGW("Compute queue has no timestamp support, GPU compute time unavailable");
+			return;
+		}
+		m_compute_timestamp_pool = vk::raii::QueryPool(m_ve_device.getDevice(), pool_info);
+	}
+
+	// Called after the frame's fence was waited on, its graphics and compute timestamps are
+	// available then. The overlap is taken between this frame's compute work and the graphics
+	// work of the frame before, the timestamps of both queues count on the same device clock.
+	void VeRenderer::readTimestamps(uint32_t frame) {
+		if (!m_timestamps_written[frame])
+			return;
+		m_timestamps_written[frame] = false;
+		auto read = [frame](vk::raii::QueryPool& pool, std::array<uint64_t, 2>& interval) {
+			auto [result, timestamps] = pool.getResults<uint64_t>(
+				2 * frame, 2, 2 * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+			if (result != vk::Result::eSuccess || timestamps[1] < timestamps[0])
+				return false;
+			interval = { timestamps[0], timestamps[1] };
+			return true;
+		};
+		auto to_ms = [this](uint64_t ticks) {
+			return static_cast<float>(static_cast<double>(ticks) * m_timestamp_period * 1e-6);
+		};
+		std::array<uint64_t, 2> graphics{};
+		if (!read(m_timestamp_pool, graphics)) {
+			m_last_graphics_valid = false;
+			return;
+		}
+		m_gpu_frame_time = to_ms(graphics[1] - graphics[0]);
+		std::array<uint64_t, 2> compute{};
+		if (*m_compute_timestamp_pool && read(m_compute_timestamp_pool, compute)) {
+			m_gpu_compute_time = to_ms(compute[1] - compute[0]);
+			const uint64_t begin = std::max(compute[0], m_last_graphics[0]);
+			const uint64_t end = std::min(compute[1], m_last_graphics[1]);
+			m_gpu_overlap_time = m_last_graphics_valid && end > begin ? to_ms(end - begin) : 0.0f;
+		}
+		m_last_graphics = graphics;
+		m_last_graphics_valid = true;
+	}
+
+	vk::SampleCountFlagBits VeRenderer::setSampleCount(vk::SampleCountFlagBits samples) {
+		const vk::SampleCountFlags supported = m_ve_device.getSupportedSampleCounts();
+		auto count = static_cast<uint32_t>(samples);
+		while (count > 1 && !(supported & static_cast<vk::SampleCountFlagBits>(count)))
+			count >>= 1;
+		m_pending_sample_count = static_cast<vk::SampleCountFlagBits>(std::max(count, 1u));
+		return m_pending_sample_count;
+	}
+
+	void VeRenderer::prepareSecondaryCommandBuffers(uint32_t count) {
+		for (auto& frame_buffers : m_secondary_command_buffers) {
+			while (frame_buffers.size() < count) {
+				SecondaryCommandBuffer secondary;
+				secondary.pool = vk::raii::CommandPool(m_ve_device.getDevice(), vk::CommandPoolCreateInfo{
+					.flags = vk::CommandPoolCreateFlagBits::eTransient,
+					.queueFamilyIndex = m_ve_device.getGraphicsQueueFamilyIndex()
+				});
+				vk::CommandBufferAllocateInfo alloc_info{
+					.commandPool = *secondary.pool,
+					.level = vk::CommandBufferLevel::eSecondary,
+					.commandBufferCount = 1
+				};
+				secondary.command_buffer = std::move(vk::raii::CommandBuffers(m_ve_device.getDevice(), alloc_info).front());
+				frame_buffers.push_back(std::move(secondary));
+			}
+		}
+	}
+
+	// The frame's fence was waited on in beginFrame, so its pools can be reset. Only the
+	// pool of index is touched, which keeps different indices independent.
+	vk::CommandBuffer VeRenderer::beginSecondaryCommandBuffer(uint32_t index) {
+		assert(m_is_frame_started && "Can't begin a secondary command buffer while frame is not in progress");
+		auto& frame_buffers = m_secondary_command_buffers[m_ve_swap_chain->getCurrentFrame()];
+		assert(index < frame_buffers.size() && "Secondary command buffer not prepared");
+		SecondaryCommandBuffer& secondary = frame_buffers[index];
+		secondary.pool.reset();
+
+		const vk::Format color_format = m_ve_swap_chain->getSwapChainImageFormat();
+		vk::CommandBufferInheritanceRenderingInfo rendering_info{
+			.colorAttachmentCount = 1,
+			.pColorAttachmentFormats = &color_format,
+			.depthAttachmentFormat = m_depth_format,
+			.rasterizationSamples = m_sample_count
+		};
+		vk::CommandBufferInheritanceInfo inheritance_info{ .pNext = &rendering_info };
+		secondary.command_buffer.begin(vk::CommandBufferBeginInfo{
+			.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+			.pInheritanceInfo = &inheritance_info
+		});
+		// Dynamic state is not inherited from the primary command buffer
+		const auto extent = getRenderExtent();
+		secondary.command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f));
+		secondary.command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
+		return *secondary.command_buffer;
+	}
+
 	void VeRenderer::recreateSwapChain() {
 		// Handle minimized window
 		auto extent = m_ve_window.getExtent();
@@ -57,20 +183,21 @@ namespace ve {
 			glfwWaitEvents();
 		}
 
-		// Create a new swap chain when device is idle
-		m_ve_device.getDevice().waitIdle();
+		// Frames in flight continue with the new swap chain's fences, the old one is retired
+		// once a frame of the new one has finished
 		extent = m_ve_window.getExtent();
 		if (m_ve_swap_chain == nullptr) {
-			m_ve_swap_chain = std::make_unique<VeSwapChain>(m_ve_device, extent, m_desired_num_samples);
+			m_ve_swap_chain = std::make_unique<VeSwapChain>(m_ve_device, extent, m_sample_count);
 		} else {
 			// Transfer ownership of the existing swap chain to a shared_ptr so the new one
 			// can safely reference it during recreation.
 			std::shared_ptr<VeSwapChain> old_swap_chain{ std::move(m_ve_swap_chain) };
-			m_ve_swap_chain = std::make_unique<VeSwapChain>(m_ve_device, extent, m_desired_num_samples, old_swap_chain);
+			m_ve_swap_chain = std::make_unique<VeSwapChain>(m_ve_device, extent, m_sample_count, old_swap_chain);
 			if (!old_swap_chain->compareSwapFormats(*m_ve_swap_chain)) {
 				throw std::runtime_error("Swap chain image (or depth) format has changed!");
 				// Todo: Handle swap chain format changes (e.g. recreate pipelines)
 			}
+			m_old_swap_chains.push_back(std::move(old_swap_chain));
 		}
 		VE_LOGI("Swap chain recreated: " << extent.width << "x" << extent.height);
 	}
@@ -83,6 +210,17 @@ namespace ve {
 
 		// Wait until image is available
 		m_ve_swap_chain->waitForCurrentFence();
+		VeRetirementQueue& retirement = m_ve_device.getRetirementQueue();
+		retirement.collect(m_ve_swap_chain->getCompletedTimelineValue());
+		// The swap chain retires the attachments the other frames in flight still use
+		if (m_pending_sample_count != m_sample_count) {
+			m_sample_count = m_pending_sample_count;
+			m_ve_swap_chain->setSampleCount(m_sample_count);
+			VE_LOGI("MSAA samples: " << static_cast<uint32_t>(m_sample_count));
+		}
+		const uint32_t frame = m_ve_swap_chain->getCurrentFrame();
+		if (*m_timestamp_pool)
+			readTimestamps(frame);
 
 		// Acquire an image from the swap chain
 		auto result = m_ve_swap_chain->acquireNextImage(&m_current_image_index);
@@ -97,11 +235,40 @@ namespace ve {
 		// frame acquired
 		m_is_frame_started = true;
 		m_ve_swap_chain->resetCurrentFence();
-		m_ve_swap_chain->updateTimelineValues();
+		m_ve_swap_chain->updateTimelineValues(m_async_compute);
+		retirement.setFrameValue(m_ve_swap_chain->getGraphicsSignalValue());
+		// Presents of old swap chains are only known to be done once a later frame finished
+		for (auto& old_swap_chain : m_old_swap_chains)
+			retirement.retire(std::move(old_swap_chain));
+		m_old_swap_chains.clear();
 
 		auto& command_buffer = getCurrentCommandBuffer();
 		command_buffer.reset();
 		command_buffer.begin({});
+		// Measures the graphics work only, it starts after the frame's compute work finished
+		if (*m_timestamp_pool) {
+			command_buffer.resetQueryPool(*m_timestamp_pool, 2 * frame, 2);
+			command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *m_timestamp_pool, 2 * frame);
+		}
+		// Compute work of several systems (particles, culling) is recorded into one command buffer
+		auto& compute_command_buffer = getCurrentComputeCommandBuffer();
+		compute_command_buffer.reset();
+		compute_command_buffer.begin({});
+		if (*m_compute_timestamp_pool) {
+			compute_command_buffer.resetQueryPool(*m_compute_timestamp_pool, 2 * frame, 2);
+			compute_command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *m_compute_timestamp_pool, 2 * frame);
+		}
+		// With async compute the previous frame's compute work is no longer ordered by the graphics
+		// timeline, only by its submission to the same queue
+		vk::MemoryBarrier2 previous_compute{
+			.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+			.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer |
+				vk::PipelineStageFlagBits2::eDrawIndirect,
+			.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite |
+				vk::AccessFlagBits2::eTransferRead | vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eIndirectCommandRead
+		};
+		compute_command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &previous_compute });
 
 		return true;
 	}
@@ -112,6 +279,11 @@ namespace ve {
 		assert(&command_buffer == &getCurrentCommandBuffer() && "Can't end frame on command buffer from a different frame");
 
 		transitionToPresent(command_buffer);
+		if (*m_timestamp_pool) {
+			const uint32_t frame = m_ve_swap_chain->getCurrentFrame();
+			command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *m_timestamp_pool, 2 * frame + 1);
+			m_timestamps_written[frame] = true;
+		}
 		command_buffer.end();
 
 		// submit graphics and present
@@ -130,40 +302,37 @@ namespace ve {
 		m_is_frame_started = false;
 	}
 
-	// Transitions the swap chain image and multi sampled color image
-	// to color_attachment_optimal. Begins dynamic rendering.
-	void VeRenderer::beginSceneRender(vk::raii::CommandBuffer& command_buffer) {
+	// Transitions the scene image to color_attachment_optimal and begins dynamic rendering
+	// of the render extent. With msaa the multi sampled color image is resolved into it.
+	void VeRenderer::beginSceneRender(vk::raii::CommandBuffer& command_buffer, bool use_secondary) {
 		assert(m_is_frame_started && "Can't call beginRender while frame is not in progress");
 		assert(&command_buffer == &getCurrentCommandBuffer() && "Can't begin render on command buffer from a different frame");
 
-		auto extent = m_ve_swap_chain->getSwapChainExtent();
+		const auto extent = getRenderExtent();
 		auto height = extent.height;
 		auto width = extent.width;
 
-		// Transition the swap chain image to eColorAttachmentOptimal
-		m_ve_swap_chain->transitionImageLayout(
-			command_buffer,
-			m_current_image_index,
-			vk::ImageLayout::eUndefined,
+		// The previous frame's present pass may still sample the scene image
+		const VeImage& scene_image = m_ve_swap_chain->getSceneImage();
+		scene_image.recordTransition(
+			*command_buffer,
+			vk::ImageLayout::eShaderReadOnlyOptimal,
 			vk::ImageLayout::eColorAttachmentOptimal,
-			{},
+			vk::AccessFlagBits2::eShaderSampledRead,
 			vk::AccessFlagBits2::eColorAttachmentWrite,
-			vk::PipelineStageFlagBits2::eTopOfPipe,
+			vk::PipelineStageFlagBits2::eFragmentShader,
 			vk::PipelineStageFlagBits2::eColorAttachmentOutput
 		);
-		//
 
 		// Setup dynamic rendering attachments
-
-
 		vk::RenderingAttachmentInfo color_attachment_info;
-		if (m_msaa_enabled) {
+		if (m_sample_count != vk::SampleCountFlagBits::e1) {
 			color_attachment_info = {
 				.sType = vk::StructureType::eRenderingAttachmentInfo,
 				.imageView = m_ve_swap_chain->getColorImageView(),
 				.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
 				.resolveMode = vk::ResolveModeFlagBits::eAverage,
-				.resolveImageView = m_ve_swap_chain->getSwapChainImageViews()[m_current_image_index],
+				.resolveImageView = scene_image.getImageView(),
 				.resolveImageLayout = vk::ImageLayout::eColorAttachmentOptimal,
 				.loadOp = vk::AttachmentLoadOp::eClear,
 				.storeOp = vk::AttachmentStoreOp::eDontCare,
@@ -172,7 +341,7 @@ namespace ve {
 		} else {
 			color_attachment_info = {
 				.sType = vk::StructureType::eRenderingAttachmentInfo,
-				.imageView = m_ve_swap_chain->getSwapChainImageViews()[m_current_image_index],
+				.imageView = scene_image.getImageView(),
 				.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
 				.loadOp = vk::AttachmentLoadOp::eClear,
 				.storeOp = vk::AttachmentStoreOp::eStore,
@@ -180,14 +349,17 @@ namespace ve {
 			};
 		}
 
+		// Stored for the transparent pass, which tests against it
 		vk::RenderingAttachmentInfo depth_attachment_info = {
 			.imageView = m_ve_swap_chain->getDepthImageView(),
 			.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
 			.loadOp = vk::AttachmentLoadOp::eClear,
-			.storeOp = vk::AttachmentStoreOp::eDontCare,
+			.storeOp = vk::AttachmentStoreOp::eStore,
 			.clearValue = vk::ClearDepthStencilValue(1.0f, 0)
 		};
+		// The attachments keep the swap chain size, a smaller render area leaves the rest untouched
 		vk::RenderingInfo rendering_info = {
+			.flags = use_secondary ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags{},
 			.renderArea = { .offset = { 0, 0 }, .extent = extent },
 			.layerCount = 1,
 			.colorAttachmentCount = 1,
@@ -195,13 +367,15 @@ namespace ve {
 			.pDepthAttachment = &depth_attachment_info
 		};
 
-		// Begin dynamic rendering
+		// Begin dynamic rendering, secondary command buffers set their own dynamic state
 		command_buffer.beginRendering(rendering_info);
+		if (use_secondary)
+			return;
 		command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f));
 		command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
 	}
 
-	// Ends the dynamic rendering pass and transitions the swap chain image to presentation
+	// Ends the dynamic rendering pass of the scene
 	void VeRenderer::endSceneRender(vk::raii::CommandBuffer& command_buffer) {
 		assert(m_is_frame_started && "Can't call endRender while frame is not in progress");
 		assert(&command_buffer == &getCurrentCommandBuffer() && "Can't end render on command buffer from a different frame");
@@ -209,6 +383,192 @@ namespace ve {
 		command_buffer.endRendering();
 	}
 
+	void VeRenderer::beginTransparentRender(vk::raii::CommandBuffer& command_buffer) {
+		assert(m_is_frame_started && "Can't call beginTransparentRender while frame is not in progress");
+		assert(&command_buffer == &getCurrentCommandBuffer() && "Can't begin render on command buffer from a different frame");
+
+		const VeSwapChain& swap_chain = *m_ve_swap_chain;
+		// The previous frame's composite pass may still sample the resolved targets
+		for (const VeImage* image : { &swap_chain.getOitAccumImage(), &swap_chain.getOitWeightImage() }) {
+			image->recordTransition(
+				*command_buffer,
+				vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::ImageLayout::eColorAttachmentOptimal,
+				vk::AccessFlagBits2::eShaderSampledRead,
+				vk::AccessFlagBits2::eColorAttachmentWrite,
+				vk::PipelineStageFlagBits2::eFragmentShader,
+				vk::PipelineStageFlagBits2::eColorAttachmentOutput
+			);
+		}
+		// Depth written by the scene pass is tested here
+		swap_chain.getDepthImage().recordTransition(
+			*command_buffer,
+			vk::ImageLayout::eDepthAttachmentOptimal,
+			vk::ImageLayout::eDepthAttachmentOptimal,
+			vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+			vk::AccessFlagBits2::eDepthStencilAttachmentRead,
+			vk::PipelineStageFlagBits2::eLateFragmentTests,
+			vk::PipelineStageFlagBits2::eEarlyFragmentTests
+		);
+
+		// Accumulation starts at no color and full revealage, the weight sum at zero
+		const std::array<vk::ClearColorValue, 2> clear_values = {
+			vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f),
+			vk::ClearColorValue(0.0f, 0.0f, 0.0f, 0.0f)
+		};
+		const std::array<const VeImage*, 2> resolved = { &swap_chain.getOitAccumImage(), &swap_chain.getOitWeightImage() };
+		const std::array<const VeImage*, 2> multisampled = { &swap_chain.getOitAccumMsImage(), &swap_chain.getOitWeightMsImage() };
+		std::array<vk::RenderingAttachmentInfo, 2> color_attachment_infos;
+		for (size_t i = 0; i < color_attachment_infos.size(); ++i) {
+			if (m_sample_count != vk::SampleCountFlagBits::e1) {
+				color_attachment_infos[i] = {
+					.sType = vk::StructureType::eRenderingAttachmentInfo,
+					.imageView = multisampled[i]->getImageView(),
+					.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+					.resolveMode = vk::ResolveModeFlagBits::eAverage,
+					.resolveImageView = resolved[i]->getImageView(),
+					.resolveImageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+					.loadOp = vk::AttachmentLoadOp::eClear,
+					.storeOp = vk::AttachmentStoreOp::eDontCare,
+					.clearValue = clear_values[i]
+				};
+			} else {
+				color_attachment_infos[i] = {
+					.sType = vk::StructureType::eRenderingAttachmentInfo,
+					.imageView = resolved[i]->getImageView(),
+					.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+					.loadOp = vk::AttachmentLoadOp::eClear,
+					.storeOp = vk::AttachmentStoreOp::eStore,
+					.clearValue = clear_values[i]
+				};
+			}
+		}
+		const vk::RenderingAttachmentInfo depth_attachment_info{
+			.imageView = swap_chain.getDepthImageView(),
+			.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+			.loadOp = vk::AttachmentLoadOp::eLoad,
+			.storeOp = vk::AttachmentStoreOp::eDontCare
+		};
+
+		const auto extent = getRenderExtent();
+		const vk::RenderingInfo rendering_info{
+			.renderArea = { .offset = { 0, 0 }, .extent = extent },
+			.layerCount = 1,
+			.colorAttachmentCount = static_cast<uint32_t>(color_attachment_infos.size()),
+			.pColorAttachments = color_attachment_infos.data(),
+			.pDepthAttachment = &depth_attachment_info
+		};
+		command_buffer.beginRendering(rendering_info);
+		command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f));
+		command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
+	}
+
+	void VeRenderer::endTransparentRender(vk::raii::CommandBuffer& command_buffer) {
+		assert(m_is_frame_started && "Can't call endTransparentRender while frame is not in progress");
+		assert(&command_buffer == &getCurrentCommandBuffer() && "Can't end render on command buffer from a different frame");
+		command_buffer.endRendering();
+
+		for (const VeImage* image : { &m_ve_swap_chain->getOitAccumImage(), &m_ve_swap_chain->getOitWeightImage() }) {
+			image->recordTransition(
+				*command_buffer,
+				vk::ImageLayout::eColorAttachmentOptimal,
+				vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::AccessFlagBits2::eColorAttachmentWrite,
+				vk::AccessFlagBits2::eShaderSampledRead,
+				vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+				vk::PipelineStageFlagBits2::eFragmentShader
+			);
+		}
+	}
+
+	void VeRenderer::beginCompositeRender(vk::raii::CommandBuffer& command_buffer) {
+		assert(m_is_frame_started && "Can't call beginCompositeRender while frame is not in progress");
+		assert(&command_buffer == &getCurrentCommandBuffer() && "Can't begin render on command buffer from a different frame");
+
+		// The scene pass wrote or resolved into the scene image, the composite blends over it
+		const VeImage& scene_image = m_ve_swap_chain->getSceneImage();
+		scene_image.recordTransition(
+			*command_buffer,
+			vk::ImageLayout::eColorAttachmentOptimal,
+			vk::ImageLayout::eColorAttachmentOptimal,
+			vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput
+		);
+
+		const auto extent = getRenderExtent();
+		const vk::RenderingAttachmentInfo color_attachment_info{
+			.imageView = scene_image.getImageView(),
+			.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+			.loadOp = vk::AttachmentLoadOp::eLoad,
+			.storeOp = vk::AttachmentStoreOp::eStore
+		};
+		const vk::RenderingInfo rendering_info{
+			.renderArea = { .offset = { 0, 0 }, .extent = extent },
+			.layerCount = 1,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &color_attachment_info
+		};
+		command_buffer.beginRendering(rendering_info);
+		command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f));
+		command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
+	}
+
+	void VeRenderer::endCompositeRender(vk::raii::CommandBuffer& command_buffer) {
+		assert(m_is_frame_started && "Can't call endCompositeRender while frame is not in progress");
+		assert(&command_buffer == &getCurrentCommandBuffer() && "Can't end render on command buffer from a different frame");
+		command_buffer.endRendering();
+	}
+
+	void VeRenderer::beginPresentRender(vk::raii::CommandBuffer& command_buffer) {
+		assert(m_is_frame_started && "Can't call beginPresentRender while frame is not in progress");
+		assert(&command_buffer == &getCurrentCommandBuffer() && "Can't begin render on command buffer from a different frame");
+
+		m_ve_swap_chain->getSceneImage().recordTransition(
+			*command_buffer,
+			vk::ImageLayout::eColorAttachmentOptimal,
+			vk::ImageLayout::eShaderReadOnlyOptimal,
+			vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::AccessFlagBits2::eShaderSampledRead,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+			vk::PipelineStageFlagBits2::eFragmentShader
+		);
+		m_ve_swap_chain->transitionImageLayout(
+			command_buffer,
+			m_current_image_index,
+			vk::ImageLayout::eUndefined,
+			vk::ImageLayout::eColorAttachmentOptimal,
+			{},
+			vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::PipelineStageFlagBits2::eTopOfPipe,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput
+		);
+
+		const auto extent = m_ve_swap_chain->getSwapChainExtent();
+		const vk::RenderingAttachmentInfo color_attachment_info{
+			.imageView = m_ve_swap_chain->getSwapChainImageViews()[m_current_image_index],
+			.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+			.loadOp = vk::AttachmentLoadOp::eDontCare,
+			.storeOp = vk::AttachmentStoreOp::eStore
+		};
+		const vk::RenderingInfo rendering_info{
+			.renderArea = { .offset = { 0, 0 }, .extent = extent },
+			.layerCount = 1,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &color_attachment_info
+		};
+		command_buffer.beginRendering(rendering_info);
+		command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f));
+		command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
+	}
+
+	void VeRenderer::endPresentRender(vk::raii::CommandBuffer& command_buffer) {
+		assert(m_is_frame_started && "Can't call endPresentRender while frame is not in progress");
+		assert(&command_buffer == &getCurrentCommandBuffer() && "Can't end render on command buffer from a different frame");
+		command_buffer.endRendering();
+	}
+
 	void VeRenderer::transitionToPresent(vk::raii::CommandBuffer& command_buffer) {
 		assert(m_is_frame_started && "Can't call transitionToPresent while frame is not in progress");
 		assert(&command_buffer == &getCurrentCommandBuffer() && "Can't transition on command buffer from a different frame");
@@ -225,12 +585,17 @@ namespace ve {
 		);
 	}
 
-	// Expects a compute command buffer that has been recorded and ended.
-	// Submits the command buffer to the compute queue, signaling the timeline semaphore when done.
-	// Should be called between beginFrame() and endFrame().
+	// Expects the compute command buffer begun by beginFrame() with all compute work recorded.
+	// Ends and submits it to the compute queue, signaling the compute timeline when done.
+	// Should be called once between beginFrame() and endFrame().
 	void VeRenderer::submitCompute(vk::raii::CommandBuffer& compute_command_buffer) {
 		assert(m_is_frame_started && "Can't call submitCompute while frame is not in progress");
 		assert(&compute_command_buffer == &getCurrentComputeCommandBuffer() && "Can't submit compute on command buffer from a different frame");
+		if (*m_compute_timestamp_pool) {
+			const uint32_t frame = m_ve_swap_chain->getCurrentFrame();
+			compute_command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *m_compute_timestamp_pool, 2 * frame + 1);
+		}
+		compute_command_buffer.end();
 		m_ve_swap_chain->submitComputeWork(compute_command_buffer);
 	}
 
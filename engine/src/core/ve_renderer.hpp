@@ -1,10 +1,19 @@
 /* VeRenderer provides methods to to render the current frame.
-It manages the swap chain and command buffers. */
+It manages the swap chain and command buffers. Besides one primary command buffer
+per frame it keeps secondary command buffers for recording the scene on several
+threads, each in a command pool of its own so they can be recorded concurrently.
+The scene is rendered into the top left corner of the scene image, scaled by the
+render scale, and drawn onto the swap chain image by a present pass. Between those,
+a transparent pass accumulates weighted blended transparency against the scene depth
+and a composite pass blends the result over the scene image. Timestamps
+around each frame's graphics and compute work give the GPU frame and compute times,
+and how long the compute work overlapped the previous frame's graphics work. */
 #pragma once
 #include "ve_export.hpp"
 #include "ve_device.hpp"
 #include "ve_window.hpp"
 #include "ve_swap_chain.hpp"
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -25,6 +34,19 @@ public:
 		vk::Format getSwapChainImageFormat() const;
 		size_t getImageCount() const;
 		vk::Extent2D getExtent() const;
+		// Extent of the scene render, the swap chain extent scaled by the render scale
+		vk::Extent2D getRenderExtent() const;
+		float getRenderScale() const { return m_render_scale; }
+		const VeImage& getSceneImage() const { return m_ve_swap_chain->getSceneImage(); }
+		const VeImage& getOitAccumImage() const { return m_ve_swap_chain->getOitAccumImage(); }
+		const VeImage& getOitWeightImage() const { return m_ve_swap_chain->getOitWeightImage(); }
+		// GPU time of the graphics work of the last finished frame in ms, 0 without timestamp support
+		float getGpuFrameTime() const { return m_gpu_frame_time; }
+		// GPU time of the compute work of the last finished frame in ms
+		float getGpuComputeTime() const { return m_gpu_compute_time; }
+		// Time in ms the compute work of the last finished frame ran alongside the graphics
+		// work of the frame before, 0 when the queues take turns
+		float getGpuOverlapTime() const { return m_gpu_overlap_time; }
 		uint32_t getCurrentFrame() const;
 		uint32_t getCurrentImageIndex() const { assert(m_is_frame_started); return m_current_image_index; }
 		vk::raii::CommandBuffer& getCurrentCommandBuffer();
@@ -34,35 +56,94 @@ public:
 	// Begin a new frame. Returns true if a frame was acquired and recording can start.
 	// When false is returned (e.g. swap chain out of date), no command buffer is valid for use.
 	bool beginFrame();
-	// Simply submits compute work for the current frame.
+	// Ends and submits the compute command buffer of the current frame.
 	void submitCompute(vk::raii::CommandBuffer& compute_command_buffer);
-	// Begin dynamic rendering for the scene.
-	void beginSceneRender(vk::raii::CommandBuffer& command_buffer);
+	// Begin dynamic rendering for the scene. With use_secondary the scene may only be
+	// recorded into secondary command buffers, executed by the primary one.
+	void beginSceneRender(vk::raii::CommandBuffer& command_buffer, bool use_secondary = false);
+	// Makes count secondary command buffers available to beginSecondaryCommandBuffer,
+	// called on the main thread
+	void prepareSecondaryCommandBuffers(uint32_t count);
+	// Resets and begins secondary command buffer index of the current frame for the
+	// scene render, with viewport and scissor set. Different indices may be begun and
+	// recorded on different threads.
+	vk::CommandBuffer beginSecondaryCommandBuffer(uint32_t index);
 	// Ends dynamic rendering for the scene but does not transition to Present.
 	void endSceneRender(vk::raii::CommandBuffer& command_buffer);
+	// Begins dynamic rendering into the weighted blended transparency targets at the render
+	// extent, cleared, testing against the depth of the scene pass without writing it
+	void beginTransparentRender(vk::raii::CommandBuffer& command_buffer);
+	// Ends the transparent pass and makes its targets readable by fragment shaders
+	void endTransparentRender(vk::raii::CommandBuffer& command_buffer);
+	// Begins dynamic rendering on the scene image at the render extent, keeping its contents
+	// and without depth, for the composite of the transparency targets
+	void beginCompositeRender(vk::raii::CommandBuffer& command_buffer);
+	void endCompositeRender(vk::raii::CommandBuffer& command_buffer);
+	// Makes the scene image readable by fragment shaders and begins dynamic rendering on
+	// the current swapchain image at full extent, without depth. Its contents are undefined,
+	// the present pass is expected to cover every pixel.
+	void beginPresentRender(vk::raii::CommandBuffer& command_buffer);
+	void endPresentRender(vk::raii::CommandBuffer& command_buffer);
 	// Transition the current swapchain image to PresentSrcKHR, submits and presents it,
 	// and advances the current frame.
 	void endFrame(vk::raii::CommandBuffer& command_buffer);
 
-	// only max or none MSAA supported for now
-	void setMSAAEnabled(bool enabled) { m_msaa_enabled = enabled; m_desired_num_samples = enabled ? m_ve_device.getSampleCount() : vk::SampleCountFlagBits::e1; recreateSwapChain(); }
+	// Requests a sample count for the scene attachments, 1 disables msaa. Counts the device
+	// does not support fall back to the next lower one, which is returned. Takes effect with
+	// the next beginFrame, which recreates the color and depth attachments and retires the
+	// old ones to the device's retirement queue. Render systems pick the matching pipelines through VeFrameInfo::sample_count.
+	vk::SampleCountFlagBits setSampleCount(vk::SampleCountFlagBits samples);
+	// Sample count of the current frame's scene attachments
+	vk::SampleCountFlagBits getSampleCount() const { return m_sample_count; }
+	// Clamped to [MIN_RENDER_SCALE, 1], takes effect with the next beginSceneRender
+	void setRenderScale(float scale);
+	// Lets the compute work of a frame run while the graphics work of the previous frame still
+	// executes, instead of after it. Takes effect with the next beginFrame. Systems writing
+	// buffers in compute that graphics reads keep one per frame in flight for it. On by default
+	// when the device has a dedicated compute queue.
+	void setAsyncCompute(bool enabled) { m_async_compute = enabled; }
+	bool isAsyncCompute() const { return m_async_compute; }
 
 private:
 	void createCommandBuffers();
 	void recreateSwapChain();
 	void transitionToPresent(vk::raii::CommandBuffer& command_buffer);
+	void createTimestampQueries();
+	void readTimestamps(uint32_t frame);
 
 	VeDevice& m_ve_device;
 	VeWindow& m_ve_window;
 	std::unique_ptr<VeSwapChain> m_ve_swap_chain;
+	// Replaced swap chains, retired with the next frame
+	std::vector<std::shared_ptr<VeSwapChain>> m_old_swap_chains;
 	std::vector<vk::raii::CommandBuffer> m_command_buffers;
 	std::vector<vk::raii::CommandBuffer> m_compute_command_buffers;
+	// Per frame, a transient pool and the secondary command buffer allocated from it
+	struct SecondaryCommandBuffer {
+		vk::raii::CommandPool pool{nullptr};
+		vk::raii::CommandBuffer command_buffer{nullptr};
+	};
+	std::array<std::vector<SecondaryCommandBuffer>, MAX_FRAMES_IN_FLIGHT> m_secondary_command_buffers;
+	vk::Format m_depth_format = vk::Format::eUndefined;
 
 	uint32_t m_current_image_index;
 	bool m_is_frame_started = false;
 
-	bool m_msaa_enabled = true;
-	vk::SampleCountFlagBits m_desired_num_samples = m_ve_device.getSampleCount();
+	vk::SampleCountFlagBits m_sample_count = m_ve_device.getSampleCount();
+	vk::SampleCountFlagBits m_pending_sample_count = m_sample_count;
+	float m_render_scale = 1.0f;
+	bool m_async_compute = m_ve_device.hasDedicatedComputeQueue();
+
+	// Two timestamps per frame in flight for each queue, none without support on the queue
+	vk::raii::QueryPool m_timestamp_pool{nullptr};
+	vk::raii::QueryPool m_compute_timestamp_pool{nullptr};
+	float m_timestamp_period = 0.0f; // ns per tick
+	std::array<bool, MAX_FRAMES_IN_FLIGHT> m_timestamps_written{};
+	float m_gpu_frame_time = 0.0f;
+	float m_gpu_compute_time = 0.0f;
+	float m_gpu_overlap_time = 0.0f;
+	std::array<uint64_t, 2> m_last_graphics{}; // begin and end ticks of the last read graphics work
+	bool m_last_graphics_valid = false;
 };
 
 }
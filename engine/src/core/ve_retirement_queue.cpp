@@ -0,0 +1,75 @@
+#include "pch.hpp"
+#include "core/ve_retirement_queue.hpp"
+#include "core/ve_descriptors.hpp"
+#include "core/ve_uploader.hpp"
+
+#include <algorithm>
+
+namespace ve {
+
+namespace {
+	struct RetiredDescriptorSet {
+		// Members are destroyed in reverse order, the set before its pool
+		std::shared_ptr<VeDescriptorPool> pool;
+		vk::raii::DescriptorSet set;
+	};
+}
+
+void VeRetirementQueue::retire(vk::raii::DescriptorSet set, std::shared_ptr<VeDescriptorPool> pool) {
+	retire(RetiredDescriptorSet{ std::move(pool), std::move(set) });
+}
+
+// A resource may be referenced by uploads that are recorded but not yet flushed,
+// those complete with the value after the submitted one.
+void VeRetirementQueue::push(uint64_t value, std::unique_ptr<Retired> resource) {
+	const VeUploader& uploader = m_ve_device.getUploader();
+	const uint64_t upload_value = uploader.getSubmittedValue() + (uploader.hasPendingWork() ? 1 : 0);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.push_back(Entry{ value, upload_value, std::move(resource) });
+}
+
+void VeRetirementQueue::setFrameValue(uint64_t value) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	assert(value >= m_frame_value && "Timeline values must not decrease");
+	m_frame_value = value;
+}
+
+uint64_t VeRetirementQueue::getFrameValue() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_frame_value;
+}
+
+void VeRetirementQueue::collect(uint64_t completed_value) {
+	const uint64_t completed_upload = m_ve_device.getUploader().getCompletedValue();
+	std::vector<Entry> released;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto is_complete = [&](const Entry& entry) {
+			return entry.value <= completed_value && entry.upload_value <= completed_upload;
+		};
+		auto kept = std::stable_partition(m_entries.begin(), m_entries.end(),
+			[&](const Entry& entry) { return !is_complete(entry); });
+		released.insert(released.end(), std::make_move_iterator(kept), std::make_move_iterator(m_entries.end()));
+		m_entries.erase(kept, m_entries.end());
+	}
+	// Destroyed outside the lock in order of retirement, a destructor may retire again
+	for (auto& entry : released)
+		entry.resource.reset();
+}
+
+void VeRetirementQueue::releaseAll() {
+	std::vector<Entry> released;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		released.swap(m_entries);
+	}
+	for (auto& entry : released)
+		entry.resource.reset();
+}
+
+size_t VeRetirementQueue::size() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
+
+} // namespace ve
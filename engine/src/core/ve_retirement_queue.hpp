@@ -0,0 +1,73 @@
+/* VeRetirementQueue defers the destruction of GPU resources that frames in flight may
+still use. Buffers, images, pipelines, descriptor sets, or anything else handed to
+retire() are kept alive until the timeline semaphore of the swap chain has passed the
+value of the last frame that could have used them, and until the uploads recorded so far
+have completed. The renderer sets the value of each frame when it begins and collects
+the completed resources then, so replacing a resource never waits for the device.
+Descriptor sets are retired together with their pool, which must outlive them. */
+#pragma once
+#include "ve_export.hpp"
+#include "core/ve_device.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace ve {
+
+class VeDescriptorPool;
+
+class VENGINE_API VeRetirementQueue {
+public:
+	VeRetirementQueue(VeDevice& device) : m_ve_device(device) {}
+	~VeRetirementQueue() = default; // the device waits for the GPU before it is destroyed
+
+	VeRetirementQueue(const VeRetirementQueue&) = delete;
+	VeRetirementQueue& operator=(const VeRetirementQueue&) = delete;
+
+	// Keeps resource alive until the current frame's timeline value has been passed
+	template <typename T>
+	void retire(T resource) { retire(std::move(resource), getFrameValue()); }
+	// Keeps resource alive until value has been passed, for resources used by later frames
+	template <typename T>
+	void retire(T resource, uint64_t value) {
+		push(value, std::make_unique<Holder<T>>(std::move(resource)));
+	}
+	// The set is freed before the reference to its pool is dropped
+	void retire(vk::raii::DescriptorSet set, std::shared_ptr<VeDescriptorPool> pool);
+
+	// Value signaled by the graphics work of the frame being recorded, called by the renderer
+	void setFrameValue(uint64_t value);
+	uint64_t getFrameValue() const;
+	// Destroys the resources whose value is at most completed_value and whose uploads finished
+	void collect(uint64_t completed_value);
+	// Destroys everything, only valid once the device is idle
+	void releaseAll();
+	size_t size() const;
+
+private:
+	struct Retired {
+		virtual ~Retired() = default;
+	};
+	template <typename T>
+	struct Holder : Retired {
+		explicit Holder(T&& value) : resource(std::move(value)) {}
+		T resource;
+	};
+	struct Entry {
+		uint64_t value;        // frame timeline value
+		uint64_t upload_value; // uploader timeline value
+		std::unique_ptr<Retired> resource;
+	};
+
+	void push(uint64_t value, std::unique_ptr<Retired> resource);
+
+	VeDevice& m_ve_device;
+	mutable std::mutex m_mutex;
+	uint64_t m_frame_value = 0;
+	std::vector<Entry> m_entries; // in order of retirement
+};
+
+} // namespace ve
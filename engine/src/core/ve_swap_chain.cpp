@@ -1,5 +1,7 @@
 #include "pch.hpp"
 #include "ve_swap_chain.hpp"
+#include "ve_uploader.hpp"
+#include "ve_retirement_queue.hpp"
 
 #include <array>
 #include <limits>
@@ -31,11 +33,28 @@ VeSwapChain::~VeSwapChain() {
 	m_swap_chain = nullptr;
 }
 
+void VeSwapChain::setSampleCount(vk::SampleCountFlagBits samples) {
+	if (samples == m_desired_num_samples)
+		return;
+	m_desired_num_samples = samples > m_ve_device.getSampleCount() ? m_ve_device.getSampleCount() : samples;
+	// Frames in flight may still render to the old attachments
+	VeRetirementQueue& retirement = m_ve_device.getRetirementQueue();
+	for (auto* image : { &m_color_image, &m_depth_image, &m_oit_accum_image, &m_oit_weight_image,
+			&m_oit_accum_ms_image, &m_oit_weight_ms_image }) {
+		retirement.retire(std::move(*image));
+	}
+	createColorResources();
+	createDepthResources();
+	createOitResources();
+}
+
 void VeSwapChain::init() {
 	createSwapChain();
 	createSwapChainImageViews();
 	createColorResources();
 	createDepthResources();
+	createSceneResources();
+	createOitResources();
 	createSyncObjects();
 }
 
@@ -52,24 +71,33 @@ vk::Result VeSwapChain::acquireNextImage(uint32_t* image_index) {
 }
 
 void VeSwapChain::submitComputeWork(vk::CommandBuffer command_buffer) {
+	// Submit pending uploads first, compute waits for them alongside the frame timeline
+	VeUploader& uploader = m_ve_device.getUploader();
+	const uint64_t upload_value = uploader.flush();
+	std::array<vk::Semaphore, 2> wait_sems{ *graphics_semaphore, uploader.getSemaphore() };
+	std::array<uint64_t, 2> wait_values{ compute_wait_value, upload_value };
 	const vk::TimelineSemaphoreSubmitInfo timeline_info{
 		.sType = vk::StructureType::eTimelineSemaphoreSubmitInfo,
 		.pNext = nullptr,
-		.waitSemaphoreValueCount = 1,
-		.pWaitSemaphoreValues = &compute_wait_value,
+		.waitSemaphoreValueCount = static_cast<uint32_t>(wait_values.size()),
+		.pWaitSemaphoreValues = wait_values.data(),
 		.signalSemaphoreValueCount = 1,
 		.pSignalSemaphoreValues = &compute_signal_value
 	};
-	vk::PipelineStageFlags wait_stages[] = {vk::PipelineStageFlagBits::eComputeShader};
+	// Fills and copies recorded by the systems (e.g. a particle buffer growing) wait for the previous frame too
+	vk::PipelineStageFlags wait_stages[] = {
+		vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+		vk::PipelineStageFlagBits::eAllCommands
+	};
 	vk::SubmitInfo submit_info{
 		.pNext = &timeline_info,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &*semaphore,
+		.waitSemaphoreCount = static_cast<uint32_t>(wait_sems.size()),
+		.pWaitSemaphores = wait_sems.data(),
 		.pWaitDstStageMask = wait_stages,
 		.commandBufferCount = 1,
 		.pCommandBuffers = &command_buffer,
 		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = &*semaphore
+		.pSignalSemaphores = &*compute_semaphore
 	};
 
 	// Submit the command buffer to the compute queue and signal the fence when it is done
@@ -77,16 +105,23 @@ void VeSwapChain::submitComputeWork(vk::CommandBuffer command_buffer) {
 }
 
 vk::Result VeSwapChain::submitAndPresent(vk::CommandBuffer command_buffer, uint32_t* image_index) {
-	// Wait on image-available (binary) and compute timeline before starting graphics work.
-	vk::PipelineStageFlags wait_stages[2] = {
+	// Uploads recorded since the last submit (e.g. models created this frame) go out first
+	VeUploader& uploader = m_ve_device.getUploader();
+	const uint64_t upload_value = uploader.flush();
+
+	// Wait on image-available (binary), the compute timeline and the upload timeline before starting graphics work.
+	vk::PipelineStageFlags wait_stages[3] = {
 		vk::PipelineStageFlagBits::eColorAttachmentOutput, // swapchain image usage
-		vk::PipelineStageFlagBits::eVertexInput            // instanced vertex buffer reads
+		vk::PipelineStageFlagBits::eVertexInput |          // instanced vertex buffer reads
+			vk::PipelineStageFlagBits::eDrawIndirect |     // draws written by GPU culling
+			vk::PipelineStageFlagBits::eFragmentShader,    // light clusters
+		vk::PipelineStageFlagBits::eAllCommands            // uploaded buffers and images
 	};
 	// We will signal two semaphores (timeline + binary). For timeline submit info,
 	// signalSemaphoreValueCount must equal signalSemaphoreCount when any signaled semaphore is a timeline.
 	// Provide a dummy 0 for the binary semaphore; it will be ignored.
 	std::array<uint64_t, 2> signal_values{ graphics_signal_value, uint64_t{0} };
-	std::array<uint64_t, 2> wait_values{ uint64_t{0}, graphics_wait_value };
+	std::array<uint64_t, 3> wait_values{ uint64_t{0}, graphics_wait_value, upload_value };
 	vk::TimelineSemaphoreSubmitInfo timeline_info{
 		.sType = vk::StructureType::eTimelineSemaphoreSubmitInfo,
 		.pNext = nullptr,
@@ -96,11 +131,11 @@ vk::Result VeSwapChain::submitAndPresent(vk::CommandBuffer command_buffer, uint3
 		.pSignalSemaphoreValues = signal_values.data()
 	};
 
-	// Wait on image-available (binary) and the timeline semaphore
-	std::array<vk::Semaphore, 2> wait_sems{ *m_image_available_semaphores[m_current_frame], *semaphore };
-	// Signal both the timeline semaphore (for internal frame graph) and a binary render-finished semaphore (for WSI present)
+	// Wait on image-available (binary) and the compute and upload timeline semaphores
+	std::array<vk::Semaphore, 3> wait_sems{ *m_image_available_semaphores[m_current_frame], *compute_semaphore, uploader.getSemaphore() };
+	// Signal both the graphics timeline semaphore (for internal frame graph) and a binary render-finished semaphore (for WSI present)
 	vk::Semaphore render_finished = *m_render_finished_semaphores[*image_index];
-	std::array<vk::Semaphore, 2> signal_sems{ *semaphore, render_finished };
+	std::array<vk::Semaphore, 2> signal_sems{ *graphics_semaphore, render_finished };
 	vk::SubmitInfo submit_info{
 		.pNext = &timeline_info,
 		.waitSemaphoreCount = static_cast<uint32_t>(wait_sems.size()),
@@ -244,23 +279,102 @@ void VeSwapChain::createDepthResources() {
 	VE_LOGD("Depth resource created");
 }
 
-// Create 2 semaphores and 1 fence per frame in flight
-void VeSwapChain::createSyncObjects() {
-	vk::SemaphoreTypeCreateInfo semaphore_type{
-		.sType = vk::StructureType::eSemaphoreTypeCreateInfo,
-		.pNext = nullptr,
-		.semaphoreType = vk::SemaphoreType::eTimeline,
-		.initialValue = 0
+// Full swap chain size, scaled renders use its top left corner. It rests in
+// ShaderReadOnlyOptimal between frames, the renderer transitions it around the scene.
+void VeSwapChain::createSceneResources() {
+	m_scene_image = std::make_unique<VeImage>(
+		m_ve_device,
+		m_swap_chain_extent.width,
+		m_swap_chain_extent.height,
+		vk::SampleCountFlagBits::e1,
+		m_swap_chain_image_format,
+		vk::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		vk::ImageAspectFlagBits::eColor);
+
+	m_scene_image->transitionImageLayout(
+		vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eShaderReadOnlyOptimal,
+		{},
+		vk::AccessFlagBits2::eShaderSampledRead,
+		vk::PipelineStageFlagBits2::eTopOfPipe,
+		vk::PipelineStageFlagBits2::eFragmentShader
+	);
+	VE_LOGD("Scene resource created");
+}
+
+// The resolved targets rest in ShaderReadOnlyOptimal between frames like the scene image,
+// the multisampled ones stay in ColorAttachmentOptimal like the color image.
+void VeSwapChain::createOitResources() {
+	auto create_target = [this](vk::Format format, vk::SampleCountFlagBits samples, vk::ImageUsageFlags usage) {
+		return std::make_unique<VeImage>(
+			m_ve_device,
+			m_swap_chain_extent.width,
+			m_swap_chain_extent.height,
+			samples,
+			format,
+			vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eColorAttachment | usage,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			vk::ImageAspectFlagBits::eColor);
 	};
-	vk::SemaphoreCreateInfo timeline_sem_ci{ .pNext = &semaphore_type };
-	semaphore = vk::raii::Semaphore(m_ve_device.getDevice(), timeline_sem_ci);
-	timeline_value = 0;
-
-	// fences
-	m_in_flight_fences.clear();
-	vk::FenceCreateInfo fence_info{ .flags = vk::FenceCreateFlagBits::eSignaled };
-	for (size_t i = 0; i < ve::MAX_FRAMES_IN_FLIGHT; i++) {
-		m_in_flight_fences.emplace_back(m_ve_device.getDevice(), fence_info);
+	m_oit_accum_image = create_target(OIT_ACCUM_FORMAT, vk::SampleCountFlagBits::e1, vk::ImageUsageFlagBits::eSampled);
+	m_oit_weight_image = create_target(OIT_WEIGHT_FORMAT, vk::SampleCountFlagBits::e1, vk::ImageUsageFlagBits::eSampled);
+	m_oit_accum_ms_image = create_target(OIT_ACCUM_FORMAT, m_desired_num_samples, vk::ImageUsageFlagBits::eTransientAttachment);
+	m_oit_weight_ms_image = create_target(OIT_WEIGHT_FORMAT, m_desired_num_samples, vk::ImageUsageFlagBits::eTransientAttachment);
+
+	for (VeImage* image : { m_oit_accum_image.get(), m_oit_weight_image.get() }) {
+		image->transitionImageLayout(
+			vk::ImageLayout::eUndefined,
+			vk::ImageLayout::eShaderReadOnlyOptimal,
+			{},
+			vk::AccessFlagBits2::eShaderSampledRead,
+			vk::PipelineStageFlagBits2::eTopOfPipe,
+			vk::PipelineStageFlagBits2::eFragmentShader
+		);
+	}
+	for (VeImage* image : { m_oit_accum_ms_image.get(), m_oit_weight_ms_image.get() }) {
+		image->transitionImageLayout(
+			vk::ImageLayout::eUndefined,
+			vk::ImageLayout::eColorAttachmentOptimal,
+			{},
+			vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::PipelineStageFlagBits2::eTopOfPipe,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput
+		);
+	}
+	VE_LOGD("Transparency resources created");
+}
+
+// Create 2 semaphores and 1 fence per frame in flight. A recreated swap chain continues the
+// timeline, fences and frame index of the old one, so its frames in flight need no wait and
+// the timeline values the retirement queue is keyed on keep increasing.
+void VeSwapChain::createSyncObjects() {
+	if (m_old_swap_chain) {
+		compute_semaphore = std::move(m_old_swap_chain->compute_semaphore);
+		graphics_semaphore = std::move(m_old_swap_chain->graphics_semaphore);
+		timeline_value = m_old_swap_chain->timeline_value;
+		m_in_flight_fences = std::move(m_old_swap_chain->m_in_flight_fences);
+		m_current_frame = m_old_swap_chain->m_current_frame;
+	} else {
+		vk::SemaphoreTypeCreateInfo semaphore_type{
+			.sType = vk::StructureType::eSemaphoreTypeCreateInfo,
+			.pNext = nullptr,
+			.semaphoreType = vk::SemaphoreType::eTimeline,
+			.initialValue = 0
+		};
+		vk::SemaphoreCreateInfo timeline_sem_ci{ .pNext = &semaphore_type };
+		compute_semaphore = vk::raii::Semaphore(m_ve_device.getDevice(), timeline_sem_ci);
+		graphics_semaphore = vk::raii::Semaphore(m_ve_device.getDevice(), timeline_sem_ci);
+		timeline_value = 0;
+
+		// fences
+		m_in_flight_fences.clear();
+		vk::FenceCreateInfo fence_info{ .flags = vk::FenceCreateFlagBits::eSignaled };
+		for (size_t i = 0; i < ve::MAX_FRAMES_IN_FLIGHT; i++) {
+			m_in_flight_fences.emplace_back(m_ve_device.getDevice(), fence_info);
+		}
 	}
 
 	// Create per-swapchain-image binary render-finished semaphores used by present
@@ -334,15 +448,24 @@ void VeSwapChain::resetCurrentFence() {
 	m_ve_device.getDevice().resetFences(*m_in_flight_fences[m_current_frame]);
 }
 
+uint64_t VeSwapChain::getCompletedTimelineValue() const {
+	return graphics_semaphore.getCounterValue();
+}
+
 void VeSwapChain::advanceFrame() {
 	m_current_frame = (m_current_frame + 1) % ve::MAX_FRAMES_IN_FLIGHT;
 }
 
-void VeSwapChain::updateTimelineValues() {
-	compute_wait_value = timeline_value;
-	compute_signal_value = ++timeline_value;
-	graphics_wait_value = compute_signal_value;
-	graphics_signal_value = ++timeline_value;
+// Graphics N always waits for compute N. Serial, compute N waits for graphics N - 1, so the
+// queues take turns. Async, compute N waits for graphics N - MAX_FRAMES_IN_FLIGHT, the last
+// user of the per-frame resources it writes, and runs while graphics N - 1 still executes.
+void VeSwapChain::updateTimelineValues(bool async_compute) {
+	const uint64_t frame = ++timeline_value;
+	const uint64_t distance = async_compute ? ve::MAX_FRAMES_IN_FLIGHT : 1;
+	compute_wait_value = frame > distance ? frame - distance : 0;
+	compute_signal_value = frame;
+	graphics_wait_value = frame;
+	graphics_signal_value = frame;
 }
 
 // Transition the image layout of the given swap chain image using
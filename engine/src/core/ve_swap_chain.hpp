@@ -1,6 +1,7 @@
 /* VeSwapChain is responsible for managing the swap chain and
 its associated resources. This includes image views, depth
-resources and synchronization objects. */
+resources, the scene image, the transparency targets and
+synchronization objects. */
 #pragma once
 #include "ve_export.hpp"
 #include "ve_device.hpp"
@@ -35,10 +36,21 @@ public:
 	const vk::raii::ImageView& getImageView(size_t index) const { return m_swap_chain_image_views[index]; };
 	const vk::raii::ImageView& getColorImageView() const { return m_color_image->getImageView(); }
 	const vk::raii::ImageView& getDepthImageView() const { return m_depth_image->getImageView(); }
-	//const vk::raii::Image& getDepthImage() const { return m_depth_image->getImage(); }
+	// Single sampled image the scene is rendered or resolved into, sampled by the upscale pass
+	const VeImage& getSceneImage() const { return *m_scene_image; }
+	const VeImage& getDepthImage() const { return *m_depth_image; }
+	// Weighted blended transparency targets, single sampled and sampled by the composite pass.
+	// The multisampled ones are rendered to and resolved into them when MSAA is on.
+	const VeImage& getOitAccumImage() const { return *m_oit_accum_image; }
+	const VeImage& getOitWeightImage() const { return *m_oit_weight_image; }
+	const VeImage& getOitAccumMsImage() const { return *m_oit_accum_ms_image; }
+	const VeImage& getOitWeightMsImage() const { return *m_oit_weight_ms_image; }
 	const std::vector<vk::Image>& getSwapChainImages() const { return m_swap_chain_images; }
 	const std::vector<vk::raii::ImageView>& getSwapChainImageViews() const { return m_swap_chain_image_views; }
 	float getExtentAspectRatio() const;
+	vk::SampleCountFlagBits getSampleCount() const { return m_desired_num_samples; }
+	// Recreates the color and depth attachments with samples, the old ones are retired
+	void setSampleCount(vk::SampleCountFlagBits samples);
 
 	bool compareSwapFormats(const VeSwapChain& other) const;
 	vk::Result acquireNextImage(uint32_t* imageIndex);
@@ -49,7 +61,12 @@ public:
 	void waitForCurrentFence();
 	void resetCurrentFence();
 	void advanceFrame();
-	void updateTimelineValues();
+	// With async_compute the compute work only waits for the graphics work that last used
+	// its per-frame resources, instead of the previous frame's
+	void updateTimelineValues(bool async_compute);
+	// Highest graphics timeline value the GPU has signaled, frames up to it have finished
+	uint64_t getCompletedTimelineValue() const;
+	uint64_t getGraphicsSignalValue() const { return graphics_signal_value; }
 	void transitionImageLayout(
 		vk::raii::CommandBuffer& command_buffer,
 		uint32_t image_index,
@@ -67,6 +84,8 @@ private:
 	void createSwapChainImageViews();
 	void createColorResources();
 	void createDepthResources();
+	void createSceneResources();
+	void createOitResources();
 	void createSyncObjects();
 
 	vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& available_formats);
@@ -85,16 +104,23 @@ private:
 	//depth/color resources
 	std::unique_ptr<VeImage> m_color_image;
 	std::unique_ptr<VeImage> m_depth_image;
+	std::unique_ptr<VeImage> m_scene_image;
+	std::unique_ptr<VeImage> m_oit_accum_image;
+	std::unique_ptr<VeImage> m_oit_weight_image;
+	std::unique_ptr<VeImage> m_oit_accum_ms_image;
+	std::unique_ptr<VeImage> m_oit_weight_ms_image;
 	vk::SampleCountFlagBits m_desired_num_samples;
 
 
 	// Synchronization primitives
-	// TODO: consider moving the timeline semaphore somewhere else
-	vk::raii::Semaphore semaphore{nullptr};
-	uint64_t timeline_value = 0;
-	uint64_t compute_wait_value;
+	// Compute and graphics signal timelines of their own with the frame number as value, with
+	// async compute the compute work of a frame may finish before the graphics work of the last one
+	vk::raii::Semaphore compute_semaphore{nullptr};
+	vk::raii::Semaphore graphics_semaphore{nullptr};
+	uint64_t timeline_value = 0; // number of the frame being recorded
+	uint64_t compute_wait_value;  // on the graphics timeline
 	uint64_t compute_signal_value;
-	uint64_t graphics_wait_value;
+	uint64_t graphics_wait_value; // on the compute timeline
 	uint64_t graphics_signal_value;
 	std::vector<vk::raii::Fence> m_in_flight_fences;
 	// Per-swapchain-image binary semaphores signaled by graphics submit and waited by present
@@ -1,10 +1,11 @@
 #include "pch.hpp"
 #include "ve_texture.hpp"
-#include "ve_buffer.hpp"
+#include "ve_uploader.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION // include implementations, without: only prototypes
 #include <stb_image.h>
 #include <iostream>
+#include <cstring>
 
 namespace ve {
 
@@ -35,24 +36,6 @@ void VeTexture::createTextureImage(const std::filesystem::path& texture_path) {
 		free_pixels = false; // do not free fallback memory with stbi
 	}
 
-	// texture loaded
-	// Create a local scope staging buffer
-	ve::VeBuffer staging_buffer(
-		m_ve_device,
-		4,                                        // instance size
-		static_cast<uint32_t>(m_width * m_height),    // instance count
-		vk::BufferUsageFlagBits::eTransferSrc,
-		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-	);
-
-	// Copy image data to staging buffer
-	staging_buffer.map();
-	staging_buffer.writeToBuffer((void*)pixels);
-	// unmap is called in the destructor of VeBuffer
-	if (free_pixels) {
-		stbi_image_free(pixels);
-	}
-
 	// Create image
 	m_texture_image = std::make_unique<ve::VeImage>(
 		m_ve_device,
@@ -65,34 +48,15 @@ void VeTexture::createTextureImage(const std::filesystem::path& texture_path) {
 		vk::MemoryPropertyFlagBits::eDeviceLocal,
 		vk::ImageAspectFlagBits::eColor
 	);
-	// Next we execute synchronously 3 single-time command buffers:
-	// TODO: consider combining these into one command buffer
-
-	//transition image to be optimal for receiving data from buffer
-	m_texture_image->transitionImageLayout(
-		vk::ImageLayout::eUndefined,
-		vk::ImageLayout::eTransferDstOptimal,
-		{},
-		vk::AccessFlagBits2::eTransferWrite,
-		vk::PipelineStageFlagBits2::eTopOfPipe,
-		vk::PipelineStageFlagBits2::eTransfer);
-
-	// Copy data from staging buffer to texture image
-	m_ve_device.copyBufferToImage(
-		staging_buffer.getBuffer(),
-		m_texture_image->getImage(),
-		static_cast<uint32_t>(m_width),
-		static_cast<uint32_t>(m_height)
-	);
-
-	// Transition image to be optimal for shader read access
-	m_texture_image->transitionImageLayout(
-		vk::ImageLayout::eTransferDstOptimal,
-		vk::ImageLayout::eShaderReadOnlyOptimal,
-		vk::AccessFlagBits2::eTransferWrite,
-		vk::AccessFlagBits2::eShaderRead,
-		vk::PipelineStageFlagBits2::eTransfer,
-		vk::PipelineStageFlagBits2::eFragmentShader);
+	// Transition, copy and transition are recorded into the uploader's open batch, the
+	// pixels are copied into its staging memory so they can be freed right away
+	m_ve_device.getUploader().uploadImage(
+		*m_texture_image,
+		pixels,
+		static_cast<vk::DeviceSize>(m_width) * static_cast<vk::DeviceSize>(m_height) * 4);
+	if (free_pixels) {
+		stbi_image_free(pixels);
+	}
 }
 
 void VeTexture::createCubeTextureImage(const std::vector<std::filesystem::path>& texture_paths) {
@@ -117,30 +81,12 @@ void VeTexture::createCubeTextureImage(const std::vector<std::filesystem::path>&
 	m_height = face_h;
 	m_channels = face_c;
 
-	// textures loaded
-	// Create a local scope staging buffer
-	ve::VeBuffer staging_buffer(
-		m_ve_device,
-		4,                                        // instance size
-		static_cast<uint32_t>(m_width * m_height * 6),    // instance count
-		vk::BufferUsageFlagBits::eTransferSrc,
-		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-	);
-	VE_LOGD("Created staging buffer for cube map with size: " << (m_width * m_height * 6 * 4) << " bytes");
-
-	// Copy image data to staging buffer (concatenate the 6 faces)
-	staging_buffer.map();
+	// Concatenate the 6 faces, the uploader copies them into one staging range
 	const vk::DeviceSize layer_size = static_cast<vk::DeviceSize>(m_width) * static_cast<vk::DeviceSize>(m_height) * 4;
+	std::vector<stbi_uc> cube_pixels(static_cast<size_t>(layer_size * 6));
 	for (int i = 0; i < 6; ++i) {
 		assert(pixels[i] != nullptr && "Cubemap face pixels are null");
-		const vk::DeviceSize offset = layer_size * static_cast<vk::DeviceSize>(i);
-		staging_buffer.writeToBuffer((void*)pixels[i], layer_size, offset);
-	}
-	// unmap is called in the destructor of VeBuffer
-
-	VE_LOGD("Copied cube map data to staging buffer");
-
-	for (int i = 0; i < 6; i++) {
+		memcpy(cube_pixels.data() + layer_size * static_cast<vk::DeviceSize>(i), pixels[i], static_cast<size_t>(layer_size));
 		stbi_image_free(pixels[i]);
 	}
 
@@ -157,38 +103,10 @@ void VeTexture::createCubeTextureImage(const std::vector<std::filesystem::path>&
 		vk::ImageAspectFlagBits::eColor,
 		true // is cubemap
 	);
-	// Next we execute synchronously 3 single-time command buffers:
-	// TODO: consider combining these into one command buffer
-
 	VE_LOGD("Created cube map image");
 
-	//transition image to be optimal for receiving data from buffer
-	m_texture_image->transitionImageLayout(
-		vk::ImageLayout::eUndefined,
-		vk::ImageLayout::eTransferDstOptimal,
-		{},
-		vk::AccessFlagBits2::eTransferWrite,
-		vk::PipelineStageFlagBits2::eTopOfPipe,
-		vk::PipelineStageFlagBits2::eTransfer);
-
-	// Copy data from staging buffer to texture image
-	m_ve_device.copyBufferToImage(
-		staging_buffer.getBuffer(),
-		m_texture_image->getImage(),
-		static_cast<uint32_t>(m_width),
-		static_cast<uint32_t>(m_height),
-		6
-	);
-
-	// Transition image to be optimal for shader read access
-	m_texture_image->transitionImageLayout(
-		vk::ImageLayout::eTransferDstOptimal,
-		vk::ImageLayout::eShaderReadOnlyOptimal,
-		vk::AccessFlagBits2::eTransferWrite,
-		vk::AccessFlagBits2::eShaderRead,
-		vk::PipelineStageFlagBits2::eTransfer,
-		vk::PipelineStageFlagBits2::eFragmentShader);
-	VE_LOGD("Transitioned cube map image layout");
+	m_ve_device.getUploader().uploadImage(*m_texture_image, cube_pixels.data(), layer_size * 6);
+	VE_LOGD("Recorded cube map upload");
 }
 
 // Sets max anisotropy to the maximum value supported by the device or 16, whichever is lower
@@ -0,0 +1,54 @@
+#include "pch.hpp"
+#include "core/ve_texture_registry.hpp"
+
+namespace ve {
+
+VeTextureRegistry::VeTextureRegistry(VeDevice& device, uint32_t capacity) : m_ve_device(device) {
+	// A combined image sampler counts against both the sampler and the sampled image limits
+	const auto properties = m_ve_device.getPhysicalDevice().getProperties2<
+		vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+	const auto& limits = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+	m_capacity = std::min({
+		capacity,
+		limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+		limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		limits.maxDescriptorSetUpdateAfterBindSamplers,
+		limits.maxDescriptorSetUpdateAfterBindSampledImages});
+	assert(m_capacity > 0 && "Texture registry needs room for at least one texture");
+	if (m_capacity < capacity)
+		VE_LOGW("VeTextureRegistry: capacity lowered from " << capacity << " to " << m_capacity << " by the device limits");
+
+	m_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
+		.addBinding(
+			0,
+			vk::DescriptorType::eCombinedImageSampler,
+			vk::ShaderStageFlagBits::eFragment,
+			m_capacity,
+			vk::DescriptorBindingFlagBits::ePartiallyBound |
+			vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+			vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending)
+		.build();
+	m_pool = VeDescriptorPool::Builder(m_ve_device)
+		.setMaxSets(1)
+		.addPoolSize(vk::DescriptorType::eCombinedImageSampler, m_capacity)
+		// The raii set frees itself on destruction
+		.setPoolFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind | vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+		.build();
+	m_pool->allocateDescriptor(m_set_layout->getDescriptorSetLayout(), m_descriptor_set);
+}
+
+VeTextureRegistry::~VeTextureRegistry() {}
+
+// Elements are only ever appended, so no frame in flight samples the element written here
+uint32_t VeTextureRegistry::add(const VeTexture& texture) {
+	if (m_count == m_capacity)
+		throw std::runtime_error(std::format("VeTextureRegistry: all {} texture slots are in use", m_capacity));
+	const uint32_t index = m_count++;
+	auto image_info = texture.getDescriptorInfo();
+	VeDescriptorWriter(*m_set_layout, *m_pool)
+		.writeImage(0, &image_info, index)
+		.overwrite(m_descriptor_set);
+	return index;
+}
+
+} // namespace ve
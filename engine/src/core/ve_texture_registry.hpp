@@ -0,0 +1,48 @@
+/* VeTextureRegistry keeps every material texture in one descriptor set, a single
+array of combined image samplers indexed by the shaders (bindless). Objects and
+materials carry the index returned by add instead of a descriptor set of their own,
+so any number of textures is drawn without switching descriptor sets. The array
+binding is partially bound and update after bind: unused elements need no valid
+descriptor and new textures are written while frames that bound the set are still
+in flight, without waiting for the device. The textures are not owned and must
+outlive the frames that sample them. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+#include "core/ve_device.hpp"
+#include "core/ve_descriptors.hpp"
+#include "core/ve_texture.hpp"
+
+#include <memory>
+
+namespace ve {
+
+class VENGINE_API VeTextureRegistry {
+public:
+	VeTextureRegistry(VeDevice& device, uint32_t capacity = TEXTURE_REGISTRY_CAPACITY);
+	~VeTextureRegistry();
+
+	VeTextureRegistry(const VeTextureRegistry&) = delete;
+	VeTextureRegistry& operator=(const VeTextureRegistry&) = delete;
+
+	// Writes the texture into the next free element and returns its index for the shaders
+	uint32_t add(const VeTexture& texture);
+
+	// Set layout of the texture array (binding 0), for fragment shaders
+	const vk::raii::DescriptorSetLayout& getSetLayout() const { return m_set_layout->getDescriptorSetLayout(); }
+	vk::DescriptorSet getDescriptorSet() const { return *m_descriptor_set; }
+	uint32_t getCount() const { return m_count; }
+	// Requested capacity lowered to what the device allows for update after bind samplers
+	uint32_t getCapacity() const { return m_capacity; }
+
+private:
+	VeDevice& m_ve_device;
+	uint32_t m_capacity;
+	uint32_t m_count = 0;
+
+	std::unique_ptr<VeDescriptorSetLayout> m_set_layout;
+	std::unique_ptr<VeDescriptorPool> m_pool; // update after bind sets need a pool of their own
+	vk::raii::DescriptorSet m_descriptor_set{nullptr};
+};
+
+} // namespace ve
@@ -0,0 +1,80 @@
+#include "pch.hpp"
+#include "core/ve_thread_pool.hpp"
+
+#include <utility>
+
+namespace ve {
+
+uint32_t VeThreadPool::getDefaultWorkerCount() {
+	const uint32_t hardware_threads = std::thread::hardware_concurrency(); // 0 when unknown
+	return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+VeThreadPool::VeThreadPool(uint32_t worker_count) {
+	m_workers.reserve(worker_count);
+	for (uint32_t i = 0; i < worker_count; ++i) {
+		m_workers.emplace_back(&VeThreadPool::workerLoop, this);
+	}
+}
+
+VeThreadPool::~VeThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_work_available.notify_all();
+	for (std::thread& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void VeThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& fn) {
+	if (count == 0) return;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	assert(m_fn == nullptr && "parallelFor is not reentrant");
+	m_fn = &fn;
+	m_count = count;
+	m_next = 0;
+	m_error = nullptr;
+	if (count > 1)
+		m_work_available.notify_all();
+	runIterations(lock);
+	m_work_done.wait(lock, [this] { return m_running == 0; });
+	m_fn = nullptr;
+	if (m_error)
+		std::rethrow_exception(std::exchange(m_error, nullptr));
+}
+
+void VeThreadPool::workerLoop() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_work_available.wait(lock, [this] { return m_stop || (m_fn && m_next < m_count); });
+		if (m_stop) return;
+		runIterations(lock);
+	}
+}
+
+// The lock is only released around the call itself, the loop bookkeeping is guarded
+void VeThreadPool::runIterations(std::unique_lock<std::mutex>& lock) {
+	while (m_fn && m_next < m_count) {
+		const uint32_t index = m_next++;
+		const auto* fn = m_fn;
+		++m_running;
+		lock.unlock();
+		std::exception_ptr error;
+		try {
+			(*fn)(index);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		lock.lock();
+		if (error && !m_error) {
+			m_error = error;
+			m_next = m_count; // skip what has not started
+		}
+		if (--m_running == 0 && m_next == m_count)
+			m_work_done.notify_all();
+	}
+}
+
+} // namespace ve
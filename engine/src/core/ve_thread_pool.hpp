@@ -0,0 +1,55 @@
+/* VeThreadPool runs the iterations of a parallel loop on a fixed set of worker threads
+and the calling thread. It is meant for short bursts of independent work within a
+frame, such as recording secondary command buffers. Workers sleep between loops. */
+#pragma once
+#include "ve_export.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ve {
+
+class VENGINE_API VeThreadPool {
+public:
+	// One worker less than the hardware threads, the calling thread takes part in every loop
+	static uint32_t getDefaultWorkerCount();
+
+	explicit VeThreadPool(uint32_t worker_count = getDefaultWorkerCount());
+	~VeThreadPool();
+
+	VeThreadPool(const VeThreadPool&) = delete;
+	VeThreadPool& operator=(const VeThreadPool&) = delete;
+
+	// Calls fn(i) once for every i in [0, count) and returns when all calls have returned.
+	// Iterations run in any order on any thread. The first exception thrown is rethrown
+	// after the loop, iterations not yet started are skipped. Not reentrant.
+	void parallelFor(uint32_t count, const std::function<void(uint32_t)>& fn);
+
+	// Workers and the calling thread
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+private:
+	void workerLoop();
+	// Runs iterations of the current loop until none are left, expects lock to be held
+	void runIterations(std::unique_lock<std::mutex>& lock);
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_work_available;
+	std::condition_variable m_work_done;
+
+	// Current loop, guarded by m_mutex
+	const std::function<void(uint32_t)>* m_fn = nullptr;
+	uint32_t m_count = 0;
+	uint32_t m_next = 0;
+	uint32_t m_running = 0;
+	std::exception_ptr m_error;
+	bool m_stop = false;
+};
+
+} // namespace ve
@@ -0,0 +1,227 @@
+#include "pch.hpp"
+#include "core/ve_uploader.hpp"
+
+#include <cstring>
+
+namespace ve {
+
+VeUploader::VeUploader(VeDevice& device, vk::DeviceSize staging_chunk_size)
+	: m_ve_device(device), m_staging_chunk_size(staging_chunk_size) {
+	assert(staging_chunk_size > 0 && "Staging chunk size must be greater than zero");
+	vk::SemaphoreTypeCreateInfo semaphore_type{
+		.sType = vk::StructureType::eSemaphoreTypeCreateInfo,
+		.pNext = nullptr,
+		.semaphoreType = vk::SemaphoreType::eTimeline,
+		.initialValue = 0
+	};
+	vk::SemaphoreCreateInfo semaphore_info{ .pNext = &semaphore_type };
+	m_semaphore = vk::raii::Semaphore(m_ve_device.getDevice(), semaphore_info);
+}
+
+VeUploader::~VeUploader() {
+	// Staging buffers and command buffers must not be released while the GPU still reads them
+	if (hasPendingWork()) {
+		VE_LOGW("VeUploader destroyed with unsubmitted uploads, they are discarded");
+	}
+	wait(m_submitted_value);
+}
+
+// Returns the open batch's command buffer, beginning a recycled or new batch if needed.
+// Caller must hold m_mutex.
+vk::CommandBuffer VeUploader::getRecordingCommandBuffer() {
+	if (m_recording) {
+		return *m_batches[*m_recording].command_buffer;
+	}
+	const uint64_t completed = getCompletedValue();
+	for (size_t i = 0; i < m_batches.size(); ++i) {
+		if (m_batches[i].value != 0 && m_batches[i].value <= completed) {
+			m_recording = i;
+			break;
+		}
+	}
+	if (!m_recording) {
+		vk::CommandBufferAllocateInfo alloc_info{
+			.sType = vk::StructureType::eCommandBufferAllocateInfo,
+			.commandPool = *m_ve_device.getTransferCommandPool(),
+			.level = vk::CommandBufferLevel::ePrimary,
+			.commandBufferCount = 1
+		};
+		m_batches.push_back(Batch{
+			.command_buffer = std::move(vk::raii::CommandBuffers(m_ve_device.getDevice(), alloc_info).front()),
+			.value = 0
+		});
+		m_recording = m_batches.size() - 1;
+	}
+	Batch& batch = m_batches[*m_recording];
+	batch.value = 0;
+	batch.command_buffer.reset();
+	batch.command_buffer.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	return *batch.command_buffer;
+}
+
+// Bump allocates from a staging chunk owned by the open batch, recycling retired chunks first.
+// Caller must hold m_mutex.
+VeUploader::StagingRange VeUploader::allocateStaging(vk::DeviceSize size, vk::DeviceSize alignment) {
+	const uint64_t completed = getCompletedValue();
+	for (auto& chunk : m_staging_chunks) {
+		if (chunk.retire_value != 0 && chunk.retire_value <= completed) {
+			chunk.retire_value = 0;
+			chunk.head = 0;
+		}
+	}
+	// Drop idle oversized chunks so one huge upload does not pin its staging memory forever
+	std::erase_if(m_staging_chunks, [this](const StagingChunk& chunk) {
+		return chunk.retire_value == 0 && chunk.head == 0 &&
+			chunk.buffer->getBufferSize() > m_staging_chunk_size;
+	});
+
+	StagingChunk* target = nullptr;
+	for (auto& chunk : m_staging_chunks) {
+		if (chunk.retire_value == 0 && VeBuffer::getAlignment(chunk.head, alignment) + size <= chunk.buffer->getBufferSize()) {
+			target = &chunk;
+			break;
+		}
+	}
+	if (!target) {
+		auto buffer = std::make_unique<VeBuffer>(
+			m_ve_device,
+			std::max(size, m_staging_chunk_size),
+			1,
+			vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		buffer->map();
+		m_staging_chunks.push_back(StagingChunk{ .buffer = std::move(buffer), .head = 0, .retire_value = 0 });
+		target = &m_staging_chunks.back();
+	}
+
+	const vk::DeviceSize offset = VeBuffer::getAlignment(target->head, alignment);
+	target->head = offset + size;
+	return StagingRange{
+		.buffer = *target->buffer->getBuffer(),
+		.offset = offset,
+		.data = static_cast<char*>(target->buffer->getMappedMemory()) + offset
+	};
+}
+
+void VeUploader::uploadBuffer(vk::Buffer dst_buffer, const void* data, vk::DeviceSize size, vk::DeviceSize dst_offset) {
+	assert(dst_buffer != VK_NULL_HANDLE && "Destination buffer must be valid");
+	assert(data != nullptr && size > 0 && "Upload data must not be empty");
+	std::lock_guard<std::mutex> lock(m_mutex);
+	StagingRange staging = allocateStaging(size, 16);
+	memcpy(staging.data, data, static_cast<size_t>(size));
+	getRecordingCommandBuffer().copyBuffer(staging.buffer, dst_buffer, vk::BufferCopy{ staging.offset, dst_offset, size });
+}
+
+void VeUploader::copyBuffer(vk::Buffer src_buffer, vk::Buffer dst_buffer, const vk::BufferCopy& region) {
+	assert(src_buffer != VK_NULL_HANDLE && dst_buffer != VK_NULL_HANDLE && "Buffers must be valid");
+	assert(region.size > 0 && "Copy size must be greater than zero");
+	std::lock_guard<std::mutex> lock(m_mutex);
+	getRecordingCommandBuffer().copyBuffer(src_buffer, dst_buffer, region);
+}
+
+void VeUploader::fillBuffer(vk::Buffer dst_buffer, vk::DeviceSize dst_offset, vk::DeviceSize size, uint32_t value) {
+	assert(dst_buffer != VK_NULL_HANDLE && "Destination buffer must be valid");
+	assert(size > 0 && size % 4 == 0 && dst_offset % 4 == 0 && "Fill range must be 4-byte aligned");
+	std::lock_guard<std::mutex> lock(m_mutex);
+	getRecordingCommandBuffer().fillBuffer(dst_buffer, dst_offset, size, value);
+}
+
+// Records the transition to transfer dst, the copy of all layers and the transition to shader read.
+// Recorded on the transfer queue, so the last barrier only uses stages valid there.
+void VeUploader::uploadImage(VeImage& image, const void* data, vk::DeviceSize size) {
+	assert(data != nullptr && size > 0 && "Upload data must not be empty");
+	std::lock_guard<std::mutex> lock(m_mutex);
+	StagingRange staging = allocateStaging(size, 16);
+	memcpy(staging.data, data, static_cast<size_t>(size));
+	vk::CommandBuffer cmd = getRecordingCommandBuffer();
+
+	image.recordTransition(
+		cmd,
+		vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eTransferDstOptimal,
+		{},
+		vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eTopOfPipe,
+		vk::PipelineStageFlagBits2::eTransfer);
+
+	vk::BufferImageCopy copy_region{
+		.bufferOffset = staging.offset,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = { vk::ImageAspectFlagBits::eColor, 0, 0, image.getArrayLayers() },
+		.imageOffset = { 0, 0, 0 },
+		.imageExtent = { image.getWidth(), image.getHeight(), 1 }
+	};
+	cmd.copyBufferToImage(staging.buffer, *image.getImage(), vk::ImageLayout::eTransferDstOptimal, copy_region);
+
+	image.recordTransition(
+		cmd,
+		vk::ImageLayout::eTransferDstOptimal,
+		vk::ImageLayout::eShaderReadOnlyOptimal,
+		vk::AccessFlagBits2::eTransferWrite,
+		{}, // visibility to shader reads comes from the timeline wait of the consuming submit
+		vk::PipelineStageFlagBits2::eTransfer,
+		vk::PipelineStageFlagBits2::eAllCommands);
+}
+
+uint64_t VeUploader::flush() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_recording) {
+		return m_submitted_value;
+	}
+	Batch& batch = m_batches[*m_recording];
+	batch.command_buffer.end();
+
+	const uint64_t signal_value = m_submitted_value + 1;
+	const vk::TimelineSemaphoreSubmitInfo timeline_info{
+		.sType = vk::StructureType::eTimelineSemaphoreSubmitInfo,
+		.pNext = nullptr,
+		.waitSemaphoreValueCount = 0,
+		.pWaitSemaphoreValues = nullptr,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &signal_value
+	};
+	vk::CommandBuffer command_buffer = *batch.command_buffer;
+	vk::SubmitInfo submit_info{
+		.pNext = &timeline_info,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &command_buffer,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &*m_semaphore
+	};
+	m_ve_device.getTransferQueue().submit(submit_info, nullptr);
+
+	// Everything recorded in this batch is retired by signal_value
+	batch.value = signal_value;
+	for (auto& chunk : m_staging_chunks) {
+		if (chunk.retire_value == 0 && chunk.head > 0) {
+			chunk.retire_value = signal_value;
+		}
+	}
+	m_submitted_value = signal_value;
+	m_recording.reset();
+	return signal_value;
+}
+
+void VeUploader::wait(uint64_t value) const {
+	if (value == 0 || isComplete(value)) return;
+	vk::SemaphoreWaitInfo wait_info{
+		.semaphoreCount = 1,
+		.pSemaphores = &*m_semaphore,
+		.pValues = &value
+	};
+	if (m_ve_device.getDevice().waitSemaphores(wait_info, UINT64_MAX) != vk::Result::eSuccess) {
+		throw std::runtime_error("VeUploader: failed to wait for upload timeline value");
+	}
+}
+
+bool VeUploader::hasPendingWork() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_recording.has_value();
+}
+
+uint64_t VeUploader::getCompletedValue() const {
+	return m_semaphore.getCounterValue();
+}
+
+} // namespace ve
@@ -0,0 +1,83 @@
+/* VeUploader batches host to device transfers. Buffer copies, buffer fills and
+image uploads (including their layout transitions) are recorded into one open
+command buffer and submitted together by flush(). Source data is copied into
+pooled, persistently mapped staging buffers that are recycled once the GPU has
+passed the timeline value of the batch that used them. Each flush signals a
+timeline semaphore value that callers can poll or wait on, the renderer makes
+its submissions wait on the latest submitted value on the GPU. */
+#pragma once
+#include "ve_export.hpp"
+#include "core/ve_device.hpp"
+#include "core/ve_buffer.hpp"
+#include "core/ve_image.hpp"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace ve {
+
+class VENGINE_API VeUploader {
+public:
+	static constexpr vk::DeviceSize DEFAULT_STAGING_SIZE = 16ull * 1024 * 1024;
+
+	VeUploader(VeDevice& device, vk::DeviceSize staging_chunk_size = DEFAULT_STAGING_SIZE);
+	~VeUploader();
+
+	VeUploader(const VeUploader&) = delete;
+	VeUploader& operator=(const VeUploader&) = delete;
+
+	// Copies size bytes of data into dst_buffer at dst_offset
+	void uploadBuffer(vk::Buffer dst_buffer, const void* data, vk::DeviceSize size, vk::DeviceSize dst_offset = 0);
+	// Device to device copy, e.g. when growing a buffer
+	void copyBuffer(vk::Buffer src_buffer, vk::Buffer dst_buffer, const vk::BufferCopy& region);
+	// Fills size bytes (multiple of 4) of dst_buffer with a repeated 32-bit value, no staging needed
+	void fillBuffer(vk::Buffer dst_buffer, vk::DeviceSize dst_offset, vk::DeviceSize size, uint32_t value);
+	// Uploads tightly packed pixels for all layers of image and leaves it in eShaderReadOnlyOptimal
+	void uploadImage(VeImage& image, const void* data, vk::DeviceSize size);
+
+	// Submits everything recorded since the last flush, returns the value signaled on completion.
+	// Returns the last submitted value when nothing was pending.
+	uint64_t flush();
+	void wait(uint64_t value) const;
+	void flushAndWait() { wait(flush()); }
+
+	bool isComplete(uint64_t value) const { return getCompletedValue() >= value; }
+	bool hasPendingWork() const;
+	uint64_t getCompletedValue() const;
+	uint64_t getSubmittedValue() const { return m_submitted_value; }
+	vk::Semaphore getSemaphore() const { return *m_semaphore; }
+
+private:
+	struct Batch {
+		vk::raii::CommandBuffer command_buffer{nullptr};
+		uint64_t value = 0; // timeline value signaled when the batch completed, 0 while recording
+	};
+	struct StagingChunk {
+		std::unique_ptr<VeBuffer> buffer;
+		vk::DeviceSize head = 0;
+		uint64_t retire_value = 0; // 0 while owned by the open batch
+	};
+	struct StagingRange {
+		vk::Buffer buffer;
+		vk::DeviceSize offset;
+		void* data;
+	};
+
+	vk::CommandBuffer getRecordingCommandBuffer();
+	StagingRange allocateStaging(vk::DeviceSize size, vk::DeviceSize alignment);
+
+	VeDevice& m_ve_device;
+	vk::DeviceSize m_staging_chunk_size;
+
+	mutable std::mutex m_mutex;
+	vk::raii::Semaphore m_semaphore{nullptr};
+	uint64_t m_submitted_value = 0;
+
+	std::vector<Batch> m_batches;
+	std::optional<size_t> m_recording; // index into m_batches of the open batch
+	std::vector<StagingChunk> m_staging_chunks;
+};
+
+} // namespace ve
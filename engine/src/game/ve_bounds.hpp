@@ -0,0 +1,56 @@
+/* Axis aligned bounding box used for culling and spatial queries. An empty box has
+min > max, so growing it by the first point or box makes it exactly that point or box. */
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <limits>
+
+namespace ve {
+
+struct VeAabb {
+	glm::vec3 min{std::numeric_limits<float>::max()};
+	glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+	static VeAabb fromCenterExtent(const glm::vec3& center, const glm::vec3& extent) {
+		return VeAabb{ center - extent, center + extent };
+	}
+
+	bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+	glm::vec3 getCenter() const { return 0.5f * (min + max); }
+	glm::vec3 getExtent() const { return 0.5f * (max - min); } // half size per axis
+	float getSurfaceArea() const {
+		const glm::vec3 d = max - min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	bool contains(const VeAabb& other) const {
+		return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+	}
+	bool overlaps(const VeAabb& other) const {
+		return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+	}
+	// Squared distance from point to the box, 0 inside
+	float getDistanceSquared(const glm::vec3& point) const {
+		const glm::vec3 d = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+		return glm::dot(d, d);
+	}
+
+	void grow(const glm::vec3& point) {
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+	void grow(const VeAabb& other) {
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	bool operator==(const VeAabb& other) const { return min == other.min && max == other.max; }
+};
+
+inline VeAabb merge(const VeAabb& a, const VeAabb& b) {
+	return VeAabb{ glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+} // namespace ve
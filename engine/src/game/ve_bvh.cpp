@@ -0,0 +1,403 @@
+#include "pch.hpp"
+#include "game/ve_bvh.hpp"
+
+#include <array>
+#include <numeric>
+
+namespace ve {
+
+namespace {
+constexpr uint32_t SAH_BIN_COUNT = 12;
+constexpr float RAY_MISS = std::numeric_limits<float>::infinity();
+}
+
+struct VeBvh::BuildState {
+	std::span<const Item> items;
+	std::vector<glm::vec3> centroids; // per item
+	std::vector<uint32_t> leaves;     // proxy per item
+};
+
+void VeBvh::clear() {
+	m_nodes.clear();
+	m_root = NULL_NODE;
+	m_free_list = NULL_NODE;
+	m_leaf_count = 0;
+}
+
+uint32_t VeBvh::allocateNode() {
+	if (m_free_list != NULL_NODE) {
+		const uint32_t index = m_free_list;
+		m_free_list = m_nodes[index].parent;
+		m_nodes[index] = Node{};
+		return index;
+	}
+	m_nodes.emplace_back();
+	return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void VeBvh::freeNode(uint32_t index) {
+	m_nodes[index] = Node{};
+	m_nodes[index].parent = m_free_list;
+	m_free_list = index;
+}
+
+void VeBvh::build(std::span<const Item> items, std::vector<uint32_t>* proxies) {
+	clear();
+	if (items.empty()) {
+		if (proxies) proxies->clear();
+		return;
+	}
+	BuildState state;
+	state.items = items;
+	state.centroids.reserve(items.size());
+	for (const Item& item : items) {
+		assert(!item.box.isEmpty() && "Cannot insert an empty box");
+		state.centroids.push_back(item.box.getCenter());
+	}
+	state.leaves.resize(items.size());
+	std::vector<uint32_t> refs(items.size());
+	std::iota(refs.begin(), refs.end(), 0u);
+
+	m_nodes.reserve(2 * items.size() - 1); // full binary tree with one item per leaf
+	m_root = buildRange(state, refs.data(), static_cast<uint32_t>(refs.size()));
+	m_leaf_count = static_cast<uint32_t>(items.size());
+	if (proxies) *proxies = std::move(state.leaves);
+}
+
+// Splits refs at the bin boundary with the lowest SAH cost along the axis where the
+// centroids spread most. Falls back to a median split when all centroids land on one side.
+uint32_t VeBvh::buildRange(BuildState& state, uint32_t* refs, uint32_t count) {
+	if (count == 1) {
+		const uint32_t leaf = allocateNode();
+		m_nodes[leaf].box = state.items[refs[0]].box;
+		m_nodes[leaf].user_data = state.items[refs[0]].user_data;
+		state.leaves[refs[0]] = leaf;
+		return leaf;
+	}
+
+	VeAabb centroid_bounds;
+	for (uint32_t i = 0; i < count; ++i) {
+		centroid_bounds.grow(state.centroids[refs[i]]);
+	}
+	const glm::vec3 spread = centroid_bounds.max - centroid_bounds.min;
+	const int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+
+	uint32_t mid = 0;
+	if (spread[axis] > 0.0f) {
+		struct Bin { VeAabb box; uint32_t count = 0; };
+		std::array<Bin, SAH_BIN_COUNT> bins{};
+		const float origin = centroid_bounds.min[axis];
+		const float scale = SAH_BIN_COUNT / spread[axis];
+		auto binOf = [&](uint32_t ref) {
+			const auto bin = static_cast<uint32_t>((state.centroids[ref][axis] - origin) * scale);
+			return std::min(bin, SAH_BIN_COUNT - 1);
+		};
+		for (uint32_t i = 0; i < count; ++i) {
+			Bin& bin = bins[binOf(refs[i])];
+			bin.box.grow(state.items[refs[i]].box);
+			++bin.count;
+		}
+
+		// right_cost[i] is the cost of bins i + 1 and up, then sweep from the left
+		std::array<float, SAH_BIN_COUNT> right_cost{};
+		VeAabb right_box;
+		uint32_t right_count = 0;
+		for (uint32_t i = SAH_BIN_COUNT - 1; i > 0; --i) {
+			right_box.grow(bins[i].box);
+			right_count += bins[i].count;
+			right_cost[i - 1] = right_count ? static_cast<float>(right_count) * right_box.getSurfaceArea() : 0.0f;
+		}
+		VeAabb left_box;
+		uint32_t left_count = 0;
+		float best_cost = std::numeric_limits<float>::max();
+		uint32_t best_split = 0;
+		for (uint32_t i = 0; i + 1 < SAH_BIN_COUNT; ++i) {
+			left_box.grow(bins[i].box);
+			left_count += bins[i].count;
+			if (left_count == 0 || left_count == count) continue;
+			const float cost = static_cast<float>(left_count) * left_box.getSurfaceArea() + right_cost[i];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_split = i;
+			}
+		}
+		mid = static_cast<uint32_t>(std::partition(refs, refs + count,
+			[&](uint32_t ref) { return binOf(ref) <= best_split; }) - refs);
+	}
+	if (mid == 0 || mid == count) {
+		mid = count / 2;
+		std::nth_element(refs, refs + mid, refs + count, [&](uint32_t a, uint32_t b) {
+			return state.centroids[a][axis] < state.centroids[b][axis];
+		});
+	}
+
+	const uint32_t left = buildRange(state, refs, mid);
+	const uint32_t right = buildRange(state, refs + mid, count - mid);
+	const uint32_t index = allocateNode();
+	Node& node = m_nodes[index];
+	node.left = left;
+	node.right = right;
+	node.box = merge(m_nodes[left].box, m_nodes[right].box);
+	node.height = 1 + std::max(m_nodes[left].height, m_nodes[right].height);
+	m_nodes[left].parent = index;
+	m_nodes[right].parent = index;
+	return index;
+}
+
+// Recomputes boxes and heights up to the root, stops early once a node is unchanged
+void VeBvh::refitAncestors(uint32_t index) {
+	while (index != NULL_NODE) {
+		Node& node = m_nodes[index];
+		const VeAabb box = merge(m_nodes[node.left].box, m_nodes[node.right].box);
+		const uint32_t height = 1 + std::max(m_nodes[node.left].height, m_nodes[node.right].height);
+		if (box == node.box && height == node.height)
+			return;
+		node.box = box;
+		node.height = height;
+		index = node.parent;
+	}
+}
+
+// Descends towards the child whose enlargement costs least (Catto's dynamic tree),
+// stopping where pairing with the current node is cheaper than going deeper
+uint32_t VeBvh::insert(const VeAabb& box, uint32_t user_data) {
+	assert(!box.isEmpty() && "Cannot insert an empty box");
+	const uint32_t leaf = allocateNode();
+	m_nodes[leaf].box = box;
+	m_nodes[leaf].user_data = user_data;
+	++m_leaf_count;
+	if (m_root == NULL_NODE) {
+		m_root = leaf;
+		return leaf;
+	}
+
+	uint32_t sibling = m_root;
+	while (!m_nodes[sibling].isLeaf()) {
+		const Node& node = m_nodes[sibling];
+		const float combined = merge(node.box, box).getSurfaceArea();
+		const float cost = 2.0f * combined;
+		// Every ancestor of the new leaf grows by this much
+		const float inheritance = 2.0f * (combined - node.box.getSurfaceArea());
+		auto descendCost = [&](uint32_t child) {
+			const Node& c = m_nodes[child];
+			const float area = merge(c.box, box).getSurfaceArea();
+			return (c.isLeaf() ? area : area - c.box.getSurfaceArea()) + inheritance;
+		};
+		const float left_cost = descendCost(node.left);
+		const float right_cost = descendCost(node.right);
+		if (cost < left_cost && cost < right_cost)
+			break;
+		sibling = left_cost < right_cost ? node.left : node.right;
+	}
+
+	const uint32_t old_parent = m_nodes[sibling].parent;
+	const uint32_t parent = allocateNode();
+	Node& node = m_nodes[parent];
+	node.parent = old_parent;
+	node.left = sibling;
+	node.right = leaf;
+	node.box = merge(m_nodes[sibling].box, box);
+	node.height = m_nodes[sibling].height + 1;
+	m_nodes[sibling].parent = parent;
+	m_nodes[leaf].parent = parent;
+	if (old_parent == NULL_NODE) {
+		m_root = parent;
+	} else {
+		Node& up = m_nodes[old_parent];
+		(up.left == sibling ? up.left : up.right) = parent;
+		refitAncestors(old_parent);
+	}
+	return leaf;
+}
+
+// The sibling takes the place of the removed leaf's parent
+void VeBvh::remove(uint32_t proxy) {
+	assert(proxy < m_nodes.size() && m_nodes[proxy].isLeaf() && "Invalid BVH proxy");
+	--m_leaf_count;
+	if (proxy == m_root) {
+		m_root = NULL_NODE;
+		freeNode(proxy);
+		return;
+	}
+	const uint32_t parent = m_nodes[proxy].parent;
+	const uint32_t grand_parent = m_nodes[parent].parent;
+	const uint32_t sibling = m_nodes[parent].left == proxy ? m_nodes[parent].right : m_nodes[parent].left;
+	m_nodes[sibling].parent = grand_parent;
+	if (grand_parent == NULL_NODE) {
+		m_root = sibling;
+	} else {
+		Node& up = m_nodes[grand_parent];
+		(up.left == parent ? up.left : up.right) = sibling;
+	}
+	freeNode(parent);
+	freeNode(proxy);
+	refitAncestors(grand_parent);
+}
+
+void VeBvh::update(uint32_t proxy, const VeAabb& box) {
+	assert(proxy < m_nodes.size() && m_nodes[proxy].isLeaf() && "Invalid BVH proxy");
+	assert(!box.isEmpty() && "Cannot insert an empty box");
+	if (m_nodes[proxy].box == box)
+		return;
+	m_nodes[proxy].box = box;
+	refitAncestors(m_nodes[proxy].parent);
+}
+
+void VeBvh::collectLeaves(uint32_t index, std::vector<uint32_t>& out) const {
+	std::vector<uint32_t> stack{index};
+	while (!stack.empty()) {
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+		if (node.isLeaf()) {
+			out.push_back(node.user_data);
+		} else {
+			stack.push_back(node.right);
+			stack.push_back(node.left);
+		}
+	}
+}
+
+// Same plane test as VeFrustum::intersectsAabb. Each stack entry carries a mask of the
+// planes its parent straddled, planes the node is fully inside of are not tested below it.
+void VeBvh::queryFrustum(const VeFrustum& frustum, std::vector<uint32_t>& out) const {
+	out.clear();
+	if (m_root == NULL_NODE)
+		return;
+	constexpr uint32_t ALL_PLANES = (1u << VeFrustum::PLANE_COUNT) - 1;
+	struct Entry { uint32_t node; uint32_t mask; };
+	std::vector<Entry> stack{{m_root, ALL_PLANES}};
+	while (!stack.empty()) {
+		const Entry entry = stack.back();
+		stack.pop_back();
+		const Node& node = m_nodes[entry.node];
+		const glm::vec3 center = node.box.getCenter();
+		const glm::vec3 extent = node.box.getExtent();
+		uint32_t mask = entry.mask;
+		bool outside = false;
+		for (uint32_t i = 0; i < VeFrustum::PLANE_COUNT && !outside; ++i) {
+			if (!(mask & (1u << i))) continue;
+			const glm::vec4& plane = frustum.planes[i];
+			const float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			const float r = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+			outside = d + r < 0.0f;
+			if (d - r >= 0.0f) mask &= ~(1u << i);
+		}
+		if (outside)
+			continue;
+		if (node.isLeaf()) {
+			out.push_back(node.user_data);
+		} else if (mask == 0) {
+			collectLeaves(entry.node, out);
+		} else {
+			stack.push_back({node.right, mask});
+			stack.push_back({node.left, mask});
+		}
+	}
+}
+
+void VeBvh::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const {
+	out.clear();
+	if (m_root == NULL_NODE)
+		return;
+	const float radius_squared = radius * radius;
+	std::vector<uint32_t> stack{m_root};
+	while (!stack.empty()) {
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+		if (node.box.getDistanceSquared(center) > radius_squared)
+			continue;
+		if (node.isLeaf()) {
+			out.push_back(node.user_data);
+		} else {
+			stack.push_back(node.right);
+			stack.push_back(node.left);
+		}
+	}
+}
+
+// Slab test per node, children are visited near first and nodes whose entry lies
+// beyond the closest hit so far are skipped
+std::optional<VeBvhHit> VeBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance) const {
+	if (m_root == NULL_NODE)
+		return std::nullopt;
+	const glm::vec3 inv_direction = 1.0f / direction; // infinite for axis parallel rays
+	float closest = max_distance;
+	auto entryDistance = [&](const VeAabb& box) {
+		const glm::vec3 t0 = (box.min - origin) * inv_direction;
+		const glm::vec3 t1 = (box.max - origin) * inv_direction;
+		const glm::vec3 t_near = glm::min(t0, t1);
+		const glm::vec3 t_far = glm::max(t0, t1);
+		const float enter = std::max({t_near.x, t_near.y, t_near.z, 0.0f});
+		const float exit = std::min({t_far.x, t_far.y, t_far.z, closest});
+		return enter <= exit ? enter : RAY_MISS;
+	};
+
+	std::optional<VeBvhHit> hit;
+	struct Entry { uint32_t node; float distance; };
+	std::vector<Entry> stack;
+	if (const float t = entryDistance(m_nodes[m_root].box); t != RAY_MISS)
+		stack.push_back({m_root, t});
+	while (!stack.empty()) {
+		const Entry entry = stack.back();
+		stack.pop_back();
+		if (entry.distance > closest)
+			continue;
+		const Node& node = m_nodes[entry.node];
+		if (node.isLeaf()) {
+			closest = entry.distance;
+			hit = VeBvhHit{ .user_data = node.user_data, .distance = entry.distance };
+			continue;
+		}
+		Entry near_child{node.left, entryDistance(m_nodes[node.left].box)};
+		Entry far_child{node.right, entryDistance(m_nodes[node.right].box)};
+		if (far_child.distance < near_child.distance)
+			std::swap(near_child, far_child);
+		if (far_child.distance != RAY_MISS) stack.push_back(far_child);
+		if (near_child.distance != RAY_MISS) stack.push_back(near_child);
+	}
+	return hit;
+}
+
+float VeBvh::getSahCost() const {
+	if (m_root == NULL_NODE || m_nodes[m_root].isLeaf())
+		return 0.0f;
+	float area = 0.0f;
+	std::vector<uint32_t> stack{m_root};
+	while (!stack.empty()) {
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+		if (node.isLeaf()) continue;
+		area += node.box.getSurfaceArea();
+		stack.push_back(node.left);
+		stack.push_back(node.right);
+	}
+	return area / m_nodes[m_root].box.getSurfaceArea();
+}
+
+bool VeBvh::validate() const {
+	if (m_root == NULL_NODE)
+		return m_leaf_count == 0;
+	if (m_nodes[m_root].parent != NULL_NODE)
+		return false;
+	uint32_t leaves = 0;
+	std::vector<uint32_t> stack{m_root};
+	while (!stack.empty()) {
+		const uint32_t index = stack.back();
+		stack.pop_back();
+		const Node& node = m_nodes[index];
+		if (node.isLeaf()) {
+			if (node.height != 0 || node.right != NULL_NODE) return false;
+			++leaves;
+			continue;
+		}
+		for (uint32_t child : {node.left, node.right}) {
+			if (child >= m_nodes.size() || m_nodes[child].parent != index) return false;
+			if (!node.box.contains(m_nodes[child].box)) return false;
+			stack.push_back(child);
+		}
+		if (node.height != 1 + std::max(m_nodes[node.left].height, m_nodes[node.right].height)) return false;
+	}
+	return leaves == m_leaf_count;
+}
+
+} // namespace ve
@@ -0,0 +1,93 @@
+/* VeBvh is a dynamic bounding volume hierarchy over world space boxes, one leaf per
+object. build() creates the tree top down with a binned surface area heuristic (SAH),
+insert() descends to the sibling with the lowest SAH cost increase and remove()
+splices the leaf's parent out. update() moves a leaf and refits its ancestors, so
+objects that move keep their leaf but slowly degrade the tree; building again restores
+SAH quality. Leaves are addressed by proxy (the node index), which stays valid until
+the leaf is removed or the tree is built again. Each leaf carries a user value, for
+game objects the object id, which is what the queries return. */
+#pragma once
+#include "ve_export.hpp"
+#include "game/ve_bounds.hpp"
+#include "game/ve_frustum.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace ve {
+
+struct VeBvhHit {
+	uint32_t user_data;
+	float distance; // along the ray direction in units of its length
+};
+
+class VENGINE_API VeBvh {
+public:
+	static constexpr uint32_t NULL_NODE = UINT32_MAX;
+
+	struct Item {
+		VeAabb box;
+		uint32_t user_data;
+	};
+
+	VeBvh() = default;
+
+	void clear();
+	// Replaces the tree with a SAH build over items. When proxies is given it receives
+	// the proxy of each item, in item order.
+	void build(std::span<const Item> items, std::vector<uint32_t>* proxies = nullptr);
+
+	// Returns the proxy of the new leaf
+	uint32_t insert(const VeAabb& box, uint32_t user_data);
+	void remove(uint32_t proxy);
+	// Moves a leaf and refits its ancestors, nothing happens when the box is unchanged
+	void update(uint32_t proxy, const VeAabb& box);
+
+	// Writes the user data of the leaves whose box intersects the frustum into out.
+	// Subtrees fully inside a plane skip that plane, fully inside ones are taken whole.
+	void queryFrustum(const VeFrustum& frustum, std::vector<uint32_t>& out) const;
+	// Writes the user data of the leaves whose box overlaps the sphere into out
+	void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const;
+	// Closest leaf box hit by origin + t * direction with t in [0, max_distance]
+	std::optional<VeBvhHit> raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance) const;
+
+	uint32_t getUserData(uint32_t proxy) const { return m_nodes[proxy].user_data; }
+	const VeAabb& getBox(uint32_t proxy) const { return m_nodes[proxy].box; }
+	uint32_t getLeafCount() const { return m_leaf_count; }
+	uint32_t getHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; }
+	// Sum of the surface areas of the internal nodes relative to the root, lower is better
+	float getSahCost() const;
+	// Checks links, heights and that every node box contains its children, for tests
+	bool validate() const;
+
+private:
+	struct Node {
+		VeAabb box;
+		uint32_t parent = NULL_NODE;
+		uint32_t left = NULL_NODE;  // NULL_NODE for leaves
+		uint32_t right = NULL_NODE;
+		uint32_t user_data = 0;
+		uint32_t height = 0;        // 0 for leaves
+		bool isLeaf() const { return left == NULL_NODE; }
+	};
+
+	struct BuildState; // scratch of build(), defined in ve_bvh.cpp
+
+	uint32_t allocateNode();
+	void freeNode(uint32_t index);
+	uint32_t buildRange(BuildState& state, uint32_t* refs, uint32_t count);
+	void refitAncestors(uint32_t index);
+	void collectLeaves(uint32_t index, std::vector<uint32_t>& out) const;
+
+	std::vector<Node> m_nodes;
+	uint32_t m_root = NULL_NODE;
+	uint32_t m_free_list = NULL_NODE; // linked through Node::parent
+	uint32_t m_leaf_count = 0;
+};
+
+} // namespace ve
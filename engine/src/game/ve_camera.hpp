@@ -43,6 +43,8 @@ public:
 	const glm::vec3& getForward() const { return m_forward; }
 	const glm::vec3& getRight() const { return m_right; }
 	const glm::vec3& getUp() const { return m_up; }
+	float getNearPlane() const { return m_z_near; }
+	float getFarPlane() const { return m_z_far; }
 
 private:
 	void clampPitch();
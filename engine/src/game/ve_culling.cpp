@@ -0,0 +1,180 @@
+#include "pch.hpp"
+#include "game/ve_culling.hpp"
+
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define VE_CULLING_SSE2 1
+	#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+	#define VE_CULLING_AVX2 1
+	#include <immintrin.h>
+#endif
+
+namespace ve {
+
+void VeBoxCuller::clear() {
+	m_center_x.clear(); m_center_y.clear(); m_center_z.clear();
+	m_extent_x.clear(); m_extent_y.clear(); m_extent_z.clear();
+}
+
+void VeBoxCuller::reserve(size_t count) {
+	m_center_x.reserve(count); m_center_y.reserve(count); m_center_z.reserve(count);
+	m_extent_x.reserve(count); m_extent_y.reserve(count); m_extent_z.reserve(count);
+}
+
+uint32_t VeBoxCuller::add(const VeAabb& box) {
+	const glm::vec3 center = box.getCenter();
+	const glm::vec3 extent = box.getExtent();
+	m_center_x.push_back(center.x); m_center_y.push_back(center.y); m_center_z.push_back(center.z);
+	m_extent_x.push_back(extent.x); m_extent_y.push_back(extent.y); m_extent_z.push_back(extent.z);
+	return size() - 1;
+}
+
+void VeBoxCuller::set(uint32_t index, const VeAabb& box) {
+	assert(index < size() && "Box index out of bounds");
+	const glm::vec3 center = box.getCenter();
+	const glm::vec3 extent = box.getExtent();
+	m_center_x[index] = center.x; m_center_y[index] = center.y; m_center_z[index] = center.z;
+	m_extent_x[index] = extent.x; m_extent_y[index] = extent.y; m_extent_z[index] = extent.z;
+}
+
+VeBoxCuller::Path VeBoxCuller::getBestPath() {
+#if defined(VE_CULLING_AVX2)
+	return PATH_AVX2;
+#elif defined(VE_CULLING_SSE2)
+	return PATH_SSE2;
+#else
+	return PATH_SCALAR;
+#endif
+}
+
+bool VeBoxCuller::isPathAvailable(Path path) {
+	return path <= getBestPath();
+}
+
+const char* VeBoxCuller::getPathName(Path path) {
+	switch (path) {
+		case PATH_SCALAR: return "scalar";
+		case PATH_SSE2: return "SSE2";
+		case PATH_AVX2: return "AVX2";
+	}
+	return "unknown";
+}
+
+uint32_t VeBoxCuller::cull(const VeFrustum& frustum, std::vector<uint32_t>& visible) const {
+	return cull(frustum, visible, getBestPath());
+}
+
+// visible is sized for the worst case up front so the kernels write without bounds checks
+uint32_t VeBoxCuller::cull(const VeFrustum& frustum, std::vector<uint32_t>& visible, Path path) const {
+	assert(isPathAvailable(path) && "Culling path not compiled into this build");
+	visible.resize(size());
+	uint32_t count = 0;
+	switch (path) {
+		case PATH_AVX2: count = cullAvx2(frustum, visible.data()); break;
+		case PATH_SSE2: count = cullSse2(frustum, visible.data()); break;
+		case PATH_SCALAR: count = cullScalar(frustum, 0, visible.data()); break;
+	}
+	visible.resize(count);
+	return count;
+}
+
+// Reference path and tail of the SIMD paths, the operation order matches the SIMD code
+// and VeFrustum::intersectsAabb so every path returns the same set
+uint32_t VeBoxCuller::cullScalar(const VeFrustum& frustum, uint32_t begin, uint32_t* out) const {
+	uint32_t count = 0;
+	for (uint32_t i = begin; i < size(); ++i) {
+		bool inside = true;
+		for (const auto& plane : frustum.planes) {
+			const float d = plane.x * m_center_x[i] + plane.y * m_center_y[i] + plane.z * m_center_z[i] + plane.w;
+			const float r = std::abs(plane.x) * m_extent_x[i] + std::abs(plane.y) * m_extent_y[i] + std::abs(plane.z) * m_extent_z[i];
+			inside = inside && (d + r >= 0.0f);
+		}
+		out[count] = i;
+		count += inside ? 1u : 0u;
+	}
+	return count;
+}
+
+uint32_t VeBoxCuller::cullSse2(const VeFrustum& frustum, uint32_t* out) const {
+#if defined(VE_CULLING_SSE2)
+	const uint32_t n = size();
+	const uint32_t batched = n & ~3u;
+	const __m128 zero = _mm_setzero_ps();
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < batched; i += 4) {
+		const __m128 cx = _mm_loadu_ps(&m_center_x[i]);
+		const __m128 cy = _mm_loadu_ps(&m_center_y[i]);
+		const __m128 cz = _mm_loadu_ps(&m_center_z[i]);
+		const __m128 ex = _mm_loadu_ps(&m_extent_x[i]);
+		const __m128 ey = _mm_loadu_ps(&m_extent_y[i]);
+		const __m128 ez = _mm_loadu_ps(&m_extent_z[i]);
+		__m128 inside = _mm_cmpeq_ps(zero, zero); // all lanes set
+		for (const auto& plane : frustum.planes) {
+			const __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(plane.x), cx),
+				_mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+				_mm_mul_ps(_mm_set1_ps(plane.z), cz)),
+				_mm_set1_ps(plane.w));
+			const __m128 r = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex),
+				_mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+				_mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+		}
+		// Compact the lanes that survived all planes
+		for (uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside)); mask != 0; mask &= mask - 1) {
+			out[count++] = i + static_cast<uint32_t>(std::countr_zero(mask));
+		}
+	}
+	return count + cullScalar(frustum, batched, out + count);
+#else
+	(void)frustum;
+	(void)out;
+	assert(false && "SSE2 culling not compiled in");
+	return 0;
+#endif
+}
+
+uint32_t VeBoxCuller::cullAvx2(const VeFrustum& frustum, uint32_t* out) const {
+#if defined(VE_CULLING_AVX2)
+	const uint32_t n = size();
+	const uint32_t batched = n & ~7u;
+	const __m256 zero = _mm256_setzero_ps();
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < batched; i += 8) {
+		const __m256 cx = _mm256_loadu_ps(&m_center_x[i]);
+		const __m256 cy = _mm256_loadu_ps(&m_center_y[i]);
+		const __m256 cz = _mm256_loadu_ps(&m_center_z[i]);
+		const __m256 ex = _mm256_loadu_ps(&m_extent_x[i]);
+		const __m256 ey = _mm256_loadu_ps(&m_extent_y[i]);
+		const __m256 ez = _mm256_loadu_ps(&m_extent_z[i]);
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const auto& plane : frustum.planes) {
+			const __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(_mm256_set1_ps(plane.x), cx),
+				_mm256_mul_ps(_mm256_set1_ps(plane.y), cy)),
+				_mm256_mul_ps(_mm256_set1_ps(plane.z), cz)),
+				_mm256_set1_ps(plane.w));
+			const __m256 r = _mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), ex),
+				_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), ey)),
+				_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), ez));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+		}
+		for (uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside)); mask != 0; mask &= mask - 1) {
+			out[count++] = i + static_cast<uint32_t>(std::countr_zero(mask));
+		}
+	}
+	return count + cullScalar(frustum, batched, out + count);
+#else
+	(void)frustum;
+	(void)out;
+	assert(false && "AVX2 culling not compiled in");
+	return 0;
+#endif
+}
+
+} // namespace ve
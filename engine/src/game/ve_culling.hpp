@@ -0,0 +1,52 @@
+/* VeBoxCuller tests many world space boxes against a frustum in one batch. Boxes are
+stored as structure of arrays (center and half extent per axis), so a SIMD register
+holds the same component of 4 (SSE2) or 8 (AVX2) boxes and each plane is tested
+with a few multiply-adds per batch. The AVX2 path is compiled in with VE_ENABLE_AVX2,
+SSE2 is used on other x86-64 builds and a scalar loop everywhere else (e.g. arm64). */
+#pragma once
+#include "ve_export.hpp"
+#include "game/ve_bounds.hpp"
+#include "game/ve_frustum.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace ve {
+
+class VENGINE_API VeBoxCuller {
+public:
+	enum Path : uint32_t {
+		PATH_SCALAR = 0,
+		PATH_SSE2 = 1,
+		PATH_AVX2 = 2
+	};
+
+	VeBoxCuller() = default;
+
+	void clear();
+	void reserve(size_t count);
+	// Returns the index of the box, indices are dense and stable until clear()
+	uint32_t add(const VeAabb& box);
+	void set(uint32_t index, const VeAabb& box);
+	uint32_t size() const { return static_cast<uint32_t>(m_center_x.size()); }
+
+	// Writes the indices of the boxes that intersect the frustum into visible, in
+	// ascending order, and returns their count. Uses the widest available path.
+	uint32_t cull(const VeFrustum& frustum, std::vector<uint32_t>& visible) const;
+	// Same with a given path, which must be available in this build
+	uint32_t cull(const VeFrustum& frustum, std::vector<uint32_t>& visible, Path path) const;
+
+	static Path getBestPath();
+	static bool isPathAvailable(Path path);
+	static const char* getPathName(Path path);
+
+private:
+	uint32_t cullScalar(const VeFrustum& frustum, uint32_t begin, uint32_t* out) const;
+	uint32_t cullSse2(const VeFrustum& frustum, uint32_t* out) const;
+	uint32_t cullAvx2(const VeFrustum& frustum, uint32_t* out) const;
+
+	std::vector<float> m_center_x, m_center_y, m_center_z;
+	std::vector<float> m_extent_x, m_extent_y, m_extent_z;
+};
+
+} // namespace ve
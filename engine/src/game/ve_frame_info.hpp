@@ -13,18 +13,26 @@ for each frame in the rendering process. */
 
 namespace ve {
 
+class VeFrameRing;
+class VeRenderQueue;
+
+// Element of the light storage buffer, see LightClusterSystem
 struct PointLight {
-	glm::vec4 position;
+	glm::vec4 position; // w is the range, beyond it the light is not shaded
 	glm::vec4 color; // w indicates light intensity
 };
 
+// Lets fragment shaders find their light cluster, written by LightClusterSystem::record
+struct LightClusterInfo {
+	glm::vec4 scale{0.0f}; // xy clusters per pixel, z and w map log(view depth) to a slice
+	glm::uvec4 grid{0u};   // cluster counts xyz, w light index slots per cluster
+};
+
 struct UniformBufferObject {
 	glm::mat4 view;
 	glm::mat4 proj;
 	glm::vec4 ambient_light_color = DEFAULT_AMBIENT_LIGHT_COLOR;
-	PointLight point_lights[ve::MAX_LIGHTS];
-	alignas(16) uint32_t num_lights = 0;
-	// reminder: alignment
+	LightClusterInfo light_clusters{};
 };
 
 struct VeFrameInfo {
@@ -33,10 +41,16 @@ struct VeFrameInfo {
 	vk::raii::DescriptorSet& cubemap_descriptor_set;
 	vk::raii::CommandBuffer& command_buffer;
 	vk::raii::CommandBuffer& compute_command_buffer;
+	VeFrameRing& frame_ring; // transient per-frame GPU memory
+	VeRenderQueue& render_queue; // draws of all render systems, recorded sorted by state
 	std::unordered_map<uint32_t, VeGameObject>& game_objects;
 	float frame_time;
 	float total_time;
 	uint32_t current_frame;
+	uint32_t global_ubo_offset = 0; // dynamic offset of this frame's ubo in frame_ring
+	vk::DescriptorSet light_descriptor_set{}; // lights and cluster lists of this frame
+	vk::DescriptorSet texture_descriptor_set{}; // all textures of VeTextureRegistry
+	vk::SampleCountFlagBits sample_count = vk::SampleCountFlagBits::e1; // of the scene attachments, selects the pipelines
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "pch.hpp"
+#include "game/ve_frustum.hpp"
+
+namespace ve {
+
+// Gribb/Hartmann plane extraction. GLM is column major, m[c][r], so row r of the
+// matrix is (m[0][r], m[1][r], m[2][r], m[3][r]). With depth in [0, 1] the near
+// plane is row 2 alone instead of row 3 + row 2.
+VeFrustum VeFrustum::fromViewProj(const glm::mat4& m) {
+	auto row = [&m](int r) { return glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]); };
+	const glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+	VeFrustum frustum;
+	frustum.planes[PLANE_LEFT] = r3 + r0;
+	frustum.planes[PLANE_RIGHT] = r3 - r0;
+	frustum.planes[PLANE_BOTTOM] = r3 + r1;
+	frustum.planes[PLANE_TOP] = r3 - r1;
+	frustum.planes[PLANE_NEAR] = r2;
+	frustum.planes[PLANE_FAR] = r3 - r2;
+	for (auto& plane : frustum.planes) {
+		const float length = glm::length(glm::vec3(plane));
+		assert(length > 0.0f && "Degenerate frustum plane");
+		plane /= length;
+	}
+	return frustum;
+}
+
+bool VeFrustum::intersectsSphere(const glm::vec3& center, float radius) const {
+	for (const auto& plane : planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+// Signed distance of the center against the projected radius of the box on the plane normal
+bool VeFrustum::intersectsAabb(const VeAabb& box) const {
+	const glm::vec3 center = box.getCenter();
+	const glm::vec3 extent = box.getExtent();
+	for (const auto& plane : planes) {
+		const float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		const float r = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+		if (d + r < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+glm::vec4 transformSphere(const glm::mat4& transform, const glm::vec4& sphere) {
+	const glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+	const float scale = std::max({
+		glm::length(glm::vec3(transform[0])),
+		glm::length(glm::vec3(transform[1])),
+		glm::length(glm::vec3(transform[2]))
+	});
+	return glm::vec4(center, sphere.w * scale);
+}
+
+VeAabb transformAabb(const glm::mat4& transform, const VeAabb& box) {
+	const glm::vec3 center = glm::vec3(transform * glm::vec4(box.getCenter(), 1.0f));
+	const glm::vec3 extent = box.getExtent();
+	const glm::mat3 abs_basis{glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2]))};
+	return VeAabb::fromCenterExtent(center, abs_basis * extent);
+}
+
+void cullSpheres(const VeFrustum& frustum, std::span<const glm::vec4> spheres, std::vector<uint32_t>& visible) {
+	visible.clear();
+	for (size_t i = 0; i < spheres.size(); ++i) {
+		if (frustum.intersectsSphere(glm::vec3(spheres[i]), spheres[i].w))
+			visible.push_back(static_cast<uint32_t>(i));
+	}
+}
+
+} // namespace ve
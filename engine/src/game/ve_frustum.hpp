@@ -0,0 +1,44 @@
+/* VeFrustum holds the six planes of a view frustum in world space, extracted from
+a combined projection * view matrix. Plane normals point into the frustum and are
+normalised, so the plane equation gives signed distances. The same test runs on
+the GPU in cull_kernel.slang, cullSpheres is the CPU reference for it. */
+#pragma once
+#include "ve_export.hpp"
+#include "game/ve_bounds.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace ve {
+
+struct VENGINE_API VeFrustum {
+	// Prefixed, windows.h defines NEAR and FAR
+	enum Plane : uint32_t { PLANE_LEFT = 0, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+	std::array<glm::vec4, PLANE_COUNT> planes{}; // xyz inward normal, w distance
+
+	// Expects a projection with depth in [0, 1] such as VeCamera's
+	static VeFrustum fromViewProj(const glm::mat4& view_proj);
+
+	// True when the sphere is at least partly inside, conservative near the corners
+	bool intersectsSphere(const glm::vec3& center, float radius) const;
+	// True when the box is at least partly inside, same test as VeBoxCuller
+	bool intersectsAabb(const VeAabb& box) const;
+};
+
+// Transforms a local bounding sphere (xyz center, w radius) to world space.
+// The radius is scaled by the largest axis scale so the result stays conservative.
+VENGINE_API glm::vec4 transformSphere(const glm::mat4& transform, const glm::vec4& sphere);
+
+// Transforms a local box to the world space box around it (Arvo's method)
+VENGINE_API VeAabb transformAabb(const glm::mat4& transform, const VeAabb& box);
+
+// Writes the indices of the spheres that intersect the frustum into visible, in ascending order
+VENGINE_API void cullSpheres(const VeFrustum& frustum, std::span<const glm::vec4> spheres, std::vector<uint32_t>& visible);
+
+} // namespace ve
@@ -73,7 +73,6 @@ VeGameObject VeGameObject::createPointLight(float intensity, float radius, glm::
 	game_object.point_light_component = std::make_unique<PointLightComponent>();
 	game_object.point_light_component->intensity = intensity;
 	game_object.color = color;
-	game_object.has_texture = 0.0f;
 	game_object.transform.scale = glm::vec3(radius); // uniform scale for point light quad size
 	return game_object;
 }
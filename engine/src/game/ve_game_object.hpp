@@ -2,6 +2,7 @@
 The user manually sets the object's properties (position, rotation, scale, etc.) after creation. */
 #pragma once
 #include "ve_export.hpp"
+#include "ve_config.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <memory>
@@ -37,7 +38,7 @@ public:
 
 	TransformComponent transform{};
 	glm::vec3 color{1.0f};
-	float has_texture{0.0f};
+	uint32_t texture_index{NO_TEXTURE}; // index into VeTextureRegistry, lit with color without one
 
 	// optional components can be nullptr
 	std::shared_ptr<VeModel> ve_model;
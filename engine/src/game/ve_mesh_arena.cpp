@@ -0,0 +1,139 @@
+#include "pch.hpp"
+#include "game/ve_mesh_arena.hpp"
+#include "core/ve_uploader.hpp"
+#include "core/ve_retirement_queue.hpp"
+
+namespace ve {
+
+namespace {
+	// Frees its range when the retirement queue destroys it, moved-from ranges do not
+	class RetiredMeshRange {
+	public:
+		RetiredMeshRange(std::shared_ptr<VeMeshArena*> arena, const VeMeshRange& range) : m_arena(std::move(arena)), m_range(range) {}
+		RetiredMeshRange(RetiredMeshRange&&) = default;
+		~RetiredMeshRange() {
+			if (m_arena && *m_arena)
+				(*m_arena)->free(m_range);
+		}
+	private:
+		std::shared_ptr<VeMeshArena*> m_arena;
+		VeMeshRange m_range;
+	};
+}
+
+VeMeshArena::VeMeshArena(VeDevice& device, vk::DeviceSize vertex_stride, uint32_t page_vertex_capacity, uint32_t page_index_capacity)
+	: m_ve_device(device),
+	  m_vertex_stride(vertex_stride),
+	  m_page_vertex_capacity(page_vertex_capacity),
+	  m_page_index_capacity(page_index_capacity) {
+	assert(vertex_stride > 0 && "Vertex stride must be greater than zero");
+	assert(page_vertex_capacity > 0 && page_index_capacity > 0 && "Page capacities must be greater than zero");
+	// Pages are created lazily by the first allocation
+}
+
+VeMeshArena::~VeMeshArena() {
+	*m_self = nullptr;
+}
+
+void VeMeshArena::createPage(uint32_t vertex_capacity, uint32_t index_capacity) {
+	// Storage usage so compute passes can read the geometry later on
+	auto vertex_buffer = std::make_unique<VeBuffer>(
+		m_ve_device,
+		m_vertex_stride,
+		vertex_capacity,
+		vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		1);
+	auto index_buffer = std::make_unique<VeBuffer>(
+		m_ve_device,
+		sizeof(uint32_t),
+		index_capacity,
+		vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		1);
+	m_pages.push_back(Page{
+		.vertex_buffer = std::move(vertex_buffer),
+		.index_buffer = std::move(index_buffer),
+		.vertex_ranges = VeFreeList{vertex_capacity},
+		.index_ranges = VeFreeList{index_capacity}
+	});
+	VE_LOGD("VeMeshArena: created page " << m_pages.size() - 1 << " with " << vertex_capacity
+		<< " vertices and " << index_capacity << " indices");
+}
+
+VeMeshRange VeMeshArena::allocate(const void* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count) {
+	assert(vertices != nullptr && vertex_count > 0 && "Mesh must have vertices");
+	assert((index_count == 0 || indices != nullptr) && "Index data missing");
+
+	VeMeshRange range{ .vertex_count = vertex_count, .index_count = index_count };
+	bool placed = false;
+	for (uint32_t page = 0; page < m_pages.size() && !placed; ++page) {
+		Page& p = m_pages[page];
+		auto first_vertex = p.vertex_ranges.allocate(vertex_count, 1);
+		if (!first_vertex) continue;
+		std::optional<vk::DeviceSize> first_index = vk::DeviceSize{0};
+		if (index_count > 0) {
+			first_index = p.index_ranges.allocate(index_count, 1);
+			if (!first_index) {
+				p.vertex_ranges.free(*first_vertex, vertex_count);
+				continue;
+			}
+		}
+		range.page = page;
+		range.first_vertex = static_cast<uint32_t>(*first_vertex);
+		range.first_index = static_cast<uint32_t>(*first_index);
+		placed = true;
+	}
+	if (!placed) {
+		// Meshes bigger than a default page get a page of their own size
+		createPage(std::max(vertex_count, m_page_vertex_capacity), std::max(index_count, m_page_index_capacity));
+		Page& p = m_pages.back();
+		range.page = static_cast<uint32_t>(m_pages.size() - 1);
+		range.first_vertex = static_cast<uint32_t>(p.vertex_ranges.allocate(vertex_count, 1).value());
+		range.first_index = index_count > 0 ? static_cast<uint32_t>(p.index_ranges.allocate(index_count, 1).value()) : 0;
+	}
+
+	VeUploader& uploader = m_ve_device.getUploader();
+	const Page& p = m_pages[range.page];
+	uploader.uploadBuffer(
+		*p.vertex_buffer->getBuffer(),
+		vertices,
+		m_vertex_stride * vertex_count,
+		m_vertex_stride * range.first_vertex);
+	if (index_count > 0) {
+		uploader.uploadBuffer(
+			*p.index_buffer->getBuffer(),
+			indices,
+			sizeof(uint32_t) * index_count,
+			sizeof(uint32_t) * range.first_index);
+	}
+	m_used_vertices += vertex_count;
+	m_used_indices += index_count;
+	return range;
+}
+
+void VeMeshArena::free(const VeMeshRange& range) {
+	assert(range.page < m_pages.size() && "Mesh range page out of bounds");
+	Page& p = m_pages[range.page];
+	p.vertex_ranges.free(range.first_vertex, range.vertex_count);
+	if (range.index_count > 0) {
+		p.index_ranges.free(range.first_index, range.index_count);
+	}
+	m_used_vertices -= range.vertex_count;
+	m_used_indices -= range.index_count;
+}
+
+void VeMeshArena::retire(const VeMeshRange& range) {
+	m_ve_device.getRetirementQueue().retire(RetiredMeshRange(m_self, range));
+}
+
+void VeMeshArena::bind(vk::CommandBuffer command_buffer, uint32_t page) const {
+	assert(page < m_pages.size() && "Mesh arena page out of bounds");
+	const Page& p = m_pages[page];
+	vk::Buffer buffers[] = { *p.vertex_buffer->getBuffer() };
+	vk::DeviceSize offsets[] = { 0 };
+	command_buffer.bindVertexBuffers(0, buffers, offsets);
+	command_buffer.bindIndexBuffer(*p.index_buffer->getBuffer(), 0, vk::IndexType::eUint32);
+}
+
+} // namespace ve
@@ -0,0 +1,80 @@
+/* VeMeshArena sub-allocates the vertices and indices of every model from a few
+large device-local buffers. Each page holds one vertex buffer and one index buffer
+with a free list per buffer, a model only stores its range inside a page. Draws
+of models in the same page share one vertex and index buffer binding and use
+firstIndex/vertexOffset to select their geometry. A new page is created when no
+existing page has room, so with default sizes a scene normally fits in one page. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+#include "core/ve_device.hpp"
+#include "core/ve_buffer.hpp"
+#include "core/ve_allocator.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace ve {
+
+// Location of one mesh inside the arena, counts are in vertices and indices, not bytes
+struct VeMeshRange {
+	uint32_t page = 0;
+	uint32_t first_vertex = 0; // vertexOffset for indexed draws, firstVertex otherwise
+	uint32_t vertex_count = 0;
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+};
+
+class VENGINE_API VeMeshArena {
+public:
+	VeMeshArena(
+		VeDevice& device,
+		vk::DeviceSize vertex_stride,
+		uint32_t page_vertex_capacity = MESH_ARENA_PAGE_VERTICES,
+		uint32_t page_index_capacity = MESH_ARENA_PAGE_INDICES);
+	~VeMeshArena();
+
+	VeMeshArena(const VeMeshArena&) = delete;
+	VeMeshArena& operator=(const VeMeshArena&) = delete;
+
+	// Reserves ranges for the mesh and records its upload into the device uploader.
+	// vertices points to vertex_count * vertex_stride bytes, index_count may be 0.
+	VeMeshRange allocate(const void* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count);
+	// Returns the ranges, the caller must make sure no submitted draw still reads them
+	void free(const VeMeshRange& range);
+	// Returns the ranges once the frames in flight that may draw them have finished
+	void retire(const VeMeshRange& range);
+
+	// Binds the vertex buffer at binding 0 and the index buffer of page
+	void bind(vk::CommandBuffer command_buffer, uint32_t page) const;
+
+	uint32_t getPageCount() const { return static_cast<uint32_t>(m_pages.size()); }
+	vk::Buffer getVertexBuffer(uint32_t page) const { return *m_pages[page].vertex_buffer->getBuffer(); }
+	vk::Buffer getIndexBuffer(uint32_t page) const { return *m_pages[page].index_buffer->getBuffer(); }
+	vk::DeviceSize getVertexStride() const { return m_vertex_stride; }
+	uint32_t getUsedVertexCount() const { return m_used_vertices; }
+	uint32_t getUsedIndexCount() const { return m_used_indices; }
+
+private:
+	struct Page {
+		std::unique_ptr<VeBuffer> vertex_buffer;
+		std::unique_ptr<VeBuffer> index_buffer;
+		VeFreeList vertex_ranges;
+		VeFreeList index_ranges;
+	};
+	void createPage(uint32_t vertex_capacity, uint32_t index_capacity);
+
+	VeDevice& m_ve_device;
+	vk::DeviceSize m_vertex_stride;
+	uint32_t m_page_vertex_capacity;
+	uint32_t m_page_index_capacity;
+	std::vector<Page> m_pages;
+
+	uint32_t m_used_vertices = 0;
+	uint32_t m_used_indices = 0;
+	// Shared with retired ranges and cleared by the destructor, ranges retired into an
+	// arena that no longer exists have nothing to return to
+	std::shared_ptr<VeMeshArena*> m_self = std::make_shared<VeMeshArena*>(this);
+};
+
+} // namespace ve
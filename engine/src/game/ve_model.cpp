@@ -6,16 +6,16 @@
 
 namespace ve {
 
-VeModel::VeModel(VeDevice& device, const std::vector<Vertex>& vertices) : m_ve_device(device) {
-	createVertexBuffers(vertices);
+VeModel::VeModel(VeMeshArena& arena, const std::vector<Vertex>& vertices) : m_arena(arena) {
+	createMesh(vertices, {});
 }
 
-VeModel::VeModel(VeDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) : m_ve_device(device) {
-	createVertexBuffers(vertices);
-	createIndexBuffers(indices);
+VeModel::VeModel(VeMeshArena& arena, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) : m_arena(arena) {
+	assert(indices.size() >= 3 && "Index count must be at least 3!");
+	createMesh(vertices, indices);
 }
 
-VeModel::VeModel(VeDevice& device, const std::filesystem::path& model_path) : m_ve_device(device) {
+VeModel::VeModel(VeMeshArena& arena, const std::filesystem::path& model_path) : m_arena(arena) {
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
@@ -68,94 +68,48 @@ VeModel::VeModel(VeDevice& device, const std::filesystem::path& model_path) : m_
 		}
 	}
 	VE_LOGI("Model " << model_path << " has " << vertices.size() << " vertices and " << indices.size() << " indices");
-	createVertexBuffers(vertices);
-	createIndexBuffers(indices);
+	createMesh(vertices, indices);
 }
 
-VeModel::~VeModel() {}
-
-void VeModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
-	m_vertex_count = static_cast<uint32_t>(vertices.size());
-	assert(m_vertex_count >= 3 && "Vertex count must be at least 3!");
-
-	// Create a local scope staging buffer, accessible by CPU
-	ve::VeBuffer staging_buffer(
-		m_ve_device,
-		sizeof(vertices[0]),
-		m_vertex_count,
-		vk::BufferUsageFlagBits::eTransferSrc,
-		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-	);
-
-	// Copy vertex data to staging buffer
-	staging_buffer.map();
-	staging_buffer.writeToBuffer((void*)vertices.data());
-	// unmap is called in the destructor of VeBuffer
-
-	// Create vertex buffer, accessible by GPU only
-	m_vertex_buffer = std::make_unique<ve::VeBuffer>(
-		m_ve_device,
-		sizeof(vertices[0]),
-		m_vertex_count,
-		vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-		vk::MemoryPropertyFlagBits::eDeviceLocal,
-		1
-	);
-
-	// Copy vertex data from staging buffer to vertex buffer
-	auto buffer_size = sizeof(vertices[0]) * m_vertex_count;
-	m_ve_device.copyBuffer(staging_buffer.getBuffer(), m_vertex_buffer->getBuffer(), buffer_size);
+// Frames in flight may still draw the mesh, a model created meanwhile must not reuse its ranges
+VeModel::~VeModel() {
+	m_arena.retire(m_mesh);
 }
 
-void VeModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
-	m_index_count = static_cast<uint32_t>(indices.size());
-	assert(m_index_count >= 3 && "Index count must be at least 3!");
-
-	// Create a local scope staging buffer, accessible by CPU
-	ve::VeBuffer staging_buffer(
-		m_ve_device,
-		sizeof(indices[0]),
-		m_index_count,
-		vk::BufferUsageFlagBits::eTransferSrc,
-		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-	);
-
-	// Copy index data to staging buffer
-	staging_buffer.map();
-	staging_buffer.writeToBuffer((void*)indices.data());
-	// unmap is called in the destructor of VeBuffer
-
-	// Create index buffer, accessible by GPU only
-	m_index_buffer = std::make_unique<ve::VeBuffer>(
-		m_ve_device,
-		sizeof(indices[0]),
-		m_index_count,
-		vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-		vk::MemoryPropertyFlagBits::eDeviceLocal,
-		1
-	);
-
-	// Copy index data from staging buffer to index buffer
-	auto buffer_size = sizeof(indices[0]) * m_index_count;
-	m_ve_device.copyBuffer(staging_buffer.getBuffer(), m_index_buffer->getBuffer(), buffer_size);
-}
-
-void VeModel::bindVertexBuffer(vk::raii::CommandBuffer& command_buffer) {
-	vk::Buffer buffers[] = { m_vertex_buffer->getBuffer() };
-	vk::DeviceSize offsets[] = { 0 };
-	command_buffer.bindVertexBuffers(0, buffers, offsets);
+void VeModel::createMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+	assert(vertices.size() >= 3 && "Vertex count must be at least 3!");
+	assert(m_arena.getVertexStride() == sizeof(Vertex) && "Mesh arena stride does not match VeModel::Vertex");
+	m_mesh = m_arena.allocate(
+		vertices.data(),
+		static_cast<uint32_t>(vertices.size()),
+		indices.empty() ? nullptr : indices.data(),
+		static_cast<uint32_t>(indices.size()));
+
+	m_bounding_box = VeAabb{};
+	for (const auto& vertex : vertices) {
+		m_bounding_box.grow(vertex.pos);
+	}
+	// Sphere around the center of the bounding box, not minimal but cheap and stable
+	const glm::vec3 center = m_bounding_box.getCenter();
+	float radius_sq = 0.0f;
+	for (const auto& vertex : vertices) {
+		const glm::vec3 d = vertex.pos - center;
+		radius_sq = std::max(radius_sq, glm::dot(d, d));
+	}
+	m_bounding_sphere = glm::vec4(center, std::sqrt(radius_sq));
 }
 
-void VeModel::bindIndexBuffer(vk::raii::CommandBuffer& command_buffer) {
-	command_buffer.bindIndexBuffer(m_index_buffer->getBuffer(), 0, vk::IndexType::eUint32);
+void VeModel::bind(vk::raii::CommandBuffer& command_buffer) const {
+	m_arena.bind(*command_buffer, m_mesh.page);
 }
 
-void VeModel::draw(vk::raii::CommandBuffer& command_buffer) {
-	command_buffer.draw(m_vertex_count, 1, 0, 0);
+void VeModel::draw(vk::raii::CommandBuffer& command_buffer) const {
+	command_buffer.draw(m_mesh.vertex_count, 1, m_mesh.first_vertex, 0);
 }
 
-void VeModel::drawIndexed(vk::raii::CommandBuffer& command_buffer) {
-	command_buffer.drawIndexed(m_index_count, 1, 0, 0, 0);
+void VeModel::drawIndexed(vk::raii::CommandBuffer& command_buffer) const {
+	assert(m_mesh.index_count > 0 && "Model has no indices");
+	command_buffer.drawIndexed(m_mesh.index_count, 1, m_mesh.first_index, static_cast<int32_t>(m_mesh.first_vertex), 0);
 }
 
 std::vector<vk::VertexInputBindingDescription> VeModel::Vertex::getBindingDescriptions() {
@@ -1,10 +1,11 @@
-/* VeModel is responsible for managing the vertex and index buffers
-for a model. It provides methods to bind these buffers and issue
-draw commands. */
+/* VeModel is a lightweight handle to a mesh stored in a VeMeshArena.
+It holds the mesh's range (first index, vertex offset and counts) inside
+the arena's shared vertex and index buffers and provides methods to bind
+the arena page and issue draw commands. */
 #pragma once
 #include "ve_export.hpp"
-#include "core/ve_device.hpp"
-#include "core/ve_buffer.hpp"
+#include "game/ve_mesh_arena.hpp"
+#include "game/ve_bounds.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -31,31 +32,37 @@ public:
 		}
 	};
 
-	VeModel(VeDevice& device, const std::vector<Vertex>& vertices);
-	VeModel(VeDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
-	VeModel(VeDevice& device, const std::filesystem::path& model_path);
+	VeModel(VeMeshArena& arena, const std::vector<Vertex>& vertices);
+	VeModel(VeMeshArena& arena, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	VeModel(VeMeshArena& arena, const std::filesystem::path& model_path);
 	~VeModel();
 
 	VeModel(const VeModel&) = delete;
 	VeModel& operator=(const VeModel&) = delete;
 
-	void bindVertexBuffer(vk::raii::CommandBuffer& commandBuffer);
-	void bindIndexBuffer(vk::raii::CommandBuffer& commandBuffer);
-	void draw(vk::raii::CommandBuffer& commandBuffer);
-	void drawIndexed(vk::raii::CommandBuffer& commandBuffer);
+	// Binds the vertex and index buffer of the arena page, shared by all models in that page
+	void bind(vk::raii::CommandBuffer& command_buffer) const;
+	void draw(vk::raii::CommandBuffer& command_buffer) const;
+	void drawIndexed(vk::raii::CommandBuffer& command_buffer) const;
 
-private:
-	void createVertexBuffers(const std::vector<Vertex>& vertices);
-	void createIndexBuffers(const std::vector<uint32_t>& indices);
-
-	VeDevice& m_ve_device; // not owned, must outlive model
+	const VeMeshArena& getArena() const { return m_arena; }
+	uint32_t getArenaPage() const { return m_mesh.page; }
+	uint32_t getFirstIndex() const { return m_mesh.first_index; }
+	int32_t getVertexOffset() const { return static_cast<int32_t>(m_mesh.first_vertex); }
+	uint32_t getVertexCount() const { return m_mesh.vertex_count; }
+	uint32_t getIndexCount() const { return m_mesh.index_count; }
+	// Local space bounds, computed once when the mesh is created
+	const VeAabb& getBoundingBox() const { return m_bounding_box; }
+	// xyz center and w radius
+	const glm::vec4& getBoundingSphere() const { return m_bounding_sphere; }
 
-	std::unique_ptr<ve::VeBuffer> m_vertex_buffer;
-	uint32_t m_vertex_count;
+private:
+	void createMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
 
-	// TODO: Consdider consolidating index and vertex buffer into single buffer and use offsets
-	std::unique_ptr<ve::VeBuffer> m_index_buffer;
-	uint32_t m_index_count;
+	VeMeshArena& m_arena; // not owned, must outlive model
+	VeMeshRange m_mesh;
+	VeAabb m_bounding_box;
+	glm::vec4 m_bounding_sphere{0.0f};
 };
 
 } // namespace ve
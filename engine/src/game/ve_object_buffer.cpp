@@ -0,0 +1,183 @@
+#include "pch.hpp"
+#include "game/ve_object_buffer.hpp"
+#include "game/ve_model.hpp"
+#include "core/ve_retirement_queue.hpp"
+
+#include <cstring>
+
+namespace ve {
+
+VeObjectBuffer::VeObjectBuffer(
+	VeDevice& device,
+	std::shared_ptr<VeDescriptorPool> descriptor_pool,
+	uint32_t initial_capacity)
+	: m_ve_device(device), m_descriptor_pool(std::move(descriptor_pool)),
+	  m_capacity(std::max(initial_capacity, 1u)) {
+	m_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
+		.addBinding(0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eCompute)
+		.build();
+	createBuffer();
+}
+
+VeObjectBuffer::~VeObjectBuffer() {}
+
+// Create or recreate the storage buffer and its descriptor set for the current capacity
+void VeObjectBuffer::createBuffer() {
+	// Frames in flight may still read the old buffer
+	if (m_buffer) {
+		VeRetirementQueue& retirement = m_ve_device.getRetirementQueue();
+		retirement.retire(std::move(m_buffer));
+		retirement.retire(std::move(m_descriptor_set), m_descriptor_pool);
+	}
+	m_buffer = std::make_unique<VeBuffer>(
+		m_ve_device,
+		sizeof(GpuObjectData),
+		m_capacity,
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal);
+	auto buffer_info = m_buffer->getDescriptorInfo();
+	m_descriptor_set = vk::raii::DescriptorSet{nullptr};
+	VeDescriptorWriter(*m_set_layout, *m_descriptor_pool)
+		.writeBuffer(0, &buffer_info)
+		.build(m_descriptor_set);
+}
+
+// Grows the buffer to at least double the old size, the old one is retired. The new
+// buffer starts empty, sync stages every slot below getSlotCount again.
+void VeObjectBuffer::ensureCapacity(uint32_t slot_count) {
+	if (slot_count <= m_capacity) return;
+	m_capacity = std::max(slot_count, m_capacity * 2);
+	VE_LOGI("VeObjectBuffer: growing to " << m_capacity << " objects");
+	createBuffer();
+}
+
+void VeObjectBuffer::sync(const std::unordered_map<uint32_t, VeGameObject>& game_objects, VeFrameRing& frame_ring) {
+	assert(m_copies.empty() && "Staged copies of the last sync were not recorded");
+	const uint32_t epoch = ++m_epoch;
+	auto sameTransform = [](const TransformComponent& a, const TransformComponent& b) {
+		return a.translation == b.translation && a.rotation == b.rotation && a.scale == b.scale;
+	};
+	m_objects.clear();
+	m_dirty.clear();
+	m_cleared.clear();
+	for (const auto& [id, obj] : game_objects) {
+		if (!obj.ve_model)
+			continue;
+		auto [it, is_new] = m_slot_ids.try_emplace(id);
+		if (is_new) {
+			if (m_free_slots.empty()) {
+				it->second = static_cast<uint32_t>(m_slots.size());
+				m_slots.emplace_back();
+			} else {
+				it->second = m_free_slots.back();
+				m_free_slots.pop_back();
+			}
+		}
+		const uint32_t slot = it->second;
+		Slot& data = m_slots[slot];
+		data.epoch = epoch;
+		m_objects.push_back({ &obj, slot });
+		if (!is_new && data.model == obj.ve_model.get() && data.texture_index == obj.texture_index &&
+			sameTransform(data.transform, obj.transform))
+			continue;
+		data.transform = obj.transform;
+		data.texture_index = obj.texture_index;
+		data.model = obj.ve_model.get();
+		data.matrix = obj.getTransform();
+		m_dirty.push_back(static_cast<uint32_t>(m_objects.size() - 1));
+	}
+	std::erase_if(m_slot_ids, [&](const auto& item) {
+		if (m_slots[item.second].epoch == epoch)
+			return false;
+		m_slots[item.second] = Slot{};
+		m_free_slots.push_back(item.second);
+		m_cleared.push_back(item.second);
+		return true;
+	});
+
+	if (m_slots.size() > m_capacity) {
+		ensureCapacity(static_cast<uint32_t>(m_slots.size()));
+		m_dirty.clear();
+		for (uint32_t i = 0; i < m_objects.size(); ++i)
+			m_dirty.push_back(i);
+		m_cleared.assign(m_free_slots.begin(), m_free_slots.end());
+	}
+	if (!m_dirty.empty() || !m_cleared.empty())
+		stage(frame_ring);
+}
+
+// Dirty objects and then cleared slots are written contiguously into the ring, each
+// in slot order, runs of consecutive slots become a single copy region
+void VeObjectBuffer::stage(VeFrameRing& frame_ring) {
+	std::sort(m_dirty.begin(), m_dirty.end(), [&](uint32_t a, uint32_t b) {
+		return m_objects[a].slot < m_objects[b].slot;
+	});
+	std::sort(m_cleared.begin(), m_cleared.end());
+	const VeRingAllocation staging = frame_ring.allocate(sizeof(GpuObjectData) * (m_dirty.size() + m_cleared.size()), 16);
+	m_staging_buffer = frame_ring.getBuffer();
+	auto* staged = static_cast<GpuObjectData*>(staging.data);
+	for (size_t i = 0; i < m_dirty.size(); ++i) {
+		const auto [obj, slot] = m_objects[m_dirty[i]];
+		const Slot& data = m_slots[slot];
+		const VeModel& model = *data.model;
+		const glm::mat3 nrm = obj->getNormalTransform();
+		// Exact as a float up to 2^24 textures
+		const float texture_index = data.texture_index == NO_TEXTURE ? -1.0f : static_cast<float>(data.texture_index);
+		GpuObjectData object{};
+		for (int column = 0; column < 4; ++column)
+			object.transform[column] = data.matrix[column];
+		object.normal_transform[0] = glm::vec4(nrm[0], texture_index);
+		object.normal_transform[1] = glm::vec4(nrm[1], 0.0f);
+		object.normal_transform[2] = glm::vec4(nrm[2], 0.0f);
+		object.bounding_sphere = model.getBoundingSphere();
+		object.index_count = model.getIndexCount();
+		object.first_index = model.getFirstIndex();
+		object.vertex_offset = model.getVertexOffset();
+		object.page = model.getArenaPage();
+		stageSlot(staged, staging.offset, i, slot, object);
+	}
+	for (size_t i = 0; i < m_cleared.size(); ++i) {
+		stageSlot(staged, staging.offset, m_dirty.size() + i, m_cleared[i], GpuObjectData{});
+	}
+}
+
+// Writes object at index of the staging allocation and extends or adds its copy region
+void VeObjectBuffer::stageSlot(
+	GpuObjectData* staged, vk::DeviceSize staging_offset, size_t index, uint32_t slot, const GpuObjectData& object) {
+	memcpy(&staged[index], &object, sizeof(GpuObjectData));
+	const vk::DeviceSize src_offset = staging_offset + sizeof(GpuObjectData) * index;
+	const vk::DeviceSize dst_offset = sizeof(GpuObjectData) * slot;
+	if (!m_copies.empty() && m_copies.back().dstOffset + m_copies.back().size == dst_offset &&
+		m_copies.back().srcOffset + m_copies.back().size == src_offset) {
+		m_copies.back().size += sizeof(GpuObjectData);
+	} else {
+		m_copies.push_back(vk::BufferCopy{
+			.srcOffset = src_offset,
+			.dstOffset = dst_offset,
+			.size = sizeof(GpuObjectData)
+		});
+	}
+}
+
+void VeObjectBuffer::record(vk::CommandBuffer command_buffer) {
+	if (m_copies.empty()) return;
+	// Earlier frames on this queue may still read the slots being overwritten
+	vk::MemoryBarrier2 before{
+		.srcStageMask = vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eComputeShader,
+		.srcAccessMask = vk::AccessFlagBits2::eNone,
+		.dstStageMask = vk::PipelineStageFlagBits2::eCopy,
+		.dstAccessMask = vk::AccessFlagBits2::eTransferWrite
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &before });
+	command_buffer.copyBuffer(m_staging_buffer, *m_buffer->getBuffer(), m_copies);
+	vk::MemoryBarrier2 after{
+		.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+		.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eComputeShader,
+		.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &after });
+	m_copies.clear();
+}
+
+} // namespace ve
@@ -0,0 +1,118 @@
+/* VeObjectBuffer keeps the per-object data of every game object with a model in one
+persistent device-local storage buffer. Each object owns a slot for as long as it
+exists. sync compares the objects against the transforms their slots were written
+from and stages only the slots that changed in the frame ring, record copies them
+into the storage buffer before the frame's draws. Static objects cost one compare
+per frame and no trig, no upload. The world matrices are cached on the CPU as well,
+so culling reads them instead of composing them again. Each slot also holds the
+model space bounding sphere and the draw arguments of its model, so the cull kernel
+reads everything it needs from the buffer and the CPU does no per-object work for it.
+Freed slots are written with an index count of 0. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+#include "core/ve_device.hpp"
+#include "core/ve_buffer.hpp"
+#include "core/ve_descriptors.hpp"
+#include "core/ve_frame_ring.hpp"
+#include "game/ve_game_object.hpp"
+
+#include <memory>
+#include <vector>
+#include <span>
+#include <unordered_map>
+
+namespace ve {
+
+// Element of the object storage buffer, layout must match ObjectData in simple_shader.slang
+// and cull_kernel.slang
+struct GpuObjectData {
+	glm::vec4 transform[4];        // columns of the model matrix
+	glm::vec4 normal_transform[3]; // columns of the normal matrix, [0].w holds the texture index or -1
+	glm::vec4 bounding_sphere;     // model space center xyz, radius w
+	uint32_t index_count;          // 0 for free slots and models without indices, the kernel skips those
+	uint32_t first_index;
+	int32_t vertex_offset;
+	uint32_t page;                 // mesh arena page of the model
+};
+static_assert(sizeof(GpuObjectData) == 144, "GpuObjectData layout must match simple_shader.slang");
+
+class VENGINE_API VeObjectBuffer {
+public:
+	// An object with a model and the slot of its data
+	struct Object {
+		const VeGameObject* object;
+		uint32_t slot;
+	};
+
+	VeObjectBuffer(
+		VeDevice& device,
+		std::shared_ptr<VeDescriptorPool> descriptor_pool,
+		uint32_t initial_capacity = 1024);
+	~VeObjectBuffer();
+
+	VeObjectBuffer(const VeObjectBuffer&) = delete;
+	VeObjectBuffer& operator=(const VeObjectBuffer&) = delete;
+
+	// New objects get a slot, removed ones free theirs and the data of new and changed
+	// objects is staged in the current frame region of frame_ring. The objects must not
+	// move in memory until the next sync, getObjects points at them.
+	void sync(const std::unordered_map<uint32_t, VeGameObject>& game_objects, VeFrameRing& frame_ring);
+	// Records the copies of the staged slots, outside of rendering. The barriers order
+	// them after the vertex and compute shader reads of earlier frames and before those
+	// of this one.
+	void record(vk::CommandBuffer command_buffer);
+
+	// Objects of the last sync in the iteration order of game_objects
+	std::span<const Object> getObjects() const { return m_objects; }
+	// Slot of an object seen by the last sync, stable for the lifetime of the object
+	uint32_t getSlot(uint32_t object_id) const { return m_slot_ids.at(object_id); }
+	// World matrix the slot was last written with
+	const glm::mat4& getTransform(uint32_t slot) const { return m_slots[slot].matrix; }
+
+	// Slots in use or freed, the cull kernel visits [0, getSlotCount())
+	uint32_t getSlotCount() const { return static_cast<uint32_t>(m_slots.size()); }
+
+	// Storage buffer at binding 0, read by the vertex shader and the cull kernel
+	const vk::raii::DescriptorSetLayout& getSetLayout() const { return m_set_layout->getDescriptorSetLayout(); }
+	vk::DescriptorSet getDescriptorSet() const { return *m_descriptor_set; }
+	uint32_t getCapacity() const { return m_capacity; }
+	// New and changed objects staged by the last sync, cleared free slots not included
+	uint32_t getUploadCount() const { return static_cast<uint32_t>(m_dirty.size()); }
+
+private:
+	struct Slot {
+		TransformComponent transform; // what the slot was written from
+		uint32_t texture_index = NO_TEXTURE;
+		const VeModel* model = nullptr;
+		glm::mat4 matrix{1.0f};
+		uint32_t epoch = 0;           // last sync that saw the object, 0 when free
+	};
+
+	void createBuffer();
+	void ensureCapacity(uint32_t slot_count);
+	void stage(VeFrameRing& frame_ring);
+	void stageSlot(GpuObjectData* staged, vk::DeviceSize staging_offset, size_t index, uint32_t slot, const GpuObjectData& object);
+
+	VeDevice& m_ve_device;
+	std::shared_ptr<VeDescriptorPool> m_descriptor_pool;
+	uint32_t m_capacity;
+
+	std::unique_ptr<VeDescriptorSetLayout> m_set_layout;
+	std::unique_ptr<VeBuffer> m_buffer;
+	vk::raii::DescriptorSet m_descriptor_set{nullptr};
+
+	std::unordered_map<uint32_t, uint32_t> m_slot_ids; // object id to slot
+	std::vector<Slot> m_slots;
+	std::vector<uint32_t> m_free_slots;
+	uint32_t m_epoch = 0;
+
+	// Reused every frame to avoid per-frame allocations
+	std::vector<Object> m_objects;
+	std::vector<uint32_t> m_dirty; // indices into m_objects of the slots to stage
+	std::vector<uint32_t> m_cleared; // free slots to stage with an index count of 0
+	std::vector<vk::BufferCopy> m_copies; // staged slots, recorded by the next record
+	vk::Buffer m_staging_buffer{};
+};
+
+} // namespace ve
@@ -120,6 +120,9 @@ namespace ve {
 		int cur_m5 = glfwGetKey(m_window, m_key_mappings.mode5);
 		if (cur_m5 == GLFW_PRESS && m_prev_mode5 == GLFW_RELEASE) actions.set_mode = 5;
 		m_prev_mode5 = cur_m5;
+		int cur_m6 = glfwGetKey(m_window, m_key_mappings.mode6);
+		if (cur_m6 == GLFW_PRESS && m_prev_mode6 == GLFW_RELEASE) actions.set_mode = 6;
+		m_prev_mode6 = cur_m6;
 
 		return actions;
 	}
@@ -42,6 +42,7 @@ public:
 		int mode3 = GLFW_KEY_3;
 		int mode4 = GLFW_KEY_4;
 		int mode5 = GLFW_KEY_5;
+		int mode6 = GLFW_KEY_6;
 	};
 
 	InputController(VeWindow& window);
@@ -80,6 +81,7 @@ private:
 	int m_prev_mode3 = GLFW_RELEASE;
 	int m_prev_mode4 = GLFW_RELEASE;
 	int m_prev_mode5 = GLFW_RELEASE;
+	int m_prev_mode6 = GLFW_RELEASE;
 };
 
 } // ve
\ No newline at end of file
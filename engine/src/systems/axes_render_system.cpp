@@ -2,6 +2,7 @@
 #include "systems/axes_render_system.hpp"
 #include "core/ve_device.hpp"
 #include "core/ve_pipeline.hpp"
+#include "core/ve_render_queue.hpp"
 #include "game/ve_model.hpp"
 #include "utils/ve_log.hpp"
 #include "glm/gtc/constants.hpp"
@@ -10,13 +11,14 @@ namespace ve {
 
 AxesRenderSystem::AxesRenderSystem(
 	VeDevice& device,
+	VeMeshArena& mesh_arena,
 	const vk::raii::DescriptorSetLayout& global_set_layout,
 	vk::Format color_format,
 	std::filesystem::path shader_path)
 	: m_ve_device(device), m_shader_path(shader_path) {
 	createPipelineLayout(global_set_layout);
 	createPipeline(color_format);
-	createAxesModel();
+	createAxesModel(mesh_arena);
 }
 
 AxesRenderSystem::~AxesRenderSystem() {}
@@ -50,7 +52,7 @@ void AxesRenderSystem::createPipeline(vk::Format color_format) {
 	assert(m_ve_pipeline && "Failed to create axes pipeline");
 }
 
-void AxesRenderSystem::createAxesModel() {
+void AxesRenderSystem::createAxesModel(VeMeshArena& mesh_arena) {
 	// 3 axes as cylinders from origin to +L along each axis, colored RGB
 	std::vector<VeModel::Vertex> vertices;
 	constexpr int SEGMENTS = 2400;           // circle segments per cylinder
@@ -116,21 +118,24 @@ void AxesRenderSystem::createAxesModel() {
 			push_tri(v2, v3, v0, col);
 		}
 	}
-	m_axes_model = std::make_unique<VeModel>(m_ve_device, vertices);
+	m_axes_model = std::make_unique<VeModel>(mesh_arena, vertices);
 }
 
-// Performs one draw call for the coordinate axes model
+// Submits one draw for the coordinate axes model at the origin
 void AxesRenderSystem::render(VeFrameInfo& frame_info) const {
-	frame_info.command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_ve_pipeline->getPipeline());
-	frame_info.command_buffer.bindDescriptorSets(
-		vk::PipelineBindPoint::eGraphics,
-		*m_pipeline_layout,
-		0,
-		{frame_info.global_descriptor_set},
-		{}
-	);
-	m_axes_model->bindVertexBuffer(frame_info.command_buffer);
-	m_axes_model->draw(frame_info.command_buffer);
+	const VeMeshArena& arena = m_axes_model->getArena();
+	frame_info.render_queue.submit(VeRenderQueue::PASS_OPAQUE, frame_info.render_queue.getViewDepth(glm::vec3(0.0f)), VeDrawPacket{
+		.type = VeDrawPacket::DRAW,
+		.pipeline = m_ve_pipeline->getPipeline(frame_info.sample_count),
+		.pipeline_layout = *m_pipeline_layout,
+		.descriptor_sets = {*frame_info.global_descriptor_set},
+		.descriptor_set_count = 1,
+		.dynamic_offset = frame_info.global_ubo_offset,
+		.vertex_buffers = {arena.getVertexBuffer(m_axes_model->getArenaPage())},
+		.vertex_buffer_count = 1,
+		.count = m_axes_model->getVertexCount(),
+		.first = static_cast<uint32_t>(m_axes_model->getVertexOffset())
+	});
 }
 
 }
@@ -12,6 +12,7 @@ namespace ve {
     class VeDevice;
     class VePipeline;
     class VeModel;
+    class VeMeshArena;
 }
 
 namespace ve {
@@ -21,6 +22,7 @@ public:
 
 AxesRenderSystem( 
 		VeDevice& device,
+		VeMeshArena& mesh_arena,
 		const vk::raii::DescriptorSetLayout& descriptor_set_layout,
 		vk::Format color_format,
 		std::filesystem::path shader_path);
@@ -34,7 +36,7 @@ AxesRenderSystem(
 private:
 	void createPipelineLayout(const vk::raii::DescriptorSetLayout& descriptor_set_layout);
 	void createPipeline(vk::Format color_format);
-	void createAxesModel();
+	void createAxesModel(VeMeshArena& mesh_arena);
 
 	VeDevice& m_ve_device;
 	vk::raii::PipelineLayout m_pipeline_layout{nullptr};
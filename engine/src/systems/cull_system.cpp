@@ -0,0 +1,159 @@
+#include "pch.hpp"
+#include "systems/cull_system.hpp"
+#include "core/ve_retirement_queue.hpp"
+
+namespace ve {
+
+CullSystem::CullSystem(
+	VeDevice& device,
+	std::shared_ptr<VeDescriptorPool> descriptor_pool,
+	VeFrameRing& frame_ring,
+	const vk::raii::DescriptorSetLayout& object_set_layout,
+	std::filesystem::path kernel_path,
+	uint32_t initial_capacity)
+	: m_ve_device(device), m_descriptor_pool(std::move(descriptor_pool)),
+	  m_frame_ring(frame_ring), m_capacity(std::max(initial_capacity, 1u)) {
+	createDescriptorSetLayout();
+	createFrameResources();
+	createPipelineLayout(object_set_layout);
+	m_pipeline = std::make_unique<VeComputePipeline>(m_ve_device, kernel_path, m_pipeline_layout);
+}
+
+CullSystem::~CullSystem() {}
+
+// - UBO with the frustum planes (dynamic offset into the frame ring)
+// - Indirect commands and per page draw counts
+// The objects are set 1, bound from the caller's VeObjectBuffer
+void CullSystem::createDescriptorSetLayout() {
+	m_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
+		.addBinding(0, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eCompute)
+		.addBinding(1, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.addBinding(2, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.build();
+}
+
+// Create or recreate the per-frame buffers and descriptor sets for the current capacities
+void CullSystem::createFrameResources() {
+	// Frames in flight may still use the old resources
+	VeRetirementQueue& retirement = m_ve_device.getRetirementQueue();
+	for (auto& frame : m_frames) {
+		retirement.retire(std::move(frame.commands));
+		retirement.retire(std::move(frame.counts));
+		retirement.retire(std::move(frame.descriptor_set), m_descriptor_pool);
+	}
+	m_frames.clear();
+	m_frames.resize(MAX_FRAMES_IN_FLIGHT);
+	for (auto& frame : m_frames) {
+		// Transfer src so tests and debug tools can read the results back
+		frame.commands = std::make_unique<VeBuffer>(
+			m_ve_device,
+			COMMAND_STRIDE,
+			m_capacity * m_page_capacity,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eDeviceLocal);
+		// A few bytes, host visible so the visible count can be read without a copy
+		frame.counts = std::make_unique<VeBuffer>(
+			m_ve_device,
+			sizeof(uint32_t),
+			m_page_capacity,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		frame.counts->map();
+
+		auto params_info = m_frame_ring.getDescriptorInfo(sizeof(CullParams));
+		auto commands_info = frame.commands->getDescriptorInfo();
+		auto counts_info = frame.counts->getDescriptorInfo();
+		VeDescriptorWriter(*m_set_layout, *m_descriptor_pool)
+			.writeBuffer(0, &params_info)
+			.writeBuffer(1, &commands_info)
+			.writeBuffer(2, &counts_info)
+			.build(frame.descriptor_set);
+	}
+}
+
+void CullSystem::createPipelineLayout(const vk::raii::DescriptorSetLayout& object_set_layout) {
+	vk::DescriptorSetLayout layouts[2] = {*m_set_layout->getDescriptorSetLayout(), *object_set_layout};
+	vk::PipelineLayoutCreateInfo pipeline_layout_info{
+		.setLayoutCount = 2,
+		.pSetLayouts = layouts,
+	};
+	m_pipeline_layout = vk::raii::PipelineLayout(m_ve_device.getDevice(), pipeline_layout_info);
+}
+
+// Grows the buffers to at least double the old size, the old ones are retired
+void CullSystem::ensureCapacity(uint32_t slot_count, uint32_t page_count) {
+	if (slot_count <= m_capacity && page_count <= m_page_capacity) return;
+	if (slot_count > m_capacity) m_capacity = std::max(slot_count, m_capacity * 2);
+	m_page_capacity = std::max(page_count, m_page_capacity);
+	VE_LOGI("CullSystem: growing to " << m_capacity << " objects and " << m_page_capacity << " pages");
+	createFrameResources();
+}
+
+uint32_t CullSystem::getLastVisibleCount(uint32_t frame_index) const {
+	assert(frame_index < MAX_FRAMES_IN_FLIGHT && "frame_index out of bounds");
+	const FrameResources& frame = m_frames[frame_index];
+	const auto* counts = static_cast<const uint32_t*>(frame.counts->getMappedMemory());
+	uint32_t visible = 0;
+	for (uint32_t page = 0; page < frame.recorded_pages; ++page) {
+		visible += counts[page];
+	}
+	return visible;
+}
+
+void CullSystem::record(
+	vk::CommandBuffer command_buffer,
+	uint32_t frame_index,
+	const VeFrustum& frustum,
+	vk::DescriptorSet object_set,
+	uint32_t slot_count,
+	uint32_t page_count) {
+	assert(frame_index < MAX_FRAMES_IN_FLIGHT && "frame_index out of bounds");
+	ensureCapacity(slot_count, page_count);
+	FrameResources& frame = m_frames[frame_index];
+	frame.recorded_pages = page_count;
+
+	CullParams params{};
+	for (uint32_t i = 0; i < VeFrustum::PLANE_COUNT; ++i) {
+		params.planes[i] = frustum.planes[i];
+	}
+	params.object_count = slot_count;
+	params.command_capacity = m_capacity;
+	const uint32_t params_offset = m_frame_ring.push(params).getDynamicOffset();
+
+	// Counts start at zero every frame, the kernel appends with atomics. Without a dispatch
+	// the zeroes are what the draws and getLastVisibleCount read.
+	command_buffer.fillBuffer(*frame.counts->getBuffer(), 0, VK_WHOLE_SIZE, 0u);
+	vk::MemoryBarrier2 barrier{
+		.srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+		.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect |
+			vk::PipelineStageFlagBits2::eHost,
+		.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite |
+			vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eHostRead
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier });
+	if (slot_count == 0) return;
+
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline->getPipeline());
+	command_buffer.bindDescriptorSets(
+		vk::PipelineBindPoint::eCompute,
+		*m_pipeline_layout,
+		0,
+		{*frame.descriptor_set, object_set},
+		params_offset);
+	const uint32_t group_count_x = (slot_count + 64 - 1) / 64; // ceilDiv, matches numthreads
+	command_buffer.dispatch(group_count_x, 1, 1);
+
+	// The draws of this frame read the commands and counts as indirect arguments,
+	// getLastVisibleCount reads the counts on the host once the frame's fence signaled
+	vk::MemoryBarrier2 draw_barrier{
+		.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+		.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eHost,
+		.dstAccessMask = vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eHostRead
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &draw_barrier });
+}
+
+} // namespace ve
@@ -0,0 +1,97 @@
+/* CullSystem tests object bounding spheres against the view frustum in a compute
+shader and writes one indexed indirect draw per visible object. The kernel reads
+the bounding spheres, transforms and draw arguments straight from the slots of
+VeObjectBuffer, so recording costs the same for any object count. The draws are
+compacted per mesh arena page, so a render system draws each page with a single
+drawIndexedIndirectCount using getCommandOffset(page) and getCountOffset(page).
+Work is recorded into the frame's graphics command buffer after the object buffer
+copies, the compute queue would run it before the copies of its frame. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+#include "core/ve_buffer.hpp"
+#include "core/ve_descriptors.hpp"
+#include "core/ve_frame_ring.hpp"
+#include "core/ve_compute_pipeline.hpp"
+#include "game/ve_frustum.hpp"
+
+#include <memory>
+#include <vector>
+#include <filesystem>
+
+namespace ve {
+
+// Uniform buffer of the cull kernel, pushed into the frame ring
+struct CullParams {
+	glm::vec4 planes[VeFrustum::PLANE_COUNT];
+	uint32_t object_count;     // slots to visit
+	uint32_t command_capacity; // command slots per page
+	uint32_t padding[2];
+};
+static_assert(sizeof(CullParams) == 112, "CullParams layout must match cull_kernel.slang");
+
+class VENGINE_API CullSystem {
+public:
+	static constexpr vk::DeviceSize COMMAND_STRIDE = sizeof(vk::DrawIndexedIndirectCommand);
+
+	CullSystem(
+		VeDevice& device,
+		std::shared_ptr<VeDescriptorPool> descriptor_pool,
+		VeFrameRing& frame_ring,
+		const vk::raii::DescriptorSetLayout& object_set_layout,
+		std::filesystem::path kernel_path,
+		uint32_t initial_capacity = 1024);
+	~CullSystem();
+
+	CullSystem(const CullSystem&) = delete;
+	CullSystem& operator=(const CullSystem&) = delete;
+
+	// Records the reset of the draw counts, the cull dispatch over the first slot_count
+	// slots of object_set (set 1, a VeObjectBuffer set) and the barrier before the
+	// indirect draws for frame_index. The draw of slot i gets firstInstance i.
+	void record(
+		vk::CommandBuffer command_buffer,
+		uint32_t frame_index,
+		const VeFrustum& frustum,
+		vk::DescriptorSet object_set,
+		uint32_t slot_count,
+		uint32_t page_count);
+
+	vk::Buffer getCommandBuffer(uint32_t frame_index) const { return *m_frames[frame_index].commands->getBuffer(); }
+	vk::Buffer getCountBuffer(uint32_t frame_index) const { return *m_frames[frame_index].counts->getBuffer(); }
+	vk::DeviceSize getCommandOffset(uint32_t page) const { return COMMAND_STRIDE * m_capacity * page; }
+	vk::DeviceSize getCountOffset(uint32_t page) const { return sizeof(uint32_t) * page; }
+	// Visible objects of the last record for frame_index, only valid once that frame's fence signaled
+	uint32_t getLastVisibleCount(uint32_t frame_index) const;
+	// Maximum draws per page, the maxDrawCount of drawIndexedIndirectCount
+	uint32_t getCapacity() const { return m_capacity; }
+	uint32_t getPageCapacity() const { return m_page_capacity; }
+
+private:
+	struct FrameResources {
+		std::unique_ptr<VeBuffer> commands; // written by the kernel, read as indirect draws
+		std::unique_ptr<VeBuffer> counts;   // one draw count per page, host visible for stats
+		uint32_t recorded_pages = 0;        // pages written by the last record
+		vk::raii::DescriptorSet descriptor_set{nullptr};
+	};
+
+	void createDescriptorSetLayout();
+	void createFrameResources();
+	void createPipelineLayout(const vk::raii::DescriptorSetLayout& object_set_layout);
+	void ensureCapacity(uint32_t slot_count, uint32_t page_count);
+
+	VeDevice& m_ve_device;
+	std::shared_ptr<VeDescriptorPool> m_descriptor_pool;
+	VeFrameRing& m_frame_ring; // parameters ubo is pushed into the frame ring each record
+
+	uint32_t m_capacity;          // command slots per page
+	uint32_t m_page_capacity = 1; // pages with command slots
+
+	std::unique_ptr<VeDescriptorSetLayout> m_set_layout;
+	std::vector<FrameResources> m_frames;
+
+	vk::raii::PipelineLayout m_pipeline_layout{nullptr};
+	std::unique_ptr<VeComputePipeline> m_pipeline;
+};
+
+} // namespace ve
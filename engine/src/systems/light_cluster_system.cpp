@@ -0,0 +1,173 @@
+#include "pch.hpp"
+#include "systems/light_cluster_system.hpp"
+#include "core/ve_retirement_queue.hpp"
+
+#include <cstring>
+
+namespace ve {
+
+float computeLightRange(const glm::vec3& color, float intensity) {
+	const float peak = intensity * std::max({color.r, color.g, color.b});
+	// peak / (0.01 d^2 + 0.1) = LIGHT_CUTOFF solved for d
+	return std::sqrt(std::max(peak / LIGHT_CUTOFF - 0.1f, 0.0f) / 0.01f);
+}
+
+LightClusterSystem::LightClusterSystem(
+	VeDevice& device,
+	std::shared_ptr<VeDescriptorPool> descriptor_pool,
+	VeFrameRing& frame_ring,
+	std::filesystem::path kernel_path,
+	uint32_t initial_light_capacity)
+	: m_ve_device(device), m_descriptor_pool(std::move(descriptor_pool)),
+	  m_frame_ring(frame_ring), m_light_capacity(std::max(initial_light_capacity, 1u)) {
+	createDescriptorSetLayouts();
+	createFrameResources();
+	createPipelineLayout();
+	m_pipeline = std::make_unique<VeComputePipeline>(m_ve_device, kernel_path, m_pipeline_layout);
+}
+
+LightClusterSystem::~LightClusterSystem() {}
+
+// Kernel set:
+// - UBO with the view and cluster grid (dynamic offset into the frame ring)
+// - Lights, per-cluster light counts and light indices
+// Render set: the same three buffers for fragment shaders
+void LightClusterSystem::createDescriptorSetLayouts() {
+	m_kernel_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
+		.addBinding(0, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eCompute)
+		.addBinding(1, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.addBinding(2, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.addBinding(3, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.build();
+	m_render_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
+		.addBinding(0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eFragment)
+		.addBinding(1, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eFragment)
+		.addBinding(2, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eFragment)
+		.build();
+}
+
+// Create or recreate the per-frame buffers and descriptor sets for the current light capacity
+void LightClusterSystem::createFrameResources() {
+	// Frames in flight may still use the old resources
+	VeRetirementQueue& retirement = m_ve_device.getRetirementQueue();
+	for (auto& frame : m_frames) {
+		retirement.retire(std::move(frame.lights));
+		retirement.retire(std::move(frame.counts));
+		retirement.retire(std::move(frame.indices));
+		retirement.retire(std::move(frame.kernel_set), m_descriptor_pool);
+		retirement.retire(std::move(frame.render_set), m_descriptor_pool);
+	}
+	m_frames.clear();
+	m_frames.resize(MAX_FRAMES_IN_FLIGHT);
+	for (auto& frame : m_frames) {
+		frame.lights = std::make_unique<VeBuffer>(
+			m_ve_device,
+			sizeof(PointLight),
+			m_light_capacity,
+			vk::BufferUsageFlagBits::eStorageBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		frame.lights->map();
+		// Transfer src so tests and debug tools can read the clusters back
+		frame.counts = std::make_unique<VeBuffer>(
+			m_ve_device,
+			sizeof(uint32_t),
+			CLUSTER_COUNT,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eDeviceLocal);
+		frame.indices = std::make_unique<VeBuffer>(
+			m_ve_device,
+			sizeof(uint32_t),
+			CLUSTER_COUNT * LIGHT_CLUSTER_MAX_LIGHTS,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+		auto params_info = m_frame_ring.getDescriptorInfo(sizeof(LightClusterParams));
+		auto lights_info = frame.lights->getDescriptorInfo();
+		auto counts_info = frame.counts->getDescriptorInfo();
+		auto indices_info = frame.indices->getDescriptorInfo();
+		VeDescriptorWriter(*m_kernel_set_layout, *m_descriptor_pool)
+			.writeBuffer(0, &params_info)
+			.writeBuffer(1, &lights_info)
+			.writeBuffer(2, &counts_info)
+			.writeBuffer(3, &indices_info)
+			.build(frame.kernel_set);
+		VeDescriptorWriter(*m_render_set_layout, *m_descriptor_pool)
+			.writeBuffer(0, &lights_info)
+			.writeBuffer(1, &counts_info)
+			.writeBuffer(2, &indices_info)
+			.build(frame.render_set);
+	}
+}
+
+void LightClusterSystem::createPipelineLayout() {
+	vk::PipelineLayoutCreateInfo pipeline_layout_info{
+		.setLayoutCount = 1,
+		.pSetLayouts = &*m_kernel_set_layout->getDescriptorSetLayout(),
+	};
+	m_pipeline_layout = vk::raii::PipelineLayout(m_ve_device.getDevice(), pipeline_layout_info);
+}
+
+// Grows the light buffers to at least double the old size, the old ones are retired.
+// The lights of the other frames are lost, each frame sets its lights before recording.
+void LightClusterSystem::ensureCapacity(uint32_t light_count) {
+	if (light_count <= m_light_capacity) return;
+	m_light_capacity = std::max(light_count, m_light_capacity * 2);
+	VE_LOGI("LightClusterSystem: growing to " << m_light_capacity << " lights");
+	createFrameResources();
+}
+
+void LightClusterSystem::setLights(uint32_t frame_index, std::span<const PointLight> lights) {
+	assert(frame_index < MAX_FRAMES_IN_FLIGHT && "frame_index out of bounds");
+	ensureCapacity(static_cast<uint32_t>(lights.size()));
+	FrameResources& frame = m_frames[frame_index];
+	frame.light_count = static_cast<uint32_t>(lights.size());
+	if (!lights.empty()) {
+		memcpy(frame.lights->getMappedMemory(), lights.data(), lights.size_bytes());
+	}
+}
+
+// Slice s covers view depths [near * (far / near)^(s / Z), near * (far / near)^((s + 1) / Z)),
+// so slice = log(depth) * Z / log(far / near) - Z * log(near) / log(far / near)
+LightClusterInfo LightClusterSystem::record(
+	vk::CommandBuffer command_buffer,
+	uint32_t frame_index,
+	const VeCamera& camera,
+	vk::Extent2D extent) {
+	assert(frame_index < MAX_FRAMES_IN_FLIGHT && "frame_index out of bounds");
+	const FrameResources& frame = m_frames[frame_index];
+	const float near_plane = camera.getNearPlane();
+	const float far_plane = camera.getFarPlane();
+	const float slice_far = std::clamp(LIGHT_CLUSTER_FAR, near_plane * 2.0f, far_plane);
+	const float log_range = std::log(slice_far / near_plane);
+
+	LightClusterInfo info{};
+	info.scale = glm::vec4(
+		static_cast<float>(LIGHT_CLUSTER_X) / static_cast<float>(std::max(extent.width, 1u)),
+		static_cast<float>(LIGHT_CLUSTER_Y) / static_cast<float>(std::max(extent.height, 1u)),
+		static_cast<float>(LIGHT_CLUSTER_Z) / log_range,
+		-static_cast<float>(LIGHT_CLUSTER_Z) * std::log(near_plane) / log_range);
+	info.grid = glm::uvec4(LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y, LIGHT_CLUSTER_Z, LIGHT_CLUSTER_MAX_LIGHTS);
+
+	const glm::mat4& proj = camera.getProj();
+	LightClusterParams params{};
+	params.view = camera.getView();
+	params.projection = glm::vec4(proj[0][0], proj[1][1], far_plane, 0.0f);
+	params.slices = glm::vec4(near_plane, slice_far, 0.0f, 0.0f);
+	params.grid = info.grid;
+	params.light_count = frame.light_count;
+	const uint32_t params_offset = m_frame_ring.push(params).getDynamicOffset();
+
+	// Every cluster writes its count, so there is nothing to clear first
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline->getPipeline());
+	command_buffer.bindDescriptorSets(
+		vk::PipelineBindPoint::eCompute,
+		*m_pipeline_layout,
+		0,
+		*frame.kernel_set,
+		params_offset);
+	const uint32_t group_count_x = (CLUSTER_COUNT + 64 - 1) / 64; // ceilDiv, matches numthreads
+	command_buffer.dispatch(group_count_x, 1, 1);
+	return info;
+}
+
+} // namespace ve
@@ -0,0 +1,105 @@
+/* LightClusterSystem bins point lights into view space clusters (froxels) so a fragment
+only shades the lights near it. The screen is split into LIGHT_CLUSTER_X by
+LIGHT_CLUSTER_Y tiles and the view depth into LIGHT_CLUSTER_Z exponential slices. A
+compute kernel tests every light's range against the view space box of every cluster and
+writes the indices of the lights that touch it. Lights live in a storage buffer per frame
+that grows with their count, so there is no fixed light limit. Fragment shaders bind the
+render set (lights, per-cluster counts and indices) and find their cluster with the
+LightClusterInfo in the global UBO. Work is recorded into the frame's compute command
+buffer; graphics waits on the compute timeline at the fragment shader stage. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+#include "core/ve_buffer.hpp"
+#include "core/ve_descriptors.hpp"
+#include "core/ve_frame_ring.hpp"
+#include "core/ve_compute_pipeline.hpp"
+#include "game/ve_frame_info.hpp"
+#include "game/ve_camera.hpp"
+
+#include <memory>
+#include <vector>
+#include <span>
+#include <filesystem>
+
+namespace ve {
+
+// Uniform buffer of the cluster kernel, pushed into the frame ring
+struct LightClusterParams {
+	glm::mat4 view;
+	glm::vec4 projection; // proj[0][0], proj[1][1], camera far plane, unused
+	glm::vec4 slices;     // near and far of the exponentially sliced depth range, zw unused
+	glm::uvec4 grid;      // cluster counts xyz, w light index slots per cluster
+	uint32_t light_count;
+	uint32_t padding[3];
+};
+static_assert(sizeof(LightClusterParams) == 128, "LightClusterParams layout must match light_cluster_kernel.slang");
+
+// Distance at which the attenuation 1 / (0.01 d^2 + 0.1) of simple_shader.slang brings
+// the brightest channel below LIGHT_CUTOFF, the shader fades the light out towards it
+VENGINE_API float computeLightRange(const glm::vec3& color, float intensity);
+
+class VENGINE_API LightClusterSystem {
+public:
+	static constexpr uint32_t CLUSTER_COUNT = LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z;
+
+	LightClusterSystem(
+		VeDevice& device,
+		std::shared_ptr<VeDescriptorPool> descriptor_pool,
+		VeFrameRing& frame_ring,
+		std::filesystem::path kernel_path,
+		uint32_t initial_light_capacity = 256);
+	~LightClusterSystem();
+
+	LightClusterSystem(const LightClusterSystem&) = delete;
+	LightClusterSystem& operator=(const LightClusterSystem&) = delete;
+
+	// Copies the lights of frame_index into its light buffer, growing it when needed
+	void setLights(uint32_t frame_index, std::span<const PointLight> lights);
+	// Records the binning of the lights set for frame_index as seen by camera. Returns
+	// what fragment shaders need to find their cluster, for UniformBufferObject.
+	LightClusterInfo record(
+		vk::CommandBuffer command_buffer,
+		uint32_t frame_index,
+		const VeCamera& camera,
+		vk::Extent2D extent);
+
+	// Set layout of the lights (0), cluster light counts (1) and cluster light indices (2)
+	const vk::raii::DescriptorSetLayout& getRenderSetLayout() const { return m_render_set_layout->getDescriptorSetLayout(); }
+	vk::DescriptorSet getRenderSet(uint32_t frame_index) const { return *m_frames[frame_index].render_set; }
+	uint32_t getLightCount(uint32_t frame_index) const { return m_frames[frame_index].light_count; }
+	uint32_t getLightCapacity() const { return m_light_capacity; }
+	// Read back buffers for tests and debug tools
+	vk::Buffer getCountBuffer(uint32_t frame_index) const { return *m_frames[frame_index].counts->getBuffer(); }
+	vk::Buffer getIndexBuffer(uint32_t frame_index) const { return *m_frames[frame_index].indices->getBuffer(); }
+
+private:
+	struct FrameResources {
+		std::unique_ptr<VeBuffer> lights;  // host visible, written by setLights
+		std::unique_ptr<VeBuffer> counts;  // lights per cluster, written by the kernel
+		std::unique_ptr<VeBuffer> indices; // LIGHT_CLUSTER_MAX_LIGHTS light indices per cluster
+		uint32_t light_count = 0;
+		vk::raii::DescriptorSet kernel_set{nullptr};
+		vk::raii::DescriptorSet render_set{nullptr};
+	};
+
+	void createDescriptorSetLayouts();
+	void createFrameResources();
+	void createPipelineLayout();
+	void ensureCapacity(uint32_t light_count);
+
+	VeDevice& m_ve_device;
+	std::shared_ptr<VeDescriptorPool> m_descriptor_pool;
+	VeFrameRing& m_frame_ring; // parameters ubo is pushed into the frame ring each record
+
+	uint32_t m_light_capacity; // lights per frame
+
+	std::unique_ptr<VeDescriptorSetLayout> m_kernel_set_layout;
+	std::unique_ptr<VeDescriptorSetLayout> m_render_set_layout;
+	std::vector<FrameResources> m_frames;
+
+	vk::raii::PipelineLayout m_pipeline_layout{nullptr};
+	std::unique_ptr<VeComputePipeline> m_pipeline;
+};
+
+} // namespace ve
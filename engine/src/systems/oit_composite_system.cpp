@@ -0,0 +1,121 @@
+#include "pch.hpp"
+#include "systems/oit_composite_system.hpp"
+#include "core/ve_device.hpp"
+#include "core/ve_image.hpp"
+#include "core/ve_pipeline.hpp"
+#include "core/ve_retirement_queue.hpp"
+#include "utils/ve_log.hpp"
+
+namespace ve {
+
+OitCompositeSystem::OitCompositeSystem(
+	VeDevice& device,
+	std::shared_ptr<VeDescriptorPool> descriptor_pool,
+	vk::Format color_format,
+	std::filesystem::path shader_path)
+	: m_ve_device(device), m_descriptor_pool(std::move(descriptor_pool)), m_shader_path(std::move(shader_path)) {
+	m_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
+		.addBinding(0, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment)
+		.addBinding(1, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment)
+		.build();
+	createSampler();
+	createPipelineLayout();
+	createPipeline(color_format);
+}
+
+OitCompositeSystem::~OitCompositeSystem() {}
+
+// The shader loads texels directly, the sampler only completes the descriptors
+void OitCompositeSystem::createSampler() {
+	vk::SamplerCreateInfo sampler_info{
+		.magFilter = vk::Filter::eNearest,
+		.minFilter = vk::Filter::eNearest,
+		.mipmapMode = vk::SamplerMipmapMode::eNearest,
+		.addressModeU = vk::SamplerAddressMode::eClampToEdge,
+		.addressModeV = vk::SamplerAddressMode::eClampToEdge,
+		.addressModeW = vk::SamplerAddressMode::eClampToEdge,
+		.mipLodBias = 0.0f,
+		.anisotropyEnable = vk::False,
+		.maxAnisotropy = 1.0f,
+		.compareEnable = vk::False,
+		.compareOp = vk::CompareOp::eAlways,
+		.minLod = 0.0f,
+		.maxLod = 0.0f,
+		.borderColor = vk::BorderColor::eIntOpaqueBlack,
+		.unnormalizedCoordinates = vk::False
+	};
+	m_sampler = vk::raii::Sampler(m_ve_device.getDevice(), sampler_info);
+}
+
+void OitCompositeSystem::createPipelineLayout() {
+	vk::DescriptorSetLayout layout = *m_set_layout->getDescriptorSetLayout();
+	vk::PipelineLayoutCreateInfo pipeline_layout_info{
+		.sType = vk::StructureType::ePipelineLayoutCreateInfo,
+		.setLayoutCount = 1,
+		.pSetLayouts = &layout
+	};
+	m_pipeline_layout = vk::raii::PipelineLayout(m_ve_device.getDevice(), pipeline_layout_info);
+}
+
+void OitCompositeSystem::createPipeline(vk::Format color_format) {
+	PipelineConfigInfo pipeline_config{};
+	VePipeline::defaultPipelineConfigInfo(pipeline_config, m_ve_device);
+
+	// A single sampled color target without depth, the triangle is generated from the vertex index.
+	// The default blend puts the average color over the scene by its coverage in alpha.
+	pipeline_config.color_format = color_format;
+	pipeline_config.depth_format = vk::Format::eUndefined;
+	pipeline_config.multisample_info.rasterizationSamples = vk::SampleCountFlagBits::e1;
+	pipeline_config.rasterization_info.cullMode = vk::CullModeFlagBits::eNone;
+	pipeline_config.rasterization_info.depthBiasEnable = VK_FALSE;
+	pipeline_config.depth_stencil_info.depthTestEnable = VK_FALSE;
+	pipeline_config.depth_stencil_info.depthWriteEnable = VK_FALSE;
+	pipeline_config.attribute_descriptions.clear();
+	pipeline_config.binding_descriptions.clear();
+
+	assert(m_pipeline_layout != VK_NULL_HANDLE && "Pipeline layout is null");
+	pipeline_config.pipeline_layout = m_pipeline_layout;
+	m_ve_pipeline = std::make_unique<VePipeline>(
+		m_ve_device,
+		m_shader_path,
+		pipeline_config
+	);
+	assert(m_ve_pipeline && "Failed to create OIT composite pipeline");
+}
+
+// The recreation of the swap chain and a new MSAA sample count replace the targets. Frames
+// in flight may still be pending with the old set bound, so a new set is written and the old one retired.
+void OitCompositeSystem::updateDescriptorSet(const VeImage& accum, const VeImage& weight) {
+	vk::ImageView accum_view = *accum.getImageView();
+	vk::ImageView weight_view = *weight.getImageView();
+	if (accum_view == m_accum_view && weight_view == m_weight_view)
+		return;
+	m_accum_view = accum_view;
+	m_weight_view = weight_view;
+	vk::DescriptorImageInfo accum_info{
+		.sampler = *m_sampler,
+		.imageView = accum_view,
+		.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+	};
+	vk::DescriptorImageInfo weight_info{
+		.sampler = *m_sampler,
+		.imageView = weight_view,
+		.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+	};
+	if (*m_descriptor_set)
+		m_ve_device.getRetirementQueue().retire(std::move(m_descriptor_set), m_descriptor_pool);
+	m_descriptor_set = vk::raii::DescriptorSet{nullptr};
+	VeDescriptorWriter(*m_set_layout, *m_descriptor_pool)
+		.writeImage(0, &accum_info)
+		.writeImage(1, &weight_info)
+		.build(m_descriptor_set);
+}
+
+void OitCompositeSystem::render(vk::CommandBuffer command_buffer, const VeImage& accum, const VeImage& weight) {
+	updateDescriptorSet(accum, weight);
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_ve_pipeline->getPipeline());
+	command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *m_pipeline_layout, 0, *m_descriptor_set, {});
+	command_buffer.draw(3, 1, 0, 0);
+}
+
+} // namespace ve
@@ -0,0 +1,58 @@
+/* OitCompositeSystem resolves weighted blended transparency. The transparent pass leaves
+the sum of weighted premultiplied colors and the revealage in the accumulation target and
+the sum of the weights in the weight target. Their quotient is the weighted average color
+of the transparent fragments, blended over the scene by the part that is not revealed.
+It records directly into the composite pass begun by VeRenderer::beginCompositeRender. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+#include "core/ve_descriptors.hpp"
+
+#include <memory>
+#include <filesystem>
+
+namespace ve {
+	// Forward declarations
+	class VeDevice;
+	class VeImage;
+	class VePipeline;
+}
+
+namespace ve {
+
+class VENGINE_API OitCompositeSystem {
+public:
+	OitCompositeSystem(
+		VeDevice& device,
+		std::shared_ptr<VeDescriptorPool> descriptor_pool,
+		vk::Format color_format,
+		std::filesystem::path shader_path);
+	~OitCompositeSystem();
+
+	OitCompositeSystem(const OitCompositeSystem&) = delete;
+	OitCompositeSystem& operator=(const OitCompositeSystem&) = delete;
+
+	// Draws a fullscreen triangle reading the same pixel of both targets. They must be in
+	// ShaderReadOnlyOptimal and cover the render extent of the composite pass.
+	void render(vk::CommandBuffer command_buffer, const VeImage& accum, const VeImage& weight);
+
+private:
+	void createSampler();
+	void createPipelineLayout();
+	void createPipeline(vk::Format color_format);
+	void updateDescriptorSet(const VeImage& accum, const VeImage& weight);
+
+	VeDevice& m_ve_device;
+	std::shared_ptr<VeDescriptorPool> m_descriptor_pool;
+	std::filesystem::path m_shader_path;
+
+	std::unique_ptr<VeDescriptorSetLayout> m_set_layout;
+	vk::raii::DescriptorSet m_descriptor_set{nullptr};
+	vk::ImageView m_accum_view{}; // the descriptor set was written with, change when the swap chain is recreated
+	vk::ImageView m_weight_view{};
+	vk::raii::Sampler m_sampler{nullptr};
+	vk::raii::PipelineLayout m_pipeline_layout{nullptr};
+	std::unique_ptr<VePipeline> m_ve_pipeline;
+};
+
+} // namespace ve
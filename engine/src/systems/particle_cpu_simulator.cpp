@@ -0,0 +1,472 @@
+#include "pch.hpp"
+#include "systems/particle_cpu_simulator.hpp"
+#include "core/ve_thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define VE_PARTICLES_SSE2 1
+	#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+	#define VE_PARTICLES_AVX2 1
+	#include <immintrin.h>
+#endif
+
+namespace ve {
+
+namespace {
+
+// Lane types the modes are written against: a broadcasting constructor, load and store,
+// arithmetic, sqrt, max, compares to a mask and a select by mask
+
+struct FloatX1 {
+	static constexpr uint32_t WIDTH = 1;
+	float v;
+	FloatX1(float s) : v(s) {}
+	static FloatX1 load(const float* p) { return *p; }
+	void store(float* p) const { *p = v; }
+};
+struct MaskX1 { bool v; };
+inline FloatX1 operator+(FloatX1 a, FloatX1 b) { return a.v + b.v; }
+inline FloatX1 operator-(FloatX1 a, FloatX1 b) { return a.v - b.v; }
+inline FloatX1 operator*(FloatX1 a, FloatX1 b) { return a.v * b.v; }
+inline FloatX1 operator/(FloatX1 a, FloatX1 b) { return a.v / b.v; }
+inline FloatX1 operator-(FloatX1 a) { return -a.v; }
+inline FloatX1 sqrt(FloatX1 a) { return std::sqrt(a.v); }
+inline FloatX1 max(FloatX1 a, FloatX1 b) { return a.v < b.v ? b.v : a.v; }
+inline MaskX1 lessThan(FloatX1 a, FloatX1 b) { return {a.v < b.v}; }
+inline MaskX1 operator&(MaskX1 a, MaskX1 b) { return {a.v && b.v}; }
+inline FloatX1 select(MaskX1 m, FloatX1 a, FloatX1 b) { return m.v ? a : b; }
+
+#if defined(VE_PARTICLES_SSE2)
+struct FloatX4 {
+	static constexpr uint32_t WIDTH = 4;
+	__m128 v;
+	FloatX4(__m128 x) : v(x) {}
+	FloatX4(float s) : v(_mm_set1_ps(s)) {}
+	static FloatX4 load(const float* p) { return _mm_loadu_ps(p); }
+	void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+struct MaskX4 { __m128 v; };
+inline FloatX4 operator+(FloatX4 a, FloatX4 b) { return _mm_add_ps(a.v, b.v); }
+inline FloatX4 operator-(FloatX4 a, FloatX4 b) { return _mm_sub_ps(a.v, b.v); }
+inline FloatX4 operator*(FloatX4 a, FloatX4 b) { return _mm_mul_ps(a.v, b.v); }
+inline FloatX4 operator/(FloatX4 a, FloatX4 b) { return _mm_div_ps(a.v, b.v); }
+inline FloatX4 operator-(FloatX4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline FloatX4 sqrt(FloatX4 a) { return _mm_sqrt_ps(a.v); }
+inline FloatX4 max(FloatX4 a, FloatX4 b) { return _mm_max_ps(a.v, b.v); }
+inline MaskX4 lessThan(FloatX4 a, FloatX4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline MaskX4 operator&(MaskX4 a, MaskX4 b) { return {_mm_and_ps(a.v, b.v)}; }
+inline FloatX4 select(MaskX4 m, FloatX4 a, FloatX4 b) { return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)); }
+#endif
+
+#if defined(VE_PARTICLES_AVX2)
+struct FloatX8 {
+	static constexpr uint32_t WIDTH = 8;
+	__m256 v;
+	FloatX8(__m256 x) : v(x) {}
+	FloatX8(float s) : v(_mm256_set1_ps(s)) {}
+	static FloatX8 load(const float* p) { return _mm256_loadu_ps(p); }
+	void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+struct MaskX8 { __m256 v; };
+inline FloatX8 operator+(FloatX8 a, FloatX8 b) { return _mm256_add_ps(a.v, b.v); }
+inline FloatX8 operator-(FloatX8 a, FloatX8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline FloatX8 operator*(FloatX8 a, FloatX8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline FloatX8 operator/(FloatX8 a, FloatX8 b) { return _mm256_div_ps(a.v, b.v); }
+inline FloatX8 operator-(FloatX8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline FloatX8 sqrt(FloatX8 a) { return _mm256_sqrt_ps(a.v); }
+inline FloatX8 max(FloatX8 a, FloatX8 b) { return _mm256_max_ps(a.v, b.v); }
+inline MaskX8 lessThan(FloatX8 a, FloatX8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline MaskX8 operator&(MaskX8 a, MaskX8 b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline FloatX8 select(MaskX8 m, FloatX8 a, FloatX8 b) { return _mm256_blendv_ps(b.v, a.v, m.v); }
+#endif
+
+// Applies a scalar function to every lane
+template <typename F, typename Fn>
+F mapLanes(F a, Fn fn) {
+	float lanes[F::WIDTH];
+	a.store(lanes);
+	for (float& lane : lanes) lane = fn(lane);
+	return F::load(lanes);
+}
+
+template <typename F>
+F atan2Lanes(F y, F x) {
+	float ys[F::WIDTH];
+	float xs[F::WIDTH];
+	y.store(ys);
+	x.store(xs);
+	for (uint32_t i = 0; i < F::WIDTH; ++i) ys[i] = std::atan2(ys[i], xs[i]);
+	return F::load(ys);
+}
+
+template <typename F>
+struct ParticleLanes {
+	F px, py, pz;
+	F vx, vy, vz;
+};
+
+// The modes below follow particle_compute.slang expression by expression, so the
+// results only differ by rounding and the precision of the transcendentals
+
+// 1) Earth-like gravity and floor collision
+template <typename F>
+void simulateGravityFloor(ParticleLanes<F>& p, const ParticleParams& params) {
+	const F dt{params.delta_time};
+	p.vz = p.vz + F(-9.81f) * dt;
+	p.px = p.px + p.vx * dt;
+	p.py = p.py + p.vy * dt;
+	p.pz = p.pz + p.vz * dt;
+
+	const F floor_z{0.1f};
+	const auto below = lessThan(p.pz, floor_z);
+	p.pz = select(below, floor_z, p.pz);
+	p.vz = select(below & lessThan(p.vz, F(0.0f)), -p.vz * F(0.8f), p.vz);
+	p.vx = select(below, p.vx * F(0.98f), p.vx); // friction
+	p.vy = select(below, p.vy * F(0.98f), p.vy);
+}
+
+// Shared by COOL and SUCC, unit direction towards the origin
+template <typename F>
+void directionToCenter(const ParticleLanes<F>& p, const ParticleParams& params, F& dx, F& dy, F& dz) {
+	const F tx = F(params.origin.x) - p.px;
+	const F ty = F(params.origin.y) - p.py;
+	const F tz = F(params.origin.z) - p.pz;
+	const F dist = sqrt(tx * tx + ty * ty + tz * tz) + F(0.01f); // avoid div by zero
+	dx = tx / dist;
+	dy = ty / dist;
+	dz = tz / dist;
+}
+
+// 2) Orbiting around a center with simple gravity + angular motion
+template <typename F>
+void coolOrbit(ParticleLanes<F>& p, const ParticleParams& params) {
+	const F dt{params.delta_time};
+	F dx{0.0f}, dy{0.0f}, dz{0.0f};
+	directionToCenter(p, params, dx, dy, dz);
+	const F gravity{3.0f};
+	p.vx = p.vx + dx * gravity * dt;
+	p.vy = p.vy + dy * gravity * dt;
+	p.vz = p.vz + dz * gravity * dt;
+
+	// right = normalize(cross(dir, up)) with up = +y, forward = normalize(cross(dir, right))
+	const F right_length = sqrt(dz * dz + dx * dx);
+	const F rx = -dz / right_length;
+	const F rz = dx / right_length;
+	const F fx = dy * rz;
+	const F fy = dz * rx - dx * rz;
+	const F fz = -(dy * rx);
+	const F forward_length = sqrt(fx * fx + fy * fy + fz * fz);
+	const F rotation{10.0f};
+	p.vx = p.vx + fx / forward_length * rotation * dt;
+	p.vy = p.vy + fy / forward_length * rotation * dt;
+	p.vz = p.vz + fz / forward_length * rotation * dt;
+
+	p.px = p.px + p.vx * dt;
+	p.py = p.py + p.vy * dt;
+	p.pz = p.pz + p.vz * dt;
+}
+
+// 3) Simple gravity towards center
+template <typename F>
+void succ(ParticleLanes<F>& p, const ParticleParams& params) {
+	const F dt{params.delta_time};
+	F dx{0.0f}, dy{0.0f}, dz{0.0f};
+	directionToCenter(p, params, dx, dy, dz);
+	const F gravity{26.0f};
+	p.vx = p.vx + dx * gravity * dt;
+	p.vy = p.vy + dy * gravity * dt;
+	p.vz = p.vz + dz * gravity * dt;
+
+	p.px = p.px + p.vx * dt;
+	p.py = p.py + p.vy * dt;
+	p.pz = p.pz + p.vz * dt;
+}
+
+// 4) Planar gravity, swirl and attraction to spiral arms, which puts particles in stasis
+template <typename F>
+void simulateStasis(ParticleLanes<F>& p, const ParticleParams& params) {
+	const F dt{params.delta_time};
+	const F rel_x = p.px - F(params.origin.x);
+	const F rel_y = p.py - F(params.origin.y);
+	const F rel_z = p.pz - F(params.origin.z);
+	const F r = sqrt(rel_x * rel_x + rel_y * rel_y);
+	const F r_safe = max(r, F(0.9f));
+	const F nx = rel_x / r_safe;
+	const F ny = rel_y / r_safe;
+	const F tx = -ny;
+	const F ty = nx;
+
+	const float mu = 2.0f;
+	const F central = F(-mu) / (r_safe * r_safe);
+	const F a_z = F(-mu * 0.02f) * rel_z;
+
+	const F v_circ = sqrt(F(mu) / r_safe);
+	const F swirl = F(0.6f) * v_circ;
+	const F swirl_radius = max(r_safe, F(5.0f));
+
+	const F theta = atan2Lanes(rel_y, rel_x);
+	const F log_r = mapLanes(r_safe, [](float x) { return std::log(x); });
+	const F phase = theta - log_r * F(1.9f) - F(0.2f * params.total_time);
+	const F arm_signal = mapLanes(F(5.0f) * phase, [](float x) { return std::sin(x); });
+	const F arm = F(-0.8f) * arm_signal;
+
+	const F ax = central * nx + swirl * tx / swirl_radius + arm * nx;
+	const F ay = central * ny + swirl * ty / swirl_radius + arm * ny;
+
+	const F keep{1.0f - 0.02f}; // damping
+	p.vx = (p.vx + ax * dt) * keep;
+	p.vy = (p.vy + ay * dt) * keep;
+	p.vz = (p.vz + a_z * dt) * keep;
+
+	p.px = p.px + p.vx * dt;
+	p.py = p.py + p.vy * dt;
+	p.pz = p.pz + p.vz * dt;
+}
+
+// 5) Flat rotation curve with radial damping, rotating spiral arms and a vertical spring
+template <typename F>
+void simulateGalaxyMassive(ParticleLanes<F>& p, const ParticleParams& params) {
+	const F dt{params.delta_time};
+	const F rel_x = p.px - F(params.origin.x);
+	const F rel_y = p.py - F(params.origin.y);
+	const F rel_z = p.pz - F(params.origin.z);
+	const F r = sqrt(rel_x * rel_x + rel_y * rel_y);
+	const F r_safe = max(r, F(1.0f)); // core softening, always positive
+	const F nx = rel_x / r_safe;
+	const F ny = rel_y / r_safe;
+	const F tx = -ny;
+	const F ty = nx;
+
+	F vt = p.vx * tx + p.vy * ty;
+	F vr = p.vx * nx + p.vy * ny;
+
+	// Flat rotation curve, v0 = 35 and r0 = 30
+	const F decay = mapLanes(-r_safe / F(30.0f), [](float x) { return std::exp(x); });
+	const F vt_target = F(35.0f) * (F(1.0f) - decay);
+	vt = vt + (vt_target - vt) * F(2.0f) * dt;
+	vr = vr + (-vr) * F(1.5f) * dt;
+
+	const F theta = atan2Lanes(rel_y, rel_x);
+	const F log_r = mapLanes(r_safe, [](float x) { return std::log(x); });
+	const F phase = theta - log_r * F(1.3f) - F(0.1f * params.total_time);
+	const F arm_signal = mapLanes(F(5.0f) * phase, [](float x) { return std::sin(x); });
+	const F arm = F(-7.0f) * arm_signal;
+
+	const F a_z = F(-0.2f) * rel_z - F(0.2f) * p.vz;
+
+	p.vx = vt * tx + vr * nx + arm * nx * dt;
+	p.vy = vt * ty + vr * ny + arm * ny * dt;
+	p.vz = p.vz + a_z * dt;
+
+	p.px = p.px + p.vx * dt;
+	p.py = p.py + p.vy * dt;
+	p.pz = p.pz + p.vz * dt;
+}
+
+// --------- RNG, same as particle_compute.slang ----------
+uint32_t wangHash(uint32_t seed) {
+	seed = (seed ^ 61u) ^ (seed >> 16);
+	seed *= 9u;
+	seed = seed ^ (seed >> 4);
+	seed *= 0x27d4eb2du;
+	seed = seed ^ (seed >> 15);
+	return seed;
+}
+
+float rand01(uint32_t& state) {
+	state = wangHash(state);
+	return static_cast<float>(state & 0x00FFFFFFu) / 16777216.0f;
+}
+
+glm::vec2 randNormal2(uint32_t& state, const ParticleParams& params) {
+	const float u1 = std::max(1e-6f, rand01(state));
+	const float u2 = rand01(state);
+	const float r = std::sqrt(-2.0f * std::log(u1));
+	const float theta = 6.28318530718f * u2;
+	return glm::vec2(r * std::cos(theta), r * std::sin(theta)) * params.stddev + params.mean;
+}
+
+} // namespace
+
+void ParticleCpuSimulator::resize(uint32_t count) {
+	m_position_x.resize(count); m_position_y.resize(count); m_position_z.resize(count);
+	m_velocity_x.resize(count); m_velocity_y.resize(count); m_velocity_z.resize(count);
+	m_size.resize(count);
+	m_color.resize(count);
+}
+
+ParticleCpuSimulator::Path ParticleCpuSimulator::getBestPath() {
+#if defined(VE_PARTICLES_AVX2)
+	return PATH_AVX2;
+#elif defined(VE_PARTICLES_SSE2)
+	return PATH_SSE2;
+#else
+	return PATH_SCALAR;
+#endif
+}
+
+bool ParticleCpuSimulator::isPathAvailable(Path path) {
+	return path <= getBestPath();
+}
+
+const char* ParticleCpuSimulator::getPathName(Path path) {
+	switch (path) {
+		case PATH_SCALAR: return "scalar";
+		case PATH_SSE2: return "SSE2";
+		case PATH_AVX2: return "AVX2";
+	}
+	return "unknown";
+}
+
+void ParticleCpuSimulator::reset(const ParticleParams& params, VeThreadPool* pool) {
+	const uint32_t chunk_count = (size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	auto run_chunk = [&](uint32_t chunk) {
+		resetRange(params, std::max(params.reset_first, chunk * CHUNK_SIZE), std::min(size(), (chunk + 1) * CHUNK_SIZE));
+	};
+	if (pool) {
+		pool->parallelFor(chunk_count, run_chunk);
+	} else {
+		for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) run_chunk(chunk);
+	}
+}
+
+void ParticleCpuSimulator::simulate(const ParticleParams& params, VeThreadPool* pool) {
+	simulate(params, getBestPath(), pool);
+}
+
+// Chunks are handed out one at a time from the pool's shared counter, so threads that
+// finish early keep taking work and uneven chunk costs balance out
+void ParticleCpuSimulator::simulate(const ParticleParams& params, Path path, VeThreadPool* pool) {
+	assert(isPathAvailable(path) && "Particle path not compiled into this build");
+	assert(params.mode != ParticleMode::FLUID && "FLUID mode needs the neighbor grid of the GPU path");
+	const uint32_t chunk_count = (size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	auto run_chunk = [&](uint32_t chunk) {
+		simulateRange(params, path, chunk * CHUNK_SIZE, std::min(size(), (chunk + 1) * CHUNK_SIZE));
+	};
+	if (pool) {
+		pool->parallelFor(chunk_count, run_chunk);
+	} else {
+		for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) run_chunk(chunk);
+	}
+}
+
+// Full registers of the path, the tail of the last chunk takes the scalar lanes
+void ParticleCpuSimulator::simulateRange(const ParticleParams& params, Path path, uint32_t begin, uint32_t end) {
+	uint32_t batched = begin;
+	switch (path) {
+		case PATH_AVX2:
+#if defined(VE_PARTICLES_AVX2)
+			batched = begin + ((end - begin) & ~7u);
+			simulateLanes<FloatX8>(params, begin, batched);
+#endif
+			break;
+		case PATH_SSE2:
+#if defined(VE_PARTICLES_SSE2)
+			batched = begin + ((end - begin) & ~3u);
+			simulateLanes<FloatX4>(params, begin, batched);
+#endif
+			break;
+		case PATH_SCALAR:
+			break;
+	}
+	simulateLanes<FloatX1>(params, batched, end);
+}
+
+template <typename F>
+void ParticleCpuSimulator::simulateLanes(const ParticleParams& params, uint32_t begin, uint32_t end) {
+	for (uint32_t i = begin; i < end; i += F::WIDTH) {
+		ParticleLanes<F> p{
+			F::load(&m_position_x[i]), F::load(&m_position_y[i]), F::load(&m_position_z[i]),
+			F::load(&m_velocity_x[i]), F::load(&m_velocity_y[i]), F::load(&m_velocity_z[i])
+		};
+		// Same dispatch as compMain, unknown modes run the massive galaxy
+		switch (params.mode) {
+			case ParticleMode::GRAVITY_EARTH: simulateGravityFloor(p, params); break;
+			case ParticleMode::COOL: coolOrbit(p, params); break;
+			case ParticleMode::SUCC: succ(p, params); break;
+			case ParticleMode::STASIS: simulateStasis(p, params); break;
+			default: simulateGalaxyMassive(p, params); break;
+		}
+		p.px.store(&m_position_x[i]); p.py.store(&m_position_y[i]); p.pz.store(&m_position_z[i]);
+		p.vx.store(&m_velocity_x[i]); p.vy.store(&m_velocity_y[i]); p.vz.store(&m_velocity_z[i]);
+	}
+}
+
+// Random streams are keyed on the particle index like resetPoint and resetDisc in the shader
+void ParticleCpuSimulator::resetRange(const ParticleParams& params, uint32_t begin, uint32_t end) {
+	for (uint32_t i = begin; i < end; ++i) {
+		uint32_t state = ((i + 1u) * 747796405u) ^ params.seed;
+		glm::vec3 position;
+		glm::vec3 velocity;
+		glm::vec3 color;
+		float scale;
+		if (params.reset_kind == ParticleResetKind::DISC) {
+			// Wide disc with a denser core, angles roughly along a spiral arm
+			scale = 0.08f + 0.10f * rand01(state);
+			const float r_max = 120.0f;
+			const float r = std::sqrt(rand01(state)) * r_max + 3.0f;
+			const float base_theta = rand01(state) * 6.2831853f;
+			const float theta = std::log(std::max(r, 1.0f)) * 2.0f + base_theta;
+			const glm::vec2 dir{std::cos(theta), std::sin(theta)};
+			const glm::vec2 xy = glm::vec2(params.origin) + dir * r;
+			position = glm::vec3(xy, params.origin.z + (rand01(state) - 0.5f) * 2.0f);
+
+			// Near circular tangential velocity with slight noise
+			const float vt = 35.0f * (1.0f - std::exp(-r / 30.0f));
+			const glm::vec2 vxy = vt * glm::vec2(-dir.y, dir.x) + randNormal2(state, params) * 0.2f;
+			velocity = glm::vec3(vxy, (rand01(state) - 0.5f) * 0.2f);
+			color = glm::mix(glm::vec3(1.0f, 0.9f, 0.8f), glm::vec3(0.6f, 0.8f, 1.0f), std::clamp(r / r_max, 0.0f, 1.0f));
+		} else {
+			// Explosion from above the origin
+			scale = 0.1f + 0.1f * rand01(state);
+			const glm::vec2 noise = randNormal2(state, params);
+			position = params.origin + glm::vec3(0.0f, 0.0f, 10.0f) + 0.1f * glm::vec3(noise.x, noise.y, noise.y);
+			const glm::vec2 vxy = randNormal2(state, params);
+			velocity = glm::vec3(vxy, randNormal2(state, params).x);
+			color.r = rand01(state);
+			color.g = rand01(state);
+			color.b = rand01(state);
+		}
+		m_position_x[i] = position.x; m_position_y[i] = position.y; m_position_z[i] = position.z;
+		m_velocity_x[i] = velocity.x; m_velocity_y[i] = velocity.y; m_velocity_z[i] = velocity.z;
+		m_size[i] = scale;
+		m_color[i] = glm::packUnorm4x8(glm::vec4(color, 1.0f));
+	}
+}
+
+Particle ParticleCpuSimulator::getParticle(uint32_t index) const {
+	assert(index < size() && "Particle index out of bounds");
+	Particle particle = Particle::pack(getPosition(index), m_size[index], getVelocity(index), glm::vec4(0.0f));
+	particle.color = m_color[index];
+	return particle;
+}
+
+void ParticleCpuSimulator::setParticle(uint32_t index, const Particle& particle) {
+	assert(index < size() && "Particle index out of bounds");
+	const glm::vec3 velocity = particle.getVelocity();
+	m_position_x[index] = particle.position.x; m_position_y[index] = particle.position.y; m_position_z[index] = particle.position.z;
+	m_velocity_x[index] = velocity.x; m_velocity_y[index] = velocity.y; m_velocity_z[index] = velocity.z;
+	m_size[index] = particle.getSize();
+	m_color[index] = particle.color;
+}
+
+glm::vec3 ParticleCpuSimulator::getPosition(uint32_t index) const {
+	assert(index < size() && "Particle index out of bounds");
+	return {m_position_x[index], m_position_y[index], m_position_z[index]};
+}
+
+glm::vec3 ParticleCpuSimulator::getVelocity(uint32_t index) const {
+	assert(index < size() && "Particle index out of bounds");
+	return {m_velocity_x[index], m_velocity_y[index], m_velocity_z[index]};
+}
+
+void ParticleCpuSimulator::pack(std::vector<Particle>& particles) const {
+	particles.resize(size());
+	for (uint32_t i = 0; i < size(); ++i) particles[i] = getParticle(i);
+}
+
+} // namespace ve
@@ -0,0 +1,68 @@
+/* ParticleCpuSimulator runs the particle modes of particle_compute.slang on the CPU, as a
+reference to check the shader against and as a fallback where compute is unavailable.
+Particles are stored as structure of arrays, so a SIMD register holds the same component
+of 4 (SSE2) or 8 (AVX2) particles and each mode is written once against a small lane
+type. Transcendentals (atan2, log, sin, exp) are evaluated per lane with the C library.
+Work is split into chunks that idle threads of a VeThreadPool pick up as they finish.
+The AVX2 path is compiled in with VE_ENABLE_AVX2, SSE2 is used on other x86-64 builds
+and the scalar path everywhere else (e.g. arm64). Reset and step use the same
+ParticleParams and Wang hash as the shader, FLUID needs the neighbor grid and is GPU only. */
+#pragma once
+#include "ve_export.hpp"
+#include "systems/particle_system.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace ve {
+
+class VeThreadPool;
+
+class VENGINE_API ParticleCpuSimulator {
+public:
+	enum Path : uint32_t {
+		PATH_SCALAR = 0,
+		PATH_SSE2 = 1,
+		PATH_AVX2 = 2
+	};
+	// Particles per parallelFor iteration, a multiple of every SIMD width
+	static constexpr uint32_t CHUNK_SIZE = 4096;
+
+	ParticleCpuSimulator() = default;
+
+	void resize(uint32_t count);
+	uint32_t size() const { return static_cast<uint32_t>(m_position_x.size()); }
+
+	// Initializes the particles from params.reset_first like the reset dispatch, params.reset_kind selects the layout
+	void reset(const ParticleParams& params, VeThreadPool* pool = nullptr);
+	// Advances every particle by params.delta_time in params.mode, with the widest available path.
+	// Without a pool the chunks run on the calling thread.
+	void simulate(const ParticleParams& params, VeThreadPool* pool = nullptr);
+	// Same with a given path, which must be available in this build
+	void simulate(const ParticleParams& params, Path path, VeThreadPool* pool = nullptr);
+
+	// Packed like the storage buffers, velocity and size lose precision to halfs
+	Particle getParticle(uint32_t index) const;
+	void setParticle(uint32_t index, const Particle& particle);
+	glm::vec3 getPosition(uint32_t index) const;
+	glm::vec3 getVelocity(uint32_t index) const;
+	// Packs every particle into particles, e.g. for an upload into a storage buffer
+	void pack(std::vector<Particle>& particles) const;
+
+	static Path getBestPath();
+	static bool isPathAvailable(Path path);
+	static const char* getPathName(Path path);
+
+private:
+	void resetRange(const ParticleParams& params, uint32_t begin, uint32_t end);
+	void simulateRange(const ParticleParams& params, Path path, uint32_t begin, uint32_t end);
+	template <typename F>
+	void simulateLanes(const ParticleParams& params, uint32_t begin, uint32_t end);
+
+	std::vector<float> m_position_x, m_position_y, m_position_z;
+	std::vector<float> m_velocity_x, m_velocity_y, m_velocity_z;
+	std::vector<float> m_size;
+	std::vector<uint32_t> m_color; // rgba8 unorm, not changed by the simulation
+};
+
+} // namespace ve
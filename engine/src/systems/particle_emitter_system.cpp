@@ -0,0 +1,274 @@
+#include "pch.hpp"
+#include "systems/particle_emitter_system.hpp"
+#include "systems/particle_system.hpp"
+#include "core/ve_uploader.hpp"
+#include "core/ve_render_queue.hpp"
+
+#include <chrono>
+#include <cmath>
+
+namespace ve {
+
+// Layout must match EmitterPushConstants in particle_emitter_kernel.slang
+struct EmitterPushConstants {
+	uint32_t pass;
+	uint32_t emit_count;
+	uint32_t capacity;
+	uint32_t parity;
+	alignas(16) glm::vec3 origin;
+	float delta_time;
+	float lifetime;
+	float speed;
+	float size;
+	uint32_t seed;
+};
+static_assert(sizeof(EmitterPushConstants) == 48, "EmitterPushConstants size mismatch");
+
+namespace {
+
+// Counters of particle_emitter_kernel.slang: dead, two alive, emitted and first emitted slot
+constexpr uint32_t COUNTER_ALIVE = 1; // + alive list index
+constexpr uint32_t COUNTER_COUNT = 5;
+// The draw command comes first in the indirect buffer, then the dispatch command
+constexpr vk::DeviceSize INDIRECT_DISPATCH_OFFSET = sizeof(vk::DrawIndirectCommand);
+
+void memoryBarrier(
+	vk::CommandBuffer command_buffer,
+	vk::PipelineStageFlags2 src_stage,
+	vk::AccessFlags2 src_access,
+	vk::PipelineStageFlags2 dst_stage,
+	vk::AccessFlags2 dst_access) {
+	vk::MemoryBarrier2 barrier{
+		.srcStageMask = src_stage,
+		.srcAccessMask = src_access,
+		.dstStageMask = dst_stage,
+		.dstAccessMask = dst_access
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier });
+}
+
+// Makes the writes of the previous pass visible to the next compute pass, and to its
+// indirect dispatch
+void computeBarrier(vk::CommandBuffer command_buffer) {
+	memoryBarrier(command_buffer,
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+		vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect,
+		vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eIndirectCommandRead);
+}
+
+} // namespace
+
+ParticleEmitterSystem::ParticleEmitterSystem(
+	VeDevice& device,
+	std::shared_ptr<VeDescriptorPool> descriptor_pool,
+	const vk::raii::DescriptorSetLayout& global_set_layout,
+	uint32_t capacity,
+	glm::vec3 origin,
+	std::filesystem::path kernel_path,
+	std::filesystem::path shader_path)
+	: m_ve_device(device), m_descriptor_pool(std::move(descriptor_pool)),
+	  m_capacity(std::max(capacity, 1u)), m_origin(origin) {
+	VE_LOGI("ParticleEmitterSystem constructor: capacity=" << m_capacity);
+	createBuffers();
+	createDescriptorSets();
+	createComputePipeline(kernel_path);
+	createPipeline(global_set_layout, shader_path);
+}
+
+ParticleEmitterSystem::~ParticleEmitterSystem() {}
+
+// Only the indirect buffers are zeroed, a draw of zero instances until the first update.
+// The lists and counters are initialized by the reset pass.
+void ParticleEmitterSystem::createBuffers() {
+	const auto storage = vk::BufferUsageFlagBits::eStorageBuffer;
+	const auto device_local = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	m_particles = std::make_unique<VeBuffer>(m_ve_device, sizeof(EmitterParticle), m_capacity, storage, device_local);
+	m_dead_list = std::make_unique<VeBuffer>(m_ve_device, sizeof(uint32_t), m_capacity, storage, device_local);
+	m_alive_lists = std::make_unique<VeBuffer>(m_ve_device, sizeof(uint32_t), 2 * m_capacity, storage, device_local);
+	// Transfer src so the alive count can be copied out and tests can read the results back
+	m_counters = std::make_unique<VeBuffer>(m_ve_device, sizeof(uint32_t), COUNTER_COUNT,
+		storage | vk::BufferUsageFlagBits::eTransferSrc, device_local);
+
+	m_indirect.clear();
+	m_vertices.clear();
+	m_stats.clear();
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		auto indirect = std::make_unique<VeBuffer>(m_ve_device, INDIRECT_DISPATCH_OFFSET + sizeof(vk::DispatchIndirectCommand), 1,
+			storage | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
+			device_local);
+		m_ve_device.getUploader().fillBuffer(*indirect->getBuffer(), 0, indirect->getBufferSize(), 0u);
+		m_indirect.push_back(std::move(indirect));
+		m_vertices.push_back(std::make_unique<VeBuffer>(m_ve_device, sizeof(ParticleVertex), m_capacity,
+			storage | vk::BufferUsageFlagBits::eVertexBuffer, device_local));
+
+		auto stats = std::make_unique<VeBuffer>(m_ve_device, sizeof(uint32_t), 1,
+			vk::BufferUsageFlagBits::eTransferDst,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		stats->map();
+		*static_cast<uint32_t*>(stats->getMappedMemory()) = 0;
+		m_stats.push_back(std::move(stats));
+	}
+}
+
+// Particles, dead list, alive lists, counters, indirect commands and the render stream,
+// one set per frame that differs in the last two
+void ParticleEmitterSystem::createDescriptorSets() {
+	VeDescriptorSetLayout::Builder builder(m_ve_device);
+	for (uint32_t binding = 0; binding < 6; ++binding)
+		builder.addBinding(binding, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute);
+	m_kernel_set_layout = builder.build();
+
+	auto particles_info = m_particles->getDescriptorInfo();
+	auto dead_info = m_dead_list->getDescriptorInfo();
+	auto alive_info = m_alive_lists->getDescriptorInfo();
+	auto counters_info = m_counters->getDescriptorInfo();
+	m_kernel_sets.clear();
+	m_kernel_sets.reserve(MAX_FRAMES_IN_FLIGHT);
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		vk::raii::DescriptorSet set{nullptr};
+		auto indirect_info = m_indirect[i]->getDescriptorInfo();
+		auto vertices_info = m_vertices[i]->getDescriptorInfo();
+		VeDescriptorWriter(*m_kernel_set_layout, *m_descriptor_pool)
+			.writeBuffer(0, &particles_info)
+			.writeBuffer(1, &dead_info)
+			.writeBuffer(2, &alive_info)
+			.writeBuffer(3, &counters_info)
+			.writeBuffer(4, &indirect_info)
+			.writeBuffer(5, &vertices_info)
+			.build(set);
+		m_kernel_sets.push_back(std::move(set));
+	}
+}
+
+void ParticleEmitterSystem::createComputePipeline(const std::filesystem::path& kernel_path) {
+	vk::PushConstantRange push_constant_range{
+		.stageFlags = vk::ShaderStageFlagBits::eCompute,
+		.offset = 0,
+		.size = sizeof(EmitterPushConstants)
+	};
+	vk::PipelineLayoutCreateInfo pipeline_layout_info{
+		.setLayoutCount = 1,
+		.pSetLayouts = &*m_kernel_set_layout->getDescriptorSetLayout(),
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constant_range
+	};
+	m_compute_pipeline_layout = vk::raii::PipelineLayout(m_ve_device.getDevice(), pipeline_layout_info);
+	m_compute_pipeline = std::make_unique<VeComputePipeline>(m_ve_device, kernel_path, m_compute_pipeline_layout);
+}
+
+// The stream is drawn like the in place particles, with the same shader and blend state
+void ParticleEmitterSystem::createPipeline(const vk::raii::DescriptorSetLayout& global_set_layout, const std::filesystem::path& shader_path) {
+	vk::PipelineLayoutCreateInfo pipeline_layout_info{
+		.setLayoutCount = 1,
+		.pSetLayouts = &*global_set_layout
+	};
+	m_pipeline_layout = vk::raii::PipelineLayout(m_ve_device.getDevice(), pipeline_layout_info);
+
+	PipelineConfigInfo config{};
+	ParticleSystem::defaultPipelineConfigInfo(config, m_ve_device, ParticleStorageMode::IN_PLACE);
+	config.pipeline_layout = m_pipeline_layout;
+	m_pipeline = std::make_unique<VePipeline>(m_ve_device, shader_path, config);
+}
+
+uint32_t ParticleEmitterSystem::getLastAliveCount(uint32_t frame_index) const {
+	assert(frame_index < MAX_FRAMES_IN_FLIGHT && "frame_index out of bounds");
+	return *static_cast<const uint32_t*>(m_stats[frame_index]->getMappedMemory());
+}
+
+vk::DeviceSize ParticleEmitterSystem::getMemoryUsage() const {
+	vk::DeviceSize size = m_particles->getBufferSize() + m_dead_list->getBufferSize() + m_alive_lists->getBufferSize() +
+		m_counters->getBufferSize();
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+		size += m_indirect[i]->getBufferSize() + m_vertices[i]->getBufferSize();
+	return size;
+}
+
+void ParticleEmitterSystem::dispatch(vk::CommandBuffer command_buffer, Pass pass, uint32_t group_count, uint32_t emit_count, float delta_time) {
+	const EmitterPushConstants push{
+		.pass = pass,
+		.emit_count = emit_count,
+		.capacity = m_capacity,
+		.parity = m_parity,
+		.origin = m_origin,
+		.delta_time = delta_time,
+		.lifetime = m_lifetime,
+		.speed = m_speed,
+		.size = m_size,
+		.seed = m_seed
+	};
+	command_buffer.pushConstants<EmitterPushConstants>(*m_compute_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, push);
+	if (group_count > 0)
+		command_buffer.dispatch(group_count, 1, 1);
+}
+
+void ParticleEmitterSystem::update(VeFrameInfo& frame_info) {
+	assert(frame_info.frame_time >= 0.0f && "delta_time should be non-negative");
+	m_emit_accumulator += m_emit_rate * frame_info.frame_time;
+	// A long hitch emits at most a pool full
+	const float emit = std::min(std::floor(m_emit_accumulator), static_cast<float>(m_capacity));
+	m_emit_accumulator -= std::floor(m_emit_accumulator);
+	const uint32_t emit_count = std::min(static_cast<uint32_t>(emit) + m_pending_burst, m_capacity);
+	m_pending_burst = 0;
+	record(*frame_info.compute_command_buffer, frame_info.current_frame, emit_count, frame_info.frame_time);
+}
+
+void ParticleEmitterSystem::record(vk::CommandBuffer command_buffer, uint32_t frame_index, uint32_t emit_count, float delta_time) {
+	assert(frame_index < MAX_FRAMES_IN_FLIGHT && "frame_index out of bounds");
+	const auto compute = vk::PipelineStageFlagBits2::eComputeShader;
+
+	// The frame's indirect buffer and stream were last drawn by the graphics work of the frame
+	// that used them before, the timeline semaphore makes the compute work wait for it
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_compute_pipeline->getPipeline());
+	command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *m_compute_pipeline_layout, 0, *m_kernel_sets[frame_index], {});
+	if (m_pending_reset) {
+		m_pending_reset = false;
+		m_parity = 0;
+		dispatch(command_buffer, PASS_RESET, (m_capacity + GROUP_SIZE - 1) / GROUP_SIZE, 0, delta_time);
+		computeBarrier(command_buffer);
+	}
+	auto now = std::chrono::high_resolution_clock::now().time_since_epoch();
+	m_seed = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+
+	dispatch(command_buffer, PASS_BEGIN, 1, emit_count, delta_time);
+	computeBarrier(command_buffer);
+	dispatch(command_buffer, PASS_EMIT, (emit_count + GROUP_SIZE - 1) / GROUP_SIZE, emit_count, delta_time);
+	computeBarrier(command_buffer);
+	// Sized by the alive count, nothing runs for an empty pool
+	dispatch(command_buffer, PASS_SIMULATE, 0, emit_count, delta_time);
+	command_buffer.dispatchIndirect(*m_indirect[frame_index]->getBuffer(), INDIRECT_DISPATCH_OFFSET);
+	computeBarrier(command_buffer);
+	dispatch(command_buffer, PASS_FINISH, 1, emit_count, delta_time);
+
+	// The stats copy the output alive count. The draw on the graphics queue is ordered by the
+	// timeline semaphore, vertex input stages are not available on a compute-only queue.
+	memoryBarrier(command_buffer,
+		compute, vk::AccessFlagBits2::eShaderStorageWrite,
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead);
+	const uint32_t alive_out = COUNTER_ALIVE + 1 - m_parity;
+	command_buffer.copyBuffer(*m_counters->getBuffer(), *m_stats[frame_index]->getBuffer(),
+		vk::BufferCopy{ sizeof(uint32_t) * alive_out, 0, sizeof(uint32_t) });
+	memoryBarrier(command_buffer,
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead);
+	m_parity = 1 - m_parity;
+}
+
+// A single indirect draw of the alive particles, the instance count was written by the last update
+void ParticleEmitterSystem::render(VeFrameInfo& frame_info) const {
+	frame_info.render_queue.submit(VeRenderQueue::PASS_OIT, frame_info.render_queue.getViewDepth(m_origin), VeDrawPacket{
+		.type = VeDrawPacket::DRAW_INDIRECT,
+		.pipeline = m_pipeline->getPipeline(frame_info.sample_count),
+		.pipeline_layout = *m_pipeline_layout,
+		.descriptor_sets = {*frame_info.global_descriptor_set},
+		.descriptor_set_count = 1,
+		.dynamic_offset = frame_info.global_ubo_offset,
+		.vertex_buffers = {*m_vertices[frame_info.current_frame]->getBuffer()},
+		.vertex_buffer_count = 1,
+		.indirect_buffer = *m_indirect[frame_info.current_frame]->getBuffer(),
+		.indirect_offset = 0,
+		.max_draw_count = 1,
+		.stride = sizeof(vk::DrawIndirectCommand)
+	});
+}
+
+} // namespace ve
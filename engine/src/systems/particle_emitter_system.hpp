@@ -0,0 +1,121 @@
+/* ParticleEmitterSystem keeps a pool of particles with lifetimes on the GPU. Free slots
+sit in a dead list and live ones in an alive list, both managed by atomic counters in
+particle_emitter_kernel.slang. Each update emits from the dead list, simulates the alive
+particles and compacts the survivors into a new alive list and a ParticleVertex stream,
+then writes the instance count of an indirect draw. The simulation is dispatched
+indirectly from the alive count, so an idle pool of millions of particles costs a few
+single thread dispatches. Work is recorded into the frame's compute command buffer. The
+pool and lists are only used by compute work, which runs in submission order, while the
+stream and indirect buffer drawn by graphics are kept per frame in flight so the update
+of a frame may run alongside the draw of the previous one. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+#include "core/ve_buffer.hpp"
+#include "core/ve_descriptors.hpp"
+#include "core/ve_pipeline.hpp"
+#include "core/ve_compute_pipeline.hpp"
+#include "game/ve_frame_info.hpp"
+
+#include <memory>
+#include <vector>
+#include <filesystem>
+
+namespace ve {
+
+// Layout must match EmitterParticle in particle_emitter_kernel.slang
+struct EmitterParticle {
+	glm::vec4 position; // w is size
+	glm::vec4 velocity; // w is age in seconds
+	glm::vec4 color;    // a is lifetime in seconds
+};
+static_assert(sizeof(EmitterParticle) == 48, "EmitterParticle layout must match particle_emitter_kernel.slang");
+
+class VENGINE_API ParticleEmitterSystem {
+public:
+	enum Pass : uint32_t {
+		PASS_RESET = 0,
+		PASS_BEGIN = 1,
+		PASS_EMIT = 2,
+		PASS_SIMULATE = 3,
+		PASS_FINISH = 4
+	};
+	static constexpr uint32_t GROUP_SIZE = 256;
+
+	// kernel_path is the emitter kernel, shader_path the particle shader the stream is drawn with
+	ParticleEmitterSystem(
+		VeDevice& device,
+		std::shared_ptr<VeDescriptorPool> descriptor_pool,
+		const vk::raii::DescriptorSetLayout& global_set_layout,
+		uint32_t capacity,
+		glm::vec3 origin,
+		std::filesystem::path kernel_path,
+		std::filesystem::path shader_path);
+	~ParticleEmitterSystem();
+
+	ParticleEmitterSystem(const ParticleEmitterSystem&) = delete;
+	ParticleEmitterSystem& operator=(const ParticleEmitterSystem&) = delete;
+
+	// Emits rate * frame_time particles plus pending bursts, while dead slots last
+	void update(VeFrameInfo& frame_info);
+	void render(VeFrameInfo& frame_info) const;
+	// Records the passes of one update, the output alive list is the input of the next
+	void record(vk::CommandBuffer command_buffer, uint32_t frame_index, uint32_t emit_count, float delta_time);
+
+	// Kills every particle on the next update
+	void clear() { m_pending_reset = true; }
+	// Emits count particles on the next update
+	void burst(uint32_t count) { m_pending_burst += count; }
+	void setEmitRate(float particles_per_second) { m_emit_rate = particles_per_second; }
+	float getEmitRate() const { return m_emit_rate; }
+	void setLifetime(float seconds) { m_lifetime = seconds; }
+	void setOrigin(glm::vec3 origin) { m_origin = origin; }
+	uint32_t getCapacity() const { return m_capacity; }
+	// Alive particles after the last record for frame_index, only valid once that frame's fence signaled
+	uint32_t getLastAliveCount(uint32_t frame_index) const;
+	// Bytes of emitter buffers allocated on the device
+	vk::DeviceSize getMemoryUsage() const;
+	// Read back buffers for tests and debug tools
+	vk::Buffer getCounterBuffer() const { return *m_counters->getBuffer(); }
+	vk::Buffer getIndirectBuffer(uint32_t frame_index = 0) const { return *m_indirect[frame_index]->getBuffer(); }
+
+private:
+	void createBuffers();
+	void createDescriptorSets();
+	void createComputePipeline(const std::filesystem::path& kernel_path);
+	void createPipeline(const vk::raii::DescriptorSetLayout& global_set_layout, const std::filesystem::path& shader_path);
+	void dispatch(vk::CommandBuffer command_buffer, Pass pass, uint32_t group_count, uint32_t emit_count, float delta_time);
+
+	VeDevice& m_ve_device;
+	std::shared_ptr<VeDescriptorPool> m_descriptor_pool;
+
+	uint32_t m_capacity;
+	glm::vec3 m_origin;
+	float m_emit_rate = 20000.0f; // particles per second
+	float m_emit_accumulator = 0.0f; // fraction of a particle carried to the next update
+	float m_lifetime = 2.0f;
+	float m_speed = 12.0f;
+	float m_size = 0.15f;
+	uint32_t m_pending_burst = 0;
+	bool m_pending_reset = true; // the lists are initialized on the GPU by the first update
+	uint32_t m_parity = 0; // input alive list of the next record
+	uint32_t m_seed = 0;
+
+	std::unique_ptr<VeBuffer> m_particles;
+	std::unique_ptr<VeBuffer> m_dead_list;
+	std::unique_ptr<VeBuffer> m_alive_lists; // two lists of capacity slots
+	std::unique_ptr<VeBuffer> m_counters;    // dead count, two alive counts, emission
+	// Per-frame resources
+	std::vector<std::unique_ptr<VeBuffer>> m_indirect; // draw then dispatch command
+	std::vector<std::unique_ptr<VeBuffer>> m_vertices; // compact render stream of the alive particles
+	std::vector<std::unique_ptr<VeBuffer>> m_stats;    // host visible alive count
+
+	std::unique_ptr<VeDescriptorSetLayout> m_kernel_set_layout;
+	std::vector<vk::raii::DescriptorSet> m_kernel_sets; // per frame, with its stream and indirect buffer
+	vk::raii::PipelineLayout m_compute_pipeline_layout{nullptr};
+	std::unique_ptr<VeComputePipeline> m_compute_pipeline;
+	vk::raii::PipelineLayout m_pipeline_layout{nullptr};
+	std::unique_ptr<VePipeline> m_pipeline;
+};
+
+} // namespace ve
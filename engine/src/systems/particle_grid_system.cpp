@@ -0,0 +1,234 @@
+#include "pch.hpp"
+#include "systems/particle_grid_system.hpp"
+#include "core/ve_uploader.hpp"
+#include "core/ve_retirement_queue.hpp"
+
+namespace ve {
+
+// Layout must match GridPushConstants in particle_grid_kernel.slang
+struct GridPushConstants {
+	uint32_t pass;
+	uint32_t particle_count;
+	float cell_size;
+	float radius;
+};
+static_assert(sizeof(GridPushConstants) == 16, "GridPushConstants size mismatch");
+
+// Layout must match GridParticle in particle_grid_kernel.slang
+struct GridParticle {
+	glm::vec4 position;
+	glm::vec4 velocity;
+};
+
+namespace {
+
+void memoryBarrier(
+	vk::CommandBuffer command_buffer,
+	vk::PipelineStageFlags2 src_stage,
+	vk::AccessFlags2 src_access,
+	vk::PipelineStageFlags2 dst_stage,
+	vk::AccessFlags2 dst_access) {
+	vk::MemoryBarrier2 barrier{
+		.srcStageMask = src_stage,
+		.srcAccessMask = src_access,
+		.dstStageMask = dst_stage,
+		.dstAccessMask = dst_access
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier });
+}
+
+// Makes the writes of the previous pass visible to the next compute pass
+void computeBarrier(vk::CommandBuffer command_buffer, vk::PipelineStageFlags2 src_stage, vk::AccessFlags2 src_access) {
+	memoryBarrier(command_buffer, src_stage, src_access,
+		vk::PipelineStageFlagBits2::eComputeShader,
+		vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+}
+
+} // namespace
+
+ParticleGridSystem::ParticleGridSystem(
+	VeDevice& device,
+	std::shared_ptr<VeDescriptorPool> descriptor_pool,
+	std::filesystem::path kernel_path,
+	uint32_t initial_capacity)
+	: m_ve_device(device), m_descriptor_pool(std::move(descriptor_pool)),
+	  m_capacity(std::max(initial_capacity, 1u)) {
+	createDescriptorSetLayouts();
+	createTableBuffers();
+	createParticleBuffers();
+	createDescriptorSets();
+	createPipelineLayout();
+	m_pipeline = std::make_unique<VeComputePipeline>(m_ve_device, kernel_path, m_pipeline_layout);
+}
+
+ParticleGridSystem::~ParticleGridSystem() {}
+
+uint32_t ParticleGridSystem::hashCell(glm::ivec3 cell) {
+	const uint32_t hash = (static_cast<uint32_t>(cell.x) * 73856093u) ^
+		(static_cast<uint32_t>(cell.y) * 19349663u) ^
+		(static_cast<uint32_t>(cell.z) * 83492791u);
+	return hash & (PARTICLE_GRID_CELLS - 1u);
+}
+
+// Kernel set: source particles, bucket counts, bucket starts, block sums, particle cells,
+// sorted particles and neighbor counts
+// Query set: bucket starts, bucket counts and sorted particles for simulation shaders
+void ParticleGridSystem::createDescriptorSetLayouts() {
+	VeDescriptorSetLayout::Builder kernel_builder(m_ve_device);
+	for (uint32_t binding = 0; binding < 7; ++binding)
+		kernel_builder.addBinding(binding, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute);
+	m_kernel_set_layout = kernel_builder.build();
+	m_query_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
+		.addBinding(0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.addBinding(1, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.addBinding(2, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.build();
+}
+
+// Transfer src so tests and debug tools can read the grid back
+void ParticleGridSystem::createTableBuffers() {
+	const auto usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+	m_cell_counts = std::make_unique<VeBuffer>(m_ve_device, sizeof(uint32_t), PARTICLE_GRID_CELLS, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_cell_start = std::make_unique<VeBuffer>(m_ve_device, sizeof(uint32_t), PARTICLE_GRID_CELLS, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_block_sums = std::make_unique<VeBuffer>(m_ve_device, sizeof(uint32_t), PARTICLE_GRID_CELLS / SCAN_BLOCK, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	// The query set may be bound before the first build, start with empty buckets
+	m_ve_device.getUploader().fillBuffer(*m_cell_counts->getBuffer(), 0, m_cell_counts->getBufferSize(), 0u);
+	m_ve_device.getUploader().fillBuffer(*m_cell_start->getBuffer(), 0, m_cell_start->getBufferSize(), 0u);
+}
+
+// Replaced buffers may still be used by frames in flight, they are retired
+void ParticleGridSystem::createParticleBuffers() {
+	VeRetirementQueue& retirement = m_ve_device.getRetirementQueue();
+	for (auto* buffer : { &m_particle_cells, &m_sorted, &m_neighbor_counts }) {
+		if (*buffer)
+			retirement.retire(std::move(*buffer));
+	}
+	const auto usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc;
+	m_particle_cells = std::make_unique<VeBuffer>(m_ve_device, sizeof(glm::uvec2), m_capacity, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_sorted = std::make_unique<VeBuffer>(m_ve_device, sizeof(GridParticle), m_capacity, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_neighbor_counts = std::make_unique<VeBuffer>(m_ve_device, sizeof(uint32_t), m_capacity, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
+
+void ParticleGridSystem::createDescriptorSets() {
+	VeRetirementQueue& retirement = m_ve_device.getRetirementQueue();
+	for (auto& set : m_kernel_sets)
+		retirement.retire(std::move(set), m_descriptor_pool);
+	if (*m_query_set)
+		retirement.retire(std::move(m_query_set), m_descriptor_pool);
+	m_kernel_sets.clear();
+	m_kernel_sets.reserve(m_sources.size());
+	auto counts_info = m_cell_counts->getDescriptorInfo();
+	auto start_info = m_cell_start->getDescriptorInfo();
+	auto sums_info = m_block_sums->getDescriptorInfo();
+	auto cells_info = m_particle_cells->getDescriptorInfo();
+	auto sorted_info = m_sorted->getDescriptorInfo();
+	auto neighbors_info = m_neighbor_counts->getDescriptorInfo();
+	for (VeBuffer* source : m_sources) {
+		vk::raii::DescriptorSet set{nullptr};
+		auto particles_info = source->getDescriptorInfo();
+		VeDescriptorWriter(*m_kernel_set_layout, *m_descriptor_pool)
+			.writeBuffer(0, &particles_info)
+			.writeBuffer(1, &counts_info)
+			.writeBuffer(2, &start_info)
+			.writeBuffer(3, &sums_info)
+			.writeBuffer(4, &cells_info)
+			.writeBuffer(5, &sorted_info)
+			.writeBuffer(6, &neighbors_info)
+			.build(set);
+		m_kernel_sets.push_back(std::move(set));
+	}
+	m_query_set = nullptr;
+	VeDescriptorWriter(*m_query_set_layout, *m_descriptor_pool)
+		.writeBuffer(0, &start_info)
+		.writeBuffer(1, &counts_info)
+		.writeBuffer(2, &sorted_info)
+		.build(m_query_set);
+}
+
+void ParticleGridSystem::createPipelineLayout() {
+	vk::PushConstantRange push_constant_range{
+		.stageFlags = vk::ShaderStageFlagBits::eCompute,
+		.offset = 0,
+		.size = sizeof(GridPushConstants)
+	};
+	vk::PipelineLayoutCreateInfo pipeline_layout_info{
+		.setLayoutCount = 1,
+		.pSetLayouts = &*m_kernel_set_layout->getDescriptorSetLayout(),
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constant_range
+	};
+	m_pipeline_layout = vk::raii::PipelineLayout(m_ve_device.getDevice(), pipeline_layout_info);
+}
+
+void ParticleGridSystem::setParticleBuffers(const std::vector<std::unique_ptr<VeBuffer>>& buffers) {
+	m_sources.clear();
+	for (const auto& buffer : buffers)
+		m_sources.push_back(buffer.get());
+	createDescriptorSets();
+}
+
+// Grows to at least double the old capacity, the old buffers are retired
+void ParticleGridSystem::reserve(uint32_t particle_count) {
+	if (particle_count <= m_capacity) return;
+	m_capacity = std::max(particle_count, m_capacity * 2);
+	VE_LOGI("ParticleGridSystem: growing to " << m_capacity << " particles");
+	createParticleBuffers();
+	createDescriptorSets();
+}
+
+vk::DeviceSize ParticleGridSystem::getMemoryUsage() const {
+	return m_cell_counts->getBufferSize() + m_cell_start->getBufferSize() + m_block_sums->getBufferSize() +
+		m_particle_cells->getBufferSize() + m_sorted->getBufferSize() + m_neighbor_counts->getBufferSize();
+}
+
+void ParticleGridSystem::dispatch(vk::CommandBuffer command_buffer, Pass pass, uint32_t group_count, uint32_t particle_count, float cell_size, float radius) {
+	const GridPushConstants push{
+		.pass = pass,
+		.particle_count = particle_count,
+		.cell_size = cell_size,
+		.radius = radius
+	};
+	command_buffer.pushConstants<GridPushConstants>(*m_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, push);
+	if (group_count > 0)
+		command_buffer.dispatch(group_count, 1, 1);
+}
+
+void ParticleGridSystem::record(vk::CommandBuffer command_buffer, uint32_t source, uint32_t particle_count, float cell_size) {
+	assert(source < m_kernel_sets.size() && "source buffer out of bounds");
+	assert(particle_count <= m_capacity && "reserve the grid before recording");
+	assert(cell_size > 0.0f && "cell size must be positive");
+	const uint32_t particle_groups = (particle_count + GROUP_SIZE - 1) / GROUP_SIZE; // ceilDiv
+
+	// Previous builds and queries may still read the buckets
+	memoryBarrier(command_buffer,
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead,
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite);
+	command_buffer.fillBuffer(*m_cell_counts->getBuffer(), 0, VK_WHOLE_SIZE, 0u);
+	computeBarrier(command_buffer, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite);
+
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline->getPipeline());
+	command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *m_pipeline_layout, 0, *m_kernel_sets[source], {});
+	const auto storage_write = vk::AccessFlagBits2::eShaderStorageWrite;
+	const auto compute = vk::PipelineStageFlagBits2::eComputeShader;
+	dispatch(command_buffer, PASS_COUNT, particle_groups, particle_count, cell_size, 0.0f);
+	computeBarrier(command_buffer, compute, storage_write);
+	dispatch(command_buffer, PASS_SCAN_BLOCKS, PARTICLE_GRID_CELLS / SCAN_BLOCK, particle_count, cell_size, 0.0f);
+	computeBarrier(command_buffer, compute, storage_write);
+	dispatch(command_buffer, PASS_SCAN_SUMS, 1, particle_count, cell_size, 0.0f);
+	computeBarrier(command_buffer, compute, storage_write);
+	dispatch(command_buffer, PASS_ADD_OFFSETS, PARTICLE_GRID_CELLS / GROUP_SIZE, particle_count, cell_size, 0.0f);
+	computeBarrier(command_buffer, compute, storage_write);
+	dispatch(command_buffer, PASS_SCATTER, particle_groups, particle_count, cell_size, 0.0f);
+	computeBarrier(command_buffer, compute, storage_write);
+}
+
+void ParticleGridSystem::recordQuery(vk::CommandBuffer command_buffer, uint32_t source, uint32_t particle_count, float cell_size, float radius) {
+	assert(source < m_kernel_sets.size() && "source buffer out of bounds");
+	assert(radius <= cell_size && "the 27 cells around a particle only cover a radius up to the cell size");
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline->getPipeline());
+	command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *m_pipeline_layout, 0, *m_kernel_sets[source], {});
+	dispatch(command_buffer, PASS_QUERY, (particle_count + GROUP_SIZE - 1) / GROUP_SIZE, particle_count, cell_size, radius);
+	computeBarrier(command_buffer, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite);
+}
+
+} // namespace ve
@@ -0,0 +1,105 @@
+/* ParticleGridSystem sorts particles into a uniform grid on the GPU so simulations can
+find their neighbors. Grid cells are hashed into PARTICLE_GRID_CELLS buckets, which keeps
+the grid unbounded at a fixed table size. The build is a counting sort in five dispatches
+of particle_grid_kernel.slang: count particles per bucket, scan the counts in blocks, scan
+the block sums, add them to the bucket starts and scatter position and velocity into
+bucket order. Everything but the scans is one thread per particle, so the build scales
+linearly with the particle count. Shaders bind the query set (bucket starts, bucket counts
+and sorted particles) and visit the 27 cells around a position. Work is recorded into the
+frame's compute command buffer, there is one grid for all frames since only compute work
+uses it and that runs in submission order on its queue. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+#include "core/ve_buffer.hpp"
+#include "core/ve_descriptors.hpp"
+#include "core/ve_compute_pipeline.hpp"
+
+#include <memory>
+#include <vector>
+#include <filesystem>
+
+namespace ve {
+
+class VENGINE_API ParticleGridSystem {
+public:
+	enum Pass : uint32_t {
+		PASS_COUNT = 0,
+		PASS_SCAN_BLOCKS = 1,
+		PASS_SCAN_SUMS = 2,
+		PASS_ADD_OFFSETS = 3,
+		PASS_SCATTER = 4,
+		PASS_QUERY = 5
+	};
+	static constexpr uint32_t GROUP_SIZE = 256;
+	static constexpr uint32_t SCAN_BLOCK = GROUP_SIZE * 4; // buckets scanned per group
+	static_assert(PARTICLE_GRID_CELLS == SCAN_BLOCK * GROUP_SIZE, "the block sums are scanned by a single group");
+
+	ParticleGridSystem(
+		VeDevice& device,
+		std::shared_ptr<VeDescriptorPool> descriptor_pool,
+		std::filesystem::path kernel_path,
+		uint32_t initial_capacity = 1);
+	~ParticleGridSystem();
+
+	ParticleGridSystem(const ParticleGridSystem&) = delete;
+	ParticleGridSystem& operator=(const ParticleGridSystem&) = delete;
+
+	// Bucket of a cell, the same hash as particle_grid_kernel.slang
+	static uint32_t hashCell(glm::ivec3 cell);
+
+	// Buffers of Particle the grid can be built from, a kernel set is written for each.
+	// The replaced sets are retired, frames in flight may still use them.
+	void setParticleBuffers(const std::vector<std::unique_ptr<VeBuffer>>& buffers);
+	// Grows the per particle buffers, the replaced ones are retired
+	void reserve(uint32_t particle_count);
+	// Records the build from the first particle_count particles of source buffer, followed
+	// by a barrier that makes the grid visible to later compute shaders
+	void record(vk::CommandBuffer command_buffer, uint32_t source, uint32_t particle_count, float cell_size);
+	// Records the count of neighbors within radius of every particle into the neighbor
+	// count buffer, after record. Radius must not exceed the cell size.
+	void recordQuery(vk::CommandBuffer command_buffer, uint32_t source, uint32_t particle_count, float cell_size, float radius);
+
+	// Set layout of the bucket starts (0), bucket counts (1) and sorted particles (2)
+	const vk::raii::DescriptorSetLayout& getQuerySetLayout() const { return m_query_set_layout->getDescriptorSetLayout(); }
+	vk::DescriptorSet getQuerySet() const { return *m_query_set; }
+	uint32_t getCapacity() const { return m_capacity; }
+	// Bytes of grid buffers allocated on the device
+	vk::DeviceSize getMemoryUsage() const;
+	// Read back buffers for tests and debug tools
+	vk::Buffer getCellCountBuffer() { return *m_cell_counts->getBuffer(); }
+	vk::Buffer getCellStartBuffer() { return *m_cell_start->getBuffer(); }
+	vk::Buffer getSortedBuffer() { return *m_sorted->getBuffer(); }
+	vk::Buffer getNeighborCountBuffer() { return *m_neighbor_counts->getBuffer(); }
+
+private:
+	void createDescriptorSetLayouts();
+	void createTableBuffers();
+	void createParticleBuffers();
+	void createDescriptorSets();
+	void createPipelineLayout();
+	void dispatch(vk::CommandBuffer command_buffer, Pass pass, uint32_t group_count, uint32_t particle_count, float cell_size, float radius);
+
+	VeDevice& m_ve_device;
+	std::shared_ptr<VeDescriptorPool> m_descriptor_pool;
+
+	uint32_t m_capacity; // particles
+
+	std::unique_ptr<VeDescriptorSetLayout> m_kernel_set_layout;
+	std::unique_ptr<VeDescriptorSetLayout> m_query_set_layout;
+	std::vector<VeBuffer*> m_sources; // not owned, set by setParticleBuffers
+	std::vector<vk::raii::DescriptorSet> m_kernel_sets;
+	vk::raii::DescriptorSet m_query_set{nullptr};
+
+	std::unique_ptr<VeBuffer> m_cell_counts;     // particles per bucket
+	std::unique_ptr<VeBuffer> m_cell_start;      // first sorted index per bucket
+	std::unique_ptr<VeBuffer> m_block_sums;      // per scan block, then their exclusive scan
+	std::unique_ptr<VeBuffer> m_particle_cells;  // bucket and slot per particle
+	std::unique_ptr<VeBuffer> m_sorted;          // position and velocity in bucket order
+	std::unique_ptr<VeBuffer> m_neighbor_counts; // written by recordQuery
+
+	vk::raii::PipelineLayout m_pipeline_layout{nullptr};
+	std::unique_ptr<VeComputePipeline> m_pipeline;
+};
+
+} // namespace ve
@@ -1,5 +1,8 @@
 #include "pch.hpp"
 #include "systems/particle_system.hpp"
+#include "core/ve_uploader.hpp"
+#include "core/ve_retirement_queue.hpp"
+#include "core/ve_render_queue.hpp"
 #include <random>
 #include <chrono>
 #include <chrono>
@@ -9,25 +12,27 @@ namespace ve {
 ParticleSystem::ParticleSystem(
 	VeDevice& device,
 	std::shared_ptr<VeDescriptorPool> descriptor_pool,
+	VeFrameRing& frame_ring,
 	const vk::raii::DescriptorSetLayout& global_set_layout,
-	vk::Format color_format,
 	uint32_t particle_count,
 	glm::vec3 origin,
-	std::filesystem::path shader_path)
-	: m_ve_device(device), m_particle_count(particle_count),
-	  m_origin(origin), m_descriptor_pool(std::move(descriptor_pool)),
+	std::filesystem::path shader_path,
+	ParticleStorageMode storage_mode)
+	: m_ve_device(device), m_frame_ring(frame_ring), m_particle_count(particle_count),
+	  m_origin(origin), m_storage_mode(storage_mode), m_descriptor_pool(std::move(descriptor_pool)),
 	  m_shader_path(shader_path) {
-	VE_LOGI("ParticleSystem constructor: particles=" << m_particle_count);
+	VE_LOGI("ParticleSystem constructor: particles=" << m_particle_count << " in place=" << (m_storage_mode == ParticleStorageMode::IN_PLACE));
 	m_pending_particle_count = m_particle_count;
 	m_capacity = 0;
+	// Grows to the particle count when FLUID mode is first used
+	m_grid = std::make_unique<ParticleGridSystem>(m_ve_device, m_descriptor_pool, m_shader_path.parent_path() / "particle_grid_kernel.spv");
 	createShaderStorageBuffers();
-	createUniformBuffers();
 	createDescriptorSetLayouts();
 	createDescriptorSets();
 	createComputePipelineLayout();
 	createComputePipeline();
 	createPipelineLayout(global_set_layout);
-	createPipeline(color_format);
+	createPipeline();
 }
 
 ParticleSystem::~ParticleSystem() {}
@@ -39,6 +44,16 @@ void ParticleSystem::scheduleRestart() {
 	// Basic seed using time; could be improved or controlled by caller
 	auto now = std::chrono::high_resolution_clock::now().time_since_epoch();
 	m_reset_seed = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+	m_reset_first = 0;
+}
+
+void ParticleSystem::scheduleTailInit(uint32_t first) {
+	if (m_pending_reset.load(std::memory_order_relaxed)) {
+		m_reset_first = std::min(m_reset_first, first);
+		return;
+	}
+	scheduleRestart();
+	m_reset_first = first;
 }
 
 // Create or recreate the SSBOs for particle storage and
@@ -48,87 +63,190 @@ void ParticleSystem::createShaderStorageBuffers() {
 	// Allocate to capacity, which may be larger than current count for amortized growth
 	uint32_t alloc_count = std::max(m_particle_count, m_capacity > 0 ? m_capacity : m_particle_count);
 	m_capacity = alloc_count;
-	std::vector<Particle> particles(m_capacity);
-	// Staging buffer for upload to device local
 	vk::DeviceSize buffer_size = static_cast<vk::DeviceSize>(m_capacity) * sizeof(Particle);
-	VeBuffer staging_buffer(
+
+	// Create per-frame SSBO and zero it on the transfer queue, no staging needed.
+	// A copy of a pending growth has nothing to copy into anymore.
+	const size_t buffer_count = m_storage_mode == ParticleStorageMode::IN_PLACE ? 1 : MAX_FRAMES_IN_FLIGHT;
+	for (auto& buffer : m_copy_sources)
+		retire(std::move(buffer));
+	m_copy_sources.clear();
+	for (auto& buffer : m_shader_storage_buffers)
+		retire(std::move(buffer));
+	m_shader_storage_buffers.clear();
+	m_shader_storage_buffers.resize(buffer_count);
+	for (size_t i = 0; i < buffer_count; ++i) {
+		m_shader_storage_buffers[i] = createShaderStorageBuffer();
+		m_ve_device.getUploader().fillBuffer(*m_shader_storage_buffers[i]->getBuffer(), 0, buffer_size, 0u);
+	}
+	createRenderStream();
+	scheduleRestart(); // sets m_reset_seed and m_pending_reset so the shader knows to init
+}
+
+// In place, the single SSBO is only simulated and the compact stream is rendered.
+// Per frame, the SSBOs are rendered directly unless culling switches to the stream.
+// Transfer source so growth can copy the particles into a larger buffer.
+std::unique_ptr<VeBuffer> ParticleSystem::createShaderStorageBuffer() const {
+	const bool in_place = m_storage_mode == ParticleStorageMode::IN_PLACE;
+	const vk::BufferUsageFlags vertex_usage = in_place ? vk::BufferUsageFlags{} : vk::BufferUsageFlagBits::eVertexBuffer;
+	return std::make_unique<VeBuffer>(
 		m_ve_device,
-		buffer_size,
+		static_cast<vk::DeviceSize>(m_capacity) * sizeof(Particle),
 		1,
-		vk::BufferUsageFlagBits::eTransferSrc,
-		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+		vk::BufferUsageFlagBits::eStorageBuffer |
+		vk::BufferUsageFlagBits::eTransferSrc |
+		vk::BufferUsageFlagBits::eTransferDst |
+		vertex_usage,
+		vk::MemoryPropertyFlagBits::eDeviceLocal
 	);
-	staging_buffer.map();
-	staging_buffer.writeToBuffer((void*)particles.data());
+}
 
-	// Create per-frame SSBO and copy initial data
+// Swaps in larger buffers while frames in flight still use the old ones. The next update
+// copies the live particles over and zeroes the rest, the old buffers are retired after it.
+void ParticleSystem::growShaderStorageBuffers(uint32_t capacity) {
+	VE_LOGI("ParticleSystem: growing to " << capacity << " particles");
+	if (m_copy_sources.empty()) {
+		m_copy_sources = std::move(m_shader_storage_buffers);
+		m_copy_count = m_particle_count;
+	} else {
+		// Grown twice before an update, the first replacement never received the particles
+		for (auto& buffer : m_shader_storage_buffers)
+			retire(std::move(buffer));
+	}
+	m_capacity = capacity;
 	m_shader_storage_buffers.clear();
-	m_shader_storage_buffers.resize(MAX_FRAMES_IN_FLIGHT);
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-		m_shader_storage_buffers[i] = std::make_unique<VeBuffer>(
-			m_ve_device,
-			buffer_size,
-			1,
-			vk::BufferUsageFlagBits::eStorageBuffer |
-			vk::BufferUsageFlagBits::eTransferDst |
-			vk::BufferUsageFlagBits::eVertexBuffer,
-			vk::MemoryPropertyFlagBits::eDeviceLocal
-		);
-		m_ve_device.copyBuffer(staging_buffer.getBuffer(), m_shader_storage_buffers[i]->getBuffer(), buffer_size);
+	for (size_t i = 0; i < m_copy_sources.size(); ++i)
+		m_shader_storage_buffers.push_back(createShaderStorageBuffer());
+	createRenderStream();
+	createDescriptorSets();
+}
+
+void ParticleSystem::recordGrowthCopy(vk::CommandBuffer command_buffer) {
+	const vk::DeviceSize live_size = static_cast<vk::DeviceSize>(m_copy_count) * sizeof(Particle);
+	for (size_t i = 0; i < m_shader_storage_buffers.size(); ++i) {
+		const vk::Buffer buffer = *m_shader_storage_buffers[i]->getBuffer();
+		if (live_size > 0)
+			command_buffer.copyBuffer(*m_copy_sources[i]->getBuffer(), buffer, vk::BufferCopy{ 0, 0, live_size });
+		// The new tail is reset by the dispatch, zeroes keep the FLUID grid built before it finite
+		command_buffer.fillBuffer(buffer, live_size, VK_WHOLE_SIZE, 0u);
 	}
-	scheduleRestart(); // sets m_reset_seed and m_pending_reset so the shader knows to init
+	vk::MemoryBarrier2 barrier{
+		.srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+		.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+		.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier });
+	for (auto& buffer : m_copy_sources)
+		retire(std::move(buffer));
+	m_copy_sources.clear();
+}
+
+void ParticleSystem::retire(std::unique_ptr<VeBuffer> buffer) {
+	if (buffer)
+		m_ve_device.getRetirementQueue().retire(std::move(buffer));
+}
+
+void ParticleSystem::retire(vk::raii::DescriptorSet set) {
+	if (*set)
+		m_ve_device.getRetirementQueue().retire(std::move(set), m_descriptor_pool);
 }
 
-void ParticleSystem::createUniformBuffers() {
-	m_compute_uniform_buffers.clear();
-	m_compute_uniform_buffers.resize(MAX_FRAMES_IN_FLIGHT);
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-		m_compute_uniform_buffers[i] = std::make_unique<VeBuffer>(
-			m_ve_device,
-			sizeof(ParticleParams),
-			1,
-			vk::BufferUsageFlagBits::eUniformBuffer,
-			vk::MemoryPropertyFlagBits::eHostVisible |
-			vk::MemoryPropertyFlagBits::eHostCoherent
-		);
-		m_compute_uniform_buffers[i]->map();
+// Written by every dispatch before it is rendered. With async compute the dispatch of a
+// frame runs while the previous frame is still drawn, so each frame in flight has its own.
+// Otherwise compute waits for the previous frame's graphics and one stream is enough.
+void ParticleSystem::createRenderStream() {
+	for (auto& buffer : m_vertex_buffers)
+		retire(std::move(buffer));
+	m_vertex_buffers.clear();
+	if (usesRenderStream()) {
+		const uint32_t stream_count = m_async_compute ? MAX_FRAMES_IN_FLIGHT : 1;
+		for (uint32_t i = 0; i < stream_count; ++i) {
+			m_vertex_buffers.push_back(std::make_unique<VeBuffer>(
+				m_ve_device,
+				static_cast<vk::DeviceSize>(m_capacity) * sizeof(ParticleVertex),
+				1,
+				vk::BufferUsageFlagBits::eStorageBuffer |
+				vk::BufferUsageFlagBits::eVertexBuffer,
+				vk::MemoryPropertyFlagBits::eDeviceLocal
+			));
+		}
+	}
+	if (m_draw_commands.empty()) {
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			m_draw_commands.push_back(std::make_unique<VeBuffer>(
+				m_ve_device,
+				sizeof(vk::DrawIndirectCommand),
+				1,
+				vk::BufferUsageFlagBits::eStorageBuffer |
+				vk::BufferUsageFlagBits::eIndirectBuffer |
+				vk::BufferUsageFlagBits::eTransferDst,
+				vk::MemoryPropertyFlagBits::eDeviceLocal
+			));
+			m_ve_device.getUploader().fillBuffer(*m_draw_commands.back()->getBuffer(), 0, sizeof(vk::DrawIndirectCommand), 0u);
+		}
 	}
 }
 
+vk::DeviceSize ParticleSystem::getMemoryUsage() const {
+	vk::DeviceSize size = static_cast<vk::DeviceSize>(m_capacity) * sizeof(Particle) * m_shader_storage_buffers.size();
+	for (const auto& buffer : m_vertex_buffers)
+		size += buffer->getBufferSize();
+	return size + m_grid->getMemoryUsage();
+}
+
 // For the compute shader we need:
-// - UBO with parameters
-// - An input and output particle SSBO
+// - UBO with parameters (dynamic offset into the frame ring)
+// - An input and output particle SSBO, the same buffer in place
+// - The render stream SSBO, written in place mode or when culling
+// - The indirect draw command of the culled stream
 void ParticleSystem::createDescriptorSetLayouts() {
 	m_compute_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
-		.addBinding(3, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eCompute)
+		.addBinding(3, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eCompute)
 		.addBinding(1, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
 		.addBinding(2, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.addBinding(4, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.addBinding(5, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
 		.build();
 }
 
 void ParticleSystem::createDescriptorSets() {
+	for (auto& set : m_compute_descriptor_sets)
+		retire(std::move(set));
 	m_compute_descriptor_sets.clear();
 	m_compute_descriptor_sets.reserve(MAX_FRAMES_IN_FLIGHT);
 
+	const uint32_t buffer_count = static_cast<uint32_t>(m_shader_storage_buffers.size());
 	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 		vk::raii::DescriptorSet set{nullptr};
-		auto ubo_info = m_compute_uniform_buffers[i]->getDescriptorInfo();
-		auto ssbo_info = m_shader_storage_buffers[i]->getDescriptorInfo();
-		uint32_t prev = (i + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT;
+		auto ubo_info = m_frame_ring.getDescriptorInfo(sizeof(ParticleParams));
+		auto ssbo_info = m_shader_storage_buffers[i % buffer_count]->getDescriptorInfo();
+		uint32_t prev = (i + buffer_count - 1) % buffer_count;
 		auto ssbo_info_last_frame = m_shader_storage_buffers[prev]->getDescriptorInfo();
+		// Without the stream the shader does not write it, any valid buffer completes the set
+		auto vertex_info = m_vertex_buffers.empty() ? ssbo_info : m_vertex_buffers[i % m_vertex_buffers.size()]->getDescriptorInfo();
+		auto draw_info = m_draw_commands[i]->getDescriptorInfo();
 		VeDescriptorWriter(*m_compute_set_layout, *m_descriptor_pool)
 			.writeBuffer(3, &ubo_info)
 			.writeBuffer(1, &ssbo_info_last_frame)
 			.writeBuffer(2, &ssbo_info)
+			.writeBuffer(4, &vertex_info)
+			.writeBuffer(5, &draw_info)
 			.build(set);
 		m_compute_descriptor_sets.push_back(std::move(set));
 	}
+	m_grid->setParticleBuffers(m_shader_storage_buffers);
 }
 
+// Set 1 is the grid query set, read in FLUID mode
 void ParticleSystem::createComputePipelineLayout() {
+	std::array<vk::DescriptorSetLayout, 2> set_layouts{
+		*m_compute_set_layout->getDescriptorSetLayout(),
+		*m_grid->getQuerySetLayout()
+	};
 	vk::PipelineLayoutCreateInfo pipeline_layout_info{
-		.setLayoutCount = 1,
-		.pSetLayouts = &*m_compute_set_layout->getDescriptorSetLayout(),
+		.setLayoutCount = static_cast<uint32_t>(set_layouts.size()),
+		.pSetLayouts = set_layouts.data(),
 	};
 	m_compute_pipeline_layout = vk::raii::PipelineLayout(m_ve_device.getDevice(), pipeline_layout_info);
 }
@@ -155,27 +273,46 @@ void ParticleSystem::createPipelineLayout(
 	m_pipeline_layout = vk::raii::PipelineLayout(m_ve_device.getDevice(), pipeline_layout_info);
 }
 
-void ParticleSystem::createPipeline(vk::Format color_format) {
-	PipelineConfigInfo config{};
-	VePipeline::defaultPipelineConfigInfo(config, m_ve_device);
-	// Use instanced attributes for particles; static unit quad provided by fixed pipeline state
-	config.attribute_descriptions = Particle::getAttributeDescriptions();
-	config.binding_descriptions = Particle::getBindingDescription();
+// Renders into the weighted blended transparency targets. Both share one blend state:
+// color channels add up, alpha multiplies the destination by (1 - alpha), which keeps
+// the revealage in the alpha of the accumulation target.
+void ParticleSystem::defaultPipelineConfigInfo(PipelineConfigInfo& config, VeDevice& device, ParticleStorageMode storage_mode) {
+	VePipeline::defaultPipelineConfigInfo(config, device);
+	// Use instanced attributes for particles; static unit quad provided by fixed pipeline state.
+	// Both layouts feed the same vertex inputs, the packed color is unpacked by the format.
+	if (storage_mode == ParticleStorageMode::IN_PLACE) {
+		config.attribute_descriptions = ParticleVertex::getAttributeDescriptions();
+		config.binding_descriptions = ParticleVertex::getBindingDescription();
+	} else {
+		config.attribute_descriptions = Particle::getAttributeDescriptions();
+		config.binding_descriptions = Particle::getBindingDescription();
+	}
 
-	config.color_format = color_format;
-	config.pipeline_layout = m_pipeline_layout;
-	// Enable depth testing but disable depth writes for alpha-blended particles
+	config.color_format = OIT_ACCUM_FORMAT;
+	config.extra_color_formats = { OIT_WEIGHT_FORMAT };
+	config.color_blend_attachment.srcColorBlendFactor = vk::BlendFactor::eOne;
+	config.color_blend_attachment.dstColorBlendFactor = vk::BlendFactor::eOne;
+	config.color_blend_attachment.srcAlphaBlendFactor = vk::BlendFactor::eZero;
+	config.color_blend_attachment.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+	// Enable depth testing but disable depth writes, the order of particles does not matter
 	config.depth_stencil_info.depthTestEnable = VK_TRUE;
 	config.depth_stencil_info.depthWriteEnable = VK_FALSE;
 	config.rasterization_info.depthBiasEnable = VK_FALSE;
+}
+
+void ParticleSystem::createPipeline() {
+	PipelineConfigInfo config{};
+	defaultPipelineConfigInfo(config, m_ve_device, usesRenderStream() ? ParticleStorageMode::IN_PLACE : ParticleStorageMode::PER_FRAME);
+	config.pipeline_layout = m_pipeline_layout;
+	if (m_pipeline)
+		m_ve_device.getRetirementQueue().retire(std::move(m_pipeline));
 	m_pipeline = std::make_unique<VePipeline>(m_ve_device, m_shader_path, config);
 }
 
-// Updates the particle system by recording compute commands into the compute command buffer.
-// updates the particle parameters UBO
+// Updates the particle system by recording compute commands into the compute command buffer,
+// which is begun by the renderer. Pushes the particle parameters UBO into the frame ring
 void ParticleSystem::update(VeFrameInfo& frame_info) {
 	assert(frame_info.current_frame < MAX_FRAMES_IN_FLIGHT && "current_frame out of bounds");
-	assert(m_compute_uniform_buffers.size() == MAX_FRAMES_IN_FLIGHT && "compute_uniform_buffers size incorrect");
 	assert(m_total_time >= 0.0f && "total_time should be non-negative");
 	assert(frame_info.frame_time >= 0.0f && "delta_time should be non-negative");
 
@@ -190,26 +327,61 @@ void ParticleSystem::update(VeFrameInfo& frame_info) {
 	params.mode = m_mode;
 	params.mean = m_mean;
 	params.stddev = m_stddev;
+	params.write_vertices = m_storage_mode == ParticleStorageMode::IN_PLACE ? 1u : 0u;
+	params.interaction_radius = FLUID_RADIUS;
+	params.cull = m_frustum_culling ? 1u : 0u;
+	params.spawn_count = getSpawnCount();
+	std::copy(m_frustum.planes.begin(), m_frustum.planes.end(), params.frustum_planes);
 	if (m_pending_reset.load(std::memory_order_relaxed)) {
 		params.reset = 1u;
 		params.seed = m_reset_seed;
-		m_total_time = 0.0f;
+		params.reset_first = m_reset_first;
+		// Particles added by a resize appear without restarting the others
+		if (m_reset_first == 0)
+			m_total_time = 0.0f;
 		// Clear pending flag so it only applies once
 		m_pending_reset.store(false, std::memory_order_relaxed);
 	} else {
 		params.reset = 0u;
 		params.seed = 0u;
 	}
-	m_compute_uniform_buffers[frame_info.current_frame]->writeToBuffer(&params);
-	frame_info.compute_command_buffer.reset();
-	frame_info.compute_command_buffer.begin(vk::CommandBufferBeginInfo{});
+	const uint32_t params_offset = frame_info.frame_ring.push(params).getDynamicOffset();
+
+	if (!m_copy_sources.empty())
+		recordGrowthCopy(*frame_info.compute_command_buffer);
+
+	// Neighbors are found among the particles the simulation reads
+	if (m_mode == ParticleMode::FLUID && (params.reset == 0u || params.reset_first > 0u)) {
+		const uint32_t buffer_count = static_cast<uint32_t>(m_shader_storage_buffers.size());
+		const uint32_t prev = (frame_info.current_frame + buffer_count - 1) % buffer_count;
+		m_grid->reserve(m_particle_count);
+		m_grid->record(*frame_info.compute_command_buffer, prev, m_particle_count, FLUID_RADIUS);
+	}
+
+	// Culled particles are appended to the stream, the instance count starts at zero
+	if (m_frustum_culling) {
+		const vk::DrawIndirectCommand draw{ .vertexCount = 6, .instanceCount = 0, .firstVertex = 0, .firstInstance = 0 };
+		frame_info.compute_command_buffer.updateBuffer<vk::DrawIndirectCommand>(*m_draw_commands[frame_info.current_frame]->getBuffer(), 0, draw);
+		vk::MemoryBarrier2 barrier{
+			.srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+			.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite
+		};
+		frame_info.compute_command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier });
+	}
+
+	const std::array<vk::DescriptorSet, 2> sets{
+		*m_compute_descriptor_sets[frame_info.current_frame],
+		m_grid->getQuerySet()
+	};
 	frame_info.compute_command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_compute_pipeline->getPipeline());
 	frame_info.compute_command_buffer.bindDescriptorSets(
 		vk::PipelineBindPoint::eCompute,
 		*m_compute_pipeline_layout,
 		0,
-		*m_compute_descriptor_sets[frame_info.current_frame],
-		{}
+		sets,
+		params_offset
 	);
 
 	// Dispatch enough workgroups to cover all particles, even when not a multiple of 256
@@ -218,57 +390,88 @@ void ParticleSystem::update(VeFrameInfo& frame_info) {
 	if (group_count_x > 0) {
 		frame_info.compute_command_buffer.dispatch(group_count_x, 1, 1);
 	}
-	frame_info.compute_command_buffer.end();
 }
 
 
-// Renders all particles with a single draw call. The shader storage buffer
-// with particle positions and colors is bound as a vertex buffer.
-// Instance rendering is used to draw a quad for each particle.
-void ParticleSystem::render(VeFrameInfo& frame_info) const {
-	frame_info.command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline->getPipeline());
-
-	frame_info.command_buffer.bindDescriptorSets(
-		vk::PipelineBindPoint::eGraphics,
-		m_pipeline_layout,
-		0,
-		{ frame_info.global_descriptor_set },
-		{}
-	);
-	vk::DeviceSize offsets[] = { 0 };
-	vk::Buffer buffers[] = { *m_shader_storage_buffers[frame_info.current_frame]->getBuffer() };
-	frame_info.command_buffer.bindVertexBuffers(0, buffers, offsets);
-
+uint32_t ParticleSystem::getSpawnCount() const {
 	// cap particles when spawning in
-	uint32_t particles_to_spawn = m_particle_count;
-	float delay_factor = 0.5f; // time to full spawn
-	if (m_total_time < delay_factor) {
-		particles_to_spawn = static_cast<uint32_t>(m_particle_count * (m_total_time / delay_factor));
+	const float delay_factor = 0.5f; // time to full spawn
+	if (m_total_time < delay_factor)
+		return static_cast<uint32_t>(m_particle_count * (m_total_time / delay_factor));
+	return m_particle_count;
+}
+
+// Submits all particles as a single draw in the order independent transparency pass.
+// Instance rendering is used to draw a quad for each particle. Per frame without culling
+// the shader storage buffer is bound as the vertex buffer, else the compact stream. When
+// culling, the compute pass wrote the visible count into the indirect draw command.
+void ParticleSystem::render(VeFrameInfo& frame_info) const {
+	VeDrawPacket packet{
+		.type = VeDrawPacket::DRAW,
+		.pipeline = m_pipeline->getPipeline(frame_info.sample_count),
+		.pipeline_layout = *m_pipeline_layout,
+		.descriptor_sets = {*frame_info.global_descriptor_set},
+		.descriptor_set_count = 1,
+		.dynamic_offset = frame_info.global_ubo_offset,
+		.vertex_buffers = {m_vertex_buffers.empty() ?
+			*m_shader_storage_buffers[frame_info.current_frame]->getBuffer() :
+			*m_vertex_buffers[frame_info.current_frame % m_vertex_buffers.size()]->getBuffer()},
+		.vertex_buffer_count = 1,
+		// unit quad is generated in shader from SV_VertexID
+		.count = 6,
+		.instance_count = getSpawnCount()
+	};
+	if (m_frustum_culling) {
+		packet.type = VeDrawPacket::DRAW_INDIRECT;
+		packet.indirect_buffer = *m_draw_commands[frame_info.current_frame]->getBuffer();
+		packet.max_draw_count = 1;
+		packet.stride = sizeof(vk::DrawIndirectCommand);
 	}
-	// unit quad is generated in shader from SV_VertexID
-	frame_info.command_buffer.draw(6, particles_to_spawn, 0, 0);
+	frame_info.render_queue.submit(VeRenderQueue::PASS_OIT, frame_info.render_queue.getViewDepth(m_origin), packet);
 }
 
 void ParticleSystem::setParticleCount(uint32_t count) {
 	if (count == 0) count = 1; // avoid zero-sized buffers
 	if (count == m_particle_count) return;
 	VE_LOGI("ParticleSystem::setParticleCount from " << m_particle_count << " to " << count);
-	// Grow capacity if needed; shrinking does not free immediately to avoid churn
-	if (count > m_capacity) {
-		// Ensure GPU is idle before resizing GPU resources
-		m_ve_device.getDevice().waitIdle();
-		m_particle_count = count;
-		m_pending_particle_count = m_particle_count;
-		// Recreate storage buffers sized to new capacity and reset on next dispatch
-		m_capacity = count;
-		createShaderStorageBuffers();
-		createDescriptorSets();
-	} else {
-		// Within capacity: just adjust logical count; compute shader will skip extra threads
-		m_particle_count = count;
-		m_pending_particle_count = m_particle_count;
-		scheduleRestart(); // schedule a re-init if desired when count changes
-	}
+	// Grow capacity by at least half so dragging the slider does not reallocate every frame,
+	// shrinking does not free immediately to avoid churn
+	if (count > m_capacity)
+		growShaderStorageBuffers(std::max(count, m_capacity + m_capacity / 2));
+	// Only the added particles are initialized, the compute shader skips threads past the count
+	if (count > m_particle_count)
+		scheduleTailInit(m_particle_count);
+	m_particle_count = count;
+	m_pending_particle_count = m_particle_count;
+}
+
+void ParticleSystem::setStorageMode(ParticleStorageMode mode) {
+	if (mode == m_storage_mode) return;
+	VE_LOGI("ParticleSystem::setStorageMode in place=" << (mode == ParticleStorageMode::IN_PLACE));
+	// Buffers and pipeline still used by frames in flight are retired
+	m_storage_mode = mode;
+	createShaderStorageBuffers();
+	createDescriptorSets();
+	createPipeline();
+}
+
+void ParticleSystem::setFrustumCulling(bool enabled) {
+	if (enabled == m_frustum_culling) return;
+	VE_LOGI("ParticleSystem::setFrustumCulling " << enabled);
+	// The stream and pipeline still used by frames in flight are retired
+	m_frustum_culling = enabled;
+	createRenderStream();
+	createDescriptorSets();
+	createPipeline();
+}
+
+void ParticleSystem::setAsyncCompute(bool enabled) {
+	if (enabled == m_async_compute) return;
+	VE_LOGI("ParticleSystem::setAsyncCompute " << enabled);
+	// The streams still used by frames in flight are retired
+	m_async_compute = enabled;
+	createRenderStream();
+	createDescriptorSets();
 }
 
 void ParticleSystem::ensureCapacity(uint32_t needed) {
@@ -284,7 +487,6 @@ void ParticleSystem::stageParticleCount(uint32_t count) {
 void ParticleSystem::applyStagedParticleCount() {
 	if (m_pending_particle_count != m_particle_count) {
 		setParticleCount(m_pending_particle_count);
-		scheduleRestart();
 	}
 }
 
@@ -3,9 +3,14 @@
 #include "ve_config.hpp"
 #include "core/ve_buffer.hpp"
 #include "core/ve_descriptors.hpp"
+#include "core/ve_frame_ring.hpp"
 #include "game/ve_frame_info.hpp"
+#include "game/ve_frustum.hpp"
 #include "core/ve_pipeline.hpp"
 #include "core/ve_compute_pipeline.hpp"
+#include "systems/particle_grid_system.hpp"
+
+#include <glm/gtc/packing.hpp>
 
 #include <memory>
 #include <vector>
@@ -25,6 +30,18 @@ enum ParticleMode : int32_t {
 	SUCC = 3,
 	STASIS = 4,
 	GALAXY_MASSIVE = 5,
+	FLUID = 6, // neighbor forces through the ParticleGridSystem
+};
+
+// Where the simulation keeps its particles. Only the compute work reads the particles of the
+// previous frame, and it runs in submission order on its queue, so one buffer can be updated in place.
+// Per frame costs 2 x 24 = 48 bytes per particle without culling. In place costs 24 + 20 = 44
+// bytes with a single render stream, which is only safe when compute waits on the previous
+// frame's graphics. With async compute every frame in flight needs its own stream, 24 + 2 x 20 =
+// 64 bytes, so in place then trades memory for the smaller stream the vertex shader reads.
+enum ParticleStorageMode : uint32_t {
+	PER_FRAME = 1, // a buffer per frame in flight, read from the previous one and rendered from
+	IN_PLACE = 2,  // one buffer updated in place, rendered from a compact ParticleVertex stream
 };
 
 // Uniform buffer with parameters for compute shader
@@ -39,42 +56,92 @@ struct ParticleParams {
 	uint32_t reset_kind; // see ParticleResetKind enum
 	int32_t mode; // see ParticleMode enum
 	alignas(16) glm::vec3 origin;
+	uint32_t write_vertices; // 1 = write the render stream, in place mode
+	float interaction_radius; // of neighbor forces, also the grid cell size
+	uint32_t cull; // 1 = write the visible spawned particles compacted into the render stream
+	uint32_t spawn_count; // particles drawn while spawning in
+	uint32_t reset_first = 0; // with reset, particles from this index are reset and earlier ones simulated
+	alignas(16) glm::vec4 frustum_planes[VeFrustum::PLANE_COUNT];
 };
 
+// Simulated particle in the shader storage buffers, 24 bytes instead of three vec4s. The
+// vertex shader reads position, color and size, velocity is only used by the simulation.
+// The layout must match loadParticle and storeParticle in particle_compute.slang.
 struct Particle {
-	glm::vec4 position; // w is scale
-	glm::vec4 velocity; // w component unused
-	glm::vec4 color;
+	glm::vec3 position;
+	uint32_t color;           // rgba8 unorm
+	uint32_t velocity_xy;     // two halfs
+	uint32_t size_velocity_z; // two halfs, size first so it is the x of the vertex attribute
+
+	static Particle pack(glm::vec3 position, float size, glm::vec3 velocity, glm::vec4 color) {
+		return {
+			.position = position,
+			.color = glm::packUnorm4x8(color),
+			.velocity_xy = glm::packHalf2x16(glm::vec2(velocity)),
+			.size_velocity_z = glm::packHalf2x16(glm::vec2(size, velocity.z))
+		};
+	}
+	float getSize() const { return glm::unpackHalf2x16(size_velocity_z).x; }
+	glm::vec3 getVelocity() const { return glm::vec3(glm::unpackHalf2x16(velocity_xy), glm::unpackHalf2x16(size_velocity_z).y); }
+	glm::vec4 getColor() const { return glm::unpackUnorm4x8(color); }
 
 	static std::vector<vk::VertexInputBindingDescription> getBindingDescription() {
-		// Per-instance particle attributes (position, color)
+		// Per-instance particle attributes (position, color, size)
 		return { { 0, sizeof(Particle), vk::VertexInputRate::eInstance } };
 	}
 
-	// we dont need velocity for rendering
+	// we dont need velocity for rendering, the size is the first half of its attribute
+	static std::vector<vk::VertexInputAttributeDescription> getAttributeDescriptions() {
+		return {
+			vk::VertexInputAttributeDescription( 0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Particle, position) ),
+			vk::VertexInputAttributeDescription( 1, 0, vk::Format::eR8G8B8A8Unorm, offsetof(Particle, color) ),
+			vk::VertexInputAttributeDescription( 2, 0, vk::Format::eR16G16Sfloat, offsetof(Particle, size_velocity_z) )
+		};
+	}
+};
+static_assert(sizeof(Particle) == 24, "Particle must match the stride of particle_compute.slang");
+
+// Render-only particle in the compact stream of the in place mode, written by the compute shader
+struct ParticleVertex {
+	glm::vec4 position; // w is scale
+	uint32_t color;     // rgba8 unorm
+
+	static std::vector<vk::VertexInputBindingDescription> getBindingDescription() {
+		return { { 0, sizeof(ParticleVertex), vk::VertexInputRate::eInstance } };
+	}
+
 	static std::vector<vk::VertexInputAttributeDescription> getAttributeDescriptions() {
 		return {
-			vk::VertexInputAttributeDescription( 0, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(Particle, position) ),
-			vk::VertexInputAttributeDescription( 1, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(Particle, color) )
+			vk::VertexInputAttributeDescription( 0, 0, vk::Format::eR32G32B32Sfloat, offsetof(ParticleVertex, position) ),
+			vk::VertexInputAttributeDescription( 1, 0, vk::Format::eR8G8B8A8Unorm, offsetof(ParticleVertex, color) ),
+			vk::VertexInputAttributeDescription( 2, 0, vk::Format::eR32Sfloat, offsetof(ParticleVertex, position) + 3 * sizeof(float) )
 		};
 	}
 };
+static_assert(sizeof(ParticleVertex) == 20, "ParticleVertex must match the stride written by particle_compute.slang");
 
 class VENGINE_API ParticleSystem {
 public:
+	static constexpr float FLUID_RADIUS = 0.4f; // neighbors closer than this push apart in FLUID mode
+
 	ParticleSystem(
 		VeDevice& device,
 		std::shared_ptr<VeDescriptorPool> descriptor_pool,
+		VeFrameRing& frame_ring,
 		const vk::raii::DescriptorSetLayout& global_set_layout,
-		vk::Format color_format,
 		uint32_t particle_count,
 		glm::vec3 origin,
-		std::filesystem::path shader_path);
+		std::filesystem::path shader_path,
+		ParticleStorageMode storage_mode = ParticleStorageMode::PER_FRAME);
 	~ParticleSystem();
 
 	ParticleSystem(const ParticleSystem&) = delete;
 	ParticleSystem& operator=(const ParticleSystem&) = delete;
 
+	// Additive weighted blended transparency state with the vertex input of the storage mode,
+	// the in place layout takes the compact ParticleVertex stream
+	static void defaultPipelineConfigInfo(PipelineConfigInfo& config, VeDevice& device, ParticleStorageMode storage_mode);
+
 	void update(VeFrameInfo& frame_info);
 	void render(VeFrameInfo& frame_info) const;
 	void scheduleRestart(); // schedule GPU reset of particle positions
@@ -82,8 +149,28 @@ public:
 	void resetPoint() { m_reset_kind = 1u; scheduleRestart(); }
 	void resetDisc() { m_reset_kind = 2u; scheduleRestart(); }
 
-	// Change particle count; recreates storage buffers and descriptor sets
+	// Change particle count without waiting for the device. Growing beyond the capacity swaps
+	// in larger buffers, the next update copies the live particles into them. New particles
+	// are initialized by the next update, the others keep running.
 	void setParticleCount(uint32_t count);
+	// Recreates the buffers, descriptor sets and pipeline, restarts the particles. The old ones are retired.
+	void setStorageMode(ParticleStorageMode mode);
+	ParticleStorageMode getStorageMode() const { return m_storage_mode; }
+	// Culled particles are drawn indirectly from the compact render stream in both storage modes.
+	// A replaced stream and pipeline are retired, the particles keep running.
+	void setFrustumCulling(bool enabled);
+	bool getFrustumCulling() const { return m_frustum_culling; }
+	// Whether the frame being recorded runs its compute work async to the previous frame's
+	// graphics, then the render stream is kept per frame in flight. Replaced streams are retired.
+	void setAsyncCompute(bool enabled);
+	// World space frustum of the camera, used by the next update
+	void setFrustum(const VeFrustum& frustum) { m_frustum = frustum; }
+	// Bytes of particle and grid buffers allocated on the device
+	vk::DeviceSize getMemoryUsage() const;
+	// Storage buffer written by the update of frame_index, for tests and debug tools
+	vk::Buffer getParticleBuffer(uint32_t frame_index) const { return *m_shader_storage_buffers[frame_index % m_shader_storage_buffers.size()]->getBuffer(); }
+	// Seed of the last scheduled reset, reproduces it on the ParticleCpuSimulator
+	uint32_t getResetSeed() const { return m_reset_seed; }
 	void setMean(float mean) { m_mean = mean;}
 	void setStddev(float stddev) { m_stddev = stddev;}
 	uint32_t getParticleCount() const { return m_particle_count; }
@@ -101,16 +188,29 @@ public:
 private:
 	void createDescriptorSetLayouts();
 	void createShaderStorageBuffers();
-	void createUniformBuffers();
+	std::unique_ptr<VeBuffer> createShaderStorageBuffer() const;
+	void growShaderStorageBuffers(uint32_t capacity);
+	void recordGrowthCopy(vk::CommandBuffer command_buffer);
+	void createRenderStream();
 	void createDescriptorSets();
 	void createComputePipelineLayout();
 	void createComputePipeline();
 	void createPipelineLayout(const vk::raii::DescriptorSetLayout& global_set_layout);
-	void createPipeline(vk::Format color_format);
+	void createPipeline();
 
 	void ensureCapacity(uint32_t needed);
+	// Initializes the particles from first on the next update, a full restart takes precedence
+	void scheduleTailInit(uint32_t first);
+	// Frames in flight may still use replaced resources, they go to the device's retirement queue
+	void retire(std::unique_ptr<VeBuffer> buffer);
+	void retire(vk::raii::DescriptorSet set);
+	// Particles drawn this frame, ramping up over the first half second after a reset
+	uint32_t getSpawnCount() const;
+	// The compact ParticleVertex stream is rendered in place or when culling
+	bool usesRenderStream() const { return m_storage_mode == ParticleStorageMode::IN_PLACE || m_frustum_culling; }
 
 	VeDevice& m_ve_device;
+	VeFrameRing& m_frame_ring; // parameters ubo is pushed into the frame ring each update
 
 	float m_mean = 0.0f;
 	float m_stddev = 6.0f;
@@ -121,17 +221,28 @@ private:
 	glm::vec3 m_origin{0.0f, 0.0f, 10.0f};
 	std::atomic<bool> m_pending_reset{false}; // atomic not necessary (no multi-threading yet)
 	uint32_t m_reset_seed{0};
+	uint32_t m_reset_first{0}; // see ParticleParams::reset_first
 	uint32_t m_reset_kind{ParticleResetKind::POINT}; // see ParticleResetKind enum
 	int32_t m_mode{ParticleMode::COOL}; // see ParticleMode enum
+	ParticleStorageMode m_storage_mode;
+	bool m_frustum_culling = true;
+	bool m_async_compute = true; // render stream per frame in flight
+	VeFrustum m_frustum{};
 
 	// Descriptor layouts for this system
 	std::unique_ptr<VeDescriptorSetLayout> m_compute_set_layout;
 
 	// Per-frame resources
-	std::vector<std::unique_ptr<VeBuffer>> m_compute_uniform_buffers;  // small UBO per frame
-	std::vector<std::unique_ptr<VeBuffer>> m_shader_storage_buffers; // large SSBO per frame
+	std::vector<std::unique_ptr<VeBuffer>> m_shader_storage_buffers; // large SSBO per frame, a single one in place
+	std::vector<std::unique_ptr<VeBuffer>> m_vertex_buffers; // compact render stream, in place mode or when culling, per frame with async compute
+	std::vector<std::unique_ptr<VeBuffer>> m_draw_commands;  // indirect draw of the culled stream per frame
+	std::unique_ptr<ParticleGridSystem> m_grid; // built from the previous particles in FLUID mode
 	std::vector<vk::raii::DescriptorSet> m_compute_descriptor_sets;
 
+	// Buffers replaced by growth whose first m_copy_count particles the next update copies
+	std::vector<std::unique_ptr<VeBuffer>> m_copy_sources;
+	uint32_t m_copy_count = 0;
+
 
 
 
@@ -2,6 +2,7 @@
 #include "systems/point_light_system.hpp"
 #include "core/ve_device.hpp"
 #include "core/ve_pipeline.hpp"
+#include "core/ve_render_queue.hpp"
 #include "utils/ve_log.hpp"
 
 #define GLM_FORCE_RADIANS
@@ -69,18 +70,19 @@ void PointLightSystem::createPipeline(vk::Format color_format) {
 }
 
 
-// Performs a draw call for each game object with a point light component
+// Submits a draw for each game object with a point light component. The billboards are
+// blended, so they go in the transparent pass and are drawn back to front.
 void PointLightSystem::render(VeFrameInfo& frame_info) const {
-	frame_info.command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_ve_pipeline->getPipeline());
-	std::array<vk::DescriptorSet, 2> sets{frame_info.global_descriptor_set, frame_info.material_descriptor_set};
-	frame_info.command_buffer.bindDescriptorSets(
-		vk::PipelineBindPoint::eGraphics,
-		*m_pipeline_layout,
-		0,
-		sets,
-		{}
-	);
-
+	const VeDrawPacket packet{
+		.type = VeDrawPacket::DRAW,
+		.pipeline = m_ve_pipeline->getPipeline(frame_info.sample_count),
+		.pipeline_layout = *m_pipeline_layout,
+		.descriptor_sets = {*frame_info.global_descriptor_set, *frame_info.material_descriptor_set},
+		.descriptor_set_count = 2,
+		.dynamic_offset = frame_info.global_ubo_offset,
+		.push_stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+		.count = 6 // 6 vertices for point light
+	};
 	for (auto& [id, obj] : frame_info.game_objects) {
 		if (obj.point_light_component == nullptr)
 			continue;
@@ -88,24 +90,17 @@ void PointLightSystem::render(VeFrameInfo& frame_info) const {
 		push.position = glm::vec4{obj.transform.translation, 1.0f};
 		push.scale = obj.transform.scale.x;
 		push.color = glm::vec4{obj.color, obj.point_light_component->intensity};
-		// push constant provided as raw bytes to avoid MSVC debug mode corruption with push across dll boundaries
-		frame_info.command_buffer.pushConstants(
-			*m_pipeline_layout,
-			vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-			0,
-			vk::ArrayProxy<const uint8_t>(sizeof(SimplePushConstantData), reinterpret_cast<const uint8_t*>(&push))
-		);
-		frame_info.command_buffer.draw(6, 1, 0, 0); // 6 vertices for point light
+		const float depth = frame_info.render_queue.getViewDepth(obj.transform.translation);
+		frame_info.render_queue.submit(VeRenderQueue::PASS_TRANSPARENT, depth, packet, push);
 	}
 }
 
-// Update UBO with point light data for global access in shaders
-void PointLightSystem::update(VeFrameInfo& frame_info, UniformBufferObject& ubo) {
-	uint32_t num_lights = 0;
+// Fill the light storage buffer of this frame, binned into clusters by LightClusterSystem
+void PointLightSystem::update(VeFrameInfo& frame_info, LightClusterSystem& light_clusters) {
+	m_lights.clear();
 	for (auto& [id, obj] : frame_info.game_objects) {
 		if (obj.point_light_component == nullptr)
 			continue;
-		assert(num_lights <= MAX_LIGHTS && "Number of point lights exceeds MAX_LIGHTS");
 
 		// rotate point lights in circle
 		if (obj.point_light_component->rotates) {
@@ -116,11 +111,12 @@ void PointLightSystem::update(VeFrameInfo& frame_info, UniformBufferObject& ubo)
 			obj.transform.translation = glm::vec3{pos};
 		}
 
-		ubo.point_lights[num_lights].position = glm::vec4{obj.transform.translation, 1.0f};
-		ubo.point_lights[num_lights].color = glm::vec4{obj.color, obj.point_light_component->intensity};
-		num_lights++;
+		const float intensity = obj.point_light_component->intensity;
+		m_lights.push_back(PointLight{
+			.position = glm::vec4{obj.transform.translation, computeLightRange(obj.color, intensity)},
+			.color = glm::vec4{obj.color, intensity}
+		});
 	}
-
-	ubo.num_lights = num_lights;
+	light_clusters.setLights(frame_info.current_frame, m_lights);
 }
 } // namespace ve
\ No newline at end of file
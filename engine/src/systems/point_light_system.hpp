@@ -2,6 +2,7 @@
 #include "ve_export.hpp"
 #include "ve_config.hpp"
 #include "game/ve_frame_info.hpp"
+#include "systems/light_cluster_system.hpp"
 
 #include <memory>
 #include <vector>
@@ -29,7 +30,8 @@ public:
 	PointLightSystem(const PointLightSystem&) = delete;
 	PointLightSystem& operator=(const PointLightSystem&) = delete;
 
-	void update(VeFrameInfo& frame_info, UniformBufferObject& ubo);
+	// Moves the rotating lights and hands all lights of this frame to the cluster system
+	void update(VeFrameInfo& frame_info, LightClusterSystem& light_clusters);
 	void render(VeFrameInfo& frame_info) const;
 
 private:
@@ -41,6 +43,8 @@ private:
 	vk::raii::PipelineLayout m_pipeline_layout{nullptr};
 	std::unique_ptr<VePipeline> m_ve_pipeline;
 	std::filesystem::path m_shader_path;
+
+	std::vector<PointLight> m_lights; // reused every frame
 };
 }
 
@@ -2,6 +2,11 @@
 #include "systems/simple_render_system.hpp"
 #include "core/ve_device.hpp"
 #include "core/ve_pipeline.hpp"
+#include "core/ve_render_queue.hpp"
+#include "core/ve_frame_ring.hpp"
+#include "core/ve_descriptors.hpp"
+#include "core/ve_uploader.hpp"
+#include "core/ve_retirement_queue.hpp"
 #include "utils/ve_log.hpp"
 
 #define GLM_FORCE_RADIANS
@@ -10,43 +15,59 @@
 
 namespace ve {
 
-struct SimplePushConstantData {
-	alignas(16) glm::mat4 transform;
-	alignas(16) glm::mat3x4 normal_transform;
-	alignas(4)  float has_texture;
-	alignas(4)  float padding[3];
-};
-static_assert(sizeof(SimplePushConstantData) <= 128, "Push constants must be 128 bytes for stable layout");
+vk::VertexInputBindingDescription SimpleInstanceData::getBindingDescription() {
+	return vk::VertexInputBindingDescription{
+		.binding = 1,
+		.stride = sizeof(SimpleInstanceData),
+		.inputRate = vk::VertexInputRate::eInstance
+	};
+}
+
+// Locations 0-3 are used by VeModel::Vertex
+std::vector<vk::VertexInputAttributeDescription> SimpleInstanceData::getAttributeDescriptions() {
+	return {{
+		.location = 4,
+		.binding = 1,
+		.format = vk::Format::eR32Uint,
+		.offset = static_cast<uint32_t>(offsetof(SimpleInstanceData, object_slot))
+	}};
+}
 
 SimpleRenderSystem::SimpleRenderSystem(
 	VeDevice& device,
 	const vk::raii::DescriptorSetLayout& global_set_layout,
-	const vk::raii::DescriptorSetLayout& material_set_layout,
+	const vk::raii::DescriptorSetLayout& texture_set_layout,
+	const vk::raii::DescriptorSetLayout& light_set_layout,
+	std::shared_ptr<VeDescriptorPool> descriptor_pool,
+	VeFrameRing& frame_ring,
 	vk::Format color_format,
-	std::filesystem::path shader_path)
+	std::filesystem::path shader_path,
+	std::filesystem::path cull_kernel_path)
 	: m_ve_device(device), m_shader_path(shader_path) {
 
-	createPipelineLayout(global_set_layout, material_set_layout);
+	m_object_buffer = std::make_unique<VeObjectBuffer>(m_ve_device, descriptor_pool);
+	createPipelineLayout(global_set_layout, texture_set_layout, light_set_layout);
 	createPipeline(color_format);
+	m_cull_system = std::make_unique<CullSystem>(
+		m_ve_device, std::move(descriptor_pool), frame_ring, m_object_buffer->getSetLayout(), cull_kernel_path);
 }
 
 SimpleRenderSystem::~SimpleRenderSystem() {
 }
 
-void SimpleRenderSystem::createPipelineLayout(const vk::raii::DescriptorSetLayout& global_set_layout, const vk::raii::DescriptorSetLayout& material_set_layout) {
-	vk::PushConstantRange push_constant_range{
-		.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-		.offset = 0, // Used for indexing multiple push constant ranges
-		.size = sizeof(SimplePushConstantData)
-	};
+void SimpleRenderSystem::createPipelineLayout(
+	const vk::raii::DescriptorSetLayout& global_set_layout,
+	const vk::raii::DescriptorSetLayout& texture_set_layout,
+	const vk::raii::DescriptorSetLayout& light_set_layout) {
 	// Store raw handles to avoid DLL boundary issues with RAII objects
-	vk::DescriptorSetLayout layouts[2] = {*global_set_layout, *material_set_layout};
+	vk::DescriptorSetLayout layouts[4] = {
+		*global_set_layout, *texture_set_layout, *light_set_layout, *m_object_buffer->getSetLayout()};
 	vk::PipelineLayoutCreateInfo pipeline_layout_info{
 		.sType = vk::StructureType::ePipelineLayoutCreateInfo,
-		.setLayoutCount = 2,
+		.setLayoutCount = 4,
 		.pSetLayouts = layouts,
-		.pushConstantRangeCount = 1,
-		.pPushConstantRanges = &push_constant_range
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr
 	};
 	m_pipeline_layout = vk::raii::PipelineLayout(m_ve_device.getDevice(), pipeline_layout_info);
 }
@@ -55,6 +76,11 @@ void SimpleRenderSystem::createPipeline(vk::Format color_format) {
 	PipelineConfigInfo pipeline_config{};
 	VePipeline::defaultPipelineConfigInfo(pipeline_config, m_ve_device);
 	pipeline_config.color_format = color_format;
+	// Per-instance object slots in binding 1 next to the model vertices in binding 0
+	pipeline_config.binding_descriptions.push_back(SimpleInstanceData::getBindingDescription());
+	auto instance_attributes = SimpleInstanceData::getAttributeDescriptions();
+	pipeline_config.attribute_descriptions.insert(
+		pipeline_config.attribute_descriptions.end(), instance_attributes.begin(), instance_attributes.end());
 
 	assert(m_pipeline_layout != VK_NULL_HANDLE && "Pipeline layout is null");
 	pipeline_config.pipeline_layout = m_pipeline_layout;
@@ -66,40 +92,258 @@ void SimpleRenderSystem::createPipeline(vk::Format color_format) {
 
 }
 
-// Performs a draw call for each game object with a model component
-// TODO: bind and draw all objects with the same model at once
-void SimpleRenderSystem::renderObjects(VeFrameInfo& frame_info) const {
-	frame_info.command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_ve_pipeline->getPipeline());
-	frame_info.command_buffer.bindDescriptorSets(
-		vk::PipelineBindPoint::eGraphics,
-		*m_pipeline_layout,
-		{},
-		{frame_info.global_descriptor_set, frame_info.material_descriptor_set},
-		{}
-	);
+void SimpleRenderSystem::updateObjects(VeFrameInfo& frame_info) {
+	m_object_buffer->sync(frame_info.game_objects, frame_info.frame_ring);
+	m_object_buffer->record(*frame_info.command_buffer);
+	m_updated_frame = frame_info.current_frame;
+}
+
+// All objects with a model (not e.g. point lights), as seen by the last updateObjects
+void SimpleRenderSystem::gatherObjects() {
+	const auto objects = m_object_buffer->getObjects();
+	m_draw_list.assign(objects.begin(), objects.end());
+}
+
+// Writes the object slots of m_draw_list contiguously into the frame ring
+VeRingAllocation SimpleRenderSystem::writeInstances(VeFrameRing& frame_ring) const {
+	VeRingAllocation instances = frame_ring.allocate(
+		sizeof(SimpleInstanceData) * m_draw_list.size(), 16);
+	auto* instance_data = static_cast<SimpleInstanceData*>(instances.data);
+	for (size_t i = 0; i < m_draw_list.size(); ++i) {
+		instance_data[i].object_slot = m_draw_list[i].slot;
+	}
+	return instances;
+}
+
+// State shared by all draws, the arena page vertices at binding 0 and the instances at binding 1
+VeDrawPacket SimpleRenderSystem::makePacket(
+	VeFrameInfo& frame_info,
+	vk::Buffer instance_buffer,
+	vk::DeviceSize instance_offset,
+	const VeMeshArena& arena,
+	uint32_t page) const {
+	return VeDrawPacket{
+		.type = VeDrawPacket::DRAW_INDEXED,
+		.pipeline = m_ve_pipeline->getPipeline(frame_info.sample_count),
+		.pipeline_layout = *m_pipeline_layout,
+		.descriptor_sets = {
+			*frame_info.global_descriptor_set,
+			frame_info.texture_descriptor_set,
+			frame_info.light_descriptor_set,
+			m_object_buffer->getDescriptorSet()},
+		.descriptor_set_count = 4,
+		.dynamic_offset = frame_info.global_ubo_offset,
+		.vertex_buffers = {arena.getVertexBuffer(page), instance_buffer},
+		.vertex_offsets = {0, instance_offset},
+		.vertex_buffer_count = 2,
+		.index_buffer = arena.getIndexBuffer(page)
+	};
+}
+
+void SimpleRenderSystem::cullObjects(VeFrameInfo& frame_info, const VeFrustum& frustum) {
+	assert(m_updated_frame == frame_info.current_frame && "updateObjects must be called before cullObjects");
+	switch (m_cull_mode) {
+		case CULL_GPU:
+			cullOnGpu(frame_info, frustum);
+			break;
+		case CULL_CPU_BOXES:
+			gatherObjects();
+			cullOnCpu(frustum);
+			break;
+		case CULL_CPU_BVH:
+			cullWithBvh(frame_info, frustum);
+			break;
+	}
+	m_culled_frame = frame_info.current_frame;
+	m_culled_on_gpu = m_cull_mode == CULL_GPU;
+}
+
+// World space boxes of all objects are culled in one SIMD batch, m_draw_list keeps the survivors
+void SimpleRenderSystem::cullOnCpu(const VeFrustum& frustum) {
+	m_box_culler.clear();
+	m_box_culler.reserve(m_draw_list.size());
+	for (const auto& [obj, slot] : m_draw_list) {
+		m_box_culler.add(transformAabb(m_object_buffer->getTransform(slot), obj->ve_model->getBoundingBox()));
+	}
+	const uint32_t visible = m_box_culler.cull(frustum, m_visible);
+	// Indices are ascending, so compacting in place never overwrites an unread entry
+	for (uint32_t i = 0; i < visible; ++i) {
+		m_draw_list[i] = m_draw_list[m_visible[i]];
+	}
+	m_culled_count = static_cast<uint32_t>(m_draw_list.size()) - visible;
+	m_visible_count = visible;
+	m_draw_list.resize(visible);
+}
+
+// Only the leaves in view are visited, m_draw_list is rebuilt from the object ids they hold
+void SimpleRenderSystem::cullWithBvh(VeFrameInfo& frame_info, const VeFrustum& frustum) {
+	syncBvh(frame_info);
+	m_bvh.queryFrustum(frustum, m_visible);
+	m_draw_list.clear();
+	for (uint32_t id : m_visible) {
+		m_draw_list.push_back({ &frame_info.game_objects.at(id), m_object_buffer->getSlot(id) });
+	}
+	m_visible_count = static_cast<uint32_t>(m_visible.size());
+	m_culled_count = m_bvh.getLeafCount() - m_visible_count;
+}
 
+// New objects are inserted, moved ones refit their leaf and missing ones are removed.
+// Finding the moved ones still compares every transform, the boxes are only recomputed
+// for those. When most leaves are new, e.g. after loading a scene, the tree is built
+// again with the SAH since one by one insertion gives a worse tree.
+void SimpleRenderSystem::syncBvh(VeFrameInfo& frame_info) {
+	const uint32_t epoch = ++m_bvh_epoch;
+	uint32_t inserted = 0;
+	auto sameTransform = [](const TransformComponent& a, const TransformComponent& b) {
+		return a.translation == b.translation && a.rotation == b.rotation && a.scale == b.scale;
+	};
 	for (auto& [id, obj] : frame_info.game_objects) {
-		// Skip non-mesh objects (e.g., point lights) or missing models
 		if (!obj.ve_model)
 			continue;
-		SimplePushConstantData push{};
-		// Pack glm::mat3 into 3 vec4 columns (last component is padding)
-		const glm::mat3 nrm = obj.getNormalTransform();
-		push.normal_transform[0] = glm::vec4(nrm[0], 0.0f);
-		push.normal_transform[1] = glm::vec4(nrm[1], 0.0f);
-		push.normal_transform[2] = glm::vec4(nrm[2], 0.0f);
-		push.transform = obj.getTransform();
-		push.has_texture = obj.has_texture;
-		// push constant provided as raw bytes to avoid MSVC debug mode corruption with push across dll boundaries
-		frame_info.command_buffer.pushConstants(
-			*m_pipeline_layout,
-			vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-			0,
-			vk::ArrayProxy<const uint8_t>(sizeof(SimplePushConstantData), reinterpret_cast<const uint8_t*>(&push))
-		);
-		obj.ve_model->bindVertexBuffer(frame_info.command_buffer);
-		obj.ve_model->bindIndexBuffer(frame_info.command_buffer);
-		obj.ve_model->drawIndexed(frame_info.command_buffer);
+		auto [it, is_new] = m_bvh_entries.try_emplace(id);
+		BvhEntry& entry = it->second;
+		entry.epoch = epoch;
+		if (!is_new && entry.model == obj.ve_model.get() && sameTransform(entry.transform, obj.transform))
+			continue;
+		entry.transform = obj.transform;
+		entry.model = obj.ve_model.get();
+		const VeAabb box = transformAabb(obj.getTransform(), obj.ve_model->getBoundingBox());
+		if (is_new) {
+			entry.proxy = m_bvh.insert(box, id);
+			++inserted;
+		} else {
+			m_bvh.update(entry.proxy, box);
+		}
+	}
+	std::erase_if(m_bvh_entries, [&](const auto& item) {
+		if (item.second.epoch == epoch)
+			return false;
+		m_bvh.remove(item.second.proxy);
+		return true;
+	});
+
+	if (inserted > 0 && 2 * inserted > m_bvh.getLeafCount()) {
+		m_bvh_items.clear();
+		for (const auto& [id, entry] : m_bvh_entries) {
+			m_bvh_items.push_back({ m_bvh.getBox(entry.proxy), id });
+		}
+		m_bvh.build(m_bvh_items, &m_bvh_proxies);
+		// Same iteration order as above, the map was not modified in between
+		size_t i = 0;
+		for (auto& [id, entry] : m_bvh_entries) {
+			entry.proxy = m_bvh_proxies[i++];
+		}
+		VE_LOGD("SimpleRenderSystem: built BVH over " << m_bvh.getLeafCount() << " objects, height " << m_bvh.getHeight());
+	}
+}
+
+// The kernel visits every slot of the object buffer, the slots hold the bounding
+// spheres and draw arguments of their models and free ones are skipped. Nothing here
+// depends on the object count. All models are expected to live in one mesh arena.
+// The counts reported are those of the last time this frame index was culled, the
+// GPU result is not waited for.
+void SimpleRenderSystem::cullOnGpu(VeFrameInfo& frame_info, const VeFrustum& frustum) {
+	const uint32_t frame = frame_info.current_frame;
+	const auto objects = m_object_buffer->getObjects();
+	m_visible_count = m_cull_system->getLastVisibleCount(frame);
+	m_culled_count = m_gpu_object_counts[frame] - std::min(m_visible_count, m_gpu_object_counts[frame]);
+	m_gpu_object_counts[frame] = static_cast<uint32_t>(objects.size());
+
+	m_culled_arena = objects.empty() ? nullptr : &objects.front().object->ve_model->getArena();
+	const uint32_t slot_count = m_object_buffer->getSlotCount();
+	ensureSlotIndices(slot_count);
+	const uint32_t page_count = m_culled_arena ? m_culled_arena->getPageCount() : 1;
+	m_cull_system->record(
+		*frame_info.command_buffer, frame, frustum, m_object_buffer->getDescriptorSet(), slot_count, page_count);
+}
+
+// Grows the slot index buffer with the object buffer, written once through the uploader.
+// Frames in flight may still read the old one.
+void SimpleRenderSystem::ensureSlotIndices(uint32_t slot_count) {
+	if (slot_count <= m_slot_index_count)
+		return;
+	if (m_slot_indices)
+		m_ve_device.getRetirementQueue().retire(std::move(m_slot_indices));
+	m_slot_index_count = std::max(slot_count, m_object_buffer->getCapacity());
+	std::vector<SimpleInstanceData> indices(m_slot_index_count);
+	for (uint32_t i = 0; i < m_slot_index_count; ++i) {
+		indices[i].object_slot = i;
+	}
+	m_slot_indices = std::make_unique<VeBuffer>(
+		m_ve_device,
+		sizeof(SimpleInstanceData),
+		m_slot_index_count,
+		vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_ve_device.getUploader().uploadBuffer(
+		*m_slot_indices->getBuffer(), indices.data(), sizeof(SimpleInstanceData) * indices.size());
+}
+
+void SimpleRenderSystem::renderObjects(VeFrameInfo& frame_info) {
+	assert(m_updated_frame == frame_info.current_frame && "updateObjects must be called before renderObjects");
+	if (m_culled_frame != frame_info.current_frame) {
+		// Not culled this frame, draw everything
+		gatherObjects();
+		m_culled_on_gpu = false;
+		m_visible_count = static_cast<uint32_t>(m_draw_list.size());
+		m_culled_count = 0;
+	}
+	if (m_culled_on_gpu) {
+		renderCulled(frame_info);
+	} else {
+		renderInstanced(frame_info);
+	}
+	m_culled_frame.reset();
+}
+
+// Draw counts come from the cull kernel, the CPU only knows the upper bound
+void SimpleRenderSystem::renderCulled(VeFrameInfo& frame_info) {
+	if (!m_culled_arena)
+		return;
+	const uint32_t frame = frame_info.current_frame;
+	for (uint32_t page = 0; page < m_culled_arena->getPageCount(); ++page) {
+		VeDrawPacket packet = makePacket(frame_info, *m_slot_indices->getBuffer(), 0, *m_culled_arena, page);
+		packet.type = VeDrawPacket::DRAW_INDEXED_INDIRECT_COUNT;
+		packet.indirect_buffer = m_cull_system->getCommandBuffer(frame);
+		packet.indirect_offset = m_cull_system->getCommandOffset(page);
+		packet.count_buffer = m_cull_system->getCountBuffer(frame);
+		packet.count_offset = m_cull_system->getCountOffset(page);
+		packet.max_draw_count = m_cull_system->getCapacity();
+		packet.stride = static_cast<uint32_t>(CullSystem::COMMAND_STRIDE);
+		frame_info.render_queue.submit(VeRenderQueue::PASS_OPAQUE, 0.0f, packet);
+	}
+}
+
+// Buckets the objects in m_draw_list by model and submits one instanced draw per bucket.
+// Instance data of all buckets is written contiguously into the frame ring and
+// bound once at binding 1, the bucket selects its range with firstInstance.
+// The render queue groups the buckets by arena page and orders them front to back
+// by their nearest instance.
+void SimpleRenderSystem::renderInstanced(VeFrameInfo& frame_info) {
+	if (m_draw_list.empty())
+		return;
+	std::sort(m_draw_list.begin(), m_draw_list.end(), [](const VeObjectBuffer::Object& a, const VeObjectBuffer::Object& b) {
+		return a.object->ve_model.get() < b.object->ve_model.get();
+	});
+	const VeRingAllocation instances = writeInstances(frame_info.frame_ring);
+
+	size_t first = 0;
+	while (first < m_draw_list.size()) {
+		const VeModel& model = *m_draw_list[first].object->ve_model;
+		float depth = std::numeric_limits<float>::max();
+		size_t last = first;
+		for (; last < m_draw_list.size() && m_draw_list[last].object->ve_model.get() == &model; ++last)
+			depth = std::min(depth, frame_info.render_queue.getViewDepth(m_draw_list[last].object->transform.translation));
+
+		VeDrawPacket packet = makePacket(
+			frame_info, frame_info.frame_ring.getBuffer(), instances.offset, model.getArena(), model.getArenaPage());
+		packet.count = model.getIndexCount();
+		packet.instance_count = static_cast<uint32_t>(last - first);
+		packet.first = model.getFirstIndex();
+		packet.vertex_offset = model.getVertexOffset();
+		packet.first_instance = static_cast<uint32_t>(first);
+		frame_info.render_queue.submit(VeRenderQueue::PASS_OPAQUE, depth, packet);
+		first = last;
 	}
 }
 
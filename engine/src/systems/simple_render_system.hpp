@@ -2,9 +2,19 @@
 #include "ve_export.hpp"
 #include "ve_config.hpp"
 #include "game/ve_frame_info.hpp"
+#include "game/ve_frustum.hpp"
+#include "game/ve_culling.hpp"
+#include "game/ve_bvh.hpp"
+#include "game/ve_object_buffer.hpp"
+#include "core/ve_frame_ring.hpp"
+#include "core/ve_render_queue.hpp"
+#include "systems/cull_system.hpp"
 
 #include <memory>
 #include <vector>
+#include <optional>
+#include <array>
+#include <unordered_map>
 #include <filesystem>
 
 namespace ve {
@@ -15,27 +25,84 @@ namespace ve {
 
 namespace ve {
 
+// Per-instance vertex data of SimpleRenderSystem, written to the frame ring every frame.
+// The object data itself stays in VeObjectBuffer, the instance only selects its slot.
+// With GPU culling binding 1 is instead a persistent buffer holding i at index i, the
+// indirect draw of slot i selects its entry with firstInstance i.
+struct SimpleInstanceData {
+	uint32_t object_slot;
+
+	static vk::VertexInputBindingDescription getBindingDescription();
+	static std::vector<vk::VertexInputAttributeDescription> getAttributeDescriptions();
+};
+
 class VENGINE_API SimpleRenderSystem {
 public:
+	enum CullMode : uint32_t {
+		CULL_GPU = 0,       // cull kernel and drawIndexedIndirectCount
+		CULL_CPU_BOXES = 1, // SIMD test of every world space box
+		CULL_CPU_BVH = 2    // frustum query of a BVH kept in sync with the objects
+	};
+
 	SimpleRenderSystem( 
 		VeDevice& device,
 		const vk::raii::DescriptorSetLayout& global_set_layout,
-		const vk::raii::DescriptorSetLayout& material_set_layout,
+		const vk::raii::DescriptorSetLayout& texture_set_layout,
+		const vk::raii::DescriptorSetLayout& light_set_layout,
+		std::shared_ptr<VeDescriptorPool> descriptor_pool,
+		VeFrameRing& frame_ring,
 		vk::Format color_format,
-		std::filesystem::path shader_path);
+		std::filesystem::path shader_path,
+		std::filesystem::path cull_kernel_path);
 	~SimpleRenderSystem();
 
 	//destroy copy and move constructors and assignment operators
 	SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 	SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
-	void renderObjects(VeFrameInfo& frame_info) const;
+	// Writes the data of new and changed game objects into the object buffer, recorded
+	// into the graphics command buffer. Must be called every frame before cullObjects
+	// and outside of rendering.
+	void updateObjects(VeFrameInfo& frame_info);
+
+	// Culls all game objects with a model against the frustum. With GPU culling the
+	// kernel is recorded into the graphics command buffer and reads the object buffer
+	// slots, the CPU does no per-object work. Otherwise the world space boxes are culled
+	// on the CPU, one by one or through the BVH. Without a call this frame everything is drawn.
+	void cullObjects(VeFrameInfo& frame_info, const VeFrustum& frustum);
+	// Submits to the frame's render queue. With GPU culling, one drawIndexedIndirectCount
+	// per arena page over the culled draws. Otherwise one instanced draw per distinct visible model.
+	void renderObjects(VeFrameInfo& frame_info);
+
+	void setCullMode(CullMode mode) { m_cull_mode = mode; }
+	CullMode getCullMode() const { return m_cull_mode; }
+	// Objects that passed and failed the last cull, GPU counts lag MAX_FRAMES_IN_FLIGHT frames
+	uint32_t getVisibleCount() const { return m_visible_count; }
+	uint32_t getCulledCount() const { return m_culled_count; }
+	// Objects written by the last updateObjects
+	uint32_t getUploadedCount() const { return m_object_buffer->getUploadCount(); }
 
 private:
 	void createPipelineLayout(
 		const vk::raii::DescriptorSetLayout& global_set_layout, 
-		const vk::raii::DescriptorSetLayout& material_set_layout);
+		const vk::raii::DescriptorSetLayout& texture_set_layout,
+		const vk::raii::DescriptorSetLayout& light_set_layout);
 	void createPipeline(vk::Format color_format);
+	void gatherObjects();
+	void cullOnCpu(const VeFrustum& frustum);
+	void cullWithBvh(VeFrameInfo& frame_info, const VeFrustum& frustum);
+	void syncBvh(VeFrameInfo& frame_info);
+	void cullOnGpu(VeFrameInfo& frame_info, const VeFrustum& frustum);
+	void ensureSlotIndices(uint32_t slot_count);
+	VeRingAllocation writeInstances(VeFrameRing& frame_ring) const;
+	VeDrawPacket makePacket(
+		VeFrameInfo& frame_info,
+		vk::Buffer instance_buffer,
+		vk::DeviceSize instance_offset,
+		const VeMeshArena& arena,
+		uint32_t page) const;
+	void renderCulled(VeFrameInfo& frame_info);
+	void renderInstanced(VeFrameInfo& frame_info);
 
 	VeDevice& m_ve_device;
 
@@ -43,6 +110,39 @@ private:
 
 	vk::raii::PipelineLayout m_pipeline_layout{nullptr};
 	std::unique_ptr<VePipeline> m_ve_pipeline;
+	std::unique_ptr<CullSystem> m_cull_system;
+	std::unique_ptr<VeObjectBuffer> m_object_buffer; // set 3, transforms of all objects
+	std::unique_ptr<VeBuffer> m_slot_indices;        // i at index i, instances of the culled draws
+	uint32_t m_slot_index_count = 0;
+
+	CullMode m_cull_mode = CULL_GPU;
+	// Set by updateObjects and cullObjects for the frame they ran for
+	std::optional<uint32_t> m_updated_frame;
+	std::optional<uint32_t> m_culled_frame; // consumed by renderObjects
+	bool m_culled_on_gpu = false;
+	const VeMeshArena* m_culled_arena = nullptr;
+
+	uint32_t m_visible_count = 0;
+	uint32_t m_culled_count = 0;
+	std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> m_gpu_object_counts{}; // objects with a slot per culled frame
+
+	// Reused every frame to avoid per-frame allocations
+	std::vector<VeObjectBuffer::Object> m_draw_list;
+	VeBoxCuller m_box_culler;
+	std::vector<uint32_t> m_visible;
+
+	// Leaf of each object with a model in m_bvh, keyed by object id
+	struct BvhEntry {
+		uint32_t proxy;
+		TransformComponent transform; // transform and model the leaf box was computed from
+		const VeModel* model;
+		uint32_t epoch;               // last sync that saw the object
+	};
+	VeBvh m_bvh;
+	std::unordered_map<uint32_t, BvhEntry> m_bvh_entries;
+	uint32_t m_bvh_epoch = 0;
+	std::vector<VeBvh::Item> m_bvh_items;
+	std::vector<uint32_t> m_bvh_proxies;
 };
 }
 
@@ -2,6 +2,7 @@
 #include "systems/skybox_render_system.hpp"
 #include "core/ve_device.hpp"
 #include "core/ve_pipeline.hpp"
+#include "core/ve_render_queue.hpp"
 #include "utils/ve_log.hpp"
 
 #define GLM_FORCE_RADIANS
@@ -18,6 +19,7 @@ static_assert(offsetof(SimplePushConstantData, transform) == 0, "SimplePushConst
 
 SkyboxRenderSystem::SkyboxRenderSystem(
 	VeDevice& device,
+	VeMeshArena& mesh_arena,
 	const vk::raii::DescriptorSetLayout& global_set_layout,
 	const vk::raii::DescriptorSetLayout& material_set_layout,
 	vk::Format color_format,
@@ -27,13 +29,13 @@ SkyboxRenderSystem::SkyboxRenderSystem(
 
 	createPipelineLayout(global_set_layout, material_set_layout);
 	createPipeline(color_format);
-	loadCubeModel(cube_model_path);
+	loadCubeModel(mesh_arena, cube_model_path);
 }
 
 SkyboxRenderSystem::~SkyboxRenderSystem() {}
 
-void SkyboxRenderSystem::loadCubeModel(const std::filesystem::path& cube_model_path) {
-	std::shared_ptr<VeModel> model = std::make_shared<VeModel>(m_ve_device, cube_model_path);
+void SkyboxRenderSystem::loadCubeModel(VeMeshArena& mesh_arena, const std::filesystem::path& cube_model_path) {
+	std::shared_ptr<VeModel> model = std::make_shared<VeModel>(mesh_arena, cube_model_path);
 	m_cube_object.ve_model = model;
 	m_cube_object.transform.scale = 4.0f * glm::vec3(1500.0f, 1500.0f, 1500.0f);
 }
@@ -85,17 +87,9 @@ void SkyboxRenderSystem::createPipeline(vk::Format color_format) {
 	assert(m_ve_pipeline && "Failed to create skybox pipeline");
 }
 
-// Draws a big cube and binds cubemap texture for shader
+// Submits a big cube with the cubemap texture bound for the shader, in the background pass
 // TODO: move update logic to a separate function
 void SkyboxRenderSystem::render(VeFrameInfo& frame_info) {
-	frame_info.command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_ve_pipeline->getPipeline());
-	frame_info.command_buffer.bindDescriptorSets(
-		vk::PipelineBindPoint::eGraphics,
-		*m_pipeline_layout,
-		{},
-		{frame_info.global_descriptor_set, frame_info.cubemap_descriptor_set},
-		{}
-	);
 	SimplePushConstantData push{};
 	assert (m_cube_object.ve_model != nullptr && "Cube model is null");
 	float speed = 0.008f;
@@ -103,17 +97,24 @@ void SkyboxRenderSystem::render(VeFrameInfo& frame_info) {
 
 	push.transform = m_cube_object.getTransform();
 
-	// push constant provided as raw bytes to avoid MSVC debug mode corruption with push across dll boundaries
-	frame_info.command_buffer.pushConstants(
-		*m_pipeline_layout,
-		vk::ShaderStageFlagBits::eVertex,
-		0,
-		vk::ArrayProxy<const uint8_t>(sizeof(SimplePushConstantData), reinterpret_cast<const uint8_t*>(&push))
-	);
-
-	m_cube_object.ve_model->bindVertexBuffer(frame_info.command_buffer);
-	m_cube_object.ve_model->bindIndexBuffer(frame_info.command_buffer);
-	m_cube_object.ve_model->drawIndexed(frame_info.command_buffer);
+	// push constants are copied into the queue as raw bytes and pushed when recorded
+	const VeModel& model = *m_cube_object.ve_model;
+	const VeMeshArena& arena = model.getArena();
+	frame_info.render_queue.submit(VeRenderQueue::PASS_BACKGROUND, 0.0f, VeDrawPacket{
+		.type = VeDrawPacket::DRAW_INDEXED,
+		.pipeline = m_ve_pipeline->getPipeline(frame_info.sample_count),
+		.pipeline_layout = *m_pipeline_layout,
+		.descriptor_sets = {*frame_info.global_descriptor_set, *frame_info.cubemap_descriptor_set},
+		.descriptor_set_count = 2,
+		.dynamic_offset = frame_info.global_ubo_offset,
+		.vertex_buffers = {arena.getVertexBuffer(model.getArenaPage())},
+		.vertex_buffer_count = 1,
+		.index_buffer = arena.getIndexBuffer(model.getArenaPage()),
+		.push_stages = vk::ShaderStageFlagBits::eVertex,
+		.count = model.getIndexCount(),
+		.first = model.getFirstIndex(),
+		.vertex_offset = model.getVertexOffset()
+	}, push);
 }
 
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ namespace ve {
     // Forward declarations
     class VeDevice;
     class VePipeline;
+    class VeMeshArena;
 }
 
 namespace ve {
@@ -22,6 +23,7 @@ namespace ve {
 class VENGINE_API SkyboxRenderSystem {
 public:
 	SkyboxRenderSystem( VeDevice& device,
+						VeMeshArena& mesh_arena,
 						const vk::raii::DescriptorSetLayout& global_set_layout,
 						const vk::raii::DescriptorSetLayout& material_set_layout,
 						vk::Format color_format,
@@ -37,7 +39,7 @@ public:
 	void render(VeFrameInfo& frame_info);
 
 private:
-	void loadCubeModel(const std::filesystem::path& cube_model_path);
+	void loadCubeModel(VeMeshArena& mesh_arena, const std::filesystem::path& cube_model_path);
 	void createPipelineLayout(const vk::raii::DescriptorSetLayout& global_set_layout, const vk::raii::DescriptorSetLayout& material_set_layout);
 	void createPipeline(vk::Format color_format);
 
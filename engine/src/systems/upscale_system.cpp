@@ -0,0 +1,139 @@
+#include "pch.hpp"
+#include "systems/upscale_system.hpp"
+#include "core/ve_device.hpp"
+#include "core/ve_image.hpp"
+#include "core/ve_pipeline.hpp"
+#include "core/ve_retirement_queue.hpp"
+#include "utils/ve_log.hpp"
+
+namespace ve {
+
+// Layout must match PushConstantData in upscale_shader.slang
+struct UpscalePushConstantData {
+	glm::vec2 scale;        // source pixels per output pixel
+	glm::vec2 source_texel; // 1 / size of the source image
+	glm::vec2 render_max;   // last source pixel of the render extent
+	float sharpness;
+	float padding;
+};
+static_assert(sizeof(UpscalePushConstantData) == 32, "UpscalePushConstantData size mismatch");
+
+UpscaleSystem::UpscaleSystem(
+	VeDevice& device,
+	std::shared_ptr<VeDescriptorPool> descriptor_pool,
+	vk::Format color_format,
+	std::filesystem::path shader_path)
+	: m_ve_device(device), m_descriptor_pool(std::move(descriptor_pool)), m_shader_path(std::move(shader_path)) {
+	m_set_layout = VeDescriptorSetLayout::Builder(m_ve_device)
+		.addBinding(0, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment)
+		.build();
+	createSampler();
+	createPipelineLayout();
+	createPipeline(color_format);
+}
+
+UpscaleSystem::~UpscaleSystem() {}
+
+// The shader only samples texel centers, linear filtering keeps those exact
+void UpscaleSystem::createSampler() {
+	vk::SamplerCreateInfo sampler_info{
+		.magFilter = vk::Filter::eLinear,
+		.minFilter = vk::Filter::eLinear,
+		.mipmapMode = vk::SamplerMipmapMode::eNearest,
+		.addressModeU = vk::SamplerAddressMode::eClampToEdge,
+		.addressModeV = vk::SamplerAddressMode::eClampToEdge,
+		.addressModeW = vk::SamplerAddressMode::eClampToEdge,
+		.mipLodBias = 0.0f,
+		.anisotropyEnable = vk::False,
+		.maxAnisotropy = 1.0f,
+		.compareEnable = vk::False,
+		.compareOp = vk::CompareOp::eAlways,
+		.minLod = 0.0f,
+		.maxLod = 0.0f,
+		.borderColor = vk::BorderColor::eIntOpaqueBlack,
+		.unnormalizedCoordinates = vk::False
+	};
+	m_sampler = vk::raii::Sampler(m_ve_device.getDevice(), sampler_info);
+}
+
+void UpscaleSystem::createPipelineLayout() {
+	vk::PushConstantRange push_constant_range{
+		.stageFlags = vk::ShaderStageFlagBits::eFragment,
+		.offset = 0,
+		.size = sizeof(UpscalePushConstantData)
+	};
+	vk::DescriptorSetLayout layout = *m_set_layout->getDescriptorSetLayout();
+	vk::PipelineLayoutCreateInfo pipeline_layout_info{
+		.sType = vk::StructureType::ePipelineLayoutCreateInfo,
+		.setLayoutCount = 1,
+		.pSetLayouts = &layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constant_range
+	};
+	m_pipeline_layout = vk::raii::PipelineLayout(m_ve_device.getDevice(), pipeline_layout_info);
+}
+
+void UpscaleSystem::createPipeline(vk::Format color_format) {
+	PipelineConfigInfo pipeline_config{};
+	VePipeline::defaultPipelineConfigInfo(pipeline_config, m_ve_device);
+
+	// A single sampled color target without depth, the triangle is generated from the vertex index
+	pipeline_config.color_format = color_format;
+	pipeline_config.depth_format = vk::Format::eUndefined;
+	pipeline_config.multisample_info.rasterizationSamples = vk::SampleCountFlagBits::e1;
+	pipeline_config.rasterization_info.cullMode = vk::CullModeFlagBits::eNone;
+	pipeline_config.rasterization_info.depthBiasEnable = VK_FALSE;
+	pipeline_config.depth_stencil_info.depthTestEnable = VK_FALSE;
+	pipeline_config.depth_stencil_info.depthWriteEnable = VK_FALSE;
+	pipeline_config.color_blend_attachment.blendEnable = VK_FALSE;
+	pipeline_config.attribute_descriptions.clear();
+	pipeline_config.binding_descriptions.clear();
+
+	assert(m_pipeline_layout != VK_NULL_HANDLE && "Pipeline layout is null");
+	pipeline_config.pipeline_layout = m_pipeline_layout;
+	m_ve_pipeline = std::make_unique<VePipeline>(
+		m_ve_device,
+		m_shader_path,
+		pipeline_config
+	);
+	assert(m_ve_pipeline && "Failed to create upscale pipeline");
+}
+
+// Only the recreation of the swap chain replaces the scene image. Frames in flight may
+// still be pending with the old set bound, so a new set is written and the old one retired.
+void UpscaleSystem::updateDescriptorSet(const VeImage& source) {
+	vk::ImageView view = *source.getImageView();
+	if (view == m_source_view)
+		return;
+	m_source_view = view;
+	vk::DescriptorImageInfo image_info{
+		.sampler = *m_sampler,
+		.imageView = view,
+		.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+	};
+	if (*m_descriptor_set)
+		m_ve_device.getRetirementQueue().retire(std::move(m_descriptor_set), m_descriptor_pool);
+	m_descriptor_set = vk::raii::DescriptorSet{nullptr};
+	VeDescriptorWriter(*m_set_layout, *m_descriptor_pool)
+		.writeImage(0, &image_info)
+		.build(m_descriptor_set);
+}
+
+void UpscaleSystem::render(vk::CommandBuffer command_buffer, const VeImage& source, vk::Extent2D render_extent) {
+	updateDescriptorSet(source);
+
+	const auto source_extent = source.getExtent2D();
+	UpscalePushConstantData push{
+		.scale = glm::vec2(render_extent.width, render_extent.height) / glm::vec2(source_extent.width, source_extent.height),
+		.source_texel = 1.0f / glm::vec2(source_extent.width, source_extent.height),
+		.render_max = glm::vec2(render_extent.width, render_extent.height) - 1.0f,
+		.sharpness = m_sharpness,
+		.padding = 0.0f
+	};
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_ve_pipeline->getPipeline());
+	command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *m_pipeline_layout, 0, *m_descriptor_set, {});
+	command_buffer.pushConstants<UpscalePushConstantData>(*m_pipeline_layout, vk::ShaderStageFlagBits::eFragment, 0, push);
+	command_buffer.draw(3, 1, 0, 0);
+}
+
+} // namespace ve
@@ -0,0 +1,63 @@
+/* UpscaleSystem draws the scene image onto the swap chain image. The scene covers only
+the top left render extent of the scene image when the render scale is below one, the
+pass stretches it over the whole output with a Catmull-Rom filter that is clamped to
+the nearest source pixels against ringing, and an optional contrast adaptive sharpen.
+It records directly into the present pass begun by VeRenderer::beginPresentRender. */
+#pragma once
+#include "ve_export.hpp"
+#include "ve_config.hpp"
+#include "core/ve_descriptors.hpp"
+
+#include <memory>
+#include <filesystem>
+
+namespace ve {
+	// Forward declarations
+	class VeDevice;
+	class VeImage;
+	class VePipeline;
+}
+
+namespace ve {
+
+class VENGINE_API UpscaleSystem {
+public:
+	UpscaleSystem(
+		VeDevice& device,
+		std::shared_ptr<VeDescriptorPool> descriptor_pool,
+		vk::Format color_format,
+		std::filesystem::path shader_path);
+	~UpscaleSystem();
+
+	UpscaleSystem(const UpscaleSystem&) = delete;
+	UpscaleSystem& operator=(const UpscaleSystem&) = delete;
+
+	// 0 disables sharpening, 1 is the strongest
+	void setSharpness(float sharpness) { m_sharpness = sharpness; }
+	float getSharpness() const { return m_sharpness; }
+
+	// Draws a fullscreen triangle sampling the render_extent corner of source. The source
+	// must be in ShaderReadOnlyOptimal and have the size of the output.
+	void render(vk::CommandBuffer command_buffer, const VeImage& source, vk::Extent2D render_extent);
+
+private:
+	void createSampler();
+	void createPipelineLayout();
+	void createPipeline(vk::Format color_format);
+	void updateDescriptorSet(const VeImage& source);
+
+	VeDevice& m_ve_device;
+	std::shared_ptr<VeDescriptorPool> m_descriptor_pool;
+	std::filesystem::path m_shader_path;
+
+	std::unique_ptr<VeDescriptorSetLayout> m_set_layout;
+	vk::raii::DescriptorSet m_descriptor_set{nullptr};
+	vk::ImageView m_source_view{}; // the descriptor set was written with, changes when the swap chain is recreated
+	vk::raii::Sampler m_sampler{nullptr};
+	vk::raii::PipelineLayout m_pipeline_layout{nullptr};
+	std::unique_ptr<VePipeline> m_ve_pipeline;
+
+	float m_sharpness = 0.25f;
+};
+
+} // namespace ve
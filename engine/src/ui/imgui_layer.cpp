@@ -8,6 +8,7 @@
 #include <imgui.h>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
+#include <bit>
 
 
 namespace ve {
@@ -140,11 +141,20 @@ void ImGuiLayer::renderUI(UIContext& context) {
 			if (ImGui::Button("Apply")) context.apply_particle_count = true;
 			ImGui::SameLine();
 			if (ImGui::Button("Reset")) context.reset_particle_count = true;
+			ImGui::Separator();
+			ImGui::Checkbox("In-place simulation", &context.particles_in_place);
+			ImGui::Checkbox("Frustum culling", &context.particle_culling);
+			ImGui::Text("Particle memory: %.1f MiB", static_cast<double>(context.particle_memory) / (1024.0 * 1024.0));
+			ImGui::Separator();
+			ImGui::SliderFloat("Emitter rate", &context.emitter_rate, 0, 500000);
+			if (ImGui::Button("Burst")) context.emitter_burst = true;
+			ImGui::SameLine();
+			ImGui::Text("Alive: %u", context.emitter_alive);
 		}
 		ImGui::End();
 
 		// Ui displaying controls such as wasd movement, c to crouch, space to jump
-		// 1,2,3,4,5 for particle behavior
+		// 1,2,3,4,5,6 for particle behavior
 		if (ImGui::Begin("Controls", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
 			// bottom right
 			ImGui::SetWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x - 200, ImGui::GetIO().DisplaySize.y - 200), ImGuiCond_Always);
@@ -157,23 +167,21 @@ void ImGuiLayer::renderUI(UIContext& context) {
 			ImGui::Text("3: Succ mode");
 			ImGui::Text("4: Stasis");
 			ImGui::Text("5: Ugly galaxy");
+			ImGui::Text("6: Fluid");
 
 		}
 		ImGui::End();
 
-		/* TODO: need to recreate pipelines when toggling MSAA
 		// Graphics settings window
 		if (ImGui::Begin("Graphics Settings", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
 			// bottom left
 			ImGui::SetWindowPos(ImVec2(10, ImGui::GetIO().DisplaySize.y - 200), ImGuiCond_Always);
-			static bool msaa_enabled = false;
-			if (ImGui::Checkbox("Enable MSAA", &msaa_enabled)) {
-				// Restart renderer with/without msaa
-				m_renderer.setMSAAEnabled(msaa_enabled);
+			int samples_index = std::min(std::countr_zero(context.sample_count), 3);
+			if (ImGui::Combo("MSAA", &samples_index, "Off\0" "2x\0" "4x\0" "8x\0")) {
+				context.sample_count = 1u << samples_index;
 			}
 		}
 		ImGui::End();
-		*/
 
 		// crude performance window
 		static auto s_time_start = std::chrono::high_resolution_clock::now();
@@ -198,6 +206,29 @@ void ImGuiLayer::renderUI(UIContext& context) {
 			//resolution
 			auto extent = m_renderer.getExtent();
 			ImGui::Text("Resolution: %d x %d", extent.width, extent.height);
+			// device memory usage of the sub-allocator
+			const auto mem_stats = m_device.getAllocator().getStats();
+			ImGui::Text("GPU memory: %.1f / %.1f MB", static_cast<double>(mem_stats.used_bytes) / (1024.0 * 1024.0),
+				static_cast<double>(mem_stats.reserved_bytes) / (1024.0 * 1024.0));
+			ImGui::Text("Allocations: %u in %u device allocs", mem_stats.allocation_count, mem_stats.getDeviceMemoryCount());
+			ImGui::Separator();
+			ImGui::Combo("Culling", &context.cull_mode, "GPU\0CPU boxes\0CPU BVH\0");
+			ImGui::Text("Objects: %u visible, %u culled, %u uploaded", context.visible_objects, context.culled_objects, context.uploaded_objects);
+			ImGui::Text("Draws: %u, binds: %u (%u saved)", context.draw_packets, context.binds, context.binds_saved);
+			ImGui::Separator();
+			ImGui::Text("GPU Time: %.2f ms", context.gpu_time);
+			ImGui::Checkbox("Async compute", &context.async_compute);
+			ImGui::Text("GPU compute: %.2f ms, overlap %.2f ms", context.gpu_compute_time, context.gpu_overlap_time);
+			const auto render_extent = m_renderer.getRenderExtent();
+			ImGui::Text("Render resolution: %d x %d", render_extent.width, render_extent.height);
+			ImGui::Checkbox("Dynamic resolution", &context.dynamic_resolution);
+			if (context.dynamic_resolution) {
+				ImGui::SliderFloat("Target GPU ms", &context.target_gpu_time, 1.0f, 33.0f);
+				ImGui::Text("Render scale: %.2f", context.render_scale);
+			} else {
+				ImGui::SliderFloat("Render scale", &context.render_scale, ve::MIN_RENDER_SCALE, 1.0f);
+			}
+			ImGui::SliderFloat("Sharpness", &context.upscale_sharpness, 0.0f, 1.0f);
 		}
 		ImGui::End();
 		s_time_start = now;
@@ -24,6 +24,42 @@ struct VENGINE_API UIContext {
 	float particle_velocity_stddev;
 	bool apply_velocity_params;
 
+	// particle storage, in place simulation halves the particle buffers but adds a render stream per frame
+	// with async compute. Memory is written by the application.
+	bool particles_in_place;
+	uint64_t particle_memory; // bytes
+	bool particle_culling; // only particles in the view frustum are drawn
+
+	// emitter pool, the alive count is written by the application
+	float emitter_rate; // particles per second
+	bool emitter_burst;
+	uint32_t emitter_alive;
+
+	// culling, counts are written by the application every frame
+	int cull_mode; // SimpleRenderSystem::CullMode
+	uint32_t visible_objects;
+	uint32_t culled_objects;
+	uint32_t uploaded_objects; // object buffer slots written this frame
+
+	// render queue counts of the last frame
+	uint32_t draw_packets;
+	uint32_t binds;
+	uint32_t binds_saved;
+
+	// resolution, render_scale is set by the UI without dynamic resolution and by the controller with it
+	bool dynamic_resolution;
+	float target_gpu_time; // ms
+	float render_scale;
+	float upscale_sharpness;
+	float gpu_time; // ms of the last finished frame, written by the application
+
+	// compute of a frame runs alongside the graphics of the previous one, times are written by the application
+	bool async_compute;
+	float gpu_compute_time; // ms
+	float gpu_overlap_time; // ms the compute work ran alongside graphics
+
+	// msaa samples requested by the UI, 1 disables msaa. The application writes back the count the device supports.
+	uint32_t sample_count;
 };
 
 class VENGINE_API ImGuiLayer {
@@ -8,7 +8,25 @@ namespace ve {
 
 constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
 constexpr glm::vec4 DEFAULT_AMBIENT_LIGHT_COLOR = glm::vec4(1.0f, 1.0f, 1.0f, 0.02f); // w indicates light intensity
-constexpr uint32_t MAX_LIGHTS = 100; // requirded for UBO alignment
+// Clustered lighting: screen tiles x, y and exponential depth slices, see LightClusterSystem
+constexpr uint32_t LIGHT_CLUSTER_X = 16;
+constexpr uint32_t LIGHT_CLUSTER_Y = 9;
+constexpr uint32_t LIGHT_CLUSTER_Z = 24;
+constexpr uint32_t LIGHT_CLUSTER_MAX_LIGHTS = 128; // light index slots per cluster, extra lights are dropped
+constexpr float LIGHT_CLUSTER_FAR = 500.0f; // depth sliced exponentially, the last slice reaches the far plane
+constexpr float LIGHT_CUTOFF = 0.005f; // attenuated intensity at which a point light's range ends
+constexpr uint64_t FRAME_RING_REGION_SIZE = 4 * 1024 * 1024; // bytes of transient data per frame in flight
+constexpr uint32_t MESH_ARENA_PAGE_VERTICES = 1024 * 1024; // vertices per mesh arena page
+constexpr uint32_t MESH_ARENA_PAGE_INDICES = 4 * 1024 * 1024; // indices per mesh arena page
+constexpr uint32_t TEXTURE_REGISTRY_CAPACITY = 4096; // bindless textures, lowered to the device limits
+constexpr uint32_t NO_TEXTURE = UINT32_MAX; // texture index of untextured objects
+constexpr uint32_t RECORD_PACKETS_PER_CHUNK = 256; // fewer draws per thread are recorded on the main thread
+constexpr float MIN_RENDER_SCALE = 0.5f; // lowest fraction of the swap chain extent the scene is rendered at
+constexpr float DYNAMIC_RESOLUTION_TARGET_MS = 1000.0f / 60.0f; // default GPU time budget of the resolution controller
+constexpr uint32_t PARTICLE_GRID_CELLS = 1u << 18; // hash buckets of the particle grid, a power of two
+constexpr uint32_t PARTICLE_EMITTER_CAPACITY = 1u << 20; // particles of the sandbox emitter pool
+constexpr vk::Format OIT_ACCUM_FORMAT = vk::Format::eR16G16B16A16Sfloat; // weighted premultiplied color and revealage
+constexpr vk::Format OIT_WEIGHT_FORMAT = vk::Format::eR16Sfloat; // sum of the weighted alphas
 
 //graphics settings
 constexpr bool MSAA_ENABLED = true;
@@ -42,7 +60,6 @@ enum class QueueKind { Graphics, Transfer };
 }// namespace ve
 
 // TODO: Windows: test separate transfer queue on Windows with a discrete GPU
-// TODO: Consdider consolidating index and vertex buffer into single buffer and use offsets
 // TODO: Make sure the directories are setup correctly
 // TODO: consider moving the timeline semaphore from VeSwapChain somewhere else
 // TODO: Fix window resize crash on windows
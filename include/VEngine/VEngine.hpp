@@ -10,18 +10,31 @@
 #include "core/ve_device.hpp"
 #include "core/ve_pipeline.hpp"
 #include "core/ve_buffer.hpp"
+#include "core/ve_frame_ring.hpp"
+#include "core/ve_render_queue.hpp"
+#include "core/ve_thread_pool.hpp"
+#include "core/ve_uploader.hpp"
+#include "core/ve_retirement_queue.hpp"
 #include "core/ve_image.hpp"
 #include "core/ve_compute_pipeline.hpp"
 #include "core/ve_descriptors.hpp"
 #include "core/ve_swap_chain.hpp"
 
 #include "core/ve_renderer.hpp"
+#include "core/ve_dynamic_resolution.hpp"
 #include "core/ve_texture.hpp"
+#include "core/ve_texture_registry.hpp"
 
 #include "game/ve_frame_info.hpp"
 #include "game/ve_game_object.hpp"
 #include "game/ve_camera.hpp"
+#include "game/ve_mesh_arena.hpp"
 #include "game/ve_model.hpp"
+#include "game/ve_bounds.hpp"
+#include "game/ve_frustum.hpp"
+#include "game/ve_culling.hpp"
+#include "game/ve_bvh.hpp"
+#include "game/ve_object_buffer.hpp"
 
 #include "utils/ve_log.hpp"
 #include "input/input_controller.hpp"
@@ -32,4 +45,11 @@
 #include "systems/axes_render_system.hpp"
 #include "systems/point_light_system.hpp"
 #include "systems/particle_system.hpp"
-#include "systems/skybox_render_system.hpp"
\ No newline at end of file
+#include "systems/skybox_render_system.hpp"
+#include "systems/cull_system.hpp"
+#include "systems/light_cluster_system.hpp"
+#include "systems/upscale_system.hpp"
+#include "systems/oit_composite_system.hpp"
+#include "systems/particle_grid_system.hpp"
+#include "systems/particle_emitter_system.hpp"
+#include "systems/particle_cpu_simulator.hpp"
\ No newline at end of file
@@ -0,0 +1,83 @@
+/* Helpers shared by the particle tests: a tolerance compare of positions, a descriptor
+pool and global set layout for ParticleSystem, and one recorded update read back. */
+#pragma once
+#include <catch2/catch_test_macros.hpp>
+#include <systems/particle_system.hpp>
+#include <core/ve_descriptors.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_frame_ring.hpp>
+#include <core/ve_render_queue.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Scaled by the magnitude above 1, positions reach a hundred units from the origin
+inline bool near(glm::vec3 a, glm::vec3 b, float tolerance) {
+	for (int axis = 0; axis < 3; ++axis) {
+		if (std::abs(a[axis] - b[axis]) > tolerance * std::max(1.0f, std::abs(b[axis]))) return false;
+	}
+	return true;
+}
+
+// Records one update of the system into a compute command buffer and reads back its particles
+inline std::vector<ve::Particle> runUpdate(ve::VeDevice& device, ve::ParticleSystem& system, ve::VeFrameRing& frame_ring, float delta_time) {
+	vk::CommandBufferAllocateInfo alloc_info{
+		.commandPool = *device.getComputeCommandPool(),
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = 1
+	};
+	auto command_buffer = std::move(vk::raii::CommandBuffers(device.getDevice(), alloc_info).front());
+	command_buffer.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+
+	frame_ring.beginFrame(0);
+	ve::VeRenderQueue render_queue;
+	std::unordered_map<uint32_t, ve::VeGameObject> game_objects;
+	vk::raii::DescriptorSet no_set{nullptr};
+	vk::raii::CommandBuffer no_graphics{nullptr};
+	ve::VeFrameInfo frame_info{no_set, no_set, no_set, no_graphics, command_buffer, frame_ring, render_queue, game_objects,
+		delta_time, 0.0f, 0};
+	system.update(frame_info);
+
+	const vk::DeviceSize size = sizeof(ve::Particle) * system.getParticleCount();
+	const auto host = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	ve::VeBuffer readback{device, size, 1u, vk::BufferUsageFlagBits::eTransferDst, host};
+	vk::MemoryBarrier2 barrier{
+		.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+		.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+		.dstAccessMask = vk::AccessFlagBits2::eTransferRead
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier });
+	command_buffer.copyBuffer(system.getParticleBuffer(0), *readback.getBuffer(), vk::BufferCopy{ 0, 0, size });
+	command_buffer.end();
+
+	vk::raii::Fence fence{device.getDevice(), vk::FenceCreateInfo{}};
+	vk::CommandBuffer cmd = *command_buffer;
+	device.getComputeQueue().submit(vk::SubmitInfo{ .commandBufferCount = 1, .pCommandBuffers = &cmd }, *fence);
+	REQUIRE(device.getDevice().waitForFences(*fence, VK_TRUE, UINT64_MAX) == vk::Result::eSuccess);
+
+	std::vector<ve::Particle> particles(system.getParticleCount());
+	readback.map();
+	std::memcpy(particles.data(), readback.getMappedMemory(), size);
+	return particles;
+}
+
+inline std::shared_ptr<ve::VeDescriptorPool> makePool(ve::VeDevice& device) {
+	return ve::VeDescriptorPool::Builder(device)
+		// Simulation and grid sets, the replaced ones stay in the retirement queue without frames to collect them
+		.setMaxSets(24)
+		.addPoolSize(vk::DescriptorType::eUniformBufferDynamic, 8)
+		.addPoolSize(vk::DescriptorType::eStorageBuffer, 96)
+		.setPoolFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+		.buildShared();
+}
+
+inline std::unique_ptr<ve::VeDescriptorSetLayout> makeGlobalSetLayout(ve::VeDevice& device) {
+	return ve::VeDescriptorSetLayout::Builder(device)
+		.addBinding(0, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eAllGraphics)
+		.build();
+}
@@ -0,0 +1,101 @@
+// Tests for the device memory sub-allocator.
+// The free list tests are pure CPU, the VeDevice tests need a Vulkan driver (a software ICD such as lavapipe works).
+#include <catch2/catch_test_macros.hpp>
+#include <core/ve_allocator.hpp>
+#include <core/ve_buffer.hpp>
+#include <core/ve_image.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+
+using DS = vk::DeviceSize;
+
+TEST_CASE("VeFreeList allocates aligned ranges first fit", "[allocator][freelist]") {
+	ve::VeFreeList list{DS{1024}};
+
+	auto a = list.allocate(DS{10}, DS{1});
+	REQUIRE(a.has_value());
+	REQUIRE(*a == DS{0});
+
+	// Next allocation is pushed to the alignment, the padding stays free
+	auto b = list.allocate(DS{64}, DS{256});
+	REQUIRE(b.has_value());
+	REQUIRE(*b == DS{256});
+	REQUIRE(list.getFreeBytes() == DS{1024 - 10 - 64});
+
+	// The padding in front of b is reused for a small allocation
+	auto c = list.allocate(DS{100}, DS{4});
+	REQUIRE(c.has_value());
+	REQUIRE(*c == DS{12});
+
+	// Too big for any remaining range
+	REQUIRE_FALSE(list.allocate(DS{1024}, DS{1}).has_value());
+}
+
+TEST_CASE("VeFreeList coalesces neighbouring ranges on free", "[allocator][freelist]") {
+	ve::VeFreeList list{DS{300}};
+	auto a = list.allocate(DS{100}, DS{1});
+	auto b = list.allocate(DS{100}, DS{1});
+	auto c = list.allocate(DS{100}, DS{1});
+	REQUIRE((a && b && c));
+	REQUIRE(list.getFreeBytes() == DS{0});
+	REQUIRE(list.getFreeRangeCount() == 0);
+
+	list.free(*a, DS{100});
+	list.free(*c, DS{100});
+	REQUIRE(list.getFreeRangeCount() == 2);
+
+	// Freeing the middle merges everything back into one range
+	list.free(*b, DS{100});
+	REQUIRE(list.getFreeRangeCount() == 1);
+	REQUIRE(list.isEmpty());
+	REQUIRE(list.allocate(DS{300}, DS{1}).value() == DS{0});
+}
+
+TEST_CASE("VeAllocator packs many buffers into few device allocations", "[allocator][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	const auto before = device.getAllocator().getStats();
+	{
+		std::vector<std::unique_ptr<ve::VeBuffer>> buffers;
+		for (int i = 0; i < 512; i++) {
+			buffers.push_back(std::make_unique<ve::VeBuffer>(
+				device, DS{1024}, 1u,
+				vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+				vk::MemoryPropertyFlagBits::eDeviceLocal));
+		}
+		const auto stats = device.getAllocator().getStats();
+		REQUIRE(stats.allocation_count == before.allocation_count + 512);
+		REQUIRE(stats.getDeviceMemoryCount() <= before.getDeviceMemoryCount() + 1);
+		REQUIRE(stats.used_bytes <= stats.reserved_bytes);
+	}
+	// Ranges are returned when buffers are destroyed
+	REQUIRE(device.getAllocator().getStats().allocation_count == before.allocation_count);
+}
+
+TEST_CASE("VeAllocator keeps host visible sub-allocations disjoint", "[allocator][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))};
+	const auto host = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	ve::VeBuffer a{device, DS{256}, 1u, vk::BufferUsageFlagBits::eUniformBuffer, host};
+	ve::VeBuffer b{device, DS{256}, 1u, vk::BufferUsageFlagBits::eUniformBuffer, host};
+	a.map();
+	b.map();
+	REQUIRE(a.getMappedMemory() != nullptr);
+	REQUIRE(b.getMappedMemory() != nullptr);
+
+	uint32_t value_a = 0xA5A5A5A5u, value_b = 0x5A5A5A5Au;
+	a.writeToBuffer(&value_a, sizeof(value_a));
+	b.writeToBuffer(&value_b, sizeof(value_b));
+	REQUIRE(*static_cast<uint32_t*>(a.getMappedMemory()) == value_a);
+	REQUIRE(*static_cast<uint32_t*>(b.getMappedMemory()) == value_b);
+}
+
+TEST_CASE("VeAllocator pads optimal images to bufferImageGranularity", "[allocator][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))};
+	const DS granularity = device.getDeviceProperties().limits.bufferImageGranularity;
+	ve::VeImage image{
+		device, 64, 64, vk::SampleCountFlagBits::e1, vk::Format::eR8G8B8A8Unorm,
+		vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eSampled,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor};
+	const auto& allocation = image.getImageMemory();
+	REQUIRE(allocation.getOffset() % granularity == 0);
+	REQUIRE(allocation.getSize() % granularity == 0);
+}
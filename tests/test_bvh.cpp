@@ -0,0 +1,196 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <game/ve_bvh.hpp>
+#include <game/ve_culling.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+static ve::VeFrustum makeFrustum() {
+	glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+	proj[1][1] *= -1.0f;
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return ve::VeFrustum::fromViewProj(proj * view);
+}
+
+// Boxes keyed by id like the game objects, spread so the density is the same for any count
+struct Scene {
+	explicit Scene(uint32_t count) {
+		const float half_size = 8.0f * std::cbrt(static_cast<float>(count));
+		position = std::uniform_real_distribution<float>(-half_size, half_size);
+		for (uint32_t id = 0; id < count; ++id) boxes[id] = randomBox();
+	}
+	ve::VeAabb randomBox() {
+		const glm::vec3 center{position(rng), position(rng), position(rng)};
+		return ve::VeAabb::fromCenterExtent(center, glm::vec3(extent(rng), extent(rng), extent(rng)));
+	}
+	std::vector<ve::VeBvh::Item> items() const {
+		std::vector<ve::VeBvh::Item> result;
+		for (const auto& [id, box] : boxes) result.push_back({box, id});
+		return result;
+	}
+
+	std::mt19937 rng{42u};
+	std::uniform_real_distribution<float> position;
+	std::uniform_real_distribution<float> extent{0.2f, 1.5f};
+	std::unordered_map<uint32_t, ve::VeAabb> boxes;
+};
+
+static std::vector<uint32_t> sorted(std::vector<uint32_t> ids) {
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+// Same slab test as VeBvh::raycast
+static std::optional<float> linearRaycast(const Scene& scene, const glm::vec3& origin, const glm::vec3& direction, float max_distance) {
+	std::optional<float> closest;
+	const glm::vec3 inv_direction = 1.0f / direction;
+	for (const auto& [id, box] : scene.boxes) {
+		const glm::vec3 t0 = (box.min - origin) * inv_direction;
+		const glm::vec3 t1 = (box.max - origin) * inv_direction;
+		const glm::vec3 t_near = glm::min(t0, t1);
+		const glm::vec3 t_far = glm::max(t0, t1);
+		const float enter = std::max({t_near.x, t_near.y, t_near.z, 0.0f});
+		const float exit = std::min({t_far.x, t_far.y, t_far.z, max_distance});
+		if (enter <= exit && (!closest || enter < *closest)) closest = enter;
+	}
+	return closest;
+}
+
+// Every query is compared against a linear scan over the same boxes
+static void requireQueriesMatch(const ve::VeBvh& bvh, Scene& scene, const ve::VeFrustum& frustum) {
+	REQUIRE(bvh.validate());
+	REQUIRE(bvh.getLeafCount() == scene.boxes.size());
+
+	std::vector<uint32_t> result;
+	std::vector<uint32_t> expected;
+	bvh.queryFrustum(frustum, result);
+	for (const auto& [id, box] : scene.boxes) {
+		if (frustum.intersectsAabb(box)) expected.push_back(id);
+	}
+	REQUIRE(sorted(result) == sorted(expected));
+
+	for (int i = 0; i < 20; ++i) {
+		const glm::vec3 center = scene.randomBox().getCenter();
+		const float radius = 10.0f;
+		expected.clear();
+		for (const auto& [id, box] : scene.boxes) {
+			if (box.getDistanceSquared(center) <= radius * radius) expected.push_back(id);
+		}
+		bvh.querySphere(center, radius, result);
+		REQUIRE(sorted(result) == sorted(expected));
+
+		const glm::vec3 origin = scene.randomBox().getCenter();
+		const glm::vec3 direction = glm::normalize(scene.randomBox().getCenter() - origin);
+		const auto hit = bvh.raycast(origin, direction, 1000.0f);
+		const auto expected_distance = linearRaycast(scene, origin, direction, 1000.0f);
+		REQUIRE(hit.has_value() == expected_distance.has_value());
+		if (hit) {
+			REQUIRE(hit->distance == *expected_distance);
+		}
+	}
+}
+
+TEST_CASE("VeBvh queries match a linear scan after a build", "[bvh]") {
+	Scene scene{5000};
+	ve::VeBvh bvh;
+	bvh.build(scene.items());
+	requireQueriesMatch(bvh, scene, makeFrustum());
+	REQUIRE(bvh.getHeight() < 32);
+}
+
+TEST_CASE("VeBvh stays consistent through inserts, removes and updates", "[bvh]") {
+	Scene scene{2000};
+	ve::VeBvh bvh;
+	std::unordered_map<uint32_t, uint32_t> proxies;
+	for (const auto& [id, box] : scene.boxes) proxies[id] = bvh.insert(box, id);
+	const ve::VeFrustum frustum = makeFrustum();
+	requireQueriesMatch(bvh, scene, frustum);
+
+	uint32_t next_id = static_cast<uint32_t>(scene.boxes.size());
+	for (int round = 0; round < 10; ++round) {
+		for (int i = 0; i < 100; ++i) {
+			auto it = std::next(scene.boxes.begin(), static_cast<std::ptrdiff_t>(scene.rng() % scene.boxes.size()));
+			bvh.remove(proxies[it->first]);
+			proxies.erase(it->first);
+			scene.boxes.erase(it);
+		}
+		for (int i = 0; i < 100; ++i) {
+			const ve::VeAabb box = scene.randomBox();
+			scene.boxes[next_id] = box;
+			proxies[next_id] = bvh.insert(box, next_id);
+			++next_id;
+		}
+		for (int i = 0; i < 200; ++i) {
+			auto it = std::next(scene.boxes.begin(), static_cast<std::ptrdiff_t>(scene.rng() % scene.boxes.size()));
+			it->second = scene.randomBox();
+			bvh.update(proxies[it->first], it->second);
+		}
+		requireQueriesMatch(bvh, scene, frustum);
+	}
+
+	for (const auto& [id, proxy] : proxies) bvh.remove(proxy);
+	REQUIRE(bvh.getLeafCount() == 0);
+	REQUIRE(bvh.validate());
+	REQUIRE_FALSE(bvh.raycast(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), 100.0f).has_value());
+}
+
+TEST_CASE("VeBvh SAH build gives a cheaper tree than insertion", "[bvh]") {
+	Scene scene{10000};
+	ve::VeBvh built;
+	built.build(scene.items());
+	ve::VeBvh inserted;
+	for (const auto& [id, box] : scene.boxes) inserted.insert(box, id);
+	REQUIRE(built.getSahCost() < inserted.getSahCost());
+}
+
+// Hidden, run with: test_bvhTests "[benchmark]"
+TEST_CASE("VeBvh frustum query against a linear scan", "[.][benchmark][bvh]") {
+	const ve::VeFrustum frustum = makeFrustum();
+	for (uint32_t count : {1'000u, 10'000u, 100'000u}) {
+		Scene scene{count};
+		const auto items = scene.items();
+		std::vector<uint32_t> proxies;
+		ve::VeBvh bvh;
+		bvh.build(items, &proxies);
+		ve::VeBoxCuller culler;
+		for (const auto& item : items) culler.add(item.box);
+		std::vector<uint32_t> visible;
+		visible.reserve(count);
+		const std::string suffix = ", " + std::to_string(count) + " objects";
+
+		BENCHMARK("linear scan" + suffix) {
+			visible.clear();
+			for (const auto& [id, box] : scene.boxes) {
+				if (frustum.intersectsAabb(box)) visible.push_back(id);
+			}
+			return visible.size();
+		};
+		BENCHMARK("VeBoxCuller" + suffix) {
+			return culler.cull(frustum, visible);
+		};
+		BENCHMARK("VeBvh" + suffix) {
+			bvh.queryFrustum(frustum, visible);
+			return visible.size();
+		};
+		// Moves 1% of the objects back and forth, each move refits the ancestors of its leaf
+		float offset = 0.5f;
+		BENCHMARK("VeBvh update 1%" + suffix) {
+			offset = -offset;
+			for (uint32_t i = 0; i < count; i += 100) {
+				const ve::VeAabb& box = items[i].box;
+				bvh.update(proxies[i], ve::VeAabb{ box.min + offset, box.max + offset });
+			}
+			return bvh.getHeight();
+		};
+		BENCHMARK("VeBvh build" + suffix) {
+			bvh.build(items);
+			return bvh.getHeight();
+		};
+	}
+}
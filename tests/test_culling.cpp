@@ -0,0 +1,102 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <game/ve_culling.hpp>
+#include <game/ve_frustum.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+// Camera at the origin looking down -z with a 90 degree fov, so the side planes are |x| = -z
+static ve::VeFrustum makeFrustum() {
+	glm::mat4 proj = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+	proj[1][1] *= -1.0f;
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return ve::VeFrustum::fromViewProj(proj * view);
+}
+
+// Boxes around the frustum, those within tolerance of a plane are skipped so the
+// paths agree even when the compiler contracts the scalar math into FMAs
+static void fillBoxes(ve::VeBoxCuller& culler, const ve::VeFrustum& frustum, uint32_t count) {
+	std::mt19937 rng{42u};
+	std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 2.0f);
+	culler.clear();
+	culler.reserve(count);
+	while (culler.size() < count) {
+		const glm::vec3 center{position(rng), position(rng), position(rng) - 60.0f};
+		const glm::vec3 half{extent(rng), extent(rng), extent(rng)};
+		bool near_plane = false;
+		for (const auto& plane : frustum.planes) {
+			const float d = glm::dot(glm::vec3(plane), center) + plane.w;
+			const float r = glm::dot(glm::abs(glm::vec3(plane)), half);
+			near_plane = near_plane || std::abs(d + r) < 1e-3f;
+		}
+		if (!near_plane) culler.add(ve::VeAabb::fromCenterExtent(center, half));
+	}
+}
+
+TEST_CASE("transformAabb bounds the rotated and scaled box", "[culling]") {
+	const ve::VeAabb box{ glm::vec3(-1.0f), glm::vec3(1.0f) };
+	glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, 0.0f, 0.0f));
+	transform = glm::rotate(transform, glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	transform = glm::scale(transform, glm::vec3(2.0f, 1.0f, 1.0f));
+	const ve::VeAabb world = ve::transformAabb(transform, box);
+	const float half_xy = (2.0f + 1.0f) * glm::sqrt(0.5f);
+	REQUIRE(std::abs(world.getCenter().x - 10.0f) < 1e-5f);
+	REQUIRE(std::abs(world.getExtent().x - half_xy) < 1e-5f);
+	REQUIRE(std::abs(world.getExtent().y - half_xy) < 1e-5f);
+	REQUIRE(std::abs(world.getExtent().z - 1.0f) < 1e-5f);
+}
+
+TEST_CASE("VeFrustum::intersectsAabb keeps boxes straddling a plane", "[culling]") {
+	const ve::VeFrustum frustum = makeFrustum();
+	REQUIRE(frustum.intersectsAabb(ve::VeAabb::fromCenterExtent({0.0f, 0.0f, -10.0f}, glm::vec3(1.0f))));
+	REQUIRE(frustum.intersectsAabb(ve::VeAabb::fromCenterExtent({-10.5f, 0.0f, -10.0f}, glm::vec3(1.0f))));
+	REQUIRE_FALSE(frustum.intersectsAabb(ve::VeAabb::fromCenterExtent({-20.0f, 0.0f, -10.0f}, glm::vec3(1.0f))));
+	REQUIRE_FALSE(frustum.intersectsAabb(ve::VeAabb::fromCenterExtent({0.0f, 0.0f, 10.0f}, glm::vec3(1.0f))));
+	REQUIRE_FALSE(frustum.intersectsAabb(ve::VeAabb::fromCenterExtent({0.0f, 0.0f, -200.0f}, glm::vec3(1.0f))));
+}
+
+TEST_CASE("VeBoxCuller paths return the same visible set as the scalar test", "[culling]") {
+	const ve::VeFrustum frustum = makeFrustum();
+	ve::VeBoxCuller culler;
+	fillBoxes(culler, frustum, 10003); // not a multiple of the SIMD width, covers the tail
+
+	std::vector<uint32_t> expected;
+	const uint32_t visible = culler.cull(frustum, expected, ve::VeBoxCuller::PATH_SCALAR);
+	REQUIRE(visible == expected.size());
+	REQUIRE(visible > 0);
+	REQUIRE(visible < culler.size());
+	REQUIRE(std::is_sorted(expected.begin(), expected.end()));
+
+	for (auto path : {ve::VeBoxCuller::PATH_SSE2, ve::VeBoxCuller::PATH_AVX2}) {
+		if (!ve::VeBoxCuller::isPathAvailable(path)) continue;
+		std::vector<uint32_t> result;
+		culler.cull(frustum, result, path);
+		INFO(ve::VeBoxCuller::getPathName(path));
+		REQUIRE(result == expected);
+	}
+
+	// Moving a box in view is picked up by set()
+	culler.set(0, ve::VeAabb::fromCenterExtent({0.0f, 0.0f, -10.0f}, glm::vec3(1.0f)));
+	culler.cull(frustum, expected);
+	REQUIRE(expected.front() == 0);
+}
+
+// Hidden, run with: test_cullingTests "[benchmark]"
+TEST_CASE("VeBoxCuller culls 1M boxes", "[.][benchmark][culling]") {
+	const ve::VeFrustum frustum = makeFrustum();
+	ve::VeBoxCuller culler;
+	fillBoxes(culler, frustum, 1'000'000);
+	std::vector<uint32_t> visible;
+	visible.reserve(culler.size());
+
+	for (auto path : {ve::VeBoxCuller::PATH_SCALAR, ve::VeBoxCuller::PATH_SSE2, ve::VeBoxCuller::PATH_AVX2}) {
+		if (!ve::VeBoxCuller::isPathAvailable(path)) continue;
+		BENCHMARK(std::string("1M boxes, ") + ve::VeBoxCuller::getPathName(path)) {
+			return culler.cull(frustum, visible, path);
+		};
+	}
+}
@@ -0,0 +1,30 @@
+// Tests for the descriptor pool chain, they need a Vulkan driver (a software ICD such as lavapipe works).
+#include <catch2/catch_test_macros.hpp>
+#include <core/ve_descriptors.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+
+#include <vector>
+
+TEST_CASE("VeDescriptorPool chains a new pool when the last one is exhausted", "[descriptors][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	auto pool = ve::VeDescriptorPool::Builder(device)
+		.setMaxSets(2)
+		.addPoolSize(vk::DescriptorType::eStorageBuffer, 2)
+		.setPoolFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+		.buildShared();
+	auto layout = ve::VeDescriptorSetLayout::Builder(device)
+		.addBinding(0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.build();
+
+	std::vector<vk::raii::DescriptorSet> sets;
+	for (int i = 0; i < 5; ++i) {
+		vk::raii::DescriptorSet set{nullptr};
+		pool->allocateDescriptor(layout->getDescriptorSetLayout(), set);
+		REQUIRE(*set);
+		sets.push_back(std::move(set));
+	}
+	REQUIRE(pool->getPoolCount() == 3);
+	// Sets are freed into the pool they came from
+	sets.clear();
+}
@@ -0,0 +1,43 @@
+#include <catch2/catch_test_macros.hpp>
+#include <core/ve_dynamic_resolution.hpp>
+
+// Frame time of a fill-rate bound scene, proportional to the rendered pixels
+static float simulatedTime(float full_resolution_ms, float scale) {
+	return full_resolution_ms * scale * scale;
+}
+
+TEST_CASE("VeDynamicResolution settles within the budget band", "[dynamic_resolution]") {
+	ve::VeDynamicResolution controller{10.0f, 0.25f, 1.0f};
+	REQUIRE(controller.getScale() == 1.0f);
+
+	// Twice the budget at full resolution settles near sqrt(1/2)
+	float scale = controller.getScale();
+	for (int frame = 0; frame < 500; ++frame)
+		scale = controller.update(simulatedTime(20.0f, scale));
+	const float settled_ms = simulatedTime(20.0f, scale);
+	REQUIRE(settled_ms <= 10.0f);
+	REQUIRE(settled_ms >= 10.0f * ve::VeDynamicResolution::HEADROOM * 0.9f);
+
+	// Within the band the scale holds
+	for (int frame = 0; frame < 100; ++frame)
+		REQUIRE(controller.update(simulatedTime(20.0f, scale)) == scale);
+
+	// A light scene goes back up to full resolution
+	for (int frame = 0; frame < 500; ++frame)
+		scale = controller.update(simulatedTime(2.0f, scale));
+	REQUIRE(scale == 1.0f);
+}
+
+TEST_CASE("VeDynamicResolution stays within its limits", "[dynamic_resolution]") {
+	ve::VeDynamicResolution controller{10.0f, 0.5f, 1.0f};
+	for (int frame = 0; frame < 200; ++frame)
+		controller.update(1000.0f);
+	REQUIRE(controller.getScale() == 0.5f);
+
+	// Frames without a measurement change nothing
+	REQUIRE(controller.update(0.0f) == 0.5f);
+
+	controller.reset();
+	REQUIRE(controller.getScale() == 1.0f);
+	REQUIRE(controller.getAverageTime() == 0.0f);
+}
@@ -0,0 +1,160 @@
+#include <catch2/catch_test_macros.hpp>
+#include <game/ve_frustum.hpp>
+#include <systems/cull_system.hpp>
+#include <game/ve_object_buffer.hpp>
+#include <core/ve_descriptors.hpp>
+#include <core/ve_frame_ring.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+// Camera at the origin looking down -z with a 90 degree fov, so the side planes are |x| = -z
+static glm::mat4 makeViewProj(bool flip_y) {
+	glm::mat4 proj = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+	if (flip_y) proj[1][1] *= -1.0f; // as VeCamera does for Vulkan
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return proj * view;
+}
+
+TEST_CASE("VeFrustum classifies spheres against all six planes", "[frustum]") {
+	for (bool flip_y : {false, true}) {
+		const ve::VeFrustum frustum = ve::VeFrustum::fromViewProj(makeViewProj(flip_y));
+		for (const auto& plane : frustum.planes) {
+			REQUIRE(std::abs(glm::length(glm::vec3(plane)) - 1.0f) < 1e-5f);
+		}
+		REQUIRE(frustum.intersectsSphere({0.0f, 0.0f, -10.0f}, 1.0f));
+		REQUIRE_FALSE(frustum.intersectsSphere({0.0f, 0.0f, 10.0f}, 1.0f));      // behind
+		REQUIRE_FALSE(frustum.intersectsSphere({0.0f, 0.0f, -0.05f}, 0.01f));    // before near
+		REQUIRE_FALSE(frustum.intersectsSphere({0.0f, 0.0f, -200.0f}, 1.0f));    // beyond far
+		REQUIRE(frustum.intersectsSphere({0.0f, 0.0f, -100.5f}, 1.0f));          // straddles far
+		REQUIRE_FALSE(frustum.intersectsSphere({-20.0f, 0.0f, -10.0f}, 1.0f));   // left
+		REQUIRE(frustum.intersectsSphere({-10.5f, 0.0f, -10.0f}, 1.0f));         // straddles left
+		REQUIRE_FALSE(frustum.intersectsSphere({0.0f, 20.0f, -10.0f}, 1.0f));    // top
+		REQUIRE_FALSE(frustum.intersectsSphere({0.0f, -20.0f, -10.0f}, 1.0f));   // bottom
+	}
+}
+
+TEST_CASE("transformSphere moves the center and scales the radius conservatively", "[frustum]") {
+	glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f));
+	transform = glm::scale(transform, glm::vec3(2.0f, 4.0f, 1.0f));
+	const glm::vec4 sphere = ve::transformSphere(transform, glm::vec4(1.0f, 0.0f, 0.0f, 0.5f));
+	REQUIRE(std::abs(sphere.x - 3.0f) < 1e-5f);
+	REQUIRE(std::abs(sphere.y - 2.0f) < 1e-5f);
+	REQUIRE(std::abs(sphere.z - 3.0f) < 1e-5f);
+	REQUIRE(std::abs(sphere.w - 2.0f) < 1e-5f);
+}
+
+// Needs a Vulkan driver (a software ICD such as lavapipe works) and the compiled cull_kernel.spv.
+// Compares the draws written by the kernel with the CPU reference, spheres that touch a plane
+// within float tolerance are left out so both sides see the same input. The slots hold model
+// space spheres, so the kernel's transform is covered, and every tenth slot is free.
+TEST_CASE("CullSystem writes the same visible set as the CPU reference", "[frustum][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	auto pool = ve::VeDescriptorPool::Builder(device)
+		// Twice the per frame sets, the ones replaced by growing stay in the retirement queue
+		.setMaxSets(2 * ve::MAX_FRAMES_IN_FLIGHT)
+		.addPoolSize(vk::DescriptorType::eUniformBufferDynamic, 2 * ve::MAX_FRAMES_IN_FLIGHT)
+		.addPoolSize(vk::DescriptorType::eStorageBuffer, 4 * ve::MAX_FRAMES_IN_FLIGHT + 1)
+		.setPoolFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+		.buildShared();
+	ve::VeFrameRing frame_ring{device};
+	auto object_set_layout = ve::VeDescriptorSetLayout::Builder(device)
+		.addBinding(0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.build();
+	ve::CullSystem cull_system{device, pool, frame_ring, object_set_layout->getDescriptorSetLayout(), "shaders/cull_kernel.spv", 64};
+
+	const ve::VeFrustum frustum = ve::VeFrustum::fromViewProj(makeViewProj(true));
+	std::mt19937 rng{1234u};
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> radius(0.1f, 3.0f);
+	std::vector<glm::vec4> spheres;
+	while (spheres.size() < 1000) {
+		const glm::vec4 sphere{position(rng), position(rng), position(rng) - 40.0f, radius(rng)};
+		const bool near_plane = std::ranges::any_of(frustum.planes, [&sphere](const glm::vec4& plane) {
+			return std::abs(glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w + sphere.w) < 1e-3f;
+		});
+		if (!near_plane) spheres.push_back(sphere);
+	}
+
+	// Two pages so the per page compaction is covered, the index count encodes the slot.
+	// Each slot scales a sphere of half the radius by two and moves it into place.
+	constexpr uint32_t page_count = 2;
+	const auto host = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	const uint32_t slot_count = static_cast<uint32_t>(spheres.size());
+	ve::VeBuffer objects{device, sizeof(ve::GpuObjectData), slot_count, vk::BufferUsageFlagBits::eStorageBuffer, host};
+	objects.map();
+	auto* slots = static_cast<ve::GpuObjectData*>(objects.getMappedMemory());
+	for (uint32_t i = 0; i < slot_count; ++i) {
+		const glm::mat4 transform = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(spheres[i])), glm::vec3(2.0f));
+		ve::GpuObjectData slot{};
+		for (int column = 0; column < 4; ++column)
+			slot.transform[column] = transform[column];
+		slot.bounding_sphere = glm::vec4(0.0f, 0.0f, 0.0f, 0.5f * spheres[i].w);
+		slot.index_count = i % 10 == 0 ? 0 : 3 + i;
+		slot.page = i % page_count;
+		slots[i] = slot;
+	}
+	auto objects_info = objects.getDescriptorInfo();
+	vk::raii::DescriptorSet object_set{nullptr};
+	ve::VeDescriptorWriter(*object_set_layout, *pool)
+		.writeBuffer(0, &objects_info)
+		.build(object_set);
+
+	std::vector<uint32_t> expected;
+	ve::cullSpheres(frustum, spheres, expected);
+	std::erase_if(expected, [](uint32_t i) { return i % 10 == 0; });
+	REQUIRE_FALSE(expected.empty());
+	REQUIRE(expected.size() < spheres.size());
+
+	vk::CommandBufferAllocateInfo alloc_info{
+		.commandPool = *device.getCommandPool(),
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = 1
+	};
+	auto command_buffer = std::move(vk::raii::CommandBuffers(device.getDevice(), alloc_info).front());
+	command_buffer.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	cull_system.record(*command_buffer, 0, frustum, *object_set, slot_count, page_count);
+	REQUIRE(cull_system.getCapacity() >= slot_count); // grew from 64
+
+	// Copy the results into host visible buffers after the dispatch
+	const vk::DeviceSize commands_size = ve::CullSystem::COMMAND_STRIDE * cull_system.getCapacity() * page_count;
+	ve::VeBuffer commands{device, commands_size, 1u, vk::BufferUsageFlagBits::eTransferDst, host};
+	ve::VeBuffer counts{device, vk::DeviceSize{sizeof(uint32_t)}, page_count, vk::BufferUsageFlagBits::eTransferDst, host};
+	vk::MemoryBarrier2 barrier{
+		.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+		.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+		.dstAccessMask = vk::AccessFlagBits2::eTransferRead
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier });
+	command_buffer.copyBuffer(cull_system.getCommandBuffer(0), *commands.getBuffer(), vk::BufferCopy{ 0, 0, commands_size });
+	command_buffer.copyBuffer(cull_system.getCountBuffer(0), *counts.getBuffer(), vk::BufferCopy{ 0, 0, sizeof(uint32_t) * page_count });
+	command_buffer.end();
+
+	vk::raii::Fence fence{device.getDevice(), vk::FenceCreateInfo{}};
+	vk::CommandBuffer cmd = *command_buffer;
+	device.getQueue().submit(vk::SubmitInfo{ .commandBufferCount = 1, .pCommandBuffers = &cmd }, *fence);
+	REQUIRE(device.getDevice().waitForFences(*fence, VK_TRUE, UINT64_MAX) == vk::Result::eSuccess);
+
+	commands.map();
+	counts.map();
+	const auto* draw_counts = static_cast<const uint32_t*>(counts.getMappedMemory());
+	const auto* draws = static_cast<const vk::DrawIndexedIndirectCommand*>(commands.getMappedMemory());
+	std::vector<uint32_t> visible;
+	for (uint32_t page = 0; page < page_count; ++page) {
+		const size_t first = cull_system.getCommandOffset(page) / ve::CullSystem::COMMAND_STRIDE;
+		for (uint32_t i = 0; i < draw_counts[page]; ++i) {
+			const auto& draw = draws[first + i];
+			REQUIRE(draw.instanceCount == 1);
+			REQUIRE(draw.firstInstance % page_count == page);
+			REQUIRE(draw.indexCount == 3 + draw.firstInstance);
+			visible.push_back(draw.firstInstance);
+		}
+	}
+	std::ranges::sort(visible);
+	REQUIRE(visible == expected);
+}
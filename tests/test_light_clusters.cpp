@@ -0,0 +1,136 @@
+#include <catch2/catch_test_macros.hpp>
+#include <systems/light_cluster_system.hpp>
+#include <core/ve_descriptors.hpp>
+#include <core/ve_frame_ring.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+TEST_CASE("computeLightRange ends where the attenuation reaches the cutoff", "[lights]") {
+	const float range = ve::computeLightRange(glm::vec3(1.0f, 0.5f, 0.0f), 0.3f);
+	const float attenuated = 0.3f / (0.01f * range * range + 0.1f);
+	REQUIRE(std::abs(attenuated - ve::LIGHT_CUTOFF) < 1e-5f);
+	REQUIRE(ve::computeLightRange(glm::vec3(0.0f), 1.0f) == 0.0f); // black lights light nothing
+	REQUIRE(ve::computeLightRange(glm::vec3(1.0f), 2.0f) > range);
+}
+
+// View space box of a cluster, the same math as light_cluster_kernel.slang
+static void clusterBox(const ve::VeCamera& camera, uint32_t cluster, glm::vec3& box_min, glm::vec3& box_max) {
+	const glm::uvec3 coord{
+		cluster % ve::LIGHT_CLUSTER_X,
+		(cluster / ve::LIGHT_CLUSTER_X) % ve::LIGHT_CLUSTER_Y,
+		cluster / (ve::LIGHT_CLUSTER_X * ve::LIGHT_CLUSTER_Y)};
+	const float near_plane = camera.getNearPlane();
+	const float slice_far = std::clamp(ve::LIGHT_CLUSTER_FAR, near_plane * 2.0f, camera.getFarPlane());
+	auto sliceDepth = [&](uint32_t slice) {
+		if (slice >= ve::LIGHT_CLUSTER_Z) return camera.getFarPlane();
+		return near_plane * std::pow(slice_far / near_plane, static_cast<float>(slice) / ve::LIGHT_CLUSTER_Z);
+	};
+	const glm::vec2 grid{ve::LIGHT_CLUSTER_X, ve::LIGHT_CLUSTER_Y};
+	const glm::vec2 proj{camera.getProj()[0][0], camera.getProj()[1][1]};
+	const glm::vec2 a = (glm::vec2(coord) / grid * 2.0f - 1.0f) / proj;
+	const glm::vec2 b = (glm::vec2(coord.x + 1, coord.y + 1) / grid * 2.0f - 1.0f) / proj;
+	const float depth_near = sliceDepth(coord.z);
+	const float depth_far = sliceDepth(coord.z + 1);
+	box_min = glm::vec3(glm::min(glm::min(a * depth_near, a * depth_far), glm::min(b * depth_near, b * depth_far)), -depth_far);
+	box_max = glm::vec3(glm::max(glm::max(a * depth_near, a * depth_far), glm::max(b * depth_near, b * depth_far)), -depth_near);
+}
+
+// Needs a Vulkan driver and the compiled light_cluster_kernel.spv. Lights within a small
+// tolerance of a cluster's range are not checked, the GPU log and pow differ slightly.
+TEST_CASE("LightClusterSystem assigns each light to the clusters its range touches", "[lights][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	auto pool = ve::VeDescriptorPool::Builder(device)
+		// Twice the per frame sets, the ones replaced by growing stay in the retirement queue
+		.setMaxSets(4 * ve::MAX_FRAMES_IN_FLIGHT)
+		.addPoolSize(vk::DescriptorType::eUniformBufferDynamic, 2 * ve::MAX_FRAMES_IN_FLIGHT)
+		.addPoolSize(vk::DescriptorType::eStorageBuffer, 12 * ve::MAX_FRAMES_IN_FLIGHT)
+		.setPoolFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+		.buildShared();
+	ve::VeFrameRing frame_ring{device};
+	ve::LightClusterSystem clusters{device, pool, frame_ring, "shaders/light_cluster_kernel.spv", 16};
+
+	ve::VeCamera camera{glm::vec3(0.0f, 0.0f, 10.0f)};
+	camera.setPerspective(glm::radians(80.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	camera.lookAt(glm::vec3(50.0f, 0.0f, 10.0f));
+	camera.updateIfDirty();
+
+	// More lights than the initial capacity and than a cluster holds in total
+	std::mt19937 rng{99u};
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> range(0.5f, 6.0f);
+	std::vector<ve::PointLight> lights;
+	for (uint32_t i = 0; i < 500; ++i) {
+		lights.push_back({
+			.position = glm::vec4(position(rng) + 100.0f, position(rng), position(rng) * 0.1f + 10.0f, range(rng)),
+			.color = glm::vec4(1.0f)
+		});
+	}
+	clusters.setLights(0, lights);
+	REQUIRE(clusters.getLightCapacity() >= lights.size());
+	REQUIRE(clusters.getLightCount(0) == lights.size());
+
+	vk::CommandBufferAllocateInfo alloc_info{
+		.commandPool = *device.getComputeCommandPool(),
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = 1
+	};
+	auto command_buffer = std::move(vk::raii::CommandBuffers(device.getDevice(), alloc_info).front());
+	command_buffer.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	const ve::LightClusterInfo info = clusters.record(*command_buffer, 0, camera, vk::Extent2D{1600, 900});
+	REQUIRE(info.grid == glm::uvec4(ve::LIGHT_CLUSTER_X, ve::LIGHT_CLUSTER_Y, ve::LIGHT_CLUSTER_Z, ve::LIGHT_CLUSTER_MAX_LIGHTS));
+	REQUIRE(std::abs(info.scale.x - ve::LIGHT_CLUSTER_X / 1600.0f) < 1e-7f);
+
+	// Copy the cluster lists into host visible buffers after the dispatch
+	constexpr uint32_t cluster_count = ve::LightClusterSystem::CLUSTER_COUNT;
+	const auto host = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	const vk::DeviceSize counts_size = sizeof(uint32_t) * cluster_count;
+	const vk::DeviceSize indices_size = counts_size * ve::LIGHT_CLUSTER_MAX_LIGHTS;
+	ve::VeBuffer counts{device, counts_size, 1u, vk::BufferUsageFlagBits::eTransferDst, host};
+	ve::VeBuffer indices{device, indices_size, 1u, vk::BufferUsageFlagBits::eTransferDst, host};
+	vk::MemoryBarrier2 barrier{
+		.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+		.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+		.dstAccessMask = vk::AccessFlagBits2::eTransferRead
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier });
+	command_buffer.copyBuffer(clusters.getCountBuffer(0), *counts.getBuffer(), vk::BufferCopy{ 0, 0, counts_size });
+	command_buffer.copyBuffer(clusters.getIndexBuffer(0), *indices.getBuffer(), vk::BufferCopy{ 0, 0, indices_size });
+	command_buffer.end();
+
+	vk::raii::Fence fence{device.getDevice(), vk::FenceCreateInfo{}};
+	vk::CommandBuffer cmd = *command_buffer;
+	device.getComputeQueue().submit(vk::SubmitInfo{ .commandBufferCount = 1, .pCommandBuffers = &cmd }, *fence);
+	REQUIRE(device.getDevice().waitForFences(*fence, VK_TRUE, UINT64_MAX) == vk::Result::eSuccess);
+
+	counts.map();
+	indices.map();
+	const auto* cluster_counts = static_cast<const uint32_t*>(counts.getMappedMemory());
+	const auto* cluster_lights = static_cast<const uint32_t*>(indices.getMappedMemory());
+	uint32_t assigned = 0;
+	for (uint32_t cluster = 0; cluster < cluster_count; ++cluster) {
+		const uint32_t count = cluster_counts[cluster];
+		REQUIRE(count <= ve::LIGHT_CLUSTER_MAX_LIGHTS);
+		const uint32_t* first = cluster_lights + cluster * ve::LIGHT_CLUSTER_MAX_LIGHTS;
+		assigned += count;
+		if (count == ve::LIGHT_CLUSTER_MAX_LIGHTS) continue; // full, which lights were dropped is not defined
+
+		glm::vec3 box_min, box_max;
+		clusterBox(camera, cluster, box_min, box_max);
+		for (uint32_t i = 0; i < lights.size(); ++i) {
+			const glm::vec3 view_pos = glm::vec3(camera.getView() * glm::vec4(glm::vec3(lights[i].position), 1.0f));
+			const float distance = glm::length(glm::clamp(view_pos, box_min, box_max) - view_pos);
+			const float light_range = lights[i].position.w;
+			if (std::abs(distance - light_range) < 1e-2f) continue;
+			const bool listed = std::find(first, first + count, i) != first + count;
+			INFO("cluster " << cluster << " light " << i);
+			REQUIRE(listed == (distance < light_range));
+		}
+	}
+	REQUIRE(assigned > 0);
+}
@@ -0,0 +1,50 @@
+// Tests for the mesh arena, they need a Vulkan driver (a software ICD such as lavapipe works).
+#include <catch2/catch_test_macros.hpp>
+#include <game/ve_mesh_arena.hpp>
+#include <game/ve_model.hpp>
+#include <core/ve_uploader.hpp>
+#include <core/ve_retirement_queue.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+
+static std::vector<ve::VeModel::Vertex> makeTriangle() {
+	return {
+		{ {0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f} },
+		{ {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f} },
+		{ {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f} }
+	};
+}
+
+TEST_CASE("VeMeshArena places models side by side in one page", "[mesh_arena][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	ve::VeMeshArena arena{device, sizeof(ve::VeModel::Vertex), 64, 64};
+	const auto vertices = makeTriangle();
+	const std::vector<uint32_t> indices{0, 1, 2};
+
+	{
+		ve::VeModel a{arena, vertices, indices};
+		ve::VeModel b{arena, vertices, indices};
+		REQUIRE(arena.getPageCount() == 1);
+		REQUIRE(a.getArenaPage() == b.getArenaPage());
+		REQUIRE(a.getVertexOffset() == 0);
+		REQUIRE(b.getVertexOffset() == 3);
+		REQUIRE(a.getFirstIndex() == 0);
+		REQUIRE(b.getFirstIndex() == 3);
+		REQUIRE(arena.getUsedVertexCount() == 6);
+		REQUIRE(arena.getUsedIndexCount() == 6);
+		device.getUploader().flushAndWait();
+	}
+	// Ranges are retired when the models are destroyed and returned once the frames finished
+	REQUIRE(arena.getUsedVertexCount() == 6);
+	device.getRetirementQueue().collect(UINT64_MAX);
+	REQUIRE(arena.getUsedVertexCount() == 0);
+	REQUIRE(arena.getUsedIndexCount() == 0);
+
+	// A mesh larger than the page capacity gets its own page
+	std::vector<ve::VeModel::Vertex> big(100, vertices[0]);
+	ve::VeModel c{arena, big};
+	REQUIRE(arena.getPageCount() == 2);
+	REQUIRE(c.getArenaPage() == 1);
+	REQUIRE(c.getIndexCount() == 0);
+	device.getUploader().flushAndWait();
+}
@@ -0,0 +1,89 @@
+#include <catch2/catch_test_macros.hpp>
+#include <game/ve_object_buffer.hpp>
+#include <game/ve_mesh_arena.hpp>
+#include <game/ve_model.hpp>
+#include <core/ve_uploader.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+
+// Records the staged copies and waits for them
+static void submitCopies(ve::VeDevice& device, ve::VeObjectBuffer& buffer) {
+	vk::CommandBufferAllocateInfo alloc_info{
+		.commandPool = *device.getCommandPool(),
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = 1
+	};
+	auto command_buffer = std::move(vk::raii::CommandBuffers(device.getDevice(), alloc_info).front());
+	command_buffer.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	buffer.record(*command_buffer);
+	command_buffer.end();
+	vk::raii::Fence fence{device.getDevice(), vk::FenceCreateInfo{}};
+	vk::CommandBuffer cmd = *command_buffer;
+	device.getQueue().submit(vk::SubmitInfo{ .commandBufferCount = 1, .pCommandBuffers = &cmd }, *fence);
+	REQUIRE(device.getDevice().waitForFences(*fence, VK_TRUE, UINT64_MAX) == vk::Result::eSuccess);
+}
+
+// Needs a Vulkan driver, the slot bookkeeping is checked, not the buffer contents
+TEST_CASE("VeObjectBuffer only stages new and changed objects", "[object_buffer][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	auto pool = ve::VeDescriptorPool::Builder(device)
+		.setMaxSets(2)
+		.addPoolSize(vk::DescriptorType::eStorageBuffer, 2)
+		.setPoolFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+		.buildShared();
+	ve::VeFrameRing frame_ring{device};
+	ve::VeMeshArena arena{device, sizeof(ve::VeModel::Vertex), 64, 64};
+	auto model = std::make_shared<ve::VeModel>(arena, std::vector<ve::VeModel::Vertex>{
+		{ {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f} },
+		{ {1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f} },
+		{ {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f} }});
+	device.getUploader().flushAndWait();
+
+	std::unordered_map<uint32_t, ve::VeGameObject> objects;
+	for (int i = 0; i < 3; ++i) {
+		auto obj = ve::VeGameObject::createGameObject();
+		obj.ve_model = model;
+		obj.transform.translation = glm::vec3(static_cast<float>(i), 0.0f, 0.0f);
+		objects.emplace(obj.getId(), std::move(obj));
+	}
+	auto light = ve::VeGameObject::createPointLight(); // no model, gets no slot
+	objects.emplace(light.getId(), std::move(light));
+
+	ve::VeObjectBuffer buffer{device, pool, 2};
+	frame_ring.beginFrame(0);
+	buffer.sync(objects, frame_ring);
+	REQUIRE(buffer.getObjects().size() == 3);
+	REQUIRE(buffer.getUploadCount() == 3);
+	REQUIRE(buffer.getCapacity() >= 3); // grew past the initial capacity
+	submitCopies(device, buffer);
+
+	frame_ring.beginFrame(1);
+	buffer.sync(objects, frame_ring);
+	REQUIRE(buffer.getUploadCount() == 0);
+
+	auto& moved = objects.begin()->second;
+	const uint32_t moved_id = moved.getId();
+	moved.transform.translation.z = 5.0f;
+	frame_ring.beginFrame(0);
+	buffer.sync(objects, frame_ring);
+	REQUIRE(buffer.getUploadCount() == 1);
+	REQUIRE(buffer.getTransform(buffer.getSlot(moved_id))[3].z == 5.0f);
+	submitCopies(device, buffer);
+
+	// A removed object frees its slot for the next new one
+	const uint32_t freed_slot = buffer.getSlot(moved_id);
+	objects.erase(moved_id);
+	frame_ring.beginFrame(1);
+	buffer.sync(objects, frame_ring);
+	REQUIRE(buffer.getObjects().size() == 2);
+	REQUIRE(buffer.getUploadCount() == 0);
+	auto added = ve::VeGameObject::createGameObject();
+	added.ve_model = model;
+	const uint32_t added_id = added.getId();
+	objects.emplace(added_id, std::move(added));
+	frame_ring.beginFrame(0);
+	buffer.sync(objects, frame_ring);
+	REQUIRE(buffer.getUploadCount() == 1);
+	REQUIRE(buffer.getSlot(added_id) == freed_slot);
+	submitCopies(device, buffer);
+}
@@ -0,0 +1,194 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <systems/particle_cpu_simulator.hpp>
+#include <systems/particle_system.hpp>
+#include <core/ve_descriptors.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_frame_ring.hpp>
+#include <core/ve_thread_pool.hpp>
+#include <core/ve_window.hpp>
+#include "particle_test_helpers.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Indexed by the path in the tests below, unavailable ones are skipped
+static constexpr ve::ParticleCpuSimulator::Path ALL_PATHS[] = {
+	ve::ParticleCpuSimulator::PATH_SCALAR, ve::ParticleCpuSimulator::PATH_SSE2, ve::ParticleCpuSimulator::PATH_AVX2
+};
+
+static ve::ParticleParams makeParams(int32_t mode, uint32_t reset_kind) {
+	ve::ParticleParams params{};
+	params.delta_time = 1.0f / 60.0f;
+	params.total_time = 1.0f;
+	params.seed = 1234u;
+	params.mean = 0.0f;
+	params.stddev = 6.0f;
+	params.reset_kind = reset_kind;
+	params.mode = mode;
+	params.origin = glm::vec3(30.0f, 0.0f, 10.0f);
+	return params;
+}
+
+static uint32_t resetKindOf(int32_t mode) {
+	return mode >= ve::ParticleMode::STASIS ? ve::ParticleResetKind::DISC : ve::ParticleResetKind::POINT;
+}
+
+TEST_CASE("ParticleCpuSimulator paths and threads agree with the scalar path", "[particles]") {
+	ve::VeThreadPool pool{3};
+	for (int32_t mode = ve::ParticleMode::GRAVITY_EARTH; mode <= ve::ParticleMode::GALAXY_MASSIVE; ++mode) {
+		ve::ParticleParams params = makeParams(mode, resetKindOf(mode));
+		// Not a multiple of the SIMD width or the chunk size, covers the tails
+		ve::ParticleCpuSimulator expected;
+		expected.resize(3 * ve::ParticleCpuSimulator::CHUNK_SIZE + 5);
+		expected.reset(params);
+
+		// The reset is the same on any number of threads
+		ve::ParticleCpuSimulator threaded;
+		threaded.resize(expected.size());
+		threaded.reset(params, &pool);
+		for (uint32_t i = 0; i < expected.size(); ++i) {
+			const ve::Particle a = threaded.getParticle(i);
+			const ve::Particle b = expected.getParticle(i);
+			REQUIRE(std::memcmp(&a, &b, sizeof(ve::Particle)) == 0);
+		}
+
+		std::vector<ve::ParticleCpuSimulator> simulators(std::size(ALL_PATHS), threaded);
+		for (int step = 0; step < 10; ++step) {
+			params.total_time += params.delta_time;
+			expected.simulate(params, ve::ParticleCpuSimulator::PATH_SCALAR);
+			for (auto path : ALL_PATHS) {
+				if (ve::ParticleCpuSimulator::isPathAvailable(path))
+					simulators[path].simulate(params, path, &pool);
+			}
+		}
+
+		for (auto path : ALL_PATHS) {
+			if (!ve::ParticleCpuSimulator::isPathAvailable(path)) continue;
+			INFO(ve::ParticleCpuSimulator::getPathName(path) << ", mode " << mode);
+			// Only rounding differs, e.g. where the compiler contracts the scalar math into FMAs
+			for (uint32_t i = 0; i < expected.size(); ++i) {
+				REQUIRE(near(simulators[path].getPosition(i), expected.getPosition(i), 1e-4f));
+				REQUIRE(near(simulators[path].getVelocity(i), expected.getVelocity(i), 1e-4f));
+			}
+		}
+	}
+}
+
+TEST_CASE("ParticleCpuSimulator keeps falling particles above the floor", "[particles]") {
+	ve::ParticleParams params = makeParams(ve::ParticleMode::GRAVITY_EARTH, ve::ParticleResetKind::POINT);
+	ve::ParticleCpuSimulator simulator;
+	simulator.resize(1000);
+	simulator.reset(params);
+	for (int step = 0; step < 600; ++step) simulator.simulate(params);
+	for (uint32_t i = 0; i < simulator.size(); ++i) {
+		REQUIRE(simulator.getPosition(i).z >= 0.1f);
+	}
+}
+
+// Needs a Vulkan driver and the compiled particle_compute.spv and particle_computec.spv.
+// Shader sin, cos and log are only accurate to about 2^-11 and velocities are stored as
+// halfs, so positions and velocities are compared to a relative 1e-3 and 2e-3.
+TEST_CASE("ParticleCpuSimulator matches the compute shader within tolerance", "[particles][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	auto pool = makePool(device);
+	auto global_set_layout = makeGlobalSetLayout(device);
+	ve::VeFrameRing frame_ring{device};
+	constexpr uint32_t count = 10000;
+	const glm::vec3 origin{30.0f, 0.0f, 10.0f};
+	ve::ParticleSystem system{device, pool, frame_ring, global_set_layout->getDescriptorSetLayout(), count, origin,
+		"shaders/particle_compute.spv", ve::ParticleStorageMode::IN_PLACE};
+	system.setFrustumCulling(false); // every particle is written in order
+
+	const float delta_time = 1.0f / 60.0f;
+	ve::ParticleCpuSimulator simulator;
+	simulator.resize(count);
+	for (int32_t mode = ve::ParticleMode::GRAVITY_EARTH; mode <= ve::ParticleMode::GALAXY_MASSIVE; ++mode) {
+		INFO("mode " << mode);
+		system.setMode(mode);
+		if (resetKindOf(mode) == ve::ParticleResetKind::DISC) system.resetDisc();
+		else system.resetPoint();
+
+		ve::ParticleParams params{};
+		params.particle_count = count;
+		params.seed = system.getResetSeed();
+		params.mean = system.getMean();
+		params.stddev = system.getStddev();
+		params.reset_kind = resetKindOf(mode);
+		params.mode = mode;
+		params.origin = origin;
+
+		// The reset dispatch
+		const std::vector<ve::Particle> reset = runUpdate(device, system, frame_ring, delta_time);
+		simulator.reset(params);
+		for (uint32_t i = 0; i < count; ++i) {
+			INFO("particle " << i);
+			const ve::Particle expected = simulator.getParticle(i);
+			REQUIRE(near(reset[i].position, expected.position, 1e-3f));
+			REQUIRE(near(reset[i].getVelocity(), expected.getVelocity(), 2e-3f));
+			REQUIRE(std::abs(reset[i].getSize() - expected.getSize()) < 1e-3f);
+			for (int channel = 0; channel < 4; ++channel) {
+				REQUIRE(std::abs(reset[i].getColor()[channel] - expected.getColor()[channel]) <= 1.5f / 255.0f);
+			}
+		}
+
+		// One step from the state of the shader, the total time restarts at the reset
+		for (uint32_t i = 0; i < count; ++i) simulator.setParticle(i, reset[i]);
+		const std::vector<ve::Particle> stepped = runUpdate(device, system, frame_ring, delta_time);
+		params.delta_time = delta_time;
+		params.total_time = delta_time;
+		simulator.simulate(params);
+		for (uint32_t i = 0; i < count; ++i) {
+			INFO("particle " << i);
+			REQUIRE(near(stepped[i].position, simulator.getPosition(i), 1e-3f));
+			REQUIRE(near(stepped[i].getVelocity(), simulator.getVelocity(i), 2e-3f));
+		}
+	}
+}
+
+// Best of a few steps in particles per second per core, the thread count divides the
+// throughput so the threaded runs show how well the chunks scale
+template <typename Fn>
+static void reportThroughput(const std::string& name, uint32_t count, uint32_t threads, Fn&& step) {
+	double best = std::numeric_limits<double>::max();
+	for (int run = 0; run < 10; ++run) {
+		const auto start = std::chrono::steady_clock::now();
+		step();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	const double per_core = static_cast<double>(count) / best / threads;
+	std::cout << name << ": " << per_core * 1e-6 << " M particles/s/core (" << threads << " threads)\n";
+}
+
+// Hidden, run with: test_particle_cpu_simulatorTests "[benchmark]". Besides the Catch2
+// timings every configuration prints its particles per second per core.
+TEST_CASE("ParticleCpuSimulator steps a million particles", "[.][benchmark][particles]") {
+	constexpr uint32_t count = 1'000'000;
+	ve::VeThreadPool pool;
+	for (int32_t mode : {ve::ParticleMode::COOL, ve::ParticleMode::GALAXY_MASSIVE}) {
+		ve::ParticleParams params = makeParams(mode, resetKindOf(mode));
+		ve::ParticleCpuSimulator simulator;
+		simulator.resize(count);
+		simulator.reset(params, &pool);
+		for (auto path : ALL_PATHS) {
+			if (!ve::ParticleCpuSimulator::isPathAvailable(path)) continue;
+			const std::string name = std::string(ve::ParticleCpuSimulator::getPathName(path)) + ", mode " + std::to_string(mode);
+			BENCHMARK(name + ", 1 thread") {
+				simulator.simulate(params, path);
+			};
+			BENCHMARK(name + ", " + std::to_string(pool.getThreadCount()) + " threads") {
+				simulator.simulate(params, path, &pool);
+			};
+			reportThroughput(name, count, 1, [&] { simulator.simulate(params, path); });
+			reportThroughput(name, count, pool.getThreadCount(), [&] { simulator.simulate(params, path, &pool); });
+		}
+	}
+}
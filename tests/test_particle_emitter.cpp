@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+#include <systems/particle_emitter_system.hpp>
+#include <core/ve_descriptors.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+
+#include <array>
+#include <cstring>
+
+// Runs one update of the emitter and reads back its counters and draw command
+static void runUpdate(ve::VeDevice& device, ve::ParticleEmitterSystem& emitter, uint32_t emit_count, float delta_time,
+	std::array<uint32_t, 5>& counters, vk::DrawIndirectCommand& draw) {
+	vk::CommandBufferAllocateInfo alloc_info{
+		.commandPool = *device.getComputeCommandPool(),
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = 1
+	};
+	auto command_buffer = std::move(vk::raii::CommandBuffers(device.getDevice(), alloc_info).front());
+	command_buffer.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	emitter.record(*command_buffer, 0, emit_count, delta_time);
+
+	const auto host = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	ve::VeBuffer counter_copy{device, sizeof(counters), 1u, vk::BufferUsageFlagBits::eTransferDst, host};
+	ve::VeBuffer draw_copy{device, sizeof(draw), 1u, vk::BufferUsageFlagBits::eTransferDst, host};
+	vk::MemoryBarrier2 barrier{
+		.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+		.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+		.dstAccessMask = vk::AccessFlagBits2::eTransferRead
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier });
+	command_buffer.copyBuffer(emitter.getCounterBuffer(), *counter_copy.getBuffer(), vk::BufferCopy{ 0, 0, sizeof(counters) });
+	command_buffer.copyBuffer(emitter.getIndirectBuffer(), *draw_copy.getBuffer(), vk::BufferCopy{ 0, 0, sizeof(draw) });
+	command_buffer.end();
+
+	vk::raii::Fence fence{device.getDevice(), vk::FenceCreateInfo{}};
+	vk::CommandBuffer cmd = *command_buffer;
+	device.getComputeQueue().submit(vk::SubmitInfo{ .commandBufferCount = 1, .pCommandBuffers = &cmd }, *fence);
+	REQUIRE(device.getDevice().waitForFences(*fence, VK_TRUE, UINT64_MAX) == vk::Result::eSuccess);
+
+	counter_copy.map();
+	draw_copy.map();
+	std::memcpy(counters.data(), counter_copy.getMappedMemory(), sizeof(counters));
+	std::memcpy(&draw, draw_copy.getMappedMemory(), sizeof(draw));
+}
+
+// Needs a Vulkan driver, the compiled particle_emitter_kernel.spv and particle_compute.spv.
+// Counters are dead, alive of list 0 and 1, emitted and first emitted slot.
+TEST_CASE("ParticleEmitterSystem recycles expired particles and draws the alive ones", "[particles][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	auto pool = ve::VeDescriptorPool::Builder(device)
+		.setMaxSets(ve::MAX_FRAMES_IN_FLIGHT)
+		.addPoolSize(vk::DescriptorType::eStorageBuffer, 6 * ve::MAX_FRAMES_IN_FLIGHT)
+		.setPoolFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+		.buildShared();
+	auto global_set_layout = ve::VeDescriptorSetLayout::Builder(device)
+		.addBinding(0, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eAllGraphics)
+		.build();
+	constexpr uint32_t capacity = 10000;
+	ve::ParticleEmitterSystem emitter{device, pool, global_set_layout->getDescriptorSetLayout(), capacity, glm::vec3(0.0f),
+		"shaders/particle_emitter_kernel.spv", "shaders/particle_compute.spv"};
+	emitter.setLifetime(1.0f);
+
+	std::array<uint32_t, 5> counters{};
+	vk::DrawIndirectCommand draw{};
+
+	// The first update resets the pool, then emits
+	runUpdate(device, emitter, 3000, 0.01f, counters, draw);
+	REQUIRE(counters[0] == capacity - 3000);
+	REQUIRE(counters[2] == 3000); // output list of the first update
+	REQUIRE(draw.vertexCount == 6);
+	REQUIRE(draw.instanceCount == 3000);
+	REQUIRE(emitter.getLastAliveCount(0) == 3000);
+
+	// Nothing expires yet, the alive lists swap
+	runUpdate(device, emitter, 1000, 0.01f, counters, draw);
+	REQUIRE(counters[0] == capacity - 4000);
+	REQUIRE(counters[1] == 4000);
+	REQUIRE(draw.instanceCount == 4000);
+
+	// Emission stops at an empty dead list
+	runUpdate(device, emitter, capacity, 0.01f, counters, draw);
+	REQUIRE(counters[0] == 0);
+	REQUIRE(counters[3] == capacity - 4000);
+	REQUIRE(draw.instanceCount == capacity);
+
+	// Everything outlives its lifetime and goes back to the dead list
+	runUpdate(device, emitter, 0, 2.0f, counters, draw);
+	REQUIRE(counters[0] == capacity);
+	REQUIRE(draw.instanceCount == 0);
+	REQUIRE(emitter.getLastAliveCount(0) == 0);
+
+	// An idle pool stays empty
+	runUpdate(device, emitter, 0, 0.01f, counters, draw);
+	REQUIRE(counters[0] == capacity);
+	REQUIRE(draw.instanceCount == 0);
+}
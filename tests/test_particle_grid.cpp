@@ -0,0 +1,213 @@
+#include <catch2/catch_test_macros.hpp>
+#include <systems/particle_grid_system.hpp>
+#include <systems/particle_system.hpp>
+#include <core/ve_descriptors.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+TEST_CASE("ParticleGridSystem::hashCell stays within the buckets", "[particles]") {
+	REQUIRE(ve::ParticleGridSystem::hashCell(glm::ivec3(0)) == 0u);
+	for (int i = -50; i < 50; ++i) {
+		REQUIRE(ve::ParticleGridSystem::hashCell(glm::ivec3(i, -i, 3 * i)) < ve::PARTICLE_GRID_CELLS);
+	}
+	// Neighboring cells land in different buckets
+	REQUIRE(ve::ParticleGridSystem::hashCell(glm::ivec3(1, 0, 0)) != ve::ParticleGridSystem::hashCell(glm::ivec3(0, 1, 0)));
+	REQUIRE(ve::ParticleGridSystem::hashCell(glm::ivec3(-1, 0, 0)) != ve::ParticleGridSystem::hashCell(glm::ivec3(1, 0, 0)));
+}
+
+// Particles spread uniformly over a cube of the given width
+static std::unique_ptr<ve::VeBuffer> makeParticles(ve::VeDevice& device, uint32_t count, float width, std::vector<ve::Particle>& particles) {
+	std::mt19937 rng{7u};
+	std::uniform_real_distribution<float> coordinate(-0.5f * width, 0.5f * width);
+	particles.resize(count);
+	for (auto& particle : particles) {
+		const glm::vec3 position{coordinate(rng), coordinate(rng), coordinate(rng)};
+		particle = ve::Particle::pack(position, 0.1f, glm::vec3(coordinate(rng), 0.0f, 0.0f), glm::vec4(1.0f));
+	}
+	auto buffer = std::make_unique<ve::VeBuffer>(device, sizeof(ve::Particle), count,
+		vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	buffer->map();
+	buffer->writeToBuffer(particles.data());
+	return buffer;
+}
+
+static std::shared_ptr<ve::VeDescriptorPool> makePool(ve::VeDevice& device) {
+	return ve::VeDescriptorPool::Builder(device)
+		// Kernel and query sets, the replaced ones stay in the retirement queue without frames to collect them
+		.setMaxSets(10)
+		.addPoolSize(vk::DescriptorType::eStorageBuffer, 50)
+		.setPoolFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+		.buildShared();
+}
+
+static vk::raii::CommandBuffer makeCommandBuffer(ve::VeDevice& device) {
+	vk::CommandBufferAllocateInfo alloc_info{
+		.commandPool = *device.getComputeCommandPool(),
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = 1
+	};
+	return std::move(vk::raii::CommandBuffers(device.getDevice(), alloc_info).front());
+}
+
+static void submitAndWait(ve::VeDevice& device, vk::raii::CommandBuffer& command_buffer, vk::raii::Fence& fence) {
+	vk::CommandBuffer cmd = *command_buffer;
+	device.getComputeQueue().submit(vk::SubmitInfo{ .commandBufferCount = 1, .pCommandBuffers = &cmd }, *fence);
+	REQUIRE(device.getDevice().waitForFences(*fence, VK_TRUE, UINT64_MAX) == vk::Result::eSuccess);
+	device.getDevice().resetFences(*fence);
+}
+
+// Needs a Vulkan driver and the compiled particle_grid_kernel.spv
+TEST_CASE("ParticleGridSystem sorts particles into buckets and finds their neighbors", "[particles][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	auto pool = makePool(device);
+	ve::ParticleGridSystem grid{device, pool, "shaders/particle_grid_kernel.spv"};
+
+	// About 4 particles per cell
+	constexpr uint32_t count = 4000;
+	constexpr float cell_size = 1.0f;
+	constexpr float radius = 0.8f;
+	std::vector<ve::Particle> particles;
+	std::vector<std::unique_ptr<ve::VeBuffer>> sources;
+	sources.push_back(makeParticles(device, count, 10.0f, particles));
+	grid.setParticleBuffers(sources);
+	grid.reserve(count);
+	REQUIRE(grid.getCapacity() >= count);
+
+	auto command_buffer = makeCommandBuffer(device);
+	command_buffer.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	grid.record(*command_buffer, 0, count, cell_size);
+	grid.recordQuery(*command_buffer, 0, count, cell_size, radius);
+
+	// Copy the grid into host visible buffers
+	const auto host = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	const vk::DeviceSize table_size = sizeof(uint32_t) * ve::PARTICLE_GRID_CELLS;
+	const vk::DeviceSize sorted_size = sizeof(glm::vec4) * 2 * count;
+	const vk::DeviceSize neighbors_size = sizeof(uint32_t) * count;
+	ve::VeBuffer counts{device, table_size, 1u, vk::BufferUsageFlagBits::eTransferDst, host};
+	ve::VeBuffer starts{device, table_size, 1u, vk::BufferUsageFlagBits::eTransferDst, host};
+	ve::VeBuffer sorted{device, sorted_size, 1u, vk::BufferUsageFlagBits::eTransferDst, host};
+	ve::VeBuffer neighbors{device, neighbors_size, 1u, vk::BufferUsageFlagBits::eTransferDst, host};
+	vk::MemoryBarrier2 barrier{
+		.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+		.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+		.dstAccessMask = vk::AccessFlagBits2::eTransferRead
+	};
+	command_buffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier });
+	command_buffer.copyBuffer(grid.getCellCountBuffer(), *counts.getBuffer(), vk::BufferCopy{ 0, 0, table_size });
+	command_buffer.copyBuffer(grid.getCellStartBuffer(), *starts.getBuffer(), vk::BufferCopy{ 0, 0, table_size });
+	command_buffer.copyBuffer(grid.getSortedBuffer(), *sorted.getBuffer(), vk::BufferCopy{ 0, 0, sorted_size });
+	command_buffer.copyBuffer(grid.getNeighborCountBuffer(), *neighbors.getBuffer(), vk::BufferCopy{ 0, 0, neighbors_size });
+	command_buffer.end();
+
+	vk::raii::Fence fence{device.getDevice(), vk::FenceCreateInfo{}};
+	submitAndWait(device, command_buffer, fence);
+
+	counts.map();
+	starts.map();
+	sorted.map();
+	neighbors.map();
+	const auto* cell_counts = static_cast<const uint32_t*>(counts.getMappedMemory());
+	const auto* cell_start = static_cast<const uint32_t*>(starts.getMappedMemory());
+	const auto* sorted_particles = static_cast<const glm::vec4*>(sorted.getMappedMemory()); // position, velocity
+	const auto* neighbor_counts = static_cast<const uint32_t*>(neighbors.getMappedMemory());
+
+	// Starts are the exclusive prefix sum of the counts
+	uint32_t total = 0;
+	for (uint32_t cell = 0; cell < ve::PARTICLE_GRID_CELLS; ++cell) {
+		INFO("bucket " << cell);
+		REQUIRE(cell_start[cell] == total);
+		total += cell_counts[cell];
+	}
+	REQUIRE(total == count);
+
+	// Every sorted particle lies in the bucket whose range holds it
+	for (uint32_t cell = 0; cell < ve::PARTICLE_GRID_CELLS; ++cell) {
+		for (uint32_t j = cell_start[cell]; j < cell_start[cell] + cell_counts[cell]; ++j) {
+			const glm::vec3 position{sorted_particles[2 * j]};
+			REQUIRE(ve::ParticleGridSystem::hashCell(glm::ivec3(glm::floor(position / cell_size))) == cell);
+		}
+	}
+
+	// Neighbor counts match brute force, pairs within a tolerance of the radius are skipped
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t expected = 0;
+		bool borderline = false;
+		for (uint32_t j = 0; j < count; ++j) {
+			const float distance = glm::length(particles[i].position - particles[j].position);
+			borderline = borderline || std::abs(distance - radius) < 1e-4f;
+			if (distance <= radius) ++expected;
+		}
+		if (borderline) continue;
+		INFO("particle " << i);
+		REQUIRE(neighbor_counts[i] == expected); // includes the particle itself
+	}
+}
+
+// Best GPU time in ms of 10 submits of one dispatch sequence, taken from timestamps
+// written around it so the submit and the fence wait are not included
+template <typename Fn>
+static double timeDispatches(ve::VeDevice& device, vk::raii::Fence& fence, Fn&& record) {
+	const vk::QueryPoolCreateInfo pool_info{ .queryType = vk::QueryType::eTimestamp, .queryCount = 2 };
+	vk::raii::QueryPool queries{device.getDevice(), pool_info};
+	auto command_buffer = makeCommandBuffer(device);
+	command_buffer.begin(vk::CommandBufferBeginInfo{});
+	command_buffer.resetQueryPool(*queries, 0, 2);
+	command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *queries, 0);
+	record(*command_buffer);
+	command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *queries, 1);
+	command_buffer.end();
+
+	const double period_ms = device.getDeviceProperties().limits.timestampPeriod * 1e-6;
+	double best = std::numeric_limits<double>::max();
+	for (int run = 0; run < 10; ++run) {
+		submitAndWait(device, command_buffer, fence);
+		auto [result, timestamps] = queries.getResults<uint64_t>(
+			0, 2, 2 * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+		REQUIRE(result == vk::Result::eSuccess);
+		best = std::min(best, static_cast<double>(timestamps[1] - timestamps[0]) * period_ms);
+	}
+	return best;
+}
+
+// Hidden, run with: test_particle_gridTests "[benchmark]". Prints the GPU time of the
+// build and the query dispatches per million particles, about 1 particle per cell like
+// a dense simulation.
+TEST_CASE("ParticleGridSystem builds and queries millions of particles", "[.][benchmark][particles]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))};
+	const auto queue_families = device.getPhysicalDevice().getQueueFamilyProperties();
+	if (queue_families[device.getComputeQueueFamilyIndex()].timestampValidBits == 0)
+		SKIP("Compute queue has no timestamp support");
+	auto pool = makePool(device);
+	ve::ParticleGridSystem grid{device, pool, "shaders/particle_grid_kernel.spv"};
+	vk::raii::Fence fence{device.getDevice(), vk::FenceCreateInfo{}};
+
+	for (uint32_t millions : {1u, 4u}) {
+		const uint32_t count = millions * 1'000'000u;
+		std::vector<ve::Particle> particles;
+		std::vector<std::unique_ptr<ve::VeBuffer>> sources;
+		sources.push_back(makeParticles(device, count, 100.0f * std::cbrt(static_cast<float>(millions)), particles));
+		grid.setParticleBuffers(sources);
+		grid.reserve(count);
+
+		// The query reads the grid of the last build, which every build run leaves the same
+		const double build_ms = timeDispatches(device, fence, [&](vk::CommandBuffer cmd) {
+			grid.record(cmd, 0, count, 1.0f);
+		});
+		const double query_ms = timeDispatches(device, fence, [&](vk::CommandBuffer cmd) {
+			grid.recordQuery(cmd, 0, count, 1.0f, 1.0f);
+		});
+		std::cout << millions << "M particles: build " << build_ms / millions << " ms/M, query "
+			<< query_ms / millions << " ms/M\n";
+		device.getDevice().waitIdle();
+	}
+}
@@ -0,0 +1,27 @@
+#include <catch2/catch_test_macros.hpp>
+#include <systems/particle_system.hpp>
+
+#include <cmath>
+
+TEST_CASE("Particle packs velocity and size into halfs and color into bytes", "[particles]") {
+	const glm::vec3 position{-120.25f, 3.5f, 1e4f};
+	const glm::vec3 velocity{35.0f, -0.02f, 9.81f};
+	const glm::vec4 color{1.0f, 0.6f, 0.0f, 1.0f};
+	const ve::Particle particle = ve::Particle::pack(position, 0.13f, velocity, color);
+
+	REQUIRE(particle.position == position); // full precision, particles travel far from the origin
+	for (int axis = 0; axis < 3; ++axis) {
+		// Halfs keep 11 significant bits
+		REQUIRE(std::abs(particle.getVelocity()[axis] - velocity[axis]) <= std::abs(velocity[axis]) / 1024.0f);
+	}
+	REQUIRE(std::abs(particle.getSize() - 0.13f) <= 0.13f / 1024.0f);
+	for (int channel = 0; channel < 4; ++channel) {
+		REQUIRE(std::abs(particle.getColor()[channel] - color[channel]) <= 0.5f / 255.0f);
+	}
+
+	// The size is read as the first half of its vertex attribute
+	const auto attributes = ve::Particle::getAttributeDescriptions();
+	REQUIRE(attributes.size() == 3);
+	REQUIRE(attributes[2].offset == offsetof(ve::Particle, size_velocity_z));
+	REQUIRE(ve::Particle::getBindingDescription()[0].stride == 24);
+}
@@ -0,0 +1,61 @@
+#include <catch2/catch_test_macros.hpp>
+#include <systems/particle_cpu_simulator.hpp>
+#include <systems/particle_system.hpp>
+#include <core/ve_frame_ring.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+#include "particle_test_helpers.hpp"
+
+#include <vector>
+
+// Needs a Vulkan driver and the compiled particle shaders. Growth copies the live particles
+// into the new buffers on the GPU and only initializes the added ones.
+TEST_CASE("ParticleSystem grows without restarting its particles", "[particles][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))};
+	auto pool = makePool(device);
+	auto global_set_layout = makeGlobalSetLayout(device);
+	ve::VeFrameRing frame_ring{device};
+	constexpr uint32_t count = 10000;
+	const glm::vec3 origin{30.0f, 0.0f, 10.0f};
+	ve::ParticleSystem system{device, pool, frame_ring, global_set_layout->getDescriptorSetLayout(), count, origin,
+		"shaders/particle_compute.spv", ve::ParticleStorageMode::PER_FRAME};
+	system.setFrustumCulling(false);
+	system.setMode(ve::ParticleMode::COOL);
+	const float delta_time = 1.0f / 60.0f;
+	const std::vector<ve::Particle> before = runUpdate(device, system, frame_ring, delta_time);
+
+	system.setParticleCount(2 * count);
+	REQUIRE(system.getParticleCount() == 2 * count);
+	REQUIRE(system.getCapacity() >= 2 * count);
+	const std::vector<ve::Particle> after = runUpdate(device, system, frame_ring, delta_time);
+
+	ve::ParticleParams params{};
+	params.delta_time = delta_time;
+	params.total_time = delta_time;
+	params.seed = system.getResetSeed();
+	params.mean = system.getMean();
+	params.stddev = system.getStddev();
+	params.reset_kind = ve::ParticleResetKind::POINT;
+	params.mode = ve::ParticleMode::COOL;
+	params.origin = origin;
+
+	// The live particles took one step from where they were
+	ve::ParticleCpuSimulator simulator;
+	simulator.resize(count);
+	for (uint32_t i = 0; i < count; ++i) simulator.setParticle(i, before[i]);
+	simulator.simulate(params);
+	for (uint32_t i = 0; i < count; ++i) {
+		INFO("particle " << i);
+		REQUIRE(near(after[i].position, simulator.getPosition(i), 1e-3f));
+	}
+
+	// Only the tail was reset
+	params.reset_first = count;
+	ve::ParticleCpuSimulator tail;
+	tail.resize(2 * count);
+	tail.reset(params);
+	for (uint32_t i = count; i < 2 * count; ++i) {
+		INFO("particle " << i);
+		REQUIRE(near(after[i].position, tail.getPosition(i), 1e-3f));
+	}
+}
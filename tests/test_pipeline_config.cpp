@@ -50,5 +50,7 @@ TEST_CASE("defaultPipelineConfigInfo sets sane Vulkan defaults", "[pipeline][con
 
     // Color format left undefined until swapchain format chosen
     REQUIRE(cfg.color_format == vk::Format::eUndefined);
+    // Depth format of the scene attachments
+    REQUIRE(cfg.depth_format == dummy_device.findDepthFormat());
 }
 
@@ -0,0 +1,166 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <core/ve_render_queue.hpp>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// Packets are only sorted here, never recorded, so the handles need not be real
+template <typename Handle>
+static Handle fakeHandle(uint64_t value) {
+	return Handle(reinterpret_cast<typename Handle::CType>(value));
+}
+
+static ve::VeDrawPacket makePacket(uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t id) {
+	return ve::VeDrawPacket{
+		.type = ve::VeDrawPacket::DRAW_INDEXED,
+		.pipeline = fakeHandle<vk::Pipeline>(0x1000 + pipeline),
+		.pipeline_layout = fakeHandle<vk::PipelineLayout>(0x2000 + pipeline),
+		.descriptor_sets = {fakeHandle<vk::DescriptorSet>(0x3000), fakeHandle<vk::DescriptorSet>(0x4000 + material)},
+		.descriptor_set_count = 2,
+		.dynamic_offset = 256,
+		.vertex_buffers = {fakeHandle<vk::Buffer>(0x5000 + mesh)},
+		.vertex_buffer_count = 1,
+		.index_buffer = fakeHandle<vk::Buffer>(0x6000 + mesh),
+		.count = id // identifies the packet after sorting
+	};
+}
+
+TEST_CASE("makeSortKey orders by pass first and by depth last", "[render_queue]") {
+	using Q = ve::VeRenderQueue;
+	REQUIRE(Q::makeSortKey(Q::PASS_BACKGROUND, 200, 9000, 9000, 1e6f) < Q::makeSortKey(Q::PASS_OPAQUE, 0, 0, 0, 0.0f));
+	REQUIRE(Q::makeSortKey(Q::PASS_OPAQUE, 1, 0, 0, 0.0f) > Q::makeSortKey(Q::PASS_OPAQUE, 0, 5, 5, 1e6f));
+	REQUIRE(Q::makeSortKey(Q::PASS_OPAQUE, 0, 1, 0, 0.0f) > Q::makeSortKey(Q::PASS_OPAQUE, 0, 0, 5, 1e6f));
+	REQUIRE(Q::makeSortKey(Q::PASS_OPAQUE, 0, 0, 1, 0.0f) > Q::makeSortKey(Q::PASS_OPAQUE, 0, 0, 0, 1e6f));
+	// Front to back for opaque, back to front for transparent
+	REQUIRE(Q::makeSortKey(Q::PASS_OPAQUE, 0, 0, 0, 2.0f) < Q::makeSortKey(Q::PASS_OPAQUE, 0, 0, 0, 3.0f));
+	REQUIRE(Q::makeSortKey(Q::PASS_TRANSPARENT, 0, 0, 0, 2.0f) > Q::makeSortKey(Q::PASS_TRANSPARENT, 0, 0, 0, 3.0f));
+	// Behind the camera sorts like depth 0
+	REQUIRE(Q::makeSortKey(Q::PASS_OPAQUE, 0, 0, 0, -5.0f) == Q::makeSortKey(Q::PASS_OPAQUE, 0, 0, 0, 0.0f));
+}
+
+TEST_CASE("VeRenderQueue groups packets by state and keeps each pass in depth order", "[render_queue]") {
+	ve::VeRenderQueue queue;
+	queue.begin(glm::mat4(1.0f));
+	std::mt19937 rng{7u};
+	std::uniform_real_distribution<float> depth(0.1f, 500.0f);
+	auto pick = [&](uint32_t count) { return static_cast<uint32_t>(rng() % count); };
+	std::vector<float> depths;
+	for (uint32_t id = 0; id < 5000; ++id) {
+		const auto pass = static_cast<ve::VeRenderQueue::Pass>(pick(3));
+		depths.push_back(pick(4) == 0 ? 10.0f : depth(rng)); // some equal depths to check stability
+		queue.submit(pass, depths.back(), makePacket(pick(3), pick(4), pick(5), id));
+	}
+	queue.sort();
+	REQUIRE(queue.getPacketCount() == 5000);
+
+	std::vector<bool> seen(5000, false);
+	for (uint32_t i = 0; i < queue.getPacketCount(); ++i) {
+		const uint32_t id = queue.getSortedPacket(i).count;
+		REQUIRE_FALSE(seen[id]);
+		seen[id] = true;
+		if (i == 0)
+			continue;
+		REQUIRE(queue.getSortedKey(i - 1) <= queue.getSortedKey(i));
+		if (queue.getSortedKey(i - 1) == queue.getSortedKey(i)) {
+			REQUIRE(queue.getSortedPacket(i - 1).count < id); // equal keys keep their submission order
+		}
+	}
+
+	// Each pipeline, material and mesh combination of a pass is one contiguous run
+	const uint32_t depth_shift = ve::VeRenderQueue::DEPTH_BITS;
+	std::vector<uint64_t> runs;
+	for (uint32_t i = 0; i < queue.getPacketCount(); ++i) {
+		const uint64_t state = queue.getSortedKey(i) >> depth_shift;
+		if (runs.empty() || runs.back() != state)
+			runs.push_back(state);
+	}
+	std::vector<uint64_t> unique_runs = runs;
+	std::sort(unique_runs.begin(), unique_runs.end());
+	REQUIRE(std::unique(unique_runs.begin(), unique_runs.end()) == unique_runs.end());
+	REQUIRE(runs.size() <= 3 * 3 * 4 * 5);
+
+	// Depths within a run go front to back, or back to front in the transparent pass
+	for (uint32_t i = 1; i < queue.getPacketCount(); ++i) {
+		const uint64_t key = queue.getSortedKey(i);
+		if ((queue.getSortedKey(i - 1) >> depth_shift) != (key >> depth_shift))
+			continue;
+		const float previous = depths[queue.getSortedPacket(i - 1).count];
+		const float current = depths[queue.getSortedPacket(i).count];
+		const bool transparent = (key >> (64 - ve::VeRenderQueue::PASS_BITS)) == ve::VeRenderQueue::PASS_TRANSPARENT;
+		// Depths equal in the upper 24 bits of their float tie and keep submission order
+		const float tolerance = 1e-4f * std::max(previous, current);
+		REQUIRE((transparent ? previous + tolerance >= current : previous <= current + tolerance));
+	}
+
+	queue.begin(glm::mat4(1.0f));
+	REQUIRE(queue.getPacketCount() == 0);
+}
+
+TEST_CASE("VeRenderQueue counts the packets of a pass range", "[render_queue]") {
+	using Q = ve::VeRenderQueue;
+	Q queue;
+	queue.begin(glm::mat4(1.0f));
+	const Q::Pass passes[] = {Q::PASS_OIT, Q::PASS_OPAQUE, Q::PASS_TRANSPARENT, Q::PASS_OPAQUE, Q::PASS_BACKGROUND, Q::PASS_OIT};
+	for (uint32_t id = 0; id < 6; ++id)
+		queue.submit(passes[id], 1.0f, makePacket(0, 0, 0, id));
+	REQUIRE(queue.getPacketCount(Q::PASS_BACKGROUND, Q::PASS_TRANSPARENT) == 4);
+	REQUIRE(queue.getPacketCount(Q::PASS_OPAQUE, Q::PASS_OPAQUE) == 2);
+	REQUIRE(queue.getPacketCount(Q::PASS_OIT, Q::PASS_OIT) == 2);
+	REQUIRE(queue.getPacketCount(Q::PASS_BACKGROUND, Q::PASS_OIT) == queue.getPacketCount());
+
+	// The OIT packets sort last, after the passes recorded into the scene
+	queue.sort();
+	for (uint32_t i = 4; i < 6; ++i)
+		REQUIRE((queue.getSortedKey(i) >> (64 - Q::PASS_BITS)) == Q::PASS_OIT);
+
+	queue.begin(glm::mat4(1.0f));
+	REQUIRE(queue.getPacketCount(Q::PASS_BACKGROUND, Q::PASS_OIT) == 0);
+}
+
+TEST_CASE("VeRenderQueue::getViewDepth is the distance in front of the camera", "[render_queue]") {
+	ve::VeRenderQueue queue;
+	glm::mat4 view(1.0f);
+	view[3] = glm::vec4(0.0f, 0.0f, -4.0f, 1.0f); // camera at z = 4 looking down -z
+	queue.begin(view);
+	REQUIRE(queue.getViewDepth(glm::vec3(0.0f)) == 4.0f);
+	REQUIRE(queue.getViewDepth(glm::vec3(1.0f, 2.0f, 1.0f)) == 3.0f);
+}
+
+// Hidden, run with: test_render_queueTests "[benchmark]"
+TEST_CASE("VeRenderQueue radix sort against std::sort", "[.][benchmark][render_queue]") {
+	for (uint32_t count : {1'000u, 10'000u, 100'000u}) {
+		std::mt19937 rng{1u};
+		std::uniform_real_distribution<float> depth(0.1f, 500.0f);
+		auto pick = [&](uint32_t range) { return static_cast<uint32_t>(rng() % range); };
+		std::vector<ve::VeDrawPacket> packets;
+		std::vector<float> depths;
+		for (uint32_t id = 0; id < count; ++id) {
+			packets.push_back(makePacket(pick(8), pick(64), pick(256), id));
+			depths.push_back(depth(rng));
+		}
+		ve::VeRenderQueue queue;
+		const std::string suffix = ", " + std::to_string(count) + " packets";
+
+		BENCHMARK("submit and radix sort" + suffix) {
+			queue.begin(glm::mat4(1.0f));
+			for (uint32_t i = 0; i < count; ++i)
+				queue.submit(ve::VeRenderQueue::PASS_OPAQUE, depths[i], packets[i]);
+			queue.sort();
+			return queue.getSortedKey(0);
+		};
+		BENCHMARK("submit and std::sort of the keys" + suffix) {
+			queue.begin(glm::mat4(1.0f));
+			std::vector<std::pair<uint64_t, uint32_t>> keys;
+			keys.reserve(count);
+			for (uint32_t i = 0; i < count; ++i) {
+				queue.submit(ve::VeRenderQueue::PASS_OPAQUE, depths[i], packets[i]);
+				keys.emplace_back(queue.getSortedKey(i), i); // not sorted yet, submission order
+			}
+			std::sort(keys.begin(), keys.end());
+			return keys.front().first;
+		};
+	}
+}
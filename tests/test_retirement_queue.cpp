@@ -0,0 +1,59 @@
+// Tests for the deferred destruction queue, they need a Vulkan driver (a software ICD such as lavapipe works).
+#include <catch2/catch_test_macros.hpp>
+#include <core/ve_retirement_queue.hpp>
+#include <core/ve_uploader.hpp>
+#include <core/ve_buffer.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+
+#include <memory>
+#include <utility>
+
+// Sets its flag when destroyed, moved-from probes do not
+struct Probe {
+	explicit Probe(bool* flag) : released(flag) {}
+	Probe(Probe&& other) noexcept : released(std::exchange(other.released, nullptr)) {}
+	~Probe() { if (released) *released = true; }
+	bool* released;
+};
+
+TEST_CASE("VeRetirementQueue releases resources once their timeline value completed", "[retirement][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	ve::VeRetirementQueue& retirement = device.getRetirementQueue();
+	bool first = false, second = false;
+
+	retirement.setFrameValue(4);
+	retirement.retire(Probe{&first});
+	retirement.retire(Probe{&second}, 6); // used by a later frame
+	REQUIRE(retirement.size() == 2);
+
+	retirement.collect(3);
+	REQUIRE_FALSE(first);
+	retirement.collect(4);
+	REQUIRE(first);
+	REQUIRE_FALSE(second);
+	retirement.collect(6);
+	REQUIRE(second);
+	REQUIRE(retirement.size() == 0);
+}
+
+TEST_CASE("VeRetirementQueue waits for uploads recorded before the retirement", "[retirement][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))};
+	ve::VeRetirementQueue& retirement = device.getRetirementQueue();
+	ve::VeUploader& uploader = device.getUploader();
+	auto buffer = std::make_unique<ve::VeBuffer>(device, vk::DeviceSize{sizeof(uint32_t)}, 64u,
+		vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	uploader.fillBuffer(*buffer->getBuffer(), 0, 64 * sizeof(uint32_t), 0u);
+	bool released = false;
+	retirement.retire(std::move(buffer));
+	retirement.retire(Probe{&released});
+
+	// Every frame finished, but the fill is not even submitted
+	retirement.collect(UINT64_MAX);
+	REQUIRE_FALSE(released);
+	REQUIRE(retirement.size() == 2);
+	uploader.flushAndWait();
+	retirement.collect(UINT64_MAX);
+	REQUIRE(released);
+	REQUIRE(retirement.size() == 0);
+}
@@ -0,0 +1,23 @@
+#include <catch2/catch_test_macros.hpp>
+#include <core/ve_texture_registry.hpp>
+#include <core/ve_device.hpp>
+#include <core/ve_window.hpp>
+
+// Needs a Vulkan driver with descriptor indexing
+TEST_CASE("VeTextureRegistry hands out consecutive indices until it is full", "[textures][device]") {
+	ve::VeDevice device{*(new ve::VeWindow(800, 600, "Dummy"))}; // Dummy device for testing
+	ve::VeTexture texture{device, "textures/viking_room.png"};
+
+	ve::VeTextureRegistry registry{device, 2};
+	REQUIRE(registry.getCapacity() == 2);
+	REQUIRE(registry.getDescriptorSet());
+	REQUIRE(registry.add(texture) == 0);
+	REQUIRE(registry.add(texture) == 1); // the same texture may sit in several slots
+	REQUIRE(registry.getCount() == 2);
+	REQUIRE_THROWS_AS(registry.add(texture), std::runtime_error);
+	REQUIRE(registry.getCount() == 2);
+
+	ve::VeTextureRegistry large{device};
+	REQUIRE(large.getCapacity() <= ve::TEXTURE_REGISTRY_CAPACITY);
+	REQUIRE(large.getCapacity() > 0);
+}
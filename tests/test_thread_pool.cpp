@@ -0,0 +1,31 @@
+#include <catch2/catch_test_macros.hpp>
+#include <core/ve_thread_pool.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("VeThreadPool::parallelFor calls every index exactly once", "[thread_pool]") {
+	for (uint32_t workers : {0u, 1u, 3u}) {
+		ve::VeThreadPool pool{workers};
+		REQUIRE(pool.getThreadCount() == workers + 1);
+		for (uint32_t count : {0u, 1u, 7u, 1000u}) {
+			std::vector<std::atomic<uint32_t>> calls(count);
+			pool.parallelFor(count, [&](uint32_t i) { calls[i].fetch_add(1); });
+			for (const auto& c : calls) {
+				REQUIRE(c.load() == 1);
+			}
+		}
+	}
+}
+
+TEST_CASE("VeThreadPool::parallelFor rethrows and stays usable", "[thread_pool]") {
+	ve::VeThreadPool pool{2};
+	REQUIRE_THROWS_AS(pool.parallelFor(100, [](uint32_t i) {
+		if (i == 10) throw std::runtime_error("iteration failed");
+	}), std::runtime_error);
+
+	std::atomic<uint32_t> sum{0};
+	pool.parallelFor(100, [&](uint32_t i) { sum.fetch_add(i); });
+	REQUIRE(sum.load() == 4950);
+}